@@ -0,0 +1,67 @@
+/**
+ * @file benchmain.cpp
+ * @brief Entry point of the lithomaker_bench performance tool
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "corpusbench.h"
+#include "e2ebench.h"
+#include "kernelbench.h"
+#include "scalingbench.h"
+#include "schedulingbench.h"
+#include "version.h"
+
+namespace {
+
+void printUsage() {
+    QTextStream(stderr)
+        << "LithoMaker " << LITHOMAKER_VERSION << " performance benchmarks\n\n"
+        << "Usage: lithomaker_bench <suite> [options]\n\n"
+        << "Suites:\n"
+        << "  e2e         Load, mesh and export one image, compared with a baseline\n"
+        << "  kernels     Time individual hot loops and their variants\n"
+        << "  scaling     Strong and weak thread scaling of the parallel stages\n"
+        << "  scheduling  Preview latency while batch jobs run in the background\n"
+        << "  corpus      Generate the synthetic test images and check they are deterministic\n\n"
+        << "Run a suite with --help for its options.\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("lithomaker_bench");
+    app.setApplicationVersion(LITHOMAKER_VERSION);
+
+    QStringList arguments = app.arguments();
+    if (arguments.size() < 2) {
+        printUsage();
+        return 2;
+    }
+
+    // Suites parse the remaining options themselves
+    const QString suite = arguments.takeAt(1);
+    if (suite == QLatin1String("e2e")) {
+        return LithoMaker::Bench::runEndToEnd(arguments);
+    }
+    if (suite == QLatin1String("kernels")) {
+        return LithoMaker::Bench::runKernels(arguments);
+    }
+    if (suite == QLatin1String("scaling")) {
+        return LithoMaker::Bench::runScaling(arguments);
+    }
+    if (suite == QLatin1String("scheduling")) {
+        return LithoMaker::Bench::runScheduling(arguments);
+    }
+    if (suite == QLatin1String("corpus")) {
+        return LithoMaker::Bench::runCorpus(arguments);
+    }
+
+    printUsage();
+    return 2;
+}
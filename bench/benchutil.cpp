@@ -0,0 +1,156 @@
+/**
+ * @file benchutil.cpp
+ * @brief Shared benchmark helpers implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "benchutil.h"
+
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+double median(std::vector<double>& values) {
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    const double upper = values[middle];
+    if (values.size() % 2 == 1) {
+        return upper;
+    }
+    return (*std::max_element(values.begin(), values.begin() + middle) + upper) / 2.0;
+}
+
+} // namespace
+
+Stats summarize(std::vector<double> samples) {
+    Stats stats;
+    stats.samples = static_cast<int>(samples.size());
+    if (samples.empty()) {
+        return stats;
+    }
+    stats.min = *std::min_element(samples.begin(), samples.end());
+    stats.median = median(samples);
+    for (double& sample : samples) {
+        sample = std::abs(sample - stats.median);
+    }
+    stats.mad = median(samples);
+    return stats;
+}
+
+qint64 peakRssBytes() {
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return static_cast<qint64>(counters.PeakWorkingSetSize);
+    }
+    return 0;
+#elif defined(Q_OS_UNIX)
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(Q_OS_MACOS)
+    return static_cast<qint64>(usage.ru_maxrss);        // bytes
+#else
+    return static_cast<qint64>(usage.ru_maxrss) * 1024; // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
+
+void setOpenMpThreads(int threads) {
+#ifdef USE_OPENMP
+    omp_set_num_threads(threads > 0 ? threads : omp_get_num_procs());
+#else
+    Q_UNUSED(threads);
+#endif
+}
+
+int hardwareThreads() {
+#ifdef USE_OPENMP
+    return omp_get_num_procs();
+#else
+    return std::max(1, QThread::idealThreadCount());
+#endif
+}
+
+QSize parseSize(const QString& text) {
+    static const QRegularExpression pattern(QStringLiteral("^(\\d+)x(\\d+)$"));
+    const QRegularExpressionMatch match = pattern.match(text.trimmed());
+    if (!match.hasMatch()) {
+        return QSize();
+    }
+    return QSize(match.captured(1).toInt(), match.captured(2).toInt());
+}
+
+QStringList counterHeader(const QString& unit) {
+    return {QStringLiteral("IPC"), QStringLiteral("LLC miss B/%1").arg(unit),
+            QStringLiteral("br miss/%1").arg(unit)};
+}
+
+QStringList counterCells(const CounterValues& counters, double items) {
+    const QString unknown = QStringLiteral("-");
+    items = std::max(items, 1.0);
+    return {counters.ipc() >= 0.0 ? QString::number(counters.ipc(), 'f', 2) : unknown,
+            counters.isValid(CounterValues::CacheMisses)
+                ? QString::number(counters.missBytes() / items, 'f', 2) : unknown,
+            counters.isValid(CounterValues::BranchMisses)
+                ? QString::number(counters.value[CounterValues::BranchMisses] / items, 'f', 3)
+                : unknown};
+}
+
+void printTable(const QStringList& header, const QList<QStringList>& rows) {
+    QList<int> widths;
+    for (const QString& title : header) {
+        widths.append(title.size());
+    }
+    for (const QStringList& row : rows) {
+        for (int i = 0; i < row.size() && i < widths.size(); ++i) {
+            widths[i] = std::max(widths[i], static_cast<int>(row[i].size()));
+        }
+    }
+
+    QTextStream out(stdout);
+    auto printRow = [&](const QStringList& row) {
+        for (int i = 0; i < row.size() && i < widths.size(); ++i) {
+            // Names left-aligned, values right-aligned
+            out << (i == 0 ? row[i].leftJustified(widths[i]) : row[i].rightJustified(widths[i]));
+            out << (i + 1 < row.size() ? "  " : "\n");
+        }
+    };
+    printRow(header);
+    QStringList rule;
+    for (int width : widths) {
+        rule.append(QString(width, QLatin1Char('-')));
+    }
+    printRow(rule);
+    for (const QStringList& row : rows) {
+        printRow(row);
+    }
+    out.flush();
+}
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,132 @@
+/**
+ * @file benchutil.h
+ * @brief Timing, statistics and workload helpers shared by the benchmarks
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "perfcounters.h"
+
+#include <QElapsedTimer>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <utility>
+#include <vector>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Summary of repeated timings (ms)
+ *
+ * The median and the median absolute deviation are used rather than
+ * mean and standard deviation, so a few runs disturbed by the system
+ * do not move the result.
+ */
+struct Stats {
+    double median{0.0};
+    double mad{0.0};
+    double min{0.0};
+    int samples{0};
+    CounterValues counters; ///< Mean per timed run, if counters were read
+};
+
+/**
+ * @brief Summarize timing samples (ms)
+ */
+Stats summarize(std::vector<double> samples);
+
+/**
+ * @brief Time a function
+ * @param warmup Untimed runs first, to fill caches and fault in memory
+ * @param repeats Timed runs
+ * @param function Work to time
+ * @param counters Hardware counters to read around each timed run, or nullptr
+ */
+template <typename Function>
+Stats measure(int warmup, int repeats, Function&& function, PerfCounters* counters = nullptr) {
+    for (int i = 0; i < warmup; ++i) {
+        function();
+    }
+    std::vector<double> samples;
+    samples.reserve(static_cast<size_t>(repeats));
+    CounterValues counted;
+    QElapsedTimer timer;
+    for (int i = 0; i < repeats; ++i) {
+        // Counters are set up outside the timed part
+        if (counters) {
+            counters->start();
+        }
+        timer.start();
+        function();
+        samples.push_back(timer.nsecsElapsed() / 1e6);
+        if (counters) {
+            counted += counters->stop();
+        }
+    }
+    Stats stats = summarize(std::move(samples));
+    if (repeats > 0) {
+        counted /= repeats;
+    }
+    stats.counters = counted;
+    return stats;
+}
+
+/**
+ * @brief Highest resident set size of this process so far (bytes, 0 if unknown)
+ */
+qint64 peakRssBytes();
+
+/**
+ * @brief Number of threads OpenMP regions use from now on
+ * @param threads Thread count, or 0 for one per CPU
+ */
+void setOpenMpThreads(int threads);
+
+/**
+ * @brief Number of CPUs available for parallel stages
+ */
+int hardwareThreads();
+
+/**
+ * @brief Parse "WIDTHxHEIGHT"
+ * @return Invalid size on malformed input
+ */
+QSize parseSize(const QString& text);
+
+/**
+ * @brief Keep the compiler from discarding a computed value
+ */
+template <typename T>
+void doNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+/**
+ * @brief Column titles for hardware counter results
+ * @param unit Work item the per-item columns refer to, e.g. "tri"
+ */
+QStringList counterHeader(const QString& unit);
+
+/**
+ * @brief Table cells for hardware counter results: IPC, cache miss
+ *        traffic and branch misses per work item ("-" where unknown)
+ */
+QStringList counterCells(const CounterValues& counters, double items);
+
+/**
+ * @brief Print a table with aligned columns to stdout
+ */
+void printTable(const QStringList& header, const QList<QStringList>& rows);
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,170 @@
+/**
+ * @file corpusbench.cpp
+ * @brief Generation of the synthetic image corpus implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "corpusbench.h"
+#include "benchutil.h"
+#include "syntheticimage.h"
+
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+#include <algorithm>
+#include <optional>
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+// Over the pixels only; the padding at the end of each scan line is
+// not initialized
+QString digest(const QImage& image) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    const int rowBytes = image.width() * image.depth() / 8;
+    for (int y = 0; y < image.height(); ++y) {
+        hash.addData(QByteArrayView(image.constScanLine(y), rowBytes));
+    }
+    return QString::fromLatin1(hash.result().toHex().left(12));
+}
+
+} // namespace
+
+int runCorpus(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Generates the deterministic synthetic test images."));
+    parser.addHelpOption();
+    const QCommandLineOption outOption(QStringLiteral("out"),
+        QStringLiteral("Save the images as PNG files in this directory."), QStringLiteral("dir"));
+    const QCommandLineOption sizesOption(QStringLiteral("sizes"),
+        QStringLiteral("Comma-separated image sizes (default: 1000x1000,4000x4000)."),
+        QStringLiteral("list"), QStringLiteral("1000x1000,4000x4000"));
+    const QCommandLineOption patternsOption(QStringLiteral("patterns"),
+        QStringLiteral("Comma-separated patterns (default: all)."), QStringLiteral("list"));
+    const QCommandLineOption depthsOption(QStringLiteral("depths"),
+        QStringLiteral("Comma-separated bit depths, 8 or 16 (default: 8,16)."),
+        QStringLiteral("list"), QStringLiteral("8,16"));
+    const QCommandLineOption seedOption(QStringLiteral("seed"),
+        QStringLiteral("Seed of every image (default: 1)."), QStringLiteral("seed"),
+        QStringLiteral("1"));
+    const QCommandLineOption verifyOption(QStringLiteral("verify"),
+        QStringLiteral("Also generate every image on one thread and fail if it differs."));
+    parser.addOptions({outOption, sizesOption, patternsOption, depthsOption, seedOption,
+                       verifyOption});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    QList<QSize> sizes;
+    for (const QString& text : parser.value(sizesOption).split(',', Qt::SkipEmptyParts)) {
+        const QSize size = parseSize(text);
+        if (size.isEmpty()) {
+            err << "Invalid image size: " << text << Qt::endl;
+            return 2;
+        }
+        sizes.append(size);
+    }
+    QList<SyntheticPattern> patterns;
+    if (parser.isSet(patternsOption)) {
+        for (const QString& name : parser.value(patternsOption).split(',', Qt::SkipEmptyParts)) {
+            const std::optional<SyntheticPattern> pattern = parsePattern(name);
+            if (!pattern) {
+                err << "Unknown pattern: " << name << Qt::endl;
+                return 2;
+            }
+            patterns.append(*pattern);
+        }
+    } else {
+        patterns = syntheticPatterns();
+    }
+    QList<int> depths;
+    for (const QString& text : parser.value(depthsOption).split(',', Qt::SkipEmptyParts)) {
+        const int depth = text.toInt();
+        if (depth != 8 && depth != 16) {
+            err << "Bit depth must be 8 or 16: " << text << Qt::endl;
+            return 2;
+        }
+        depths.append(depth);
+    }
+    if (sizes.isEmpty() || patterns.isEmpty() || depths.isEmpty()) {
+        err << "Nothing to generate" << Qt::endl;
+        return 2;
+    }
+
+    QDir outDir;
+    if (parser.isSet(outOption)) {
+        outDir.setPath(parser.value(outOption));
+        if (!outDir.mkpath(QStringLiteral("."))) {
+            err << "Cannot create " << outDir.path() << Qt::endl;
+            return 2;
+        }
+    }
+    const bool verify = parser.isSet(verifyOption);
+    const quint32 seed = parser.value(seedOption).toUInt();
+
+    QStringList header{QStringLiteral("image"), QStringLiteral("ms"),
+                       QStringLiteral("Mpx/s"), QStringLiteral("digest")};
+    if (verify) {
+        header << QStringLiteral("1 thread");
+    }
+    QList<QStringList> rows;
+    bool deterministic = true;
+    for (const QSize& size : sizes) {
+        for (int depth : depths) {
+            for (SyntheticPattern pattern : patterns) {
+                SyntheticSpec spec;
+                spec.pattern = pattern;
+                spec.size = size;
+                spec.bitDepth = depth;
+                spec.seed = seed;
+
+                setOpenMpThreads(0);
+                QElapsedTimer timer;
+                timer.start();
+                const QImage image = generateSynthetic(spec);
+                const double ms = timer.nsecsElapsed() / 1e6;
+                if (image.isNull()) {
+                    err << "Cannot allocate a " << size.width() << "x" << size.height()
+                        << " image" << Qt::endl;
+                    return 2;
+                }
+
+                const QString fileName = corpusFileName(spec);
+                const double megapixels = double(size.width()) * size.height() / 1e6;
+                QStringList row{fileName, QString::number(ms, 'f', 1),
+                                QString::number(megapixels * 1000.0 / std::max(ms, 1e-3), 'f', 1),
+                                digest(image)};
+                if (verify) {
+                    setOpenMpThreads(1);
+                    const bool same = generateSynthetic(spec) == image;
+                    setOpenMpThreads(0);
+                    deterministic = deterministic && same;
+                    row << (same ? QStringLiteral("same") : QStringLiteral("DIFFERENT"));
+                }
+                rows.append(row);
+
+                if (parser.isSet(outOption) && !image.save(outDir.filePath(fileName))) {
+                    err << "Cannot write " << outDir.filePath(fileName) << Qt::endl;
+                    return 2;
+                }
+            }
+        }
+    }
+    printTable(header, rows);
+
+    if (!deterministic) {
+        err << "Generated images depend on the thread count" << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace Bench
+} // namespace LithoMaker
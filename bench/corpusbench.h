@@ -0,0 +1,30 @@
+/**
+ * @file corpusbench.h
+ * @brief Generation of the synthetic image corpus
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Generate synthetic images, optionally saving them as PNG files
+ * @param arguments Program name followed by the suite's options
+ * @return 0 on success, 1 if an image depends on the thread count,
+ *         2 on invalid options or write errors
+ *
+ * Prints the generation time and a digest of every image, so corpora
+ * made on different machines can be compared without moving files.
+ * With --verify each image is also generated on a single thread and
+ * must match the parallel result bit for bit.
+ */
+int runCorpus(const QStringList& arguments);
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,439 @@
+/**
+ * @file e2ebench.cpp
+ * @brief End-to-end performance suite implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "e2ebench.h"
+#include "benchutil.h"
+#include "syntheticimage.h"
+
+#include "core/imageloader.h"
+#include "core/memorystats.h"
+#include "export/gltfexporter.h"
+#include "export/objexporter.h"
+#include "export/stlexporter.h"
+#include "export/threemfexporter.h"
+#include "mesh/meshgenerator.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPair>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <optional>
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+/**
+ * @brief How a metric is judged: by its name's unit suffix
+ */
+enum class MetricKind {
+    Time,       ///< *_ms, lower is better
+    Throughput, ///< *_per_s, higher is better
+    Memory      ///< *_mb, lower is better
+};
+
+MetricKind metricKind(const QString& name) {
+    if (name.endsWith(QLatin1String("_per_s"))) {
+        return MetricKind::Throughput;
+    }
+    if (name.endsWith(QLatin1String("_mb"))) {
+        return MetricKind::Memory;
+    }
+    return MetricKind::Time;
+}
+
+struct Metric {
+    QString name;
+    double value{0.0};
+    double spread{0.0}; ///< Median absolute deviation of timed metrics
+};
+
+/**
+ * @brief Allowed relative change before a metric counts as a regression
+ */
+struct Tolerances {
+    double time{0.25};
+    double throughput{0.20};
+    double memory{0.10};
+    double minTimeMs{5.0}; ///< Smaller time differences are noise
+};
+
+QStringList exporterIds() {
+    QStringList ids = {QStringLiteral("stl"), QStringLiteral("stl_ascii")};
+#ifdef HAVE_ZLIB
+    ids << QStringLiteral("stl_gz");
+#endif
+#ifdef HAVE_ZSTD
+    ids << QStringLiteral("stl_zst");
+#endif
+    ids << QStringLiteral("obj") << QStringLiteral("3mf") << QStringLiteral("glb");
+    return ids;
+}
+
+/**
+ * @brief Exporters as configured by default in the application
+ */
+std::unique_ptr<Exporter> makeExporter(const QString& id) {
+    if (id == QLatin1String("stl")) {
+        return std::make_unique<StlExporter>(StlFormat::Binary);
+    }
+    if (id == QLatin1String("stl_ascii")) {
+        return std::make_unique<StlExporter>(StlFormat::Ascii);
+    }
+    if (id == QLatin1String("stl_gz") || id == QLatin1String("stl_zst")) {
+        auto exporter = std::make_unique<StlExporter>(StlFormat::Binary);
+        exporter->setCompression(id == QLatin1String("stl_gz") ? Compression::Gzip
+                                                               : Compression::Zstd);
+        return exporter;
+    }
+    if (id == QLatin1String("obj")) {
+        return std::make_unique<ObjExporter>();
+    }
+    if (id == QLatin1String("3mf")) {
+        auto exporter = std::make_unique<ThreeMfExporter>();
+        exporter->setUpright(true);
+        exporter->setThumbnail(true);
+        return exporter;
+    }
+    if (id == QLatin1String("glb")) {
+        return std::make_unique<GltfExporter>();
+    }
+    return nullptr;
+}
+
+QString formatValue(double value) {
+    return QString::number(value, 'f', value >= 1000.0 ? 0 : 2);
+}
+
+/**
+ * @brief Print measured against baseline values
+ * @return true if no metric regressed beyond its tolerance
+ */
+bool compare(const QList<Metric>& metrics, const QJsonObject& baseline,
+             const Tolerances& tolerances) {
+    QList<QStringList> rows;
+    bool passed = true;
+    for (const Metric& metric : metrics) {
+        QString measured = formatValue(metric.value);
+        if (metric.spread > 0.0) {
+            measured += QStringLiteral(" ±") + formatValue(metric.spread);
+        }
+        if (!baseline.contains(metric.name)) {
+            rows.append({metric.name, QStringLiteral("-"), measured, QStringLiteral("-"),
+                         QStringLiteral("new")});
+            continue;
+        }
+
+        const double base = baseline.value(metric.name).toDouble();
+        const double delta = base != 0.0 ? (metric.value - base) / base : 0.0;
+        const MetricKind kind = metricKind(metric.name);
+        // Positive when the metric got worse
+        const double worse = kind == MetricKind::Throughput ? -delta : delta;
+        const double tolerance = kind == MetricKind::Time ? tolerances.time
+                               : kind == MetricKind::Throughput ? tolerances.throughput
+                               : tolerances.memory;
+        const bool significant = kind != MetricKind::Time ||
+                                 std::abs(metric.value - base) >= tolerances.minTimeMs;
+
+        QString status = QStringLiteral("ok");
+        if (significant && worse > tolerance) {
+            status = QStringLiteral("REGRESSION");
+            passed = false;
+        } else if (significant && worse < -tolerance) {
+            status = QStringLiteral("improved");
+        }
+        rows.append({metric.name, formatValue(base), measured,
+                     QString::asprintf("%+.1f%%", delta * 100.0), status});
+    }
+    printTable({QStringLiteral("metric"), QStringLiteral("baseline"), QStringLiteral("measured"),
+                QStringLiteral("delta"), QStringLiteral("status")}, rows);
+    return passed;
+}
+
+} // namespace
+
+int runEndToEnd(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Times loading, mesh generation and every exporter for one image."));
+    parser.addHelpOption();
+    const QCommandLineOption nameOption(QStringLiteral("name"),
+        QStringLiteral("Workload name in the baseline (default: image name)."), QStringLiteral("name"));
+    const QCommandLineOption imageOption(QStringLiteral("image"),
+        QStringLiteral("Image file to process."), QStringLiteral("file"));
+    const QCommandLineOption syntheticOption(QStringLiteral("synthetic"),
+        QStringLiteral("Process a generated test image of this size instead."),
+        QStringLiteral("WIDTHxHEIGHT"));
+    const QCommandLineOption patternOption(QStringLiteral("pattern"),
+        QStringLiteral("Content of the generated image: gradient, noise, checkerboard, text, "
+                       "flat or mixed (default)."),
+        QStringLiteral("pattern"), QStringLiteral("mixed"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"),
+        QStringLiteral("Bits per pixel of the generated image, 8 (default) or 16."),
+        QStringLiteral("bits"), QStringLiteral("8"));
+    const QCommandLineOption seedOption(QStringLiteral("seed"),
+        QStringLiteral("Seed of the generated image (default: 1)."), QStringLiteral("seed"),
+        QStringLiteral("1"));
+    const QCommandLineOption exportersOption(QStringLiteral("exporters"),
+        QStringLiteral("Comma-separated exporters (default: %1).").arg(exporterIds().join(',')),
+        QStringLiteral("list"));
+    const QCommandLineOption repeatOption(QStringLiteral("repeat"),
+        QStringLiteral("Timed runs per stage (default: 3)."), QStringLiteral("count"),
+        QStringLiteral("3"));
+    const QCommandLineOption baselineOption(QStringLiteral("baseline"),
+        QStringLiteral("Baseline file to compare with."), QStringLiteral("file"));
+    const QCommandLineOption updateOption(QStringLiteral("update-baseline"),
+        QStringLiteral("Store the results in the baseline file instead of comparing "
+                       "(also enabled by LITHOMAKER_UPDATE_BASELINE=1)."));
+    const QCommandLineOption countersOption(QStringLiteral("counters"),
+        QStringLiteral("Also read hardware performance counters per stage (Linux)."));
+    const QCommandLineOption jsonOption(QStringLiteral("json"),
+        QStringLiteral("Also write the results and memory per subsystem to this JSON file."),
+        QStringLiteral("file"));
+    parser.addOptions({nameOption, imageOption, syntheticOption, patternOption, depthOption,
+                       seedOption, exportersOption, repeatOption, baselineOption, updateOption,
+                       countersOption, jsonOption});
+    parser.process(arguments);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        err << "Cannot create a temporary directory: " << workDir.errorString() << Qt::endl;
+        return 2;
+    }
+
+    QString imagePath = parser.value(imageOption);
+    QString name = QFileInfo(imagePath).completeBaseName();
+    if (parser.isSet(syntheticOption)) {
+        SyntheticSpec spec;
+        spec.size = parseSize(parser.value(syntheticOption));
+        if (spec.size.isEmpty()) {
+            err << "Invalid image size: " << parser.value(syntheticOption) << Qt::endl;
+            return 2;
+        }
+        const std::optional<SyntheticPattern> pattern = parsePattern(parser.value(patternOption));
+        if (!pattern) {
+            err << "Unknown pattern: " << parser.value(patternOption) << Qt::endl;
+            return 2;
+        }
+        spec.pattern = *pattern;
+        spec.bitDepth = parser.value(depthOption).toInt();
+        if (spec.bitDepth != 8 && spec.bitDepth != 16) {
+            err << "Bit depth must be 8 or 16: " << parser.value(depthOption) << Qt::endl;
+            return 2;
+        }
+        spec.seed = parser.value(seedOption).toUInt();
+        imagePath = workDir.filePath(corpusFileName(spec));
+        if (!generateSynthetic(spec).save(imagePath)) {
+            err << "Cannot write the test image to " << imagePath << Qt::endl;
+            return 2;
+        }
+
+        // "synthetic-WxH" for the default mixed image, as in older baselines
+        name = QStringLiteral("%1-%2x%3")
+            .arg(spec.pattern == SyntheticPattern::Mixed ? QStringLiteral("synthetic")
+                                                         : patternName(spec.pattern))
+            .arg(spec.size.width()).arg(spec.size.height());
+        if (spec.bitDepth != 8) {
+            name += QStringLiteral("-%1bit").arg(spec.bitDepth);
+        }
+        if (spec.seed != 1) {
+            name += QStringLiteral("-s%1").arg(spec.seed);
+        }
+    } else if (imagePath.isEmpty()) {
+        err << "Either --image or --synthetic is required" << Qt::endl;
+        return 2;
+    }
+    if (parser.isSet(nameOption)) {
+        name = parser.value(nameOption);
+    }
+
+    const int repeats = std::max(1, parser.value(repeatOption).toInt());
+    const QStringList exporters = parser.isSet(exportersOption)
+        ? parser.value(exportersOption).split(',', Qt::SkipEmptyParts) : exporterIds();
+
+    std::unique_ptr<PerfCounters> counters;
+    if (parser.isSet(countersOption)) {
+        counters = std::make_unique<PerfCounters>();
+        if (!counters->isAvailable()) {
+            QTextStream(stdout) << "Hardware counters unavailable: " << counters->reason() << Qt::endl;
+            counters.reset();
+        }
+    }
+
+    QList<Metric> metrics;
+    QList<QPair<QString, CounterValues>> stageCounters;
+
+    // Load
+    std::optional<ImageLoadResult> loaded;
+    const Stats load = measure(0, repeats, [&] { loaded = ImageLoader::load(imagePath); },
+                               counters.get());
+    if (!loaded) {
+        err << "Cannot load " << imagePath << Qt::endl;
+        return 2;
+    }
+    metrics.append({QStringLiteral("load_ms"), load.median, load.mad});
+    stageCounters.append({QStringLiteral("load"), load.counters});
+
+    // Mesh, from the image as MainWindow::prepareImage() passes it
+    QImage image = loaded->image;
+    image.invertPixels();
+    const MemoryLease imageMemory(MemorySubsystem::Image, image.sizeInBytes());
+    MeshGenerator generator{MeshConfig()};
+    QList<QVector3D> mesh;
+    const Stats meshing = measure(0, repeats, [&] {
+        mesh = QList<QVector3D>(); // Free the previous mesh first
+        mesh = generator.generate(image);
+    }, counters.get());
+    const qsizetype triangles = mesh.size() / 3;
+    metrics.append({QStringLiteral("mesh_ms"), meshing.median, meshing.mad});
+    stageCounters.append({QStringLiteral("mesh"), meshing.counters});
+    metrics.append({QStringLiteral("mesh_triangles_per_s"),
+                    triangles / std::max(meshing.median / 1000.0, 1e-9), 0.0});
+
+    // Export
+    for (const QString& id : exporters) {
+        std::unique_ptr<Exporter> exporter = makeExporter(id);
+        if (!exporter) {
+            err << "Unknown exporter: " << id << Qt::endl;
+            return 2;
+        }
+        const QString path = workDir.filePath(QStringLiteral("workload.") + exporter->extension());
+        ExportResult result;
+        const Stats stats = measure(0, repeats, [&] { result = exporter->exportMesh(mesh, path); },
+                                    counters.get());
+        QFile::remove(path);
+        if (!result.success) {
+            err << "Export to " << id << " failed: " << result.errorMessage << Qt::endl;
+            return 2;
+        }
+        metrics.append({QStringLiteral("export_%1_ms").arg(id), stats.median, stats.mad});
+        stageCounters.append({QStringLiteral("export %1").arg(id), stats.counters});
+    }
+
+    metrics.append({QStringLiteral("peak_rss_mb"), peakRssBytes() / (1024.0 * 1024.0), 0.0});
+
+    // Peaks per subsystem catch extra copies that the RSS peak hides
+    for (int i = 0; i < int(MemorySubsystem::Count); ++i) {
+        const auto subsystem = static_cast<MemorySubsystem>(i);
+        if (MemoryStats::peak(subsystem) > 0) {
+            metrics.append({QStringLiteral("peak_%1_mb").arg(MemoryStats::key(subsystem)),
+                            MemoryStats::peak(subsystem) / (1024.0 * 1024.0), 0.0});
+        }
+    }
+
+    out << "Workload " << name << ": " << image.width() << "x" << image.height() << ", "
+        << triangles << " triangles, " << QThread::idealThreadCount() << " threads, "
+        << repeats << " runs per stage" << Qt::endl;
+
+    if (counters) {
+        // Not part of the baseline: counts depend on the CPU model
+        QList<QStringList> rows;
+        for (const auto& stage : stageCounters) {
+            rows.append(QStringList{stage.first} + counterCells(stage.second, double(triangles)));
+        }
+        printTable(QStringList{QStringLiteral("stage")} + counterHeader(QStringLiteral("tri")), rows);
+        out << Qt::endl;
+    }
+
+    if (parser.isSet(jsonOption)) {
+        QJsonObject values;
+        for (const Metric& metric : metrics) {
+            values.insert(metric.name, std::round(metric.value * 1000.0) / 1000.0);
+        }
+        QJsonObject json;
+        json.insert(QStringLiteral("workload"), name);
+        json.insert(QStringLiteral("width"), image.width());
+        json.insert(QStringLiteral("height"), image.height());
+        json.insert(QStringLiteral("triangles"), static_cast<double>(triangles));
+        json.insert(QStringLiteral("metrics"), values);
+        json.insert(QStringLiteral("memory"), MemoryStats::toJson());
+        QFile jsonFile(parser.value(jsonOption));
+        if (!jsonFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            jsonFile.write(QJsonDocument(json).toJson(QJsonDocument::Indented)) < 0) {
+            err << "Cannot write " << jsonFile.fileName() << ": " << jsonFile.errorString() << Qt::endl;
+            return 2;
+        }
+    }
+
+    // Baseline
+    const QString baselinePath = parser.value(baselineOption);
+    if (baselinePath.isEmpty()) {
+        compare(metrics, QJsonObject(), Tolerances());
+        return 0;
+    }
+
+    QJsonObject root;
+    QFile baselineFile(baselinePath);
+    if (baselineFile.open(QIODevice::ReadOnly)) {
+        root = QJsonDocument::fromJson(baselineFile.readAll()).object();
+        baselineFile.close();
+    }
+    QJsonObject workloads = root.value(QStringLiteral("workloads")).toObject();
+
+    if (parser.isSet(updateOption) || qEnvironmentVariableIntValue("LITHOMAKER_UPDATE_BASELINE")) {
+        QJsonObject entry;
+        entry.insert(QStringLiteral("triangles"), static_cast<double>(triangles));
+        for (const Metric& metric : metrics) {
+            entry.insert(metric.name, std::round(metric.value * 1000.0) / 1000.0);
+        }
+        workloads.insert(name, entry);
+        root.insert(QStringLiteral("workloads"), workloads);
+        if (!baselineFile.open(QIODevice::WriteOnly | QIODevice::Truncate) ||
+            baselineFile.write(QJsonDocument(root).toJson(QJsonDocument::Indented)) < 0) {
+            err << "Cannot write " << baselinePath << ": " << baselineFile.errorString() << Qt::endl;
+            return 2;
+        }
+        compare(metrics, QJsonObject(), Tolerances());
+        out << "Baseline for " << name << " updated in " << baselinePath << Qt::endl;
+        return 0;
+    }
+
+    const QJsonObject tolerance = root.value(QStringLiteral("tolerance")).toObject();
+    Tolerances tolerances;
+    tolerances.time = tolerance.value(QStringLiteral("time")).toDouble(tolerances.time);
+    tolerances.throughput = tolerance.value(QStringLiteral("throughput")).toDouble(tolerances.throughput);
+    tolerances.memory = tolerance.value(QStringLiteral("memory")).toDouble(tolerances.memory);
+    tolerances.minTimeMs = tolerance.value(QStringLiteral("min_time_ms")).toDouble(tolerances.minTimeMs);
+
+    const QJsonObject entry = workloads.value(name).toObject();
+    if (entry.isEmpty()) {
+        // Loud, so a missing baseline is not mistaken for a pass
+        compare(metrics, QJsonObject(), tolerances);
+        out << "NO BASELINE for " << name << " in " << baselinePath
+            << ": nothing was checked. Record one on the reference machine with the "
+               "perf-baseline target (or --update-baseline)" << Qt::endl;
+        return 3;
+    }
+    if (entry.value(QStringLiteral("triangles")).toDouble() != static_cast<double>(triangles)) {
+        out << "Note: the baseline was recorded with "
+            << entry.value(QStringLiteral("triangles")).toDouble()
+            << " triangles, the mesh generator changed" << Qt::endl;
+    }
+
+    const bool passed = compare(metrics, entry, tolerances);
+    out << (passed ? "PASSED" : "FAILED") << " against " << baselinePath
+        << " (tolerances: time +" << tolerances.time * 100.0 << "%, throughput -"
+        << tolerances.throughput * 100.0 << "%, memory +" << tolerances.memory * 100.0 << "%)"
+        << Qt::endl;
+    return passed ? 0 : 1;
+}
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,31 @@
+/**
+ * @file e2ebench.h
+ * @brief End-to-end performance suite with baseline comparison
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Load, mesh and export one workload and compare with a baseline
+ * @param arguments Program name followed by the suite's options
+ * @return 0 on success, 1 if a metric regressed beyond the baseline's
+ *         tolerance, 2 if the workload could not be run, 3 if there is
+ *         no baseline to compare with (reported as skipped by CTest)
+ *
+ * Every stage is timed over several runs and its median reported, along
+ * with mesh throughput (triangles/s) and the peak resident set size of
+ * the process. Each workload is meant to run in its own process, so the
+ * peak belongs to it alone.
+ */
+int runEndToEnd(const QStringList& arguments);
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,260 @@
+/**
+ * @file kernelbench.cpp
+ * @brief Kernel microbenchmarks implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "kernelbench.h"
+#include "benchutil.h"
+#include "syntheticimage.h"
+
+#include "core/imageloader.h"
+#include "mesh/indexedmesh.h"
+#include "mesh/meshgenerator.h"
+#include "mesh/meshstages.h"
+
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <memory>
+
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+#include <charconv>
+#endif
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+/**
+ * @brief One way of running a kernel
+ */
+struct Variant {
+    QString name;
+    int threads{0}; ///< OpenMP threads, 0 for the default
+    std::function<void()> run;
+};
+
+struct Kernel {
+    QString name;
+    double items{0.0}; ///< Work per run, for the throughput column
+    QString unit;
+    bool heavy{false}; ///< Takes seconds per run: fewer repeats
+    QList<Variant> variants;
+};
+
+/**
+ * @brief Serial and parallel variants of an OpenMP kernel
+ */
+QList<Variant> threadVariants(const std::function<void()>& run) {
+    QList<Variant> variants = {{QStringLiteral("1 thread"), 1, run}};
+#ifdef USE_OPENMP
+    if (hardwareThreads() > 1) {
+        variants.append({QStringLiteral("%1 threads").arg(hardwareThreads()), hardwareThreads(), run});
+    }
+#endif
+    return variants;
+}
+
+QString formatRate(double perSecond, const QString& unit) {
+    static const char* const prefixes[] = {"", "k", "M", "G"};
+    int prefix = 0;
+    while (perSecond >= 1000.0 && prefix < 3) {
+        perSecond /= 1000.0;
+        ++prefix;
+    }
+    return QStringLiteral("%1 %2%3/s").arg(perSecond, 0, 'f', 1).arg(prefixes[prefix]).arg(unit);
+}
+
+} // namespace
+
+int runKernels(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Times the hot loops of loading, mesh generation and export."));
+    parser.addHelpOption();
+    const QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Size of the test image (default: 2000x2000)."), QStringLiteral("WIDTHxHEIGHT"),
+        QStringLiteral("2000x2000"));
+    const QCommandLineOption repeatOption(QStringLiteral("repeat"),
+        QStringLiteral("Timed runs per variant (default: 15)."), QStringLiteral("count"),
+        QStringLiteral("15"));
+    const QCommandLineOption warmupOption(QStringLiteral("warmup"),
+        QStringLiteral("Untimed runs before timing (default: 2)."), QStringLiteral("count"),
+        QStringLiteral("2"));
+    const QCommandLineOption filterOption(QStringLiteral("filter"),
+        QStringLiteral("Only run kernels whose name contains this text."), QStringLiteral("text"));
+    const QCommandLineOption countersOption(QStringLiteral("counters"),
+        QStringLiteral("Also read hardware performance counters (Linux)."));
+    parser.addOptions({sizeOption, repeatOption, warmupOption, filterOption, countersOption});
+    parser.process(arguments);
+
+    const QSize size = parseSize(parser.value(sizeOption));
+    if (size.width() < 2 || size.height() < 2) {
+        QTextStream(stderr) << "Invalid image size: " << parser.value(sizeOption) << Qt::endl;
+        return 2;
+    }
+    const int repeats = std::max(1, parser.value(repeatOption).toInt());
+    const int warmup = std::max(0, parser.value(warmupOption).toInt());
+    const QString filter = parser.value(filterOption);
+
+    // Inputs shared by all kernels
+    QImage image = generateSynthetic(size);
+    image.invertPixels();
+    MeshGenerator generator{MeshConfig()};
+    const QList<QVector3D> mesh = generator.generate(image);
+    MeshStages kernels(generator);
+    const QVector<float> depth = kernels.depthBuffer(image);
+    const double pixels = double(size.width()) * size.height();
+    const double triangles = double(mesh.size()) / 3.0;
+
+    MeshConfig reliefConfig;
+    reliefConfig.reliefMode = ReliefMode::BasRelief;
+    MeshGenerator reliefGenerator(reliefConfig);
+    reliefGenerator.generate(image.scaled(64, 64)); // Sets the scale factors
+    MeshStages reliefKernels(reliefGenerator);
+
+    // Coordinates as the text exporters format them
+    const qsizetype floatCount = std::min<qsizetype>(mesh.size(), 1 << 18) * 3;
+    const float* floats = reinterpret_cast<const float*>(mesh.constData());
+
+    QList<Kernel> list;
+    list.append({QStringLiteral("depth conversion"), pixels, QStringLiteral("px"), false,
+                 {{QStringLiteral("linear"), 0, [&] { doNotOptimize(kernels.depthBuffer(image)); }}}});
+    list.append({QStringLiteral("depth conversion, bas-relief"), pixels, QStringLiteral("px"), true,
+                 threadVariants([&] { doNotOptimize(reliefKernels.depthBuffer(image)); })});
+    list.append({QStringLiteral("surface emission"), triangles, QStringLiteral("tri"), false,
+                 threadVariants([&] {
+                     doNotOptimize(kernels.surfaceRows(depth, size.width(), size.height()));
+                 })});
+    list.append({QStringLiteral("vertex welding"), triangles, QStringLiteral("tri"), false,
+                 {{QStringLiteral("weld"), 0, [&] {
+                      doNotOptimize(IndexedMesh::fromTriangles(mesh).indices.size());
+                  }},
+                  {QStringLiteral("weld + cache order"), 0, [&] {
+                      IndexedMesh indexed = IndexedMesh::fromTriangles(mesh);
+                      indexed.optimizeVertexCache();
+                      doNotOptimize(indexed.indices.size());
+                  }}}});
+    list.append({QStringLiteral("float formatting"), double(floatCount), QStringLiteral("float"), false,
+                 {{QStringLiteral("QString::arg (ASCII STL)"), 0, [&] {
+                      qsizetype length = 0;
+                      for (qsizetype i = 0; i < floatCount; ++i) {
+                          length += QStringLiteral("%1").arg(double(floats[i]), 0, 'g', 6).size();
+                      }
+                      doNotOptimize(length);
+                  }},
+                  {QStringLiteral("QTextStream (OBJ)"), 0, [&] {
+                      QString text;
+                      QTextStream stream(&text);
+                      for (qsizetype i = 0; i < floatCount; ++i) {
+                          stream << floats[i] << ' ';
+                      }
+                      stream.flush();
+                      doNotOptimize(text.size());
+                  }},
+                  {QStringLiteral("snprintf %g"), 0, [&] {
+                      char buffer[32];
+                      qsizetype length = 0;
+                      for (qsizetype i = 0; i < floatCount; ++i) {
+                          length += std::snprintf(buffer, sizeof(buffer), "%g", double(floats[i]));
+                      }
+                      doNotOptimize(length);
+                  }},
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+                  {QStringLiteral("std::to_chars"), 0, [&] {
+                      char buffer[32];
+                      qsizetype length = 0;
+                      for (qsizetype i = 0; i < floatCount; ++i) {
+                          length += std::to_chars(buffer, buffer + sizeof(buffer), floats[i]).ptr - buffer;
+                      }
+                      doNotOptimize(length);
+                  }},
+#endif
+                 }});
+    list.append({QStringLiteral("normal calculation"), triangles, QStringLiteral("tri"), false,
+                 {{QStringLiteral("cross product"), 0, [&] {
+                      QVector3D sum;
+                      for (qsizetype i = 0; i + 2 < mesh.size(); i += 3) {
+                          sum += QVector3D::crossProduct(mesh[i + 1] - mesh[i],
+                                                         mesh[i + 2] - mesh[i]).normalized();
+                      }
+                      doNotOptimize(sum);
+                  }}}});
+    list.append({QStringLiteral("JPEG artifact scan"), pixels, QStringLiteral("px"), false,
+                 {{QStringLiteral("scan"), 0, [&] {
+                      doNotOptimize(ImageLoader::detectJpegArtifacts(image));
+                  }}}});
+    list.append({QStringLiteral("bounding box"), double(mesh.size()), QStringLiteral("vtx"), false,
+                 threadVariants([&] { doNotOptimize(computeBounds(mesh)); })});
+    list.append({QStringLiteral("resampling to half width"), pixels, QStringLiteral("px"), false,
+                 {{QStringLiteral("smooth (image loader)"), 0, [&] {
+                      doNotOptimize(image.scaledToWidth(size.width() / 2, Qt::SmoothTransformation));
+                  }},
+                  {QStringLiteral("nearest"), 0, [&] {
+                      doNotOptimize(image.scaledToWidth(size.width() / 2, Qt::FastTransformation));
+                  }}}});
+
+    QTextStream(stdout) << "Kernels on a " << size.width() << "x" << size.height() << " image ("
+                        << qsizetype(triangles) << " triangles), " << warmup << " warm-up and "
+                        << repeats << " timed runs, " << QThread::idealThreadCount()
+                        << " hardware threads" << Qt::endl << Qt::endl;
+
+    std::unique_ptr<PerfCounters> counters;
+    if (parser.isSet(countersOption)) {
+        counters = std::make_unique<PerfCounters>();
+        if (!counters->isAvailable()) {
+            QTextStream(stdout) << "Hardware counters unavailable: " << counters->reason()
+                                << Qt::endl << Qt::endl;
+            counters.reset();
+        }
+    }
+
+    QList<QStringList> rows;
+    for (const Kernel& kernel : list) {
+        if (!filter.isEmpty() && !kernel.name.contains(filter, Qt::CaseInsensitive)) {
+            continue;
+        }
+        const int kernelRepeats = kernel.heavy ? std::max(3, repeats / 5) : repeats;
+        const int kernelWarmup = kernel.heavy ? std::min(warmup, 1) : warmup;
+        double reference = 0.0;
+        for (const Variant& variant : kernel.variants) {
+            setOpenMpThreads(variant.threads);
+            const Stats stats = measure(kernelWarmup, kernelRepeats, variant.run, counters.get());
+            if (reference == 0.0) {
+                reference = stats.median;
+            }
+            QStringList row = {kernel.name, variant.name,
+                               QString::number(stats.median, 'f', 3), QString::number(stats.mad, 'f', 3),
+                               QString::number(stats.min, 'f', 3),
+                               formatRate(kernel.items / std::max(stats.median / 1000.0, 1e-9), kernel.unit),
+                               QStringLiteral("%1x").arg(reference / std::max(stats.median, 1e-9), 0, 'f', 2)};
+            if (counters) {
+                // Per-item columns are per pixel, triangle etc. depending on the kernel
+                row << counterCells(stats.counters, kernel.items);
+            }
+            rows.append(row);
+        }
+    }
+    setOpenMpThreads(0);
+
+    QStringList header = {QStringLiteral("kernel"), QStringLiteral("variant"),
+                          QStringLiteral("median ms"), QStringLiteral("MAD ms"),
+                          QStringLiteral("min ms"), QStringLiteral("throughput"),
+                          QStringLiteral("speedup")};
+    if (counters) {
+        header << counterHeader(QStringLiteral("item"));
+    }
+    printTable(header, rows);
+    return 0;
+}
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,29 @@
+/**
+ * @file kernelbench.h
+ * @brief Microbenchmarks of individual hot loops
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Time each kernel and its variants on fixed-size inputs
+ * @param arguments Program name followed by the suite's options
+ * @return 0 on success, 2 on invalid options
+ *
+ * Every kernel runs on the same generated image (and the mesh generated
+ * from it), with warm-up runs before the timed ones. Variants of a
+ * kernel, e.g. single- and multi-threaded, are listed together with
+ * their speedup over the first.
+ */
+int runKernels(const QStringList& arguments);
+
+} // namespace Bench
+} // namespace LithoMaker
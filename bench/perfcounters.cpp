@@ -0,0 +1,179 @@
+/**
+ * @file perfcounters.cpp
+ * @brief Hardware performance counter implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "perfcounters.h"
+
+#ifdef Q_OS_LINUX
+#include <QDir>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace LithoMaker {
+namespace Bench {
+
+double CounterValues::ipc() const {
+    if (!valid[Cycles] || !valid[Instructions] || value[Cycles] <= 0.0) {
+        return -1.0;
+    }
+    return value[Instructions] / value[Cycles];
+}
+
+CounterValues& CounterValues::operator+=(const CounterValues& other) {
+    for (int event = 0; event < EventCount; ++event) {
+        value[event] += other.value[event];
+        valid[event] = valid[event] || other.valid[event];
+    }
+    return *this;
+}
+
+CounterValues& CounterValues::operator/=(double divisor) {
+    for (double& v : value) {
+        v /= divisor;
+    }
+    return *this;
+}
+
+#ifdef Q_OS_LINUX
+
+namespace {
+
+const quint64 kEventConfig[CounterValues::EventCount] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int openCounter(quint64 config, pid_t thread, bool inherit) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, thread, -1, -1, 0));
+}
+
+QString describeError(int error) {
+    switch (error) {
+        case EACCES:
+        case EPERM:
+            return QStringLiteral("not permitted (see /proc/sys/kernel/perf_event_paranoid)");
+        case ENOENT:
+        case EOPNOTSUPP:
+            return QStringLiteral("not supported by this CPU or virtual machine");
+        case ENOSYS:
+            return QStringLiteral("perf_event_open is not available (blocked in containers by default)");
+        default:
+            return QString::fromLocal8Bit(std::strerror(error));
+    }
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+    // Probe each event on this thread; hardware without a PMU often
+    // lacks only some of them
+    int firstError = 0;
+    for (int event = 0; event < CounterValues::EventCount; ++event) {
+        const int fd = openCounter(kEventConfig[event], 0, false);
+        if (fd >= 0) {
+            m_supported[event] = true;
+            close(fd);
+        } else if (!firstError) {
+            firstError = errno;
+        }
+    }
+    m_available = m_supported[CounterValues::Cycles] || m_supported[CounterValues::Instructions];
+    if (!m_available) {
+        m_reason = describeError(firstError);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    stop();
+}
+
+void PerfCounters::start() {
+    if (!m_available) {
+        return;
+    }
+    stop();
+
+    const QStringList threads = QDir(QStringLiteral("/proc/self/task"))
+        .entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (int event = 0; event < CounterValues::EventCount; ++event) {
+        if (!m_supported[event]) {
+            continue;
+        }
+        for (const QString& thread : threads) {
+            // Threads may exit between listing and opening
+            const int fd = openCounter(kEventConfig[event], thread.toInt(), true);
+            if (fd >= 0) {
+                m_fds[event].append(fd);
+            }
+        }
+    }
+    for (const QVector<int>& fds : m_fds) {
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+CounterValues PerfCounters::stop() {
+    CounterValues values;
+    for (const QVector<int>& fds : m_fds) {
+        for (int fd : fds) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int event = 0; event < CounterValues::EventCount; ++event) {
+        for (int fd : m_fds[event]) {
+            quint64 data[3] = {}; // value, time enabled, time running
+            if (read(fd, data, sizeof(data)) == static_cast<ssize_t>(sizeof(data)) && data[2] > 0) {
+                values.value[event] += double(data[0]) * double(data[1]) / double(data[2]);
+                values.valid[event] = true;
+            }
+            close(fd);
+        }
+        m_fds[event].clear();
+    }
+    return values;
+}
+
+#else
+
+PerfCounters::PerfCounters()
+    : m_reason(QStringLiteral("only supported on Linux"))
+{
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::start() {
+}
+
+CounterValues PerfCounters::stop() {
+    return CounterValues();
+}
+
+#endif
+
+} // namespace Bench
+} // namespace LithoMaker
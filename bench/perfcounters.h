@@ -0,0 +1,92 @@
+/**
+ * @file perfcounters.h
+ * @brief Hardware performance counters around measured regions (Linux)
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Counter totals of one or more measured regions
+ */
+struct CounterValues {
+    enum Event {
+        Cycles,
+        Instructions,
+        CacheMisses, ///< Last level cache misses
+        BranchMisses,
+        EventCount
+    };
+
+    double value[EventCount] = {};
+    bool valid[EventCount] = {};
+
+    bool isValid(Event event) const { return valid[event]; }
+
+    /**
+     * @brief Instructions per cycle, or a negative value if unknown
+     */
+    double ipc() const;
+
+    /**
+     * @brief Memory traffic implied by cache misses (64-byte lines)
+     */
+    double missBytes() const { return value[CacheMisses] * 64.0; }
+
+    CounterValues& operator+=(const CounterValues& other);
+    CounterValues& operator/=(double divisor);
+};
+
+/**
+ * @brief Counts cycles, instructions, cache and branch misses of this process
+ *
+ * Uses Linux perf_event_open on every thread that exists when start()
+ * is called, so OpenMP worker pools are included once they have been
+ * created (by a warm-up run), and threads those start are included when
+ * they finish within the region. Only user space is counted, which
+ * perf_event_paranoid allows for unprivileged users by default.
+ *
+ * Where counters cannot be used (other systems, containers without the
+ * system call, virtual machines without a PMU) isAvailable() is false,
+ * reason() says why and start()/stop() do nothing.
+ */
+class PerfCounters {
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool isAvailable() const { return m_available; }
+    QString reason() const { return m_reason; }
+
+    /**
+     * @brief Start counting
+     */
+    void start();
+
+    /**
+     * @brief Stop counting
+     * @return Counts since start(), scaled for time the kernel multiplexed
+     *         counters out
+     */
+    CounterValues stop();
+
+private:
+    bool m_available{false};
+    bool m_supported[CounterValues::EventCount] = {};
+    QString m_reason;
+    QVector<int> m_fds[CounterValues::EventCount];
+};
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,306 @@
+/**
+ * @file scalingbench.cpp
+ * @brief Thread scaling harness implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "scalingbench.h"
+#include "benchutil.h"
+#include "syntheticimage.h"
+
+#include "export/compressedwriter.h"
+#include "export/objexporter.h"
+#include "export/objimporter.h"
+#include "export/stlexporter.h"
+#include "export/stlimporter.h"
+#include "mesh/meshgenerator.h"
+#include "mesh/meshstages.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+/**
+ * @brief Prepared input of a stage, run at a given thread count
+ */
+using StageRun = std::function<bool(int threads)>;
+
+/**
+ * @brief A parallel stage
+ *
+ * setup() builds the stage's input from an image once per image size;
+ * the returned function is what is timed.
+ */
+struct Stage {
+    QString name;
+    std::function<StageRun(const QImage& image)> setup;
+};
+
+QList<int> defaultThreadCounts() {
+    QList<int> counts;
+    for (int threads = 1; threads < hardwareThreads(); threads *= 2) {
+        counts.append(threads);
+    }
+    counts.append(hardwareThreads());
+    return counts;
+}
+
+QList<Stage> stages(const QString& workDir) {
+    QList<Stage> list;
+
+    list.append({QStringLiteral("mesh generation"), [](const QImage& image) -> StageRun {
+        auto generator = std::make_shared<MeshGenerator>(MeshConfig());
+        return [generator, image](int) {
+            return !generator->generate(image).isEmpty();
+        };
+    }});
+
+    list.append({QStringLiteral("surface emission"), [](const QImage& image) -> StageRun {
+        auto generator = std::make_shared<MeshGenerator>(MeshConfig());
+        generator->generate(image);
+        auto depth = std::make_shared<QVector<float>>(MeshStages(*generator).depthBuffer(image));
+        return [generator, depth, image](int) {
+            return MeshStages(*generator).surfaceRows(*depth, image.width(), image.height()) > 0;
+        };
+    }});
+
+    list.append({QStringLiteral("bas-relief"), [](const QImage& image) -> StageRun {
+        MeshConfig config;
+        config.reliefMode = ReliefMode::BasRelief;
+        auto generator = std::make_shared<MeshGenerator>(config);
+        generator->generate(image.scaled(64, 64));
+        return [generator, image](int) {
+            return !MeshStages(*generator).depthBuffer(image).isEmpty();
+        };
+    }});
+
+    for (const Compression compression : {Compression::Gzip, Compression::Zstd}) {
+        if (!CompressedFileWriter::isSupported(compression)) {
+            continue;
+        }
+        const QString name = compression == Compression::Gzip ? QStringLiteral("gzip compression")
+                                                              : QStringLiteral("zstd compression");
+        const QString path = workDir + QStringLiteral("/scaling.stl") +
+                             CompressedFileWriter::suffix(compression);
+        list.append({name, [compression, path](const QImage& image) -> StageRun {
+            // The vertex data stands in for a binary STL of the same size
+            const QList<QVector3D> mesh = MeshGenerator(MeshConfig()).generate(image);
+            const QByteArray data(reinterpret_cast<const char*>(mesh.constData()),
+                                  mesh.size() * qsizetype(sizeof(QVector3D)));
+            return [compression, path, data](int threads) {
+                CompressedFileWriter writer(path, compression);
+                writer.setThreadCount(threads);
+                const bool written = writer.open(QIODevice::WriteOnly) &&
+                                     writer.write(data) == data.size() && writer.finish();
+                QFile::remove(path);
+                return written;
+            };
+        }});
+    }
+
+    list.append({QStringLiteral("STL import"), [workDir](const QImage& image) -> StageRun {
+        const QString path = workDir + QStringLiteral("/import.stl");
+        if (!StlExporter().exportMesh(MeshGenerator(MeshConfig()).generate(image), path).success) {
+            return nullptr;
+        }
+        return [path](int) { return StlImporter().importMesh(path).success; };
+    }});
+
+    list.append({QStringLiteral("OBJ import"), [workDir](const QImage& image) -> StageRun {
+        const QString path = workDir + QStringLiteral("/import.obj");
+        if (!ObjExporter().exportMesh(MeshGenerator(MeshConfig()).generate(image), path).success) {
+            return nullptr;
+        }
+        return [path](int) { return ObjImporter().importMesh(path).success; };
+    }});
+
+    return list;
+}
+
+struct Result {
+    QString mode;
+    QString stage;
+    int threads{1};
+    QSize size;
+    Stats stats;
+    double speedup{1.0};
+    double efficiency{1.0};
+    double serialFraction{0.0};
+};
+
+} // namespace
+
+int runScaling(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Measures how the parallel stages scale with the number of threads."));
+    parser.addHelpOption();
+    const QCommandLineOption threadsOption(QStringLiteral("threads"),
+        QStringLiteral("Comma-separated thread counts (default: powers of two up to the CPU count)."),
+        QStringLiteral("list"));
+    const QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Image size for strong scaling (default: 2000x2000)."),
+        QStringLiteral("WIDTHxHEIGHT"), QStringLiteral("2000x2000"));
+    const QCommandLineOption weakSizeOption(QStringLiteral("weak-size"),
+        QStringLiteral("Image size per thread for weak scaling; more threads add rows "
+                       "(default: 1000x250)."),
+        QStringLiteral("WIDTHxHEIGHT"), QStringLiteral("1000x250"));
+    const QCommandLineOption modeOption(QStringLiteral("mode"),
+        QStringLiteral("strong, weak or both (default: both)."), QStringLiteral("mode"),
+        QStringLiteral("both"));
+    const QCommandLineOption stageOption(QStringLiteral("stage"),
+        QStringLiteral("Only run stages whose name contains this text."), QStringLiteral("text"));
+    const QCommandLineOption repeatOption(QStringLiteral("repeat"),
+        QStringLiteral("Timed runs per thread count (default: 5)."), QStringLiteral("count"),
+        QStringLiteral("5"));
+    const QCommandLineOption csvOption(QStringLiteral("csv"),
+        QStringLiteral("Also write the results as CSV to this file."), QStringLiteral("file"));
+    parser.addOptions({threadsOption, sizeOption, weakSizeOption, modeOption, stageOption,
+                       repeatOption, csvOption});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    QList<int> threadCounts;
+    if (parser.isSet(threadsOption)) {
+        for (const QString& count : parser.value(threadsOption).split(',', Qt::SkipEmptyParts)) {
+            threadCounts.append(std::max(1, count.toInt()));
+        }
+        threadCounts.append(1); // Every curve is relative to one thread
+        std::sort(threadCounts.begin(), threadCounts.end());
+        threadCounts.erase(std::unique(threadCounts.begin(), threadCounts.end()), threadCounts.end());
+    } else {
+        threadCounts = defaultThreadCounts();
+    }
+    const QSize strongSize = parseSize(parser.value(sizeOption));
+    const QSize weakSize = parseSize(parser.value(weakSizeOption));
+    if (threadCounts.isEmpty() || strongSize.height() < 2 || weakSize.height() < 2) {
+        err << "Invalid thread counts or image sizes" << Qt::endl;
+        return 2;
+    }
+    const QString mode = parser.value(modeOption);
+    QStringList modes;
+    if (mode == QLatin1String("strong") || mode == QLatin1String("both")) {
+        modes << QStringLiteral("strong");
+    }
+    if (mode == QLatin1String("weak") || mode == QLatin1String("both")) {
+        modes << QStringLiteral("weak");
+    }
+    const int repeats = std::max(1, parser.value(repeatOption).toInt());
+
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        err << "Cannot create a temporary directory: " << workDir.errorString() << Qt::endl;
+        return 2;
+    }
+
+    QTextStream out(stdout);
+    out << "Thread counts " << [&] {
+        QStringList counts;
+        for (int threads : threadCounts) {
+            counts << QString::number(threads);
+        }
+        return counts.join(',');
+    }() << " on " << hardwareThreads() << " CPUs, " << repeats << " runs each" << Qt::endl;
+
+    QList<Result> results;
+    for (const Stage& stage : stages(workDir.path())) {
+        if (parser.isSet(stageOption) &&
+            !stage.name.contains(parser.value(stageOption), Qt::CaseInsensitive)) {
+            continue;
+        }
+        for (const QString& scaling : modes) {
+            const bool weak = scaling == QLatin1String("weak");
+            QList<QStringList> rows;
+            StageRun run;
+            QSize preparedSize;
+            double reference = 0.0;
+            for (int threads : threadCounts) {
+                const QSize size = weak ? QSize(weakSize.width(), weakSize.height() * threads)
+                                        : strongSize;
+                if (size != preparedSize) {
+                    QImage image = generateSynthetic(size);
+                    image.invertPixels();
+                    run = stage.setup(image);
+                    preparedSize = size;
+                }
+                if (!run) {
+                    err << stage.name << ": cannot prepare the input" << Qt::endl;
+                    return 2;
+                }
+
+                setOpenMpThreads(threads);
+                bool succeeded = true;
+                Result result{scaling, stage.name, threads, size,
+                              measure(1, repeats, [&] { succeeded = run(threads) && succeeded; })};
+                if (!succeeded) {
+                    err << stage.name << " failed at " << threads << " threads" << Qt::endl;
+                    return 2;
+                }
+
+                // Relative to the single-threaded run
+                if (reference == 0.0) {
+                    reference = result.stats.median;
+                }
+                const double ratio = reference / std::max(result.stats.median, 1e-9);
+                if (weak) {
+                    // Ideal: constant time as work grows with the threads
+                    result.speedup = ratio * threads;
+                    result.efficiency = ratio;
+                } else {
+                    result.speedup = ratio;
+                    result.efficiency = ratio / threads;
+                }
+                if (threads > 1 && result.speedup > 0.0) {
+                    result.serialFraction = (1.0 / result.speedup - 1.0 / threads) / (1.0 - 1.0 / threads);
+                }
+                results.append(result);
+                rows.append({QString::number(threads),
+                             QStringLiteral("%1x%2").arg(size.width()).arg(size.height()),
+                             QString::number(result.stats.median, 'f', 2),
+                             QString::number(result.stats.mad, 'f', 2),
+                             QString::number(result.speedup, 'f', 2),
+                             QStringLiteral("%1%").arg(result.efficiency * 100.0, 0, 'f', 0),
+                             threads > 1 ? QString::number(result.serialFraction, 'f', 3)
+                                         : QStringLiteral("-")});
+            }
+            setOpenMpThreads(0);
+
+            out << Qt::endl << stage.name << ", " << scaling << " scaling" << Qt::endl;
+            printTable({QStringLiteral("threads"), QStringLiteral("image"), QStringLiteral("median ms"),
+                        QStringLiteral("MAD ms"), QStringLiteral("speedup"),
+                        QStringLiteral("efficiency"), QStringLiteral("serial fraction")}, rows);
+        }
+    }
+
+    if (parser.isSet(csvOption)) {
+        QFile csv(parser.value(csvOption));
+        if (!csv.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+            err << "Cannot write " << csv.fileName() << ": " << csv.errorString() << Qt::endl;
+            return 2;
+        }
+        QTextStream stream(&csv);
+        stream << "mode,stage,threads,width,height,median_ms,mad_ms,speedup,efficiency,serial_fraction\n";
+        for (const Result& result : results) {
+            stream << result.mode << ',' << result.stage << ',' << result.threads << ','
+                   << result.size.width() << ',' << result.size.height() << ','
+                   << result.stats.median << ',' << result.stats.mad << ',' << result.speedup << ','
+                   << result.efficiency << ',' << result.serialFraction << '\n';
+        }
+    }
+    return 0;
+}
+
+} // namespace Bench
+} // namespace LithoMaker
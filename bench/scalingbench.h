@@ -0,0 +1,31 @@
+/**
+ * @file scalingbench.h
+ * @brief Strong and weak thread scaling of the parallel stages
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Run each parallel stage at increasing thread counts
+ * @param arguments Program name followed by the suite's options
+ * @return 0 on success, 2 on invalid options or failed stages
+ *
+ * Strong scaling keeps the image size fixed; weak scaling grows the
+ * image with the thread count, so each thread has the same amount of
+ * work. For every stage and thread count the speedup and parallel
+ * efficiency are reported, along with the Karp-Flatt serial fraction,
+ * which stays flat for a fixed serial part (such as merging per-thread
+ * results) and grows with overhead that increases with the thread count.
+ */
+int runScaling(const QStringList& arguments);
+
+} // namespace Bench
+} // namespace LithoMaker
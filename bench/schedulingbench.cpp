@@ -0,0 +1,168 @@
+/**
+ * @file schedulingbench.cpp
+ * @brief Preview latency while batch jobs run in the background implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "schedulingbench.h"
+#include "benchutil.h"
+#include "syntheticimage.h"
+
+#include "core/jobscheduler.h"
+#include "mesh/meshgenerator.h"
+
+#include <QCommandLineParser>
+#include <QTextStream>
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <thread>
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+enum class Mode {
+    Idle,    // No batch jobs
+    Queued,  // Previews go first in the queue, batch jobs never yield
+    Preempt  // Running batch jobs also yield at their checkpoints
+};
+
+struct Workload {
+    QImage batchImage;
+    QImage previewImage;
+    int batchJobs{0};
+    int previews{0};
+    int intervalMs{0};
+};
+
+QString modeName(Mode mode) {
+    switch (mode) {
+    case Mode::Idle:
+        return QStringLiteral("idle");
+    case Mode::Queued:
+        return QStringLiteral("queued");
+    case Mode::Preempt:
+        return QStringLiteral("preempt");
+    }
+    return QString();
+}
+
+QStringList runMode(Mode mode, const Workload& workload) {
+    JobScheduler& scheduler = JobScheduler::instance();
+    scheduler.resetStats();
+
+    if (mode != Mode::Idle) {
+        const bool yield = mode == Mode::Preempt;
+        for (int i = 0; i < workload.batchJobs; ++i) {
+            scheduler.submit(JobPriority::Batch, [&workload, yield](JobContext& context) {
+                MeshGenerator generator{MeshConfig()};
+                if (yield) {
+                    generator.setJobContext(&context);
+                }
+                doNotOptimize(generator.generate(workload.batchImage).size());
+            });
+        }
+        // Let the batch get going before the first preview
+        std::this_thread::sleep_for(std::chrono::milliseconds(workload.intervalMs));
+    }
+
+    // One preview at a time, like someone adjusting settings; stop when
+    // the batch is done, as later previews would see an idle scheduler
+    for (int i = 0; i < workload.previews; ++i) {
+        if (mode != Mode::Idle && scheduler.activeCount(JobPriority::Batch) == 0) {
+            break;
+        }
+        std::promise<void> done;
+        scheduler.submit(JobPriority::Interactive, [&workload, &done](JobContext&) {
+            MeshGenerator generator{MeshConfig()};
+            doNotOptimize(generator.generate(workload.previewImage).size());
+            done.set_value();
+        });
+        done.get_future().wait();
+        std::this_thread::sleep_for(std::chrono::milliseconds(workload.intervalMs));
+    }
+    scheduler.waitForIdle();
+
+    const JobStats previews = scheduler.stats(JobPriority::Interactive);
+    const JobStats batch = scheduler.stats(JobPriority::Batch);
+    const bool hasBatch = mode != Mode::Idle;
+    return {modeName(mode), QString::number(previews.completed),
+            QString::number(previews.medianLatencyMs, 'f', 1),
+            QString::number(previews.p95LatencyMs, 'f', 1),
+            QString::number(previews.maxLatencyMs, 'f', 1),
+            hasBatch ? QString::number(batch.jobsPerMinute, 'f', 1) : QStringLiteral("-"),
+            hasBatch ? QString::number(batch.yieldedMs) : QStringLiteral("-")};
+}
+
+} // namespace
+
+int runScheduling(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Measures preview latency while batch jobs run in the background."));
+    parser.addHelpOption();
+    const QCommandLineOption sizeOption(QStringLiteral("size"),
+        QStringLiteral("Synthetic batch image size (default: 2000x2000)."),
+        QStringLiteral("WxH"), QStringLiteral("2000x2000"));
+    const QCommandLineOption previewSizeOption(QStringLiteral("preview-size"),
+        QStringLiteral("Synthetic preview image size (default: 1000x1000)."),
+        QStringLiteral("WxH"), QStringLiteral("1000x1000"));
+    const QCommandLineOption jobsOption(QStringLiteral("jobs"),
+        QStringLiteral("Batch jobs (default: 16)."), QStringLiteral("count"),
+        QStringLiteral("16"));
+    const QCommandLineOption workersOption(QStringLiteral("workers"),
+        QStringLiteral("Scheduler threads (default: half the CPUs)."), QStringLiteral("count"),
+        QStringLiteral("0"));
+    const QCommandLineOption previewsOption(QStringLiteral("previews"),
+        QStringLiteral("Previews per mode (default: 10)."), QStringLiteral("count"),
+        QStringLiteral("10"));
+    const QCommandLineOption intervalOption(QStringLiteral("interval"),
+        QStringLiteral("Pause between previews (default: 200 ms)."), QStringLiteral("ms"),
+        QStringLiteral("200"));
+    parser.addOptions({sizeOption, previewSizeOption, jobsOption, workersOption,
+                       previewsOption, intervalOption});
+    parser.process(arguments);
+
+    QTextStream err(stderr);
+    const QSize batchSize = parseSize(parser.value(sizeOption));
+    const QSize previewSize = parseSize(parser.value(previewSizeOption));
+    if (batchSize.isEmpty() || previewSize.isEmpty()) {
+        err << "Invalid image size" << Qt::endl;
+        return 2;
+    }
+
+    Workload workload;
+    workload.batchJobs = parser.value(jobsOption).toInt();
+    workload.previews = parser.value(previewsOption).toInt();
+    workload.intervalMs = std::max(0, parser.value(intervalOption).toInt());
+    if (workload.batchJobs < 1 || workload.previews < 1) {
+        err << "Need at least one batch job and one preview" << Qt::endl;
+        return 2;
+    }
+    setOpenMpThreads(0);
+    workload.batchImage = generateSynthetic(batchSize, 1);
+    workload.previewImage = generateSynthetic(previewSize, 2);
+
+    JobScheduler& scheduler = JobScheduler::instance();
+    scheduler.setWorkerCount(parser.value(workersOption).toInt());
+    QTextStream(stdout) << scheduler.workerCount() << " scheduler threads, "
+                        << hardwareThreads() << " CPUs" << Qt::endl;
+
+    QList<QStringList> rows;
+    for (Mode mode : {Mode::Idle, Mode::Queued, Mode::Preempt}) {
+        rows.append(runMode(mode, workload));
+    }
+    printTable({QStringLiteral("mode"), QStringLiteral("previews"),
+                QStringLiteral("median ms"), QStringLiteral("p95 ms"), QStringLiteral("max ms"),
+                QStringLiteral("batch jobs/min"), QStringLiteral("yielded ms")},
+               rows);
+    return 0;
+}
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,28 @@
+/**
+ * @file schedulingbench.h
+ * @brief Preview latency while batch jobs run in the background
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Generate previews while the job scheduler meshes batch images
+ * @param arguments Program name followed by the suite's options
+ * @return 0 on success, 2 on invalid options
+ *
+ * Reports preview latency and batch throughput separately, for previews
+ * on an idle scheduler, previews that only jump the queue, and previews
+ * that running batch jobs also yield to at their checkpoints.
+ */
+int runScheduling(const QStringList& arguments);
+
+} // namespace Bench
+} // namespace LithoMaker
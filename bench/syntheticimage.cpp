@@ -0,0 +1,327 @@
+/**
+ * @file syntheticimage.cpp
+ * @brief Deterministic synthetic test images implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "syntheticimage.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace LithoMaker {
+namespace Bench {
+
+namespace {
+
+constexpr float kPaper = 0.92f;
+constexpr float kInk = 0.08f;
+
+// Integer hash with good avalanche (lowbias32). Pixels are hashed from
+// their coordinates rather than drawn from a sequential generator, so
+// any row can be computed without the ones before it.
+quint32 mix(quint32 x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+quint32 hash(quint32 seed, quint32 a, quint32 b = 0) {
+    return mix(mix(mix(seed) + a) + b);
+}
+
+float unitFloat(quint32 value) {
+    return float(value >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ * @brief Improved Perlin noise with a seeded permutation
+ */
+class Perlin {
+public:
+    explicit Perlin(quint32 seed) {
+        for (int i = 0; i < 256; ++i) {
+            m_permutation[i] = i;
+        }
+        for (int i = 255; i > 0; --i) {
+            const int j = int(hash(seed, 0x5eed, quint32(i)) % quint32(i + 1));
+            std::swap(m_permutation[i], m_permutation[j]);
+        }
+        for (int i = 0; i < 256; ++i) {
+            m_permutation[256 + i] = m_permutation[i];
+        }
+    }
+
+    /**
+     * @brief Noise at a point, roughly in -1..1
+     */
+    float noise(float x, float y) const {
+        const float fx = std::floor(x);
+        const float fy = std::floor(y);
+        const int xi = int(fx) & 255;
+        const int yi = int(fy) & 255;
+        const float tx = x - fx;
+        const float ty = y - fy;
+        const float u = fade(tx);
+        const float v = fade(ty);
+
+        const int a = m_permutation[xi] + yi;
+        const int b = m_permutation[xi + 1] + yi;
+        const float bottom = lerp(u, gradient(m_permutation[a], tx, ty),
+                                     gradient(m_permutation[b], tx - 1.0f, ty));
+        const float top = lerp(u, gradient(m_permutation[a + 1], tx, ty - 1.0f),
+                                  gradient(m_permutation[b + 1], tx - 1.0f, ty - 1.0f));
+        return lerp(v, bottom, top);
+    }
+
+    /**
+     * @brief Sum of octaves of halving amplitude, in 0..1
+     */
+    float fractal(float x, float y, int octaves) const {
+        float sum = 0.0f;
+        float amplitude = 1.0f;
+        float norm = 0.0f;
+        for (int i = 0; i < octaves; ++i) {
+            sum += amplitude * noise(x, y);
+            norm += amplitude;
+            amplitude *= 0.5f;
+            x *= 2.0f;
+            y *= 2.0f;
+        }
+        // Perlin noise rarely nears its bounds, so stretch the contrast
+        return std::clamp(sum / norm * 0.7f + 0.5f, 0.0f, 1.0f);
+    }
+
+private:
+    static float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+    static float lerp(float t, float a, float b) { return a + t * (b - a); }
+
+    static float gradient(int hashed, float x, float y) {
+        switch (hashed & 7) {
+        case 0: return x + y;
+        case 1: return -x + y;
+        case 2: return x - y;
+        case 3: return -x - y;
+        case 4: return x;
+        case 5: return -x;
+        case 6: return y;
+        default: return -y;
+        }
+    }
+
+    std::array<int, 512> m_permutation{};
+};
+
+/**
+ * @brief Per-image constants, evaluated per pixel from any thread
+ */
+class Generator {
+public:
+    explicit Generator(const SyntheticSpec& spec)
+        : m_spec(spec)
+        , m_perlin(spec.seed)
+    {
+        const int width = spec.size.width();
+        const int height = spec.size.height();
+        const int longest = std::max(1, std::max(width, height));
+
+        const float angle = unitFloat(hash(spec.seed, 1)) * 6.2831853f;
+        const float halfDiagonal = 0.5f * std::hypot(float(width), float(height));
+        m_gradientX = std::cos(angle) / std::max(1.0f, halfDiagonal);
+        m_gradientY = std::sin(angle) / std::max(1.0f, halfDiagonal);
+        m_centerX = width * 0.5f;
+        m_centerY = height * 0.5f;
+
+        // About eight features across the image at the lowest octave
+        m_noiseScale = 8.0f / longest;
+        m_noiseOffset = unitFloat(hash(spec.seed, 2)) * 256.0f;
+
+        m_checkerPhaseX = int(hash(spec.seed, 3) & 1);
+        m_checkerPhaseY = int(hash(spec.seed, 4) & 1);
+
+        // Glyphs grow with the image, so their edges survive downscaling
+        m_glyphScale = std::max(1, std::min(width, height) / 500);
+        m_blockSize = std::max(1, longest / 8);
+    }
+
+    SyntheticPattern patternOfRow(int y) const {
+        if (m_spec.pattern != SyntheticPattern::Mixed) {
+            return m_spec.pattern;
+        }
+        const int bands = int(SyntheticPattern::Mixed);
+        const int band = int(qint64(y) * bands / std::max(1, m_spec.size.height()));
+        return static_cast<SyntheticPattern>(std::min(band, bands - 1));
+    }
+
+    template <typename Pixel>
+    void fillRow(Pixel* line, int y, float maximum) const {
+        const int width = m_spec.size.width();
+        const auto quantize = [maximum](float value) {
+            return static_cast<Pixel>(std::clamp(value, 0.0f, 1.0f) * maximum + 0.5f);
+        };
+
+        switch (patternOfRow(y)) {
+        case SyntheticPattern::Gradient:
+            for (int x = 0; x < width; ++x) {
+                line[x] = quantize(gradient(x, y));
+            }
+            break;
+        case SyntheticPattern::Noise:
+            for (int x = 0; x < width; ++x) {
+                line[x] = quantize(noise(x, y));
+            }
+            break;
+        case SyntheticPattern::Checkerboard:
+            for (int x = 0; x < width; ++x) {
+                line[x] = quantize(checkerboard(x, y));
+            }
+            break;
+        case SyntheticPattern::Text:
+            for (int x = 0; x < width; ++x) {
+                line[x] = quantize(text(x, y));
+            }
+            break;
+        case SyntheticPattern::Flat:
+        case SyntheticPattern::Mixed:
+            for (int x = 0; x < width; ++x) {
+                line[x] = quantize(flat(x, y));
+            }
+            break;
+        }
+    }
+
+private:
+    float gradient(int x, int y) const {
+        return 0.5f + 0.5f * ((x - m_centerX) * m_gradientX + (y - m_centerY) * m_gradientY);
+    }
+
+    float noise(int x, int y) const {
+        return m_perlin.fractal(x * m_noiseScale + m_noiseOffset,
+                                y * m_noiseScale + m_noiseOffset, 5);
+    }
+
+    float checkerboard(int x, int y) const {
+        const int cell = ((x + m_checkerPhaseX) >> 1) + ((y + m_checkerPhaseY) >> 1);
+        return cell & 1 ? kPaper : kInk;
+    }
+
+    // Lines of 5x7 glyphs in 6x9 cells. Each glyph is a random bitmap,
+    // which has the stroke edges of text without depending on fonts,
+    // whose rendering differs between platforms.
+    float text(int x, int y) const {
+        const int gx = x / m_glyphScale;
+        const int gy = y / m_glyphScale;
+        const int column = gx / 6;
+        const int row = gy / 9;
+        const int cellX = gx % 6;
+        const int cellY = gy % 9;
+        if (cellX >= 5 || cellY >= 7) {
+            return kPaper;
+        }
+        // Ragged line ends and about one space in seven
+        const quint32 line = hash(m_spec.seed, 0x7e47, quint32(row));
+        if (column >= int(line % 40U) + 40) {
+            return kPaper;
+        }
+        const quint32 glyph = hash(line, quint32(column));
+        if ((glyph & 0xff) < 37) {
+            return kPaper;
+        }
+        return hash(glyph, quint32(cellY * 5 + cellX)) % 5U < 2 ? kInk : kPaper;
+    }
+
+    float flat(int x, int y) const {
+        const quint32 block = hash(m_spec.seed, quint32(x / m_blockSize), quint32(y / m_blockSize) + 0x8000U);
+        return 0.2f + 0.2f * float(block & 3);
+    }
+
+    const SyntheticSpec m_spec;
+    const Perlin m_perlin;
+    float m_gradientX{0.0f};
+    float m_gradientY{0.0f};
+    float m_centerX{0.0f};
+    float m_centerY{0.0f};
+    float m_noiseScale{1.0f};
+    float m_noiseOffset{0.0f};
+    int m_checkerPhaseX{0};
+    int m_checkerPhaseY{0};
+    int m_glyphScale{1};
+    int m_blockSize{1};
+};
+
+} // namespace
+
+QImage generateSynthetic(const SyntheticSpec& spec) {
+    if (spec.size.isEmpty()) {
+        return QImage();
+    }
+    const bool deep = spec.bitDepth > 8;
+    QImage image(spec.size, deep ? QImage::Format_Grayscale16 : QImage::Format_Grayscale8);
+    if (image.isNull()) {
+        return image;
+    }
+
+    const Generator generator(spec);
+    const int height = spec.size.height();
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < height; ++y) {
+        if (deep) {
+            generator.fillRow(reinterpret_cast<quint16*>(image.scanLine(y)), y, 65535.0f);
+        } else {
+            generator.fillRow(image.scanLine(y), y, 255.0f);
+        }
+    }
+    return image;
+}
+
+QImage generateSynthetic(const QSize& size, quint32 seed) {
+    SyntheticSpec spec;
+    spec.size = size;
+    spec.seed = seed;
+    return generateSynthetic(spec);
+}
+
+QList<SyntheticPattern> syntheticPatterns() {
+    return {SyntheticPattern::Gradient, SyntheticPattern::Noise, SyntheticPattern::Checkerboard,
+            SyntheticPattern::Text, SyntheticPattern::Flat, SyntheticPattern::Mixed};
+}
+
+QString patternName(SyntheticPattern pattern) {
+    switch (pattern) {
+    case SyntheticPattern::Gradient: return QStringLiteral("gradient");
+    case SyntheticPattern::Noise: return QStringLiteral("noise");
+    case SyntheticPattern::Checkerboard: return QStringLiteral("checkerboard");
+    case SyntheticPattern::Text: return QStringLiteral("text");
+    case SyntheticPattern::Flat: return QStringLiteral("flat");
+    case SyntheticPattern::Mixed: return QStringLiteral("mixed");
+    }
+    return QString();
+}
+
+std::optional<SyntheticPattern> parsePattern(const QString& name) {
+    const QString wanted = name.trimmed().toLower();
+    for (SyntheticPattern pattern : syntheticPatterns()) {
+        if (patternName(pattern) == wanted) {
+            return pattern;
+        }
+    }
+    return std::nullopt;
+}
+
+QString corpusFileName(const SyntheticSpec& spec) {
+    return QStringLiteral("%1-%2x%3-%4bit-s%5.png")
+        .arg(patternName(spec.pattern))
+        .arg(spec.size.width())
+        .arg(spec.size.height())
+        .arg(spec.bitDepth > 8 ? 16 : 8)
+        .arg(spec.seed);
+}
+
+} // namespace Bench
+} // namespace LithoMaker
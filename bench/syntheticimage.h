@@ -0,0 +1,74 @@
+/**
+ * @file syntheticimage.h
+ * @brief Deterministic synthetic test images
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QImage>
+#include <QList>
+#include <QSize>
+#include <QString>
+
+#include <optional>
+
+namespace LithoMaker {
+namespace Bench {
+
+/**
+ * @brief Content of a synthetic image
+ *
+ * Each pattern stresses the pipeline differently: smooth content
+ * compresses well, noise and checkerboards defeat vertex welding and
+ * compression, text has hard edges everywhere, and flat regions produce
+ * long runs of identical depths.
+ */
+enum class SyntheticPattern {
+    Gradient,     ///< Linear ramp at a seeded angle
+    Noise,        ///< Fractal Perlin noise, like textured photo content
+    Checkerboard, ///< Alternating 2-pixel squares, the worst case for detail
+    Text,         ///< Lines of random glyphs: hard edges on a flat background
+    Flat,         ///< Large blocks of a few constant shades
+    Mixed         ///< One horizontal band of each of the above
+};
+
+/**
+ * @brief Description of a synthetic image
+ */
+struct SyntheticSpec {
+    SyntheticPattern pattern{SyntheticPattern::Mixed};
+    QSize size{2000, 2000};
+    int bitDepth{8}; ///< 8 (Grayscale8) or 16 (Grayscale16) bits per pixel
+    quint32 seed{1};
+};
+
+/**
+ * @brief Generate a synthetic grayscale image
+ *
+ * Every pixel is computed from its coordinates and the seed alone, so
+ * rows are generated in parallel and the result is the same for any
+ * thread count. The same spec gives the same image on every run and, up
+ * to rounding in the math library, on every platform.
+ */
+QImage generateSynthetic(const SyntheticSpec& spec);
+
+/**
+ * @brief Mixed-content 8-bit image of a size, as used by most benchmarks
+ */
+QImage generateSynthetic(const QSize& size, quint32 seed = 1);
+
+QList<SyntheticPattern> syntheticPatterns();
+QString patternName(SyntheticPattern pattern);
+std::optional<SyntheticPattern> parsePattern(const QString& name);
+
+/**
+ * @brief File name of an image in a generated corpus
+ * @return e.g. "noise-2000x2000-16bit-s1.png"
+ */
+QString corpusFileName(const SyntheticSpec& spec);
+
+} // namespace Bench
+} // namespace LithoMaker
@@ -0,0 +1,306 @@
+/**
+ * @file batchcommand.cpp
+ * @brief Command line batch conversion implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "batchcommand.h"
+#include "batchrunner.h"
+#include "batchworker.h"
+
+#include "core/imageloader.h"
+#include "core/memorystats.h"
+#include "ui/pipelinesettings.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QTextStream>
+
+#include <algorithm>
+#include <cstring>
+
+namespace LithoMaker {
+
+namespace {
+
+const char* const kBatchFlag = "--batch";
+const char* const kWorkerFlag = "--batch-worker";
+
+QString tr(const char* text) {
+    return QCoreApplication::translate("BatchCommand", text);
+}
+
+int runWorker(const QString& format, bool flipVertically) {
+    // Read once, so every job of this worker uses the same settings
+    const MeshConfig config = meshConfigFromSettings();
+
+    return BatchWorker::run([&](const BatchJob& job) {
+        BatchJobOutcome outcome;
+        const auto loaded = ImageLoader::load(job.input);
+        if (!loaded) {
+            outcome.errorMessage = tr("Cannot read the image");
+            return outcome;
+        }
+
+        MeshGenerator generator(config);
+        const QList<QVector3D> mesh =
+            generator.generate(prepareLithophaneImage(loaded->image, flipVertically));
+        if (mesh.isEmpty()) {
+            outcome.errorMessage = tr("Mesh generation failed");
+            return outcome;
+        }
+
+        const ExportResult result = exporterFromSettings(format)->exportMesh(mesh, job.output);
+        outcome.success = result.success;
+        outcome.errorMessage = result.errorMessage;
+        outcome.triangles = mesh.size() / 3;
+        return outcome;
+    });
+}
+
+// Images given directly, and the supported images in given directories
+QStringList collectInputs(const QStringList& paths, QTextStream& err) {
+    QStringList nameFilters;
+    for (const QString& extension : ImageLoader::supportedExtensions()) {
+        nameFilters << QStringLiteral("*.") + extension;
+    }
+    QStringList inputs;
+    for (const QString& path : paths) {
+        const QFileInfo info(path);
+        if (info.isDir()) {
+            const QDir dir(path);
+            for (const QString& name : dir.entryList(nameFilters, QDir::Files, QDir::Name)) {
+                inputs << dir.filePath(name);
+            }
+        } else if (info.isFile()) {
+            inputs << path;
+        } else {
+            err << tr("Not found, skipped: %1").arg(path) << Qt::endl;
+        }
+    }
+    return inputs;
+}
+
+// out/<name>.<extension>, made unique for inputs that differ only in
+// their directory or image format
+QList<BatchJob> makeJobs(const QStringList& inputs, const QDir& outDir, const QString& extension) {
+    QList<BatchJob> jobs;
+    QSet<QString> used;
+    for (const QString& input : inputs) {
+        const QFileInfo info(input);
+        QString name = info.completeBaseName();
+        for (int n = 2; used.contains(name.toLower()); ++n) {
+            name = QStringLiteral("%1_%2").arg(info.completeBaseName()).arg(n);
+        }
+        used.insert(name.toLower());
+        jobs.append({input, outDir.filePath(name + QLatin1Char('.') + extension)});
+    }
+    return jobs;
+}
+
+void printWorkers(const BatchResult& result, QTextStream& out) {
+    const QStringList header{tr("worker"), tr("processes"), tr("crashes"), tr("jobs"),
+                             tr("failed"), tr("busy"), tr("jobs/min"), tr("Mtri/s"),
+                             tr("peak memory")};
+    QList<QStringList> rows{header};
+    for (const BatchWorkerStats& worker : result.workers) {
+        const double busy = result.elapsedMs > 0 ? 100.0 * worker.busyMs / result.elapsedMs : 0.0;
+        rows.append({QString::number(worker.slot + 1), QString::number(worker.processes),
+                     QString::number(worker.crashes), QString::number(worker.jobs),
+                     QString::number(worker.failed), QStringLiteral("%1%").arg(busy, 0, 'f', 0),
+                     QString::number(worker.jobsPerMinute(result.elapsedMs), 'f', 1),
+                     QString::number(worker.trianglesPerSecond() / 1e6, 'f', 2),
+                     MemoryStats::formatBytes(worker.peakBytes)});
+    }
+
+    QList<int> widths(header.size(), 0);
+    for (const QStringList& row : rows) {
+        for (int i = 0; i < row.size(); ++i) {
+            widths[i] = std::max(widths[i], int(row[i].size()));
+        }
+    }
+    for (const QStringList& row : rows) {
+        QStringList cells;
+        for (int i = 0; i < row.size(); ++i) {
+            cells << (i == 0 ? row[i].leftJustified(widths[i]) : row[i].rightJustified(widths[i]));
+        }
+        out << cells.join(QStringLiteral("  ")) << Qt::endl;
+    }
+}
+
+QJsonObject toJson(const BatchResult& result) {
+    QJsonArray jobs;
+    for (const BatchJobResult& job : result.jobs) {
+        QJsonObject entry;
+        entry.insert(QStringLiteral("input"), job.job.input);
+        entry.insert(QStringLiteral("output"), job.job.output);
+        entry.insert(QStringLiteral("ok"), job.success);
+        if (!job.success) {
+            entry.insert(QStringLiteral("error"), job.errorMessage);
+            entry.insert(QStringLiteral("crashed"), job.crashed);
+        }
+        entry.insert(QStringLiteral("attempts"), job.attempts);
+        entry.insert(QStringLiteral("worker"), job.worker + 1);
+        entry.insert(QStringLiteral("ms"), job.ms);
+        entry.insert(QStringLiteral("triangles"), job.triangles);
+        jobs.append(entry);
+    }
+
+    QJsonArray workers;
+    for (const BatchWorkerStats& worker : result.workers) {
+        QJsonObject entry;
+        entry.insert(QStringLiteral("worker"), worker.slot + 1);
+        entry.insert(QStringLiteral("processes"), worker.processes);
+        entry.insert(QStringLiteral("crashes"), worker.crashes);
+        entry.insert(QStringLiteral("jobs"), worker.jobs);
+        entry.insert(QStringLiteral("failed"), worker.failed);
+        entry.insert(QStringLiteral("busy_ms"), worker.busyMs);
+        entry.insert(QStringLiteral("jobs_per_min"), worker.jobsPerMinute(result.elapsedMs));
+        entry.insert(QStringLiteral("triangles_per_s"), worker.trianglesPerSecond());
+        entry.insert(QStringLiteral("peak_bytes"), worker.peakBytes);
+        workers.append(entry);
+    }
+
+    QJsonObject json;
+    json.insert(QStringLiteral("completed"), result.completed);
+    json.insert(QStringLiteral("elapsed_ms"), result.elapsedMs);
+    json.insert(QStringLiteral("failed"), result.failedCount());
+    json.insert(QStringLiteral("jobs"), jobs);
+    json.insert(QStringLiteral("workers"), workers);
+    return json;
+}
+
+} // namespace
+
+bool isBatchCommand(int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], kBatchFlag) == 0 || std::strcmp(argv[i], kWorkerFlag) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int runBatchCommand(const QStringList& arguments) {
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        tr("Converts images to lithophanes in parallel worker processes, using the mesh and "
+           "export settings from the preferences."));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("images"),
+        tr("Images, or directories whose images are converted."), QStringLiteral("images..."));
+    const QCommandLineOption batchOption(QString::fromLatin1(kBatchFlag + 2),
+        tr("Convert the images without opening a window."));
+    QCommandLineOption workerOption(QString::fromLatin1(kWorkerFlag + 2),
+        tr("Run as a worker of a batch (internal)."));
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    const QCommandLineOption outOption(QStringLiteral("out"),
+        tr("Directory for the lithophane files (default: current directory)."),
+        QStringLiteral("dir"), QStringLiteral("."));
+    const QCommandLineOption formatOption(QStringLiteral("format"),
+        tr("Export format: %1 (default: stl_bin).").arg(exportFormats().join(QStringLiteral(", "))),
+        QStringLiteral("format"), QStringLiteral("stl_bin"));
+    const QCommandLineOption flipOption(QStringLiteral("flip"),
+        tr("Flip the images vertically."));
+    const QCommandLineOption workersOption(QStringLiteral("workers"),
+        tr("Worker processes (default: one per CPU)."), QStringLiteral("count"),
+        QStringLiteral("0"));
+    const QCommandLineOption jobsPerWorkerOption(QStringLiteral("jobs-per-worker"),
+        tr("Images a worker converts before it is replaced by a new process, "
+           "0 for no limit (default: 50)."),
+        QStringLiteral("count"), QStringLiteral("50"));
+    const QCommandLineOption timeoutOption(QStringLiteral("timeout"),
+        tr("Seconds after which a worker stuck on one image is stopped, 0 for no limit "
+           "(default: 600)."),
+        QStringLiteral("seconds"), QStringLiteral("600"));
+    const QCommandLineOption reportOption(QStringLiteral("report"),
+        tr("Write the result of every image and worker to this JSON file."),
+        QStringLiteral("file"));
+    parser.addOptions({batchOption, workerOption, outOption, formatOption, flipOption,
+                       workersOption, jobsPerWorkerOption, timeoutOption, reportOption});
+    parser.process(arguments);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    const QString format = parser.value(formatOption);
+    if (!exportFormats().contains(format)) {
+        err << tr("Unknown or unsupported format: %1").arg(format) << Qt::endl;
+        return 2;
+    }
+    if (parser.isSet(workerOption)) {
+        return runWorker(format, parser.isSet(flipOption));
+    }
+
+    const QStringList inputs = collectInputs(parser.positionalArguments(), err);
+    if (inputs.isEmpty()) {
+        err << tr("No images to convert") << Qt::endl;
+        return 2;
+    }
+    const QDir outDir(parser.value(outOption));
+    if (!outDir.mkpath(QStringLiteral("."))) {
+        err << tr("Cannot create %1").arg(outDir.path()) << Qt::endl;
+        return 2;
+    }
+
+    BatchOptions options;
+    options.workers = std::max(0, parser.value(workersOption).toInt());
+    options.jobsPerWorker = std::max(0, parser.value(jobsPerWorkerOption).toInt());
+    options.jobTimeoutMs = std::max(0, parser.value(timeoutOption).toInt()) * 1000;
+
+    QStringList workerArguments{QString::fromLatin1(kWorkerFlag),
+                                QStringLiteral("--format"), format};
+    if (parser.isSet(flipOption)) {
+        workerArguments << QStringLiteral("--flip");
+    }
+
+    const QList<BatchJob> jobs =
+        makeJobs(inputs, outDir, exporterFromSettings(format)->extension());
+    const BatchRunner runner(QCoreApplication::applicationFilePath(), workerArguments, options);
+    const BatchResult result = runner.run(jobs, [&err](const Progress& progress) {
+        err << QStringLiteral("\r%1/%2 (%3)   ")
+                   .arg(progress.done).arg(progress.total)
+                   .arg(ProgressMeter::describe(progress, tr("images")));
+        err.flush();
+    });
+    err << Qt::endl;
+
+    if (!result.completed) {
+        err << result.errorMessage << Qt::endl;
+        return 2;
+    }
+
+    const int failed = result.failedCount();
+    out << tr("Converted %1 of %2 images in %3 s")
+               .arg(jobs.size() - failed).arg(jobs.size())
+               .arg(result.elapsedMs / 1000.0, 0, 'f', 1) << Qt::endl << Qt::endl;
+    printWorkers(result, out);
+    if (failed > 0) {
+        out << Qt::endl << tr("Failed:") << Qt::endl;
+        for (const BatchJobResult& job : result.jobs) {
+            if (!job.success) {
+                out << "  " << job.job.input << ": " << job.errorMessage << Qt::endl;
+            }
+        }
+    }
+
+    if (parser.isSet(reportOption)) {
+        QFile report(parser.value(reportOption));
+        if (!report.open(QIODevice::WriteOnly) ||
+            report.write(QJsonDocument(toJson(result)).toJson()) < 0) {
+            err << tr("Cannot write %1: %2").arg(report.fileName(), report.errorString()) << Qt::endl;
+            return 2;
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,33 @@
+/**
+ * @file batchcommand.h
+ * @brief Command line batch conversion
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QStringList>
+
+namespace LithoMaker {
+
+/**
+ * @brief Whether the command line asks for batch conversion
+ *
+ * Checked before the application object exists, since batch runs use a
+ * QCoreApplication and need no display.
+ */
+bool isBatchCommand(int argc, char* argv[]);
+
+/**
+ * @brief Convert images to lithophane files in worker processes
+ * @param arguments Application arguments, including --batch
+ * @return 0 if every image was converted, 1 if some failed, 2 on
+ *         invalid options or when the workers could not run
+ *
+ * With --batch-worker instead, runs one worker of such a batch.
+ */
+int runBatchCommand(const QStringList& arguments);
+
+} // namespace LithoMaker
@@ -0,0 +1,361 @@
+/**
+ * @file batchrunner.cpp
+ * @brief Batch conversion in a pool of worker processes implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "batchrunner.h"
+#include "batchworker.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QProcess>
+#include <QThread>
+#include <QTimer>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+// Workers that exit before reading a request, or while idle, point at a
+// broken setup rather than a bad input, so the batch is stopped instead
+constexpr int kMaxStartFailures = 3;
+
+struct Worker {
+    int slot{0};
+    QProcess* process{nullptr};
+    QTimer timeout;
+    QByteArray buffer;  // Output not yet split into lines
+    int job{-1};        // Job being run, -1 when idle
+    int jobsRun{0};     // By the current process
+    bool ready{false};  // Reading requests
+    bool retiring{false};
+    bool timedOut{false};
+    QElapsedTimer jobClock;
+};
+
+/**
+ * @brief State of one BatchRunner::run() call
+ */
+class BatchRun {
+public:
+    BatchRun(const QString& program, const QStringList& arguments, const BatchOptions& options,
+             const QList<BatchJob>& jobs, ProgressCallback progressCallback)
+        : m_program(program)
+        , m_arguments(arguments)
+        , m_options(options)
+        , m_jobs(jobs)
+        , m_progress(jobs.size(), std::move(progressCallback))
+        , m_remaining(jobs.size())
+    {
+        m_result.jobs.reserve(jobs.size());
+        for (int i = 0; i < jobs.size(); ++i) {
+            BatchJobResult result;
+            result.job = jobs[i];
+            m_result.jobs.append(result);
+            m_queue.push_back(i);
+        }
+        m_final.assign(static_cast<size_t>(jobs.size()), false);
+        m_startCrashes.assign(static_cast<size_t>(jobs.size()), 0);
+    }
+
+    BatchResult exec() {
+        QElapsedTimer clock;
+        clock.start();
+
+        const int cpus = std::max(1, QThread::idealThreadCount());
+        const int count = std::clamp(m_options.workers > 0 ? m_options.workers : cpus,
+                                     1, std::max(1, int(m_jobs.size())));
+        // Share the CPUs between the workers' own OpenMP threads
+        m_environment = QProcessEnvironment::systemEnvironment();
+        if (!m_environment.contains(QStringLiteral("OMP_NUM_THREADS"))) {
+            m_environment.insert(QStringLiteral("OMP_NUM_THREADS"),
+                                 QString::number(std::max(1, cpus / count)));
+        }
+
+        for (int slot = 0; slot < count && !m_jobs.isEmpty(); ++slot) {
+            auto worker = std::make_unique<Worker>();
+            worker->slot = slot;
+            worker->timeout.setSingleShot(true);
+            BatchWorkerStats stats;
+            stats.slot = slot;
+            m_result.workers.append(stats);
+            m_workers.push_back(std::move(worker));
+        }
+        for (auto& worker : m_workers) {
+            if (!m_aborted) {
+                startProcess(*worker);
+            }
+        }
+        if (!isFinished()) {
+            m_loop.exec();
+        }
+        QCoreApplication::sendPostedEvents(nullptr, QEvent::DeferredDelete);
+
+        for (size_t i = 0; i < m_final.size(); ++i) {
+            if (!m_final[i] && m_result.jobs[int(i)].errorMessage.isEmpty()) {
+                m_result.jobs[int(i)].errorMessage = QObject::tr("Not run");
+            }
+        }
+        m_progress.finish();
+        m_result.completed = !m_aborted;
+        m_result.elapsedMs = clock.elapsed();
+        return m_result;
+    }
+
+private:
+    void startProcess(Worker& worker) {
+        worker.process = new QProcess;
+        worker.buffer.clear();
+        worker.job = -1;
+        worker.jobsRun = 0;
+        worker.ready = false;
+        worker.retiring = false;
+        worker.timedOut = false;
+        ++m_result.workers[worker.slot].processes;
+
+        QProcess* process = worker.process;
+        process->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process->setProcessEnvironment(m_environment);
+        QObject::connect(process, &QProcess::readyReadStandardOutput, process,
+                         [this, &worker]() { readReplies(worker); });
+        QObject::connect(process, &QProcess::finished, process,
+                         [this, &worker](int exitCode, QProcess::ExitStatus status) {
+                             processFinished(worker, exitCode, status);
+                         });
+        QObject::connect(process, &QProcess::errorOccurred, process,
+                         [this, &worker](QProcess::ProcessError error) {
+                             // No finished() follows a failed start
+                             if (error == QProcess::FailedToStart) {
+                                 const QString reason = worker.process->errorString();
+                                 worker.process->deleteLater();
+                                 worker.process = nullptr;
+                                 abort(QObject::tr("Cannot start a batch worker: %1").arg(reason));
+                             }
+                         });
+        QObject::connect(&worker.timeout, &QTimer::timeout, process, [&worker]() {
+            worker.timedOut = true;
+            worker.process->kill();
+        });
+
+        process->start(m_program, m_arguments);
+        dispatch(worker);
+    }
+
+    void dispatch(Worker& worker) {
+        if (!worker.process || worker.job >= 0 || worker.retiring) {
+            return;
+        }
+        const bool spent = m_options.jobsPerWorker > 0 && worker.jobsRun >= m_options.jobsPerWorker;
+        if (m_aborted || m_queue.empty() || spent) {
+            // Exits after the current request; replaced in processFinished()
+            // if there is still work
+            worker.retiring = true;
+            worker.process->closeWriteChannel();
+            return;
+        }
+
+        const int index = m_queue.front();
+        m_queue.pop_front();
+        worker.job = index;
+        BatchJobResult& result = m_result.jobs[index];
+        ++result.attempts;
+        result.worker = worker.slot;
+
+        BatchProtocol::Request request;
+        request.id = index;
+        request.job = m_jobs[index];
+        worker.jobClock.start();
+        worker.process->write(BatchProtocol::encode(request));
+        if (m_options.jobTimeoutMs > 0) {
+            worker.timeout.start(m_options.jobTimeoutMs);
+        }
+    }
+
+    void readReplies(Worker& worker) {
+        worker.buffer += worker.process->readAllStandardOutput();
+        qsizetype newline;
+        while ((newline = worker.buffer.indexOf('\n')) >= 0) {
+            const QByteArray line = worker.buffer.left(newline);
+            worker.buffer.remove(0, newline + 1);
+            if (BatchProtocol::isReady(line)) {
+                worker.ready = true;
+                continue;
+            }
+            const auto reply = BatchProtocol::decodeReply(line);
+            if (!reply || reply->id != worker.job) {
+                qWarning() << "Unexpected output from batch worker" << worker.slot << ":" << line;
+                continue;
+            }
+
+            m_startFailures = 0;
+            ++worker.jobsRun;
+            BatchWorkerStats& stats = m_result.workers[worker.slot];
+            stats.peakBytes = std::max(stats.peakBytes, reply->peakBytes);
+            completeJob(worker, reply->success, reply->errorMessage, reply->triangles, false);
+            dispatch(worker);
+        }
+    }
+
+    void processFinished(Worker& worker, int exitCode, QProcess::ExitStatus status) {
+        readReplies(worker); // Replies written right before exiting
+
+        BatchWorkerStats& stats = m_result.workers[worker.slot];
+        const bool crashed = status == QProcess::CrashExit || exitCode != 0;
+        if (crashed) {
+            ++stats.crashes;
+        }
+        if (worker.job >= 0) {
+            QString error;
+            if (worker.timedOut) {
+                error = QObject::tr("Timed out after %1 s").arg(m_options.jobTimeoutMs / 1000);
+            } else if (status == QProcess::CrashExit) {
+                error = QObject::tr("Worker crashed");
+            } else {
+                error = QObject::tr("Worker exited with code %1").arg(exitCode);
+            }
+            qWarning() << "Batch worker" << worker.slot << "lost" << m_jobs[worker.job].input
+                       << "-" << error;
+            // A worker that never got to read the request is a start
+            // failure. One lost on its first job does not charge the input,
+            // once; an input that also takes down a second fresh worker is
+            // charged. Neither counts as a start failure then.
+            int& startCrashes = m_startCrashes[size_t(worker.job)];
+            if (!worker.ready) {
+                requeue(worker, error);
+                if (++m_startFailures >= kMaxStartFailures) {
+                    abort(QObject::tr("Batch workers exit before reading a job: %1").arg(error));
+                }
+            } else if (worker.jobsRun == 0 && !worker.timedOut && startCrashes == 0) {
+                ++startCrashes;
+                requeue(worker, error);
+            } else {
+                completeJob(worker, false, error, 0, true);
+            }
+        } else if (!worker.retiring && ++m_startFailures >= kMaxStartFailures) {
+            abort(QObject::tr("Batch workers exit right after starting (exit code %1)").arg(exitCode));
+        }
+
+        worker.timeout.stop();
+        worker.process->deleteLater();
+        worker.process = nullptr;
+        if (!m_aborted && !m_queue.empty()) {
+            startProcess(worker);
+        }
+        checkFinished();
+    }
+
+    // Puts the worker's job back without using up an attempt
+    void requeue(Worker& worker, const QString& error) {
+        const int index = worker.job;
+        worker.job = -1;
+        worker.timeout.stop();
+        BatchJobResult& result = m_result.jobs[index];
+        --result.attempts;
+        result.errorMessage = error;
+        m_queue.push_back(index);
+    }
+
+    void completeJob(Worker& worker, bool success, const QString& error, qint64 triangles,
+                     bool crashed) {
+        const int index = worker.job;
+        worker.job = -1;
+        worker.timeout.stop();
+
+        BatchJobResult& result = m_result.jobs[index];
+        BatchWorkerStats& stats = m_result.workers[worker.slot];
+        result.ms = worker.jobClock.elapsed();
+        result.crashed = crashed;
+        stats.busyMs += result.ms;
+        if (crashed && result.attempts < m_options.attempts && !m_aborted) {
+            // Maybe not the input's fault; try again on a fresh worker
+            result.errorMessage = error;
+            m_queue.push_back(index);
+            return;
+        }
+
+        result.success = success;
+        result.errorMessage = success ? QString() : error;
+        result.triangles = triangles;
+        m_final[size_t(index)] = true;
+        ++stats.jobs;
+        stats.failed += success ? 0 : 1;
+        stats.triangles += triangles;
+        --m_remaining;
+        if (!success) {
+            qWarning() << "Batch job failed:" << result.job.input << "-" << error;
+        }
+        m_progress.add(1);
+    }
+
+    void abort(const QString& message) {
+        if (!m_aborted) {
+            qWarning() << message;
+            m_aborted = true;
+            m_result.errorMessage = message;
+        }
+        for (auto& worker : m_workers) {
+            if (worker->process) {
+                worker->process->kill();
+            }
+        }
+        checkFinished();
+    }
+
+    bool isFinished() const {
+        if (m_remaining > 0 && !m_aborted) {
+            return false;
+        }
+        return std::none_of(m_workers.begin(), m_workers.end(),
+                            [](const auto& worker) { return worker->process != nullptr; });
+    }
+
+    void checkFinished() {
+        if (isFinished()) {
+            m_loop.quit();
+        }
+    }
+
+    const QString m_program;
+    const QStringList m_arguments;
+    const BatchOptions m_options;
+    const QList<BatchJob> m_jobs;
+    QProcessEnvironment m_environment;
+
+    BatchResult m_result;
+    std::vector<bool> m_final;  // Job has its result
+    std::vector<int> m_startCrashes; // Fresh workers lost on the job without charging it
+    std::deque<int> m_queue;    // Jobs waiting for a worker
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    ProgressMeter m_progress;
+    qint64 m_remaining{0};
+    int m_startFailures{0};
+    bool m_aborted{false};
+    QEventLoop m_loop;
+};
+
+} // namespace
+
+BatchRunner::BatchRunner(const QString& program, const QStringList& workerArguments,
+                         const BatchOptions& options)
+    : m_program(program)
+    , m_workerArguments(workerArguments)
+    , m_options(options)
+{
+}
+
+BatchResult BatchRunner::run(const QList<BatchJob>& jobs, ProgressCallback progressCallback) const {
+    BatchRun batch(m_program, m_workerArguments, m_options, jobs, std::move(progressCallback));
+    return batch.exec();
+}
+
+} // namespace LithoMaker
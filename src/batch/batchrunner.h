@@ -0,0 +1,129 @@
+/**
+ * @file batchrunner.h
+ * @brief Batch conversion in a pool of worker processes
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "core/progress.h"
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+namespace LithoMaker {
+
+/**
+ * @brief One input of a batch and where its result goes
+ */
+struct BatchJob {
+    QString input;
+    QString output;
+};
+
+/**
+ * @brief Outcome of one batch job
+ */
+struct BatchJobResult {
+    BatchJob job;
+    bool success{false};
+    QString errorMessage;
+    bool crashed{false}; ///< The worker died or timed out on this job
+    int attempts{0};
+    int worker{-1};      ///< Worker slot of the last attempt
+    qint64 ms{0};        ///< Duration of the last attempt
+    qint64 triangles{0};
+};
+
+/**
+ * @brief Work done by one worker slot over the whole batch
+ *
+ * A slot is one place in the pool; its process is replaced when it
+ * crashes or has run its share of jobs, and the counts cover all of
+ * its processes.
+ */
+struct BatchWorkerStats {
+    int slot{0};
+    int jobs{0};         ///< Jobs finished, successful or not
+    int failed{0};
+    int crashes{0};      ///< Processes that died or were killed
+    int processes{0};    ///< Processes started
+    qint64 busyMs{0};    ///< Time spent on jobs
+    qint64 triangles{0};
+    qint64 peakBytes{0}; ///< Highest accounted memory of any of its jobs
+
+    double jobsPerMinute(qint64 elapsedMs) const {
+        return elapsedMs > 0 ? jobs * 60000.0 / double(elapsedMs) : 0.0;
+    }
+    double trianglesPerSecond() const {
+        return busyMs > 0 ? triangles * 1000.0 / double(busyMs) : 0.0;
+    }
+};
+
+/**
+ * @brief Result of a batch
+ */
+struct BatchResult {
+    bool completed{false}; ///< False if the workers could not be run at all
+    QString errorMessage;
+    QList<BatchJobResult> jobs; ///< In the order of the input jobs
+    QList<BatchWorkerStats> workers;
+    qint64 elapsedMs{0};
+
+    int failedCount() const {
+        int count = 0;
+        for (const BatchJobResult& result : jobs) {
+            count += result.success ? 0 : 1;
+        }
+        return count;
+    }
+};
+
+/**
+ * @brief Pool settings
+ */
+struct BatchOptions {
+    int workers{0};          ///< Worker processes, 0 for one per CPU
+    int jobsPerWorker{50};   ///< Jobs before a worker is replaced, 0 for never
+    int jobTimeoutMs{10 * 60 * 1000}; ///< A worker taking longer is killed, 0 for no limit
+    int attempts{2};         ///< Runs of a job whose worker crashes before it is given up
+};
+
+/**
+ * @brief Runs batch jobs in separate worker processes
+ *
+ * Each worker handles one job at a time, so a crash in the decoder or
+ * mesh code only loses the job it was working on: the job is retried
+ * on a new worker, and recorded as failed if that crashes as well.
+ * Replacing workers after a number of jobs returns memory fragmented
+ * by long runs to the system.
+ *
+ * Workers are started as `program workerArguments...` and speak the
+ * line protocol described in batchworker.h over their standard input
+ * and output. Their standard error is passed through.
+ */
+class BatchRunner {
+public:
+    BatchRunner(const QString& program, const QStringList& workerArguments,
+                const BatchOptions& options);
+
+    /**
+     * @brief Run all jobs, returning when every job has a result
+     * @param jobs Inputs and outputs
+     * @param progressCallback Optional callback, one step per finished job
+     *
+     * Runs an event loop while waiting, so it must be called from a
+     * thread with a QCoreApplication.
+     */
+    BatchResult run(const QList<BatchJob>& jobs, ProgressCallback progressCallback = nullptr) const;
+
+private:
+    QString m_program;
+    QStringList m_workerArguments;
+    BatchOptions m_options;
+};
+
+} // namespace LithoMaker
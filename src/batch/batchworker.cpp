@@ -0,0 +1,131 @@
+/**
+ * @file batchworker.cpp
+ * @brief Worker side of batch conversion implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "batchworker.h"
+
+#include "core/memorystats.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <cstdio>
+
+namespace LithoMaker {
+
+namespace {
+
+std::optional<QJsonObject> parseLine(const QByteArray& line) {
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(line.trimmed(), &error);
+    if (error.error != QJsonParseError::NoError || !document.isObject()) {
+        return std::nullopt;
+    }
+    return document.object();
+}
+
+QByteArray toLine(const QJsonObject& object) {
+    return QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n';
+}
+
+} // namespace
+
+QByteArray BatchProtocol::encode(const Request& request) {
+    QJsonObject object;
+    object.insert(QStringLiteral("id"), request.id);
+    object.insert(QStringLiteral("input"), request.job.input);
+    object.insert(QStringLiteral("output"), request.job.output);
+    return toLine(object);
+}
+
+QByteArray BatchProtocol::encode(const Reply& reply) {
+    QJsonObject object;
+    object.insert(QStringLiteral("id"), reply.id);
+    object.insert(QStringLiteral("ok"), reply.success);
+    if (reply.success) {
+        object.insert(QStringLiteral("triangles"), reply.triangles);
+    } else {
+        object.insert(QStringLiteral("error"), reply.errorMessage);
+    }
+    object.insert(QStringLiteral("peak_bytes"), reply.peakBytes);
+    return toLine(object);
+}
+
+std::optional<BatchProtocol::Request> BatchProtocol::decodeRequest(const QByteArray& line) {
+    const auto object = parseLine(line);
+    if (!object || !object->contains(QStringLiteral("id"))) {
+        return std::nullopt;
+    }
+    Request request;
+    request.id = object->value(QStringLiteral("id")).toInteger(-1);
+    request.job.input = object->value(QStringLiteral("input")).toString();
+    request.job.output = object->value(QStringLiteral("output")).toString();
+    return request;
+}
+
+std::optional<BatchProtocol::Reply> BatchProtocol::decodeReply(const QByteArray& line) {
+    const auto object = parseLine(line);
+    if (!object || !object->contains(QStringLiteral("id"))) {
+        return std::nullopt;
+    }
+    Reply reply;
+    reply.id = object->value(QStringLiteral("id")).toInteger(-1);
+    reply.success = object->value(QStringLiteral("ok")).toBool();
+    reply.errorMessage = object->value(QStringLiteral("error")).toString();
+    reply.triangles = object->value(QStringLiteral("triangles")).toInteger();
+    reply.peakBytes = object->value(QStringLiteral("peak_bytes")).toInteger();
+    return reply;
+}
+
+QByteArray BatchProtocol::readyLine() {
+    return toLine(QJsonObject{{QStringLiteral("ready"), true}});
+}
+
+bool BatchProtocol::isReady(const QByteArray& line) {
+    const auto object = parseLine(line);
+    return object && object->value(QStringLiteral("ready")).toBool();
+}
+
+int BatchWorker::run(const BatchJobHandler& handler) {
+    QFile in;
+    QFile out;
+    if (!in.open(stdin, QIODevice::ReadOnly) || !out.open(stdout, QIODevice::WriteOnly)) {
+        qWarning() << "Batch worker cannot open its standard streams";
+        return 2;
+    }
+    out.write(BatchProtocol::readyLine());
+    out.flush();
+
+    // Blocking reads: a worker has nothing else to do while it waits
+    while (true) {
+        const QByteArray line = in.readLine();
+        if (line.isEmpty()) {
+            break; // Closed by the runner
+        }
+        const auto request = BatchProtocol::decodeRequest(line);
+        if (!request) {
+            qWarning() << "Batch worker ignored a malformed request:" << line.trimmed();
+            continue;
+        }
+
+        MemoryStats::resetPeaks();
+        const BatchJobOutcome outcome = handler(request->job);
+        BatchProtocol::Reply reply;
+        reply.id = request->id;
+        reply.success = outcome.success;
+        reply.errorMessage = outcome.errorMessage;
+        reply.triangles = outcome.triangles;
+        reply.peakBytes = MemoryStats::peakTotal();
+        out.write(BatchProtocol::encode(reply));
+        out.flush();
+    }
+    return 0;
+}
+
+} // namespace LithoMaker
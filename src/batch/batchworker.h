@@ -0,0 +1,86 @@
+/**
+ * @file batchworker.h
+ * @brief Worker side of batch conversion and its line protocol
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "batchrunner.h"
+
+#include <QByteArray>
+#include <functional>
+#include <optional>
+
+namespace LithoMaker {
+
+/**
+ * @brief Messages between BatchRunner and its workers
+ *
+ * One compact JSON object per line. A worker announces that it reads
+ * requests with {"ready":true}. The runner sends a request per job,
+ * {"id":3,"input":"a.png","output":"out/a.stl"}, and waits for the
+ * reply before it sends the next one:
+ * {"id":3,"ok":true,"triangles":1200000,"peak_bytes":73400320} or
+ * {"id":3,"ok":false,"error":"..."}. The worker exits when its
+ * standard input is closed.
+ */
+class BatchProtocol {
+public:
+    struct Request {
+        qint64 id{-1};
+        BatchJob job;
+    };
+
+    struct Reply {
+        qint64 id{-1};
+        bool success{false};
+        QString errorMessage;
+        qint64 triangles{0};
+        qint64 peakBytes{0}; ///< Peak accounted memory during the job (see MemoryStats)
+    };
+
+    static QByteArray encode(const Request& request);
+    static QByteArray encode(const Reply& reply);
+    static std::optional<Request> decodeRequest(const QByteArray& line);
+    static std::optional<Reply> decodeReply(const QByteArray& line);
+    static QByteArray readyLine();
+    static bool isReady(const QByteArray& line);
+
+private:
+    BatchProtocol() = default;
+};
+
+/**
+ * @brief Result of one job inside a worker
+ */
+struct BatchJobOutcome {
+    bool success{false};
+    QString errorMessage;
+    qint64 triangles{0};
+};
+
+using BatchJobHandler = std::function<BatchJobOutcome(const BatchJob& job)>;
+
+/**
+ * @brief Worker process main loop
+ *
+ * Reads requests from standard input, runs them one after the other and
+ * writes a reply for each to standard output, which must not be used
+ * for anything else in a worker.
+ */
+class BatchWorker {
+public:
+    /**
+     * @brief Serve requests until standard input is closed
+     * @return Process exit code
+     */
+    static int run(const BatchJobHandler& handler);
+
+private:
+    BatchWorker() = default;
+};
+
+} // namespace LithoMaker
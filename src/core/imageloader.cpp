@@ -57,6 +57,7 @@ std::optional<ImageLoadResult> ImageLoader::load(
         qWarning() << "Failed to decode image:" << filePath << "-" << reader.errorString();
         return std::nullopt;
     }
+    result.memory.resize(result.image.sizeInBytes());
 
     // Check for JPEG quality issues
     if (result.originalFormat == "JPEG" || result.originalFormat == "JPG") {
@@ -86,6 +87,7 @@ std::optional<ImageLoadResult> ImageLoader::load(
         result.wasConverted = true;
         qInfo() << "Image converted to grayscale";
     }
+    result.memory.resize(result.image.sizeInBytes());
 
     return result;
 }
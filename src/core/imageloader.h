@@ -8,6 +8,8 @@
 
 #pragma once
 
+#include "memorystats.h"
+
 #include <QImage>
 #include <QString>
 #include <QStringList>
@@ -25,6 +27,7 @@ struct ImageLoadResult {
     QString originalFormat;        ///< Original image format
     QSize originalSize;            ///< Original image size before any processing
     bool hasQualityWarning{false}; ///< True if JPEG with potential artifacts
+    MemoryLease memory{MemorySubsystem::Image}; ///< Reports the image's bytes
 };
 
 /**
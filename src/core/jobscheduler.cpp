@@ -0,0 +1,340 @@
+/**
+ * @file jobscheduler.cpp
+ * @brief Background jobs with interactive work taking precedence
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "jobscheduler.h"
+
+#include <QThread>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#ifndef BUILD_WASM
+#include <thread>
+#endif
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+qint64 nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int indexOf(JobPriority priority) {
+    return priority == JobPriority::Interactive ? 0 : 1;
+}
+
+int defaultWorkerCount() {
+    return std::max(1, QThread::idealThreadCount() / 2);
+}
+
+struct QueuedJob {
+    JobScheduler::Job job;
+    qint64 requestedNs{0};
+};
+
+// What happened to the jobs of one priority
+struct Record {
+    int active{0}; // Queued or running
+    std::vector<double> latenciesMs;
+    qint64 firstRequestNs{-1};
+    qint64 lastCompletionNs{0};
+    qint64 yieldedNs{0};
+};
+
+} // namespace
+
+/**
+ * @brief Queues, worker threads and records, guarded by one mutex
+ */
+class JobScheduler::Pool {
+public:
+    explicit Pool(JobScheduler& scheduler)
+        : m_scheduler(scheduler)
+        , workerCount(defaultWorkerCount())
+    {
+    }
+
+    // Called with the mutex held
+    void request(JobPriority priority, qint64 requestedNs) {
+        Record& record = records[indexOf(priority)];
+        ++record.active;
+        if (record.firstRequestNs < 0) {
+            record.firstRequestNs = requestedNs;
+        }
+        if (priority == JobPriority::Interactive) {
+            ++m_scheduler.m_interactive;
+        }
+    }
+
+    // Called without the mutex
+    void finish(JobPriority priority, qint64 requestedNs, qint64 yieldedNs) {
+        const qint64 now = nowNs();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            Record& record = records[indexOf(priority)];
+            --record.active;
+            record.latenciesMs.push_back((now - requestedNs) / 1e6);
+            record.lastCompletionNs = now;
+            record.yieldedNs += yieldedNs;
+            if (priority == JobPriority::Interactive) {
+                --m_scheduler.m_interactive;
+            }
+        }
+        changed.notify_all();
+    }
+
+    // Called without the mutex
+    void execute(JobPriority priority, QueuedJob& queued) {
+        JobContext context(m_scheduler, priority);
+#ifdef USE_OPENMP
+        // Batch threads share the cores; an interactive job runs while
+        // they wait and gets all of them
+        int workers = 1;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            workers = std::max(1, workerCount);
+        }
+        const int previousThreads = omp_get_max_threads();
+        omp_set_num_threads(priority == JobPriority::Interactive
+            ? omp_get_num_procs()
+            : std::max(1, omp_get_num_procs() / workers));
+#endif
+        queued.job(context);
+#ifdef USE_OPENMP
+        omp_set_num_threads(previousThreads);
+#endif
+        finish(priority, queued.requestedNs, context.m_yieldedNs);
+    }
+
+#ifndef BUILD_WASM
+    // Called with the mutex held
+    void startThreads() {
+        while (liveThreads < workerCount) {
+            ++liveThreads;
+            threads.emplace_back(&Pool::run, this);
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            work.wait(lock, [this] {
+                return stop || liveThreads > workerCount ||
+                       !queues[0].empty() || !queues[1].empty();
+            });
+            if (stop) {
+                return;
+            }
+            if (liveThreads > workerCount) {
+                --liveThreads;
+                return;
+            }
+            const JobPriority priority = queues[0].empty() ? JobPriority::Batch
+                                                           : JobPriority::Interactive;
+            std::deque<QueuedJob>& queue = queues[indexOf(priority)];
+            QueuedJob queued = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            execute(priority, queued);
+            lock.lock();
+        }
+    }
+#endif
+
+    JobScheduler& m_scheduler;
+    mutable std::mutex mutex;
+    std::condition_variable work;    // Jobs queued or worker count lowered
+    std::condition_variable changed; // Jobs finished or dropped
+    std::deque<QueuedJob> queues[2]; // Interactive, batch
+    Record records[2];
+    int workerCount;
+    bool stop{false};
+#ifndef BUILD_WASM
+    std::vector<std::thread> threads; // Including ones that exited after setWorkerCount()
+    int liveThreads{0};
+#endif
+};
+
+void JobContext::checkpoint() {
+    m_scheduler.yield(*this);
+}
+
+JobScheduler& JobScheduler::instance() {
+    static JobScheduler scheduler;
+    return scheduler;
+}
+
+JobScheduler::JobScheduler()
+    : m_pool(std::make_unique<Pool>(*this))
+{
+}
+
+JobScheduler::~JobScheduler() {
+#ifndef BUILD_WASM
+    {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        m_pool->stop = true;
+        m_pool->queues[0].clear();
+        m_pool->queues[1].clear();
+    }
+    m_pool->work.notify_all();
+    m_pool->changed.notify_all();
+    for (std::thread& thread : m_pool->threads) {
+        thread.join();
+    }
+#endif
+}
+
+void JobScheduler::submit(JobPriority priority, Job job) {
+    QueuedJob queued{std::move(job), nowNs()};
+    {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        m_pool->request(priority, queued.requestedNs);
+#ifndef BUILD_WASM
+        m_pool->queues[indexOf(priority)].push_back(std::move(queued));
+        m_pool->startThreads();
+    }
+    m_pool->work.notify_one();
+#else
+    }
+    // No threads in the browser build
+    m_pool->execute(priority, queued);
+#endif
+}
+
+int JobScheduler::cancelPending(JobPriority priority) {
+    int dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        std::deque<QueuedJob>& queue = m_pool->queues[indexOf(priority)];
+        dropped = static_cast<int>(queue.size());
+        queue.clear();
+        m_pool->records[indexOf(priority)].active -= dropped;
+        if (priority == JobPriority::Interactive) {
+            m_interactive -= dropped;
+        }
+    }
+    m_pool->changed.notify_all();
+    return dropped;
+}
+
+int JobScheduler::activeCount(JobPriority priority) const {
+    std::lock_guard<std::mutex> lock(m_pool->mutex);
+    return m_pool->records[indexOf(priority)].active;
+}
+
+void JobScheduler::waitForIdle() {
+    std::unique_lock<std::mutex> lock(m_pool->mutex);
+    m_pool->changed.wait(lock, [this] {
+        return m_pool->records[0].active == 0 && m_pool->records[1].active == 0;
+    });
+}
+
+void JobScheduler::setWorkerCount(int count) {
+    {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        m_pool->workerCount = count > 0 ? count : defaultWorkerCount();
+#ifndef BUILD_WASM
+        if (!m_pool->queues[0].empty() || !m_pool->queues[1].empty()) {
+            m_pool->startThreads();
+        }
+#endif
+    }
+    m_pool->work.notify_all();
+}
+
+int JobScheduler::workerCount() const {
+    std::lock_guard<std::mutex> lock(m_pool->mutex);
+    return m_pool->workerCount;
+}
+
+JobStats JobScheduler::stats(JobPriority priority) const {
+    std::vector<double> latencies;
+    JobStats stats;
+    qint64 spanNs = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_pool->mutex);
+        const Record& record = m_pool->records[indexOf(priority)];
+        latencies = record.latenciesMs;
+        stats.yieldedMs = record.yieldedNs / 1000000;
+        spanNs = record.lastCompletionNs - record.firstRequestNs;
+    }
+
+    stats.completed = static_cast<int>(latencies.size());
+    if (latencies.empty()) {
+        return stats;
+    }
+    std::sort(latencies.begin(), latencies.end());
+    stats.medianLatencyMs = latencies[latencies.size() / 2];
+    stats.p95LatencyMs = latencies[std::min(latencies.size() - 1, latencies.size() * 95 / 100)];
+    stats.maxLatencyMs = latencies.back();
+    if (spanNs > 0) {
+        stats.jobsPerMinute = stats.completed * 60e9 / double(spanNs);
+    }
+    return stats;
+}
+
+void JobScheduler::resetStats() {
+    std::lock_guard<std::mutex> lock(m_pool->mutex);
+    for (Record& record : m_pool->records) {
+        record.latenciesMs.clear();
+        record.firstRequestNs = -1;
+        record.lastCompletionNs = 0;
+        record.yieldedNs = 0;
+    }
+}
+
+void JobScheduler::yield(JobContext& context) {
+#ifdef BUILD_WASM
+    Q_UNUSED(context);
+#else
+    if (context.priority() != JobPriority::Batch || m_interactive.load() == 0) {
+        return;
+    }
+    const qint64 start = nowNs();
+    std::unique_lock<std::mutex> lock(m_pool->mutex);
+    while (m_interactive.load() > 0 && !m_pool->stop) {
+        // Rather than wait for a free thread, run queued interactive
+        // jobs here
+        if (!m_pool->queues[0].empty()) {
+            QueuedJob queued = std::move(m_pool->queues[0].front());
+            m_pool->queues[0].pop_front();
+            lock.unlock();
+            m_pool->execute(JobPriority::Interactive, queued);
+            lock.lock();
+            continue;
+        }
+        m_pool->changed.wait(lock);
+    }
+    context.m_yieldedNs += nowNs() - start;
+#endif
+}
+
+JobScheduler::InteractiveScope::InteractiveScope()
+    : m_startNs(nowNs())
+{
+    JobScheduler& scheduler = instance();
+    std::lock_guard<std::mutex> lock(scheduler.m_pool->mutex);
+    scheduler.m_pool->request(JobPriority::Interactive, m_startNs);
+}
+
+JobScheduler::InteractiveScope::~InteractiveScope() {
+    instance().m_pool->finish(JobPriority::Interactive, m_startNs, 0);
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,159 @@
+/**
+ * @file jobscheduler.h
+ * @brief Background jobs with interactive work taking precedence
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+namespace LithoMaker {
+
+/**
+ * @brief Urgency of a job
+ */
+enum class JobPriority {
+    Interactive, ///< Someone is waiting for it, such as a preview
+    Batch        ///< Throughput matters, not latency
+};
+
+/**
+ * @brief Latency and throughput of the jobs of one priority
+ */
+struct JobStats {
+    int completed{0};
+    double medianLatencyMs{0.0}; ///< From request to completion
+    double p95LatencyMs{0.0};
+    double maxLatencyMs{0.0};
+    double jobsPerMinute{0.0};   ///< From the first request to the last completion
+    qint64 yieldedMs{0};         ///< Time jobs spent waiting at checkpoints
+};
+
+class JobScheduler;
+
+/**
+ * @brief Handle through which a running job gives way to more urgent work
+ */
+class JobContext {
+public:
+    JobPriority priority() const { return m_priority; }
+
+    /**
+     * @brief Let interactive work go first
+     *
+     * Batch jobs call this between units of work, such as row bands,
+     * outside of parallel regions. While interactive work is queued or
+     * running, the call blocks, and runs queued interactive jobs on the
+     * waiting thread meanwhile. It costs one atomic load otherwise, and
+     * does nothing in interactive jobs.
+     */
+    void checkpoint();
+
+    qint64 yieldedMs() const { return m_yieldedNs / 1000000; }
+
+private:
+    friend class JobScheduler;
+    JobContext(JobScheduler& scheduler, JobPriority priority)
+        : m_scheduler(scheduler)
+        , m_priority(priority)
+    {
+    }
+
+    JobScheduler& m_scheduler;
+    const JobPriority m_priority;
+    qint64 m_yieldedNs{0};
+};
+
+/**
+ * @brief Runs jobs on background threads, interactive ones first
+ *
+ * Queued interactive jobs start before any queued batch job, and batch
+ * jobs that are already running pause at their next checkpoint until no
+ * interactive work is left, which gives the interactive job the CPU
+ * cores (batch threads share the OpenMP threads between them, an
+ * interactive job gets all of them). Interactive work that runs on the
+ * calling thread, like a preview generated on the UI thread, takes part
+ * through InteractiveScope.
+ *
+ * Latency is recorded per interactive request and throughput per batch
+ * job, so both can be reported separately. In the browser build there
+ * are no threads and submitted jobs run right away.
+ */
+class JobScheduler {
+public:
+    using Job = std::function<void(JobContext& context)>;
+
+    static JobScheduler& instance();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    /**
+     * @brief Queue a job for a background thread
+     */
+    void submit(JobPriority priority, Job job);
+
+    /**
+     * @brief Drop queued jobs that have not started
+     * @return Number of jobs dropped
+     */
+    int cancelPending(JobPriority priority);
+
+    /**
+     * @brief Jobs queued or running
+     */
+    int activeCount(JobPriority priority) const;
+
+    /**
+     * @brief Block until no job is queued or running
+     */
+    void waitForIdle();
+
+    /**
+     * @brief Number of threads running queued jobs
+     * @param count Threads, or 0 for half the CPUs
+     */
+    void setWorkerCount(int count);
+    int workerCount() const;
+
+    JobStats stats(JobPriority priority) const;
+    void resetStats();
+
+    /**
+     * @brief Interactive work on the calling thread
+     *
+     * Batch jobs yield while a scope exists, and its lifetime is recorded
+     * as the latency of an interactive request.
+     */
+    class InteractiveScope {
+    public:
+        InteractiveScope();
+        ~InteractiveScope();
+        InteractiveScope(const InteractiveScope&) = delete;
+        InteractiveScope& operator=(const InteractiveScope&) = delete;
+
+    private:
+        qint64 m_startNs;
+    };
+
+private:
+    friend class JobContext;
+    class Pool;
+
+    JobScheduler();
+    ~JobScheduler();
+
+    void yield(JobContext& context);
+
+    std::unique_ptr<Pool> m_pool;
+    std::atomic<int> m_interactive{0}; // Interactive jobs queued or running, plus scopes
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,194 @@
+/**
+ * @file memorystats.cpp
+ * @brief Per-subsystem memory accounting implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "memorystats.h"
+
+#include <QCoreApplication>
+#include <QStringList>
+
+#include <atomic>
+#include <cmath>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr int kSubsystems = static_cast<int>(MemorySubsystem::Count);
+
+struct Counter {
+    std::atomic<qint64> current{0};
+    std::atomic<qint64> peak{0};
+
+    void add(qint64 bytes) {
+        const qint64 now = current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        qint64 highest = peak.load(std::memory_order_relaxed);
+        while (now > highest &&
+               !peak.compare_exchange_weak(highest, now, std::memory_order_relaxed)) {
+        }
+    }
+};
+
+Counter s_counters[kSubsystems];
+Counter s_total;
+
+Counter& counter(MemorySubsystem subsystem) {
+    return s_counters[static_cast<int>(subsystem)];
+}
+
+double toMegabytes(qint64 bytes) {
+    return std::round(bytes / (1024.0 * 1024.0) * 100.0) / 100.0;
+}
+
+} // namespace
+
+void MemoryStats::allocate(MemorySubsystem subsystem, qint64 bytes) {
+    counter(subsystem).add(bytes);
+    s_total.add(bytes);
+}
+
+void MemoryStats::release(MemorySubsystem subsystem, qint64 bytes) {
+    counter(subsystem).current.fetch_sub(bytes, std::memory_order_relaxed);
+    s_total.current.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+qint64 MemoryStats::current(MemorySubsystem subsystem) {
+    return counter(subsystem).current.load(std::memory_order_relaxed);
+}
+
+qint64 MemoryStats::peak(MemorySubsystem subsystem) {
+    return counter(subsystem).peak.load(std::memory_order_relaxed);
+}
+
+qint64 MemoryStats::currentTotal() {
+    return s_total.current.load(std::memory_order_relaxed);
+}
+
+qint64 MemoryStats::peakTotal() {
+    return s_total.peak.load(std::memory_order_relaxed);
+}
+
+void MemoryStats::resetPeaks() {
+    for (Counter& c : s_counters) {
+        c.peak.store(c.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    s_total.peak.store(s_total.current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+QString MemoryStats::key(MemorySubsystem subsystem) {
+    switch (subsystem) {
+    case MemorySubsystem::Image: return QStringLiteral("image");
+    case MemorySubsystem::DepthBuffer: return QStringLiteral("depth_buffer");
+    case MemorySubsystem::Mesh: return QStringLiteral("mesh");
+    case MemorySubsystem::Preview: return QStringLiteral("preview");
+    case MemorySubsystem::Export: return QStringLiteral("export");
+    case MemorySubsystem::Count: break;
+    }
+    return QString();
+}
+
+QString MemoryStats::displayName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+    case MemorySubsystem::Image: return QCoreApplication::translate("MemoryStats", "Image");
+    case MemorySubsystem::DepthBuffer: return QCoreApplication::translate("MemoryStats", "Depth buffer");
+    case MemorySubsystem::Mesh: return QCoreApplication::translate("MemoryStats", "Mesh");
+    case MemorySubsystem::Preview: return QCoreApplication::translate("MemoryStats", "Preview");
+    case MemorySubsystem::Export: return QCoreApplication::translate("MemoryStats", "Export");
+    case MemorySubsystem::Count: break;
+    }
+    return QString();
+}
+
+QString MemoryStats::formatBytes(qint64 bytes) {
+    if (bytes >= qint64(1) << 30) {
+        return QStringLiteral("%1 GB").arg(bytes / double(qint64(1) << 30), 0, 'f', 2);
+    }
+    if (bytes >= qint64(1) << 20) {
+        return QStringLiteral("%1 MB").arg(bytes / double(qint64(1) << 20), 0, 'f', 1);
+    }
+    return QStringLiteral("%1 KB").arg((bytes + 1023) / 1024);
+}
+
+QStringList MemoryStats::report() {
+    QStringList lines;
+    for (int i = 0; i < kSubsystems; ++i) {
+        const auto subsystem = static_cast<MemorySubsystem>(i);
+        lines.append(QCoreApplication::translate("MemoryStats", "%1: %2 (peak %3)")
+            .arg(displayName(subsystem), formatBytes(current(subsystem)),
+                 formatBytes(peak(subsystem))));
+    }
+    return lines;
+}
+
+QJsonObject MemoryStats::toJson() {
+    const auto entry = [](qint64 currentBytes, qint64 peakBytes) {
+        QJsonObject object;
+        object.insert(QStringLiteral("current_mb"), toMegabytes(currentBytes));
+        object.insert(QStringLiteral("peak_mb"), toMegabytes(peakBytes));
+        return object;
+    };
+
+    QJsonObject json;
+    for (int i = 0; i < kSubsystems; ++i) {
+        const auto subsystem = static_cast<MemorySubsystem>(i);
+        json.insert(key(subsystem), entry(current(subsystem), peak(subsystem)));
+    }
+    json.insert(QStringLiteral("total"), entry(currentTotal(), peakTotal()));
+    return json;
+}
+
+MemoryLease::MemoryLease(MemorySubsystem subsystem, qint64 bytes)
+    : m_subsystem(subsystem)
+{
+    resize(bytes);
+}
+
+MemoryLease::MemoryLease(const MemoryLease& other)
+    : MemoryLease(other.m_subsystem, other.m_bytes)
+{
+}
+
+MemoryLease::MemoryLease(MemoryLease&& other) noexcept
+    : m_subsystem(other.m_subsystem)
+    , m_bytes(other.m_bytes)
+{
+    other.m_bytes = 0;
+}
+
+MemoryLease& MemoryLease::operator=(const MemoryLease& other) {
+    if (this != &other) {
+        resize(0);
+        m_subsystem = other.m_subsystem;
+        resize(other.m_bytes);
+    }
+    return *this;
+}
+
+MemoryLease& MemoryLease::operator=(MemoryLease&& other) noexcept {
+    if (this != &other) {
+        resize(0);
+        m_subsystem = other.m_subsystem;
+        m_bytes = other.m_bytes;
+        other.m_bytes = 0;
+    }
+    return *this;
+}
+
+MemoryLease::~MemoryLease() {
+    resize(0);
+}
+
+void MemoryLease::resize(qint64 bytes) {
+    if (bytes > m_bytes) {
+        MemoryStats::allocate(m_subsystem, bytes - m_bytes);
+    } else if (bytes < m_bytes) {
+        MemoryStats::release(m_subsystem, m_bytes - bytes);
+    }
+    m_bytes = bytes;
+}
+
+} // namespace LithoMaker
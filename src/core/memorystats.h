@@ -0,0 +1,162 @@
+/**
+ * @file memorystats.h
+ * @brief Per-subsystem memory accounting
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QJsonObject>
+#include <QStringList>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace LithoMaker {
+
+/**
+ * @brief Parts of the pipeline whose memory is accounted separately
+ */
+enum class MemorySubsystem {
+    Image,       ///< Decoded and prepared source images
+    DepthBuffer, ///< Depth buffers, heightfields and relief solver grids
+    Mesh,        ///< Generated and imported triangle lists
+    Preview,     ///< Preview copies of the mesh and its GPU buffers
+    Export,      ///< Exporter vertex dedup maps and indexed meshes
+    Count
+};
+
+/**
+ * @brief Process-wide current and peak bytes per subsystem
+ *
+ * Counters are updated with atomics and can be changed from any thread.
+ * They hold what the code reports through MemoryLease and
+ * TrackedAllocator, not what the allocator or the OS actually uses, so
+ * they show which part of the pipeline holds memory rather than the
+ * process size.
+ */
+class MemoryStats {
+public:
+    static void allocate(MemorySubsystem subsystem, qint64 bytes);
+    static void release(MemorySubsystem subsystem, qint64 bytes);
+
+    static qint64 current(MemorySubsystem subsystem);
+    static qint64 peak(MemorySubsystem subsystem);
+
+    /**
+     * @brief Sum over all subsystems, and its peak
+     *
+     * The total peak is the highest simultaneous sum, which can be lower
+     * than the sum of the subsystem peaks.
+     */
+    static qint64 currentTotal();
+    static qint64 peakTotal();
+
+    /**
+     * @brief Restart peak tracking from the current values
+     */
+    static void resetPeaks();
+
+    /**
+     * @brief Short lowercase name, as used in JSON keys ("depth_buffer")
+     */
+    static QString key(MemorySubsystem subsystem);
+
+    /**
+     * @brief Translated name for display
+     */
+    static QString displayName(MemorySubsystem subsystem);
+
+    /**
+     * @brief Format a byte count as KB, MB or GB
+     */
+    static QString formatBytes(qint64 bytes);
+
+    /**
+     * @brief One line per subsystem: name, current and peak
+     */
+    static QStringList report();
+
+    /**
+     * @brief Current and peak megabytes per subsystem and in total
+     *
+     * Keyed by key(), each entry holding "current_mb" and "peak_mb".
+     */
+    static QJsonObject toJson();
+
+private:
+    MemoryStats() = default;
+};
+
+/**
+ * @brief Reports memory held by an object to MemoryStats while it lives
+ *
+ * For containers without allocator support (QList, QVector, QImage):
+ * the owner resizes the lease when the container changes size. Copies
+ * report their bytes again, moves transfer them.
+ */
+class MemoryLease {
+public:
+    explicit MemoryLease(MemorySubsystem subsystem, qint64 bytes = 0);
+    MemoryLease(const MemoryLease& other);
+    MemoryLease(MemoryLease&& other) noexcept;
+    MemoryLease& operator=(const MemoryLease& other);
+    MemoryLease& operator=(MemoryLease&& other) noexcept;
+    ~MemoryLease();
+
+    /**
+     * @brief Set the number of bytes held
+     */
+    void resize(qint64 bytes);
+
+    qint64 bytes() const { return m_bytes; }
+    MemorySubsystem subsystem() const { return m_subsystem; }
+
+private:
+    MemorySubsystem m_subsystem;
+    qint64 m_bytes{0};
+};
+
+/**
+ * @brief Standard allocator that reports its allocations to MemoryStats
+ *
+ * For std containers, which then need no manual bookkeeping.
+ */
+template <typename T, MemorySubsystem S>
+struct TrackedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind {
+        using other = TrackedAllocator<U, S>;
+    };
+
+    TrackedAllocator() = default;
+    template <typename U>
+    TrackedAllocator(const TrackedAllocator<U, S>&) noexcept {}
+
+    T* allocate(std::size_t count) {
+        T* pointer = std::allocator<T>().allocate(count);
+        MemoryStats::allocate(S, static_cast<qint64>(count * sizeof(T)));
+        return pointer;
+    }
+
+    void deallocate(T* pointer, std::size_t count) noexcept {
+        std::allocator<T>().deallocate(pointer, count);
+        MemoryStats::release(S, static_cast<qint64>(count * sizeof(T)));
+    }
+
+    template <typename U>
+    bool operator==(const TrackedAllocator<U, S>&) const noexcept { return true; }
+    template <typename U>
+    bool operator!=(const TrackedAllocator<U, S>&) const noexcept { return false; }
+};
+
+template <typename T, MemorySubsystem S>
+using TrackedVector = std::vector<T, TrackedAllocator<T, S>>;
+
+} // namespace LithoMaker
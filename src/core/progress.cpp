@@ -0,0 +1,106 @@
+/**
+ * @file progress.cpp
+ * @brief Progress reporting implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "progress.h"
+
+#include <QCoreApplication>
+
+#include <cmath>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr qint64 kReportIntervalMs = 100;
+constexpr double kRateSmoothing = 0.3; // Weight of the latest interval
+
+QString formatCount(double value) {
+    if (value >= 1e9) {
+        return QStringLiteral("%1G").arg(value / 1e9, 0, 'f', 1);
+    }
+    if (value >= 1e6) {
+        return QStringLiteral("%1M").arg(value / 1e6, 0, 'f', 1);
+    }
+    if (value >= 1e3) {
+        return QStringLiteral("%1k").arg(value / 1e3, 0, 'f', 1);
+    }
+    return QString::number(value, 'f', value < 10.0 ? 1 : 0);
+}
+
+QString formatDuration(double seconds) {
+    const qint64 whole = qint64(std::ceil(seconds));
+    if (whole < 60) {
+        return QCoreApplication::translate("ProgressMeter", "%n s", nullptr, int(whole));
+    }
+    return QCoreApplication::translate("ProgressMeter", "%1 min %2 s")
+        .arg(whole / 60).arg(whole % 60);
+}
+
+} // namespace
+
+ProgressMeter::ProgressMeter(qint64 total, ProgressCallback callback)
+    : m_total(std::max<qint64>(total, 1))
+    , m_callback(std::move(callback))
+    , m_owner(std::this_thread::get_id())
+{
+    // Read the clock about a thousand times per job at most
+    m_checkStep = std::max<qint64>(1, m_total / 1000);
+    m_nextCheck = m_checkStep;
+    m_clock.start();
+}
+
+void ProgressMeter::finish() {
+    m_done.store(m_total, std::memory_order_relaxed);
+    if (m_callback) {
+        report(m_total, true);
+    }
+}
+
+void ProgressMeter::report(qint64 done, bool final) {
+    m_nextCheck = done + m_checkStep;
+    const qint64 now = m_clock.elapsed();
+    const qint64 interval = now - m_lastReportMs;
+    if (!final && interval < kReportIntervalMs) {
+        return;
+    }
+
+    // Smoothed over the last few reports, so the estimate follows
+    // stages of different speed without jumping around
+    if (interval > 0 && done > m_lastDone) {
+        const double rate = double(done - m_lastDone) * 1000.0 / double(interval);
+        m_rate = m_rate > 0.0 ? m_rate + (rate - m_rate) * kRateSmoothing : rate;
+    }
+    m_lastReportMs = now;
+    m_lastDone = done;
+
+    Progress progress;
+    progress.done = std::min(done, m_total);
+    progress.total = m_total;
+    progress.perSecond = m_rate;
+    if (final) {
+        progress.remainingSeconds = 0.0;
+    } else if (m_rate > 0.0) {
+        progress.remainingSeconds = double(m_total - progress.done) / m_rate;
+    }
+    m_callback(progress);
+}
+
+QString ProgressMeter::describe(const Progress& progress, const QString& unit) {
+    QString text = QCoreApplication::translate("ProgressMeter", "%1%").arg(progress.percent());
+    if (progress.perSecond > 0.0) {
+        text += QCoreApplication::translate("ProgressMeter", ", %1 %2/s")
+            .arg(formatCount(progress.perSecond), unit);
+    }
+    if (progress.remainingSeconds >= 0.0 && progress.done < progress.total) {
+        text += QCoreApplication::translate("ProgressMeter", ", about %1 left")
+            .arg(formatDuration(progress.remainingSeconds));
+    }
+    return text;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,101 @@
+/**
+ * @file progress.h
+ * @brief Progress reporting with throughput and time estimates
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+namespace LithoMaker {
+
+/**
+ * @brief State of a long-running job
+ */
+struct Progress {
+    qint64 done{0};
+    qint64 total{0};
+    double perSecond{0.0};         ///< Recent throughput in units per second
+    double remainingSeconds{-1.0}; ///< Estimated time left, negative while unknown
+
+    double fraction() const {
+        return total > 0 ? std::clamp(double(done) / double(total), 0.0, 1.0) : 0.0;
+    }
+    int percent() const { return int(fraction() * 100.0); }
+};
+
+/**
+ * @brief Progress callback type
+ */
+using ProgressCallback = std::function<void(const Progress& progress)>;
+
+/**
+ * @brief Iterations between ProgressMeter::add() calls in tight loops
+ */
+constexpr qint64 kProgressBatch = 4096;
+
+/**
+ * @brief Counts finished work and reports it at a limited rate
+ *
+ * add() may be called from any thread, such as OpenMP workers, and
+ * costs one relaxed atomic add there. The callback only runs on the
+ * thread that created the meter, when that thread adds work, and at
+ * most every 100 ms, so it may update the UI.
+ */
+class ProgressMeter {
+public:
+    /**
+     * @param total Work units of the whole job
+     * @param callback Receiver of the updates, may be empty
+     */
+    ProgressMeter(qint64 total, ProgressCallback callback);
+
+    /**
+     * @brief Count finished units, from any thread
+     */
+    void add(qint64 units) {
+        const qint64 done = m_done.fetch_add(units, std::memory_order_relaxed) + units;
+        if (m_callback && std::this_thread::get_id() == m_owner && done >= m_nextCheck) {
+            report(done, false);
+        }
+    }
+
+    /**
+     * @brief Report the job as complete
+     */
+    void finish();
+
+    /**
+     * @brief Human-readable state: percentage, throughput and time left
+     * @param progress State to describe
+     * @param unit Plural name of a work unit, for the throughput
+     */
+    static QString describe(const Progress& progress, const QString& unit);
+
+private:
+    void report(qint64 done, bool final);
+
+    std::atomic<qint64> m_done{0};
+    const qint64 m_total;
+    const ProgressCallback m_callback;
+    const std::thread::id m_owner;
+
+    // Used by the creating thread only
+    QElapsedTimer m_clock;
+    qint64 m_checkStep{1};   // Units between clock reads
+    qint64 m_nextCheck{0};
+    qint64 m_lastReportMs{0};
+    qint64 m_lastDone{0};
+    double m_rate{0.0};
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,748 @@
+/**
+ * @file asyncfilewriter.cpp
+ * @brief Double-buffered output file device implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "asyncfilewriter.h"
+
+#include <QFile>
+#include <QThread>
+#include <QDebug>
+
+#include <algorithm>
+
+#ifndef BUILD_WASM
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+#ifdef BUILD_WASM
+#include <QFileInfo>
+#include <emscripten.h>
+#endif
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#endif
+
+namespace LithoMaker {
+
+/**
+ * @brief Destination of filled buffers
+ *
+ * submit() queues a filled buffer, waiting only if the backend has no
+ * room for it, and hands back an empty buffer (recycled when possible,
+ * so capacity is kept) for the caller to fill next.
+ */
+class WriteBackend {
+public:
+    virtual ~WriteBackend() = default;
+    virtual bool open(const QString& filePath) = 0;
+    virtual bool submit(QByteArray& buffer) = 0;
+    virtual bool finish() = 0;
+
+    QString errorString() const { return m_error; }
+
+protected:
+    bool fail(const QString& message) {
+        if (m_error.isEmpty()) {
+            m_error = message;
+        }
+        return false;
+    }
+
+    QString m_error;
+};
+
+namespace {
+
+/**
+ * @brief Writes each buffer on the calling thread
+ */
+class DirectBackend : public WriteBackend {
+public:
+    bool open(const QString& filePath) override {
+        m_file.setFileName(filePath);
+        if (!m_file.open(QIODevice::WriteOnly)) {
+            return fail(QObject::tr("Cannot open file for writing: ") + m_file.errorString());
+        }
+        return true;
+    }
+
+    bool submit(QByteArray& buffer) override {
+        if (m_file.write(buffer) != buffer.size()) {
+            return fail(QObject::tr("Write error: ") + m_file.errorString());
+        }
+        buffer.resize(0);
+        return true;
+    }
+
+    bool finish() override {
+        m_file.close();
+        return m_error.isEmpty();
+    }
+
+private:
+    QFile m_file;
+};
+
+#ifdef BUILD_WASM
+
+// Browser-side sink for DownloadBackend. Chunks are copied out of the
+// WASM heap into a file in the Origin Private File System, or into Blob
+// parts where OPFS is unavailable; the browser keeps both outside the
+// heap (Blobs are paged to disk when large). Closing the sink offers the
+// result as a download. The calls suspend through ASYNCIFY while the
+// browser writes.
+EM_ASYNC_JS(int, lithoSinkOpen, (const char* name), {
+    const sink = { name: UTF8ToString(name), parts: [], handle: null, writable: null };
+    try {
+        if (navigator.storage && navigator.storage.getDirectory) {
+            // A fixed name, so each export replaces the previous one
+            const root = await navigator.storage.getDirectory();
+            const handle = await root.getFileHandle('lithomaker-export', { create: true });
+            if (handle.createWritable) {
+                sink.writable = await handle.createWritable({ keepExistingData: false });
+                sink.handle = handle;
+            }
+        }
+    } catch (e) {
+        console.warn('Origin private file system not available, collecting the export in Blobs:', e);
+        sink.writable = null;
+    }
+    Module.lithoSink = sink;
+    return 1;
+});
+
+EM_ASYNC_JS(int, lithoSinkWrite, (const char* data, int size), {
+    const sink = Module.lithoSink;
+    // Copy, the buffer is refilled as soon as this returns
+    const chunk = HEAPU8.slice(data, data + size);
+    try {
+        if (sink.writable) {
+            await sink.writable.write(chunk);
+        } else {
+            sink.parts.push(new Blob([chunk]));
+        }
+        return 1;
+    } catch (e) {
+        console.error('Export write failed:', e);
+        return 0;
+    }
+});
+
+EM_ASYNC_JS(int, lithoSinkClose, (int save), {
+    const sink = Module.lithoSink;
+    Module.lithoSink = null;
+    if (!sink) {
+        return 0;
+    }
+    try {
+        let blob;
+        if (sink.writable) {
+            await sink.writable.close();
+            blob = await sink.handle.getFile();
+        } else {
+            blob = new Blob(sink.parts, { type: 'application/octet-stream' });
+        }
+        if (save) {
+            const url = URL.createObjectURL(blob);
+            const link = document.createElement('a');
+            link.href = url;
+            link.download = sink.name;
+            document.body.appendChild(link);
+            link.click();
+            link.remove();
+            setTimeout(() => URL.revokeObjectURL(url), 60000);
+        }
+        return 1;
+    } catch (e) {
+        console.error('Export download failed:', e);
+        return 0;
+    }
+});
+
+/**
+ * @brief Streams each buffer to a browser download
+ *
+ * Only the buffer being filled lives in the WASM heap, so exports are
+ * not limited by its size. The file is named after the output path.
+ */
+class DownloadBackend : public WriteBackend {
+public:
+    ~DownloadBackend() override {
+        if (m_open) {
+            lithoSinkClose(0);
+        }
+    }
+
+    bool open(const QString& filePath) override {
+        const QByteArray name = QFileInfo(filePath).fileName().toUtf8();
+        if (!lithoSinkOpen(name.constData())) {
+            return fail(QObject::tr("Cannot start the download"));
+        }
+        m_open = true;
+        return true;
+    }
+
+    bool submit(QByteArray& buffer) override {
+        if (!lithoSinkWrite(buffer.constData(), static_cast<int>(buffer.size()))) {
+            return fail(QObject::tr("Write error: the browser rejected the data"));
+        }
+        buffer.resize(0);
+        return true;
+    }
+
+    bool finish() override {
+        if (!m_open) {
+            return m_error.isEmpty();
+        }
+        m_open = false;
+        // A failed export is discarded rather than offered for download
+        if (!lithoSinkClose(m_error.isEmpty() ? 1 : 0)) {
+            return fail(QObject::tr("Cannot save the download"));
+        }
+        return m_error.isEmpty();
+    }
+
+private:
+    bool m_open{false};
+};
+
+#else
+
+/**
+ * @brief Bounded ring of buffers drained by a dedicated writer thread
+ *
+ * submit() only blocks when all ring slots hold unwritten data, i.e.
+ * when serialization outruns the disk. Written buffers are recycled so
+ * their capacity is allocated once.
+ */
+class ThreadedBackend : public WriteBackend {
+public:
+    explicit ThreadedBackend(int depth)
+        : m_depth(std::max<size_t>(1, static_cast<size_t>(depth)))
+    {
+    }
+
+    ~ThreadedBackend() override {
+        finish();
+    }
+
+    bool open(const QString& filePath) override {
+        m_file.setFileName(filePath);
+        if (!m_file.open(QIODevice::WriteOnly)) {
+            return fail(QObject::tr("Cannot open file for writing: ") + m_file.errorString());
+        }
+        m_thread = std::thread(&ThreadedBackend::run, this);
+        return true;
+    }
+
+    bool submit(QByteArray& buffer) override {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_space.wait(lock, [this] { return m_queue.size() < m_depth || !m_error.isEmpty(); });
+        if (!m_error.isEmpty()) {
+            return false;
+        }
+        m_queue.push_back(std::move(buffer));
+        if (!m_free.empty()) {
+            buffer = std::move(m_free.back());
+            m_free.pop_back();
+        } else {
+            buffer = QByteArray();
+        }
+        m_data.notify_one();
+        return true;
+    }
+
+    bool finish() override {
+        if (m_thread.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_data.notify_one();
+            m_thread.join();
+            m_file.close();
+        }
+        return m_error.isEmpty();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_data.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+            if (m_queue.empty()) {
+                return;
+            }
+            // The front buffer stays queued while it is written so the
+            // producer cannot exceed the ring depth
+            QByteArray& front = m_queue.front();
+            const bool failed = !m_error.isEmpty();
+            lock.unlock();
+            const bool ok = failed || m_file.write(front) == front.size();
+            lock.lock();
+            if (!ok) {
+                fail(QObject::tr("Write error: ") + m_file.errorString());
+            }
+            QByteArray done = std::move(m_queue.front());
+            m_queue.pop_front();
+            done.resize(0);
+            m_free.push_back(std::move(done));
+            m_space.notify_one();
+        }
+    }
+
+    const size_t m_depth;
+    QFile m_file;
+    std::deque<QByteArray> m_queue;
+    std::vector<QByteArray> m_free;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_data;
+    std::condition_variable m_space;
+    bool m_stop{false};
+};
+
+#endif // BUILD_WASM
+
+#ifdef HAVE_IO_URING
+
+constexpr unsigned kRingEntries = 32;
+constexpr qint64 kSegmentSize = 256 * 1024;
+
+int ioUringSetup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int ioUringEnter(int ring, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, ring, toSubmit, minComplete,
+                                    flags, nullptr, 0));
+}
+
+/**
+ * @brief Submits buffer writes through a small io_uring instance
+ *
+ * Uses the raw system calls so no liburing dependency is needed. Each
+ * buffer is written as several segments in flight at once; short
+ * writes are resubmitted for the remainder.
+ */
+class IoUringBackend : public WriteBackend {
+public:
+    ~IoUringBackend() override {
+        finish();
+        release();
+    }
+
+    /**
+     * @brief Create the ring; false if the kernel lacks io_uring or IORING_OP_WRITE
+     */
+    bool setup() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        m_ring = ioUringSetup(kRingEntries, &params);
+        if (m_ring < 0) {
+            return false;
+        }
+        m_entries = std::min(params.sq_entries, params.cq_entries);
+
+        // IORING_REGISTER_PROBE arrived together with IORING_OP_WRITE (5.6)
+        std::vector<char> probeData(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto* probe = reinterpret_cast<io_uring_probe*>(probeData.data());
+        if (syscall(__NR_io_uring_register, m_ring, IORING_REGISTER_PROBE, probe, 256) < 0 ||
+            probe->last_op < IORING_OP_WRITE ||
+            !(probe->ops[IORING_OP_WRITE].flags & IO_URING_OP_SUPPORTED)) {
+            release();
+            return false;
+        }
+
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) {
+            m_sqRing = nullptr;
+            release();
+            return false;
+        }
+        if (singleMap) {
+            m_cqRing = m_sqRing;
+        } else {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED) {
+                m_cqRing = nullptr;
+                release();
+                return false;
+            }
+        }
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            release();
+            return false;
+        }
+        m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(m_sqRing);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        char* cq = static_cast<char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    bool open(const QString& filePath) override {
+        m_fd = ::open(QFile::encodeName(filePath).constData(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_fd < 0) {
+            return fail(QObject::tr("Cannot open file for writing: ") +
+                        QString::fromLocal8Bit(std::strerror(errno)));
+        }
+        return true;
+    }
+
+    bool submit(QByteArray& buffer) override {
+        if (!waitInFlight()) {
+            return false;
+        }
+        m_inFlight.swap(buffer);
+        buffer.resize(0);
+
+        // Split into segments so the kernel can complete them inline
+        // instead of punting one huge write to its worker threads
+        m_segments.clear();
+        for (qint64 start = 0; start < m_inFlight.size(); start += kSegmentSize) {
+            m_segments.push_back({start, std::min<qint64>(start + kSegmentSize, m_inFlight.size())});
+        }
+        m_nextSegment = 0;
+        return queueSegments();
+    }
+
+    bool finish() override {
+        waitInFlight();
+        if (m_fd >= 0) {
+            if (::close(m_fd) != 0) {
+                fail(QObject::tr("Write error: ") + QString::fromLocal8Bit(std::strerror(errno)));
+            }
+            m_fd = -1;
+        }
+        return m_error.isEmpty();
+    }
+
+private:
+    struct Segment {
+        qint64 start; ///< Next byte to write (advances on short writes)
+        qint64 end;
+    };
+
+    // Submit queued segments while there is room in the ring
+    bool queueSegments() {
+        unsigned queued = 0;
+        unsigned tail = *m_sqTail; // Only this thread produces
+        while (m_nextSegment < m_segments.size() && m_pending < m_entries) {
+            const Segment& segment = m_segments[m_nextSegment];
+            const unsigned index = tail & *m_sqMask;
+            io_uring_sqe* sqe = &m_sqes[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = m_fd;
+            sqe->addr = reinterpret_cast<quint64>(m_inFlight.constData() + segment.start);
+            sqe->len = static_cast<quint32>(segment.end - segment.start);
+            sqe->off = static_cast<quint64>(m_offset + segment.start);
+            sqe->user_data = m_nextSegment;
+            m_sqArray[index] = index;
+            ++tail;
+            ++queued;
+            ++m_pending;
+            ++m_nextSegment;
+        }
+        if (queued == 0) {
+            return true;
+        }
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+        int submitted;
+        do {
+            submitted = ioUringEnter(m_ring, queued, 0, 0);
+        } while (submitted < 0 && errno == EINTR);
+        if (submitted != static_cast<int>(queued)) {
+            m_pending -= queued - std::max(submitted, 0);
+            return fail(QObject::tr("io_uring submission failed: ") +
+                        QString::fromLocal8Bit(std::strerror(errno)));
+        }
+        return true;
+    }
+
+    bool waitInFlight() {
+        while (m_pending > 0) {
+            const unsigned head = *m_cqHead;
+            if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+                if (ioUringEnter(m_ring, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                    m_pending = 0;
+                    return fail(QObject::tr("io_uring wait failed: ") +
+                                QString::fromLocal8Bit(std::strerror(errno)));
+                }
+                continue;
+            }
+            const io_uring_cqe& cqe = m_cqes[head & *m_cqMask];
+            const int result = cqe.res;
+            const size_t segmentIndex = static_cast<size_t>(cqe.user_data);
+            __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+            --m_pending;
+
+            if (result < 0) {
+                fail(QObject::tr("Write error: ") + QString::fromLocal8Bit(std::strerror(-result)));
+            } else if (result == 0) {
+                fail(QObject::tr("Write error: no data written"));
+            } else if (m_error.isEmpty()) {
+                Segment& segment = m_segments[segmentIndex];
+                segment.start += result;
+                if (segment.start < segment.end) {
+                    // Short write: requeue the remainder
+                    m_segments.push_back(segment);
+                }
+            }
+            if (m_error.isEmpty() && !queueSegments()) {
+                continue; // Drain what is still in flight
+            }
+        }
+        if (m_error.isEmpty()) {
+            m_offset += m_inFlight.size();
+        }
+        m_segments.clear();
+        m_nextSegment = 0;
+        return m_error.isEmpty();
+    }
+
+    void release() {
+        if (m_sqes) munmap(m_sqes, m_sqesSize);
+        if (m_cqRing && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing) munmap(m_sqRing, m_sqRingSize);
+        m_sqes = nullptr;
+        m_sqRing = m_cqRing = nullptr;
+        if (m_ring >= 0) {
+            ::close(m_ring);
+            m_ring = -1;
+        }
+    }
+
+    int m_ring{-1};
+    int m_fd{-1};
+    void* m_sqRing{nullptr};
+    void* m_cqRing{nullptr};
+    size_t m_sqRingSize{0};
+    size_t m_cqRingSize{0};
+    size_t m_sqesSize{0};
+    io_uring_sqe* m_sqes{nullptr};
+    unsigned* m_sqTail{nullptr};
+    unsigned* m_sqMask{nullptr};
+    unsigned* m_sqArray{nullptr};
+    unsigned* m_cqHead{nullptr};
+    unsigned* m_cqTail{nullptr};
+    unsigned* m_cqMask{nullptr};
+    io_uring_cqe* m_cqes{nullptr};
+
+    unsigned m_entries{0};
+
+    QByteArray m_inFlight;
+    std::vector<Segment> m_segments;
+    size_t m_nextSegment{0};
+    unsigned m_pending{0};
+    qint64 m_offset{0};
+};
+
+#endif // HAVE_IO_URING
+
+} // namespace
+
+AsyncFileWriter::AsyncFileWriter(const QString& filePath, WriterBackend backend, QObject* parent)
+    : QIODevice(parent)
+    , m_filePath(filePath)
+    , m_backend(backend)
+{
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+    if (isOpen()) {
+        finish();
+    }
+}
+
+bool AsyncFileWriter::open(OpenMode mode) {
+    if ((mode & ReadOnly) || !(mode & WriteOnly) || isOpen()) {
+        setErrorString(tr("Unsupported open mode"));
+        return false;
+    }
+
+    m_writer.reset();
+    WriterBackend backend = m_backend;
+#ifdef BUILD_WASM
+    // The browser build has no threads, and files written to its
+    // in-memory file system would stay in the heap: always download
+    backend = WriterBackend::Download;
+    m_writer = std::make_unique<DownloadBackend>();
+#else
+    if (backend == WriterBackend::Auto) {
+        // With a single CPU the io_uring kernel workers only add latency
+        backend = isIoUringAvailable() && QThread::idealThreadCount() > 1
+            ? WriterBackend::IoUring : WriterBackend::Threaded;
+    }
+#endif
+
+#ifdef HAVE_IO_URING
+    if (backend == WriterBackend::IoUring) {
+        auto uring = std::make_unique<IoUringBackend>();
+        if (uring->setup()) {
+            m_writer = std::move(uring);
+        }
+    }
+#endif
+#ifndef BUILD_WASM
+    if (!m_writer && backend != WriterBackend::Direct) {
+        if (backend == WriterBackend::IoUring) {
+            qWarning() << "io_uring is not available, using a writer thread";
+        }
+        backend = WriterBackend::Threaded;
+        m_writer = std::make_unique<ThreadedBackend>(m_bufferCount - 1);
+    }
+#endif
+    if (!m_writer) {
+        backend = WriterBackend::Direct;
+        m_writer = std::make_unique<DirectBackend>();
+    }
+    m_backend = backend;
+
+    if (!m_writer->open(m_filePath)) {
+        setErrorString(m_writer->errorString());
+        m_writer.reset();
+        return false;
+    }
+
+    m_buffer.clear();
+    m_buffer.reserve(m_chunkSize);
+    m_totalBytes = 0;
+    m_stallNs = 0;
+    m_failed = false;
+    m_timer.start();
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool AsyncFileWriter::finish() {
+    if (!isOpen()) {
+        return !m_failed;
+    }
+
+    if (!m_failed && !m_buffer.isEmpty()) {
+        submitBuffer();
+    }
+    QElapsedTimer drain;
+    drain.start();
+    if (!m_writer->finish() && !m_failed) {
+        m_failed = true;
+        setErrorString(m_writer->errorString());
+    }
+    m_stallNs += drain.nsecsElapsed();
+    m_writer.reset();
+    m_buffer = QByteArray();
+    QIODevice::close();
+
+    if (!m_failed) {
+        const qint64 elapsed = std::max<qint64>(m_timer.elapsed(), 1);
+        qInfo() << "Wrote" << m_totalBytes << "bytes via" << backendName(m_backend)
+                << "in" << elapsed << "ms (" << (m_totalBytes / 1000.0 / elapsed) << "MB/s,"
+                << stallMs() << "ms stalled)";
+    }
+    return !m_failed;
+}
+
+void AsyncFileWriter::close() {
+    finish();
+}
+
+bool AsyncFileWriter::isIoUringAvailable() {
+#ifdef HAVE_IO_URING
+    static const bool available = [] {
+        IoUringBackend probe;
+        return probe.setup();
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+QString AsyncFileWriter::backendName(WriterBackend backend) {
+    switch (backend) {
+        case WriterBackend::Direct: return QStringLiteral("direct");
+        case WriterBackend::Threaded: return QStringLiteral("threaded");
+        case WriterBackend::IoUring: return QStringLiteral("io_uring");
+        case WriterBackend::Download: return QStringLiteral("download");
+        case WriterBackend::Auto: break;
+    }
+    return QStringLiteral("auto");
+}
+
+WriterBackend AsyncFileWriter::backendFromName(const QString& name) {
+    if (name == QLatin1String("direct")) return WriterBackend::Direct;
+    if (name == QLatin1String("threaded")) return WriterBackend::Threaded;
+    if (name == QLatin1String("io_uring")) return WriterBackend::IoUring;
+    return WriterBackend::Auto;
+}
+
+qint64 AsyncFileWriter::readData(char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 AsyncFileWriter::writeData(const char* data, qint64 size) {
+    if (m_failed) {
+        return -1;
+    }
+    m_buffer.append(data, static_cast<qsizetype>(size));
+    m_totalBytes += size;
+    if (m_buffer.size() >= m_chunkSize && !submitBuffer()) {
+        return -1;
+    }
+    return size;
+}
+
+bool AsyncFileWriter::submitBuffer() {
+    QElapsedTimer stall;
+    stall.start();
+    const bool ok = m_writer->submit(m_buffer);
+    m_stallNs += stall.nsecsElapsed();
+    if (!ok) {
+        m_failed = true;
+        setErrorString(m_writer->errorString());
+        return false;
+    }
+    return true;
+}
+
+} // namespace LithoMaker
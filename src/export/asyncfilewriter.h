@@ -0,0 +1,122 @@
+/**
+ * @file asyncfilewriter.h
+ * @brief Output file device that overlaps serialization with disk I/O
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QString>
+#include <algorithm>
+#include <memory>
+
+namespace LithoMaker {
+
+/**
+ * @brief How exported data reaches the disk
+ */
+enum class WriterBackend {
+    Auto,     ///< io_uring on multi-core Linux, else Threaded (Download in the browser)
+    Direct,   ///< Synchronous writes on the calling thread
+    Threaded, ///< A writer thread drains filled buffers
+    IoUring,  ///< Linux io_uring submissions (falls back to Threaded)
+    Download  ///< Browser build only: buffers are streamed into a file download
+};
+
+class WriteBackend;
+
+/**
+ * @brief Write-only file device with buffered background writes
+ *
+ * Data is collected into a large buffer. When the buffer is full it is
+ * handed to the backend and the caller continues filling another one
+ * while it is written, so serialization only waits for the disk when it
+ * outruns it (back-pressure). The time spent waiting is reported by
+ * stallMs(). The device is sequential; size() is the number of bytes
+ * accepted so far.
+ */
+class AsyncFileWriter : public QIODevice {
+    Q_OBJECT
+
+public:
+    /**
+     * @param filePath Output file path
+     * @param backend Requested backend, resolved when the file is opened
+     * @param parent Parent object
+     */
+    explicit AsyncFileWriter(const QString& filePath,
+                             WriterBackend backend = WriterBackend::Auto,
+                             QObject* parent = nullptr);
+    ~AsyncFileWriter() override;
+
+    /**
+     * @brief Open the file; only WriteOnly (optionally with Text) is supported
+     */
+    bool open(OpenMode mode) override;
+
+    /**
+     * @brief Flush remaining data, wait for all writes and close
+     * @return false if any write failed (see errorString())
+     */
+    bool finish();
+
+    void close() override;
+    bool isSequential() const override { return true; }
+    qint64 size() const override { return m_totalBytes; }
+
+    QString fileName() const { return m_filePath; }
+
+    /**
+     * @brief Backend in use after resolving Auto and fallbacks
+     */
+    WriterBackend backend() const { return m_backend; }
+
+    /**
+     * @brief Size of each buffer (default 4 MB)
+     */
+    void setChunkSize(qsizetype size) { m_chunkSize = size; }
+
+    /**
+     * @brief Number of buffers in the ring, including the one being
+     *        filled (default 4, minimum 2; io_uring always uses 2)
+     */
+    void setBufferCount(int count) { m_bufferCount = std::max(count, 2); }
+
+    /**
+     * @brief Time the caller spent blocked on the disk so far
+     */
+    qint64 stallMs() const { return m_stallNs / 1000000; }
+
+    /**
+     * @brief Whether io_uring can be used on this system
+     */
+    static bool isIoUringAvailable();
+
+    static QString backendName(WriterBackend backend);
+    static WriterBackend backendFromName(const QString& name);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    bool submitBuffer();
+
+    QString m_filePath;
+    WriterBackend m_backend;
+    std::unique_ptr<WriteBackend> m_writer;
+    QByteArray m_buffer;
+    qsizetype m_chunkSize{4 << 20};
+    int m_bufferCount{4};
+    qint64 m_totalBytes{0};
+    qint64 m_stallNs{0};
+    bool m_failed{false};
+    QElapsedTimer m_timer;
+};
+
+} // namespace LithoMaker
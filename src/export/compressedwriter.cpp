@@ -0,0 +1,416 @@
+/**
+ * @file compressedwriter.cpp
+ * @brief Parallel block compression device implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "compressedwriter.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+
+#include <algorithm>
+#include <deque>
+
+#ifndef BUILD_WASM
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr int kGzipLevel = 6;
+constexpr int kZstdLevel = 3;
+constexpr qsizetype kDictionarySize = 32 * 1024; // Deflate window
+
+/**
+ * @brief One block of input and its compressed form
+ */
+struct Block {
+    QByteArray input;
+    QByteArray dictionary; ///< Gzip: tail of the previous block
+    QByteArray output;
+    qint64 inputSize{0};
+    quint32 crc{0};
+    bool last{false};
+    bool done{false};
+    bool failed{false};
+};
+
+#ifdef HAVE_ZLIB
+void compressGzip(Block& block) {
+    z_stream stream{};
+    if (deflateInit2(&stream, kGzipLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        block.failed = true;
+        return;
+    }
+    if (!block.dictionary.isEmpty()) {
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(block.dictionary.constData()),
+                             static_cast<uInt>(block.dictionary.size()));
+    }
+
+    // Room for the sync flush marker on top of the deflate bound
+    block.output.resize(static_cast<qsizetype>(deflateBound(&stream, static_cast<uLong>(block.input.size()))) + 16);
+    stream.next_in = reinterpret_cast<Bytef*>(block.input.data());
+    stream.avail_in = static_cast<uInt>(block.input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(block.output.data());
+    stream.avail_out = static_cast<uInt>(block.output.size());
+
+    // Non-final blocks end byte-aligned (sync flush) so they can be joined
+    const int result = deflate(&stream, block.last ? Z_FINISH : Z_SYNC_FLUSH);
+    block.failed = block.last ? result != Z_STREAM_END
+                              : (result != Z_OK || stream.avail_in != 0 || stream.avail_out == 0);
+    block.output.resize(static_cast<qsizetype>(stream.total_out));
+    deflateEnd(&stream);
+
+    block.crc = static_cast<quint32>(crc32(0L, reinterpret_cast<const Bytef*>(block.input.constData()),
+                                           static_cast<uInt>(block.input.size())));
+}
+#endif
+
+#ifdef HAVE_ZSTD
+void compressZstd(Block& block) {
+    block.output.resize(static_cast<qsizetype>(ZSTD_compressBound(static_cast<size_t>(block.input.size()))));
+    const size_t result = ZSTD_compress(block.output.data(), static_cast<size_t>(block.output.size()),
+                                        block.input.constData(), static_cast<size_t>(block.input.size()),
+                                        kZstdLevel);
+    if (ZSTD_isError(result)) {
+        block.failed = true;
+        return;
+    }
+    block.output.resize(static_cast<qsizetype>(result));
+}
+#endif
+
+void compressBlock(Compression compression, Block& block) {
+    switch (compression) {
+#ifdef HAVE_ZLIB
+        case Compression::Gzip: compressGzip(block); break;
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::Zstd: compressZstd(block); break;
+#endif
+        default:
+            block.output = block.input;
+            break;
+    }
+    block.input = QByteArray(); // Release the input early
+}
+
+} // namespace
+
+/**
+ * @brief Worker threads plus the in-order queue of blocks
+ *
+ * The caller thread queues blocks and writes finished ones from the
+ * front of the queue; it only waits when the queue is full.
+ */
+class CompressedFileWriter::Pipeline {
+public:
+    Pipeline(Compression compression, AsyncFileWriter* file, int threadCount)
+        : m_compression(compression)
+        , m_file(file)
+    {
+#ifndef BUILD_WASM
+        const int threads = std::max(1, threadCount > 0 ? threadCount : QThread::idealThreadCount());
+        m_maxQueued = static_cast<size_t>(threads) * 2;
+        for (int i = 0; i < threads; ++i) {
+            m_workers.emplace_back(&Pipeline::run, this);
+        }
+#else
+        Q_UNUSED(threadCount);
+#endif
+    }
+
+    ~Pipeline() {
+#ifndef BUILD_WASM
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_all();
+        for (std::thread& worker : m_workers) {
+            worker.join();
+        }
+#endif
+    }
+
+    /**
+     * @brief Queue a block, writing finished blocks while the queue is full
+     */
+    bool push(std::unique_ptr<Block> block) {
+#ifdef BUILD_WASM
+        // No threads in the browser build: compress in place
+        compressBlock(m_compression, *block);
+        block->done = true;
+        m_blocks.push_back(std::move(block));
+        return writeFinished(0);
+#else
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_todo.push_back(block.get());
+            m_blocks.push_back(std::move(block));
+        }
+        m_wake.notify_one();
+        return writeFinished(m_maxQueued);
+#endif
+    }
+
+    /**
+     * @brief Write finished blocks in order until at most @p keep remain
+     */
+    bool writeFinished(size_t keep) {
+        while (!m_blocks.empty()) {
+            Block* front = m_blocks.front().get();
+#ifndef BUILD_WASM
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (!front->done) {
+                    if (m_blocks.size() <= keep) {
+                        return true;
+                    }
+                    QElapsedTimer wait;
+                    wait.start();
+                    m_finished.wait(lock, [front] { return front->done; });
+                    m_stallNs += wait.nsecsElapsed();
+                }
+            }
+#endif
+            if (front->failed) {
+                return false;
+            }
+            if (m_file->write(front->output) != front->output.size()) {
+                return false;
+            }
+            m_written += front->output.size();
+            m_crc = combineCrc(m_crc, front->crc, front->inputSize);
+            m_blocks.pop_front();
+        }
+        return true;
+    }
+
+    quint32 crc() const { return m_crc; }
+    qint64 written() const { return m_written; }
+    qint64 stallNs() const { return m_stallNs; }
+
+private:
+    static quint32 combineCrc(quint32 crc, quint32 blockCrc, qint64 blockSize) {
+#ifdef HAVE_ZLIB
+        return static_cast<quint32>(crc32_combine(crc, blockCrc, static_cast<z_off_t>(blockSize)));
+#else
+        Q_UNUSED(blockCrc);
+        Q_UNUSED(blockSize);
+        return crc;
+#endif
+    }
+
+#ifndef BUILD_WASM
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            m_wake.wait(lock, [this] { return !m_todo.empty() || m_stop; });
+            if (m_todo.empty()) {
+                return;
+            }
+            Block* block = m_todo.front();
+            m_todo.pop_front();
+            lock.unlock();
+            compressBlock(m_compression, *block);
+            lock.lock();
+            block->done = true;
+            m_finished.notify_all();
+        }
+    }
+#endif
+
+    Compression m_compression;
+    AsyncFileWriter* m_file;
+    std::deque<std::unique_ptr<Block>> m_blocks;
+    quint32 m_crc{0};
+    qint64 m_written{0};
+    qint64 m_stallNs{0};
+
+#ifndef BUILD_WASM
+    std::deque<Block*> m_todo;
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_finished;
+    size_t m_maxQueued{2};
+    bool m_stop{false};
+#endif
+};
+
+CompressedFileWriter::CompressedFileWriter(const QString& filePath, Compression compression,
+                                           WriterBackend backend, QObject* parent)
+    : QIODevice(parent)
+    , m_compression(compression)
+    , m_file(std::make_unique<AsyncFileWriter>(filePath, backend))
+{
+}
+
+CompressedFileWriter::~CompressedFileWriter() {
+    if (isOpen()) {
+        finish();
+    }
+}
+
+bool CompressedFileWriter::open(OpenMode mode) {
+    if ((mode & ReadOnly) || !(mode & WriteOnly) || isOpen()) {
+        setErrorString(tr("Unsupported open mode"));
+        return false;
+    }
+    if (!isSupported(m_compression)) {
+        setErrorString(tr("This compression method is not available in this build"));
+        return false;
+    }
+    if (!m_file->open(QIODevice::WriteOnly)) {
+        setErrorString(m_file->errorString());
+        return false;
+    }
+
+    if (m_compression == Compression::Gzip) {
+        // Member header: deflate, no flags, no mtime, unknown OS
+        static const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff'};
+        m_file->write(header, sizeof(header));
+    }
+
+    if (m_compression != Compression::None) {
+        m_pipeline = std::make_unique<Pipeline>(m_compression, m_file.get(), m_threadCount);
+    }
+    m_block.clear();
+    m_dictionary.clear();
+    if (m_pipeline) {
+        m_block.reserve(m_blockSize);
+    }
+    m_totalIn = 0;
+    m_failed = false;
+    return QIODevice::open(mode | Unbuffered);
+}
+
+bool CompressedFileWriter::finish() {
+    if (!isOpen()) {
+        return !m_failed;
+    }
+
+    if (!m_failed && m_pipeline) {
+        // The last block is always sent: gzip needs its final deflate block
+        if (!dispatchBlock(true) || !m_pipeline->writeFinished(0)) {
+            fail(tr("Compression failed: ") + m_file->errorString());
+        }
+    }
+
+    if (!m_failed && m_compression == Compression::Gzip) {
+        const quint32 trailer[2] = {m_pipeline->crc(), static_cast<quint32>(m_totalIn)};
+        m_file->write(reinterpret_cast<const char*>(trailer), sizeof(trailer));
+    }
+
+    if (m_pipeline) {
+        m_pipelineStallNs = m_pipeline->stallNs();
+        m_pipeline.reset();
+    }
+    if (!m_file->finish() && !m_failed) {
+        fail(m_file->errorString());
+    }
+    QIODevice::close();
+    return !m_failed;
+}
+
+void CompressedFileWriter::close() {
+    finish();
+}
+
+qint64 CompressedFileWriter::compressedSize() const {
+    return m_file->size();
+}
+
+qint64 CompressedFileWriter::stallMs() const {
+    const qint64 pipelineStall = m_pipeline ? m_pipeline->stallNs() : m_pipelineStallNs;
+    return pipelineStall / 1000000 + m_file->stallMs();
+}
+
+bool CompressedFileWriter::isSupported(Compression compression) {
+    switch (compression) {
+        case Compression::None: return true;
+#ifdef HAVE_ZLIB
+        case Compression::Gzip: return true;
+#endif
+#ifdef HAVE_ZSTD
+        case Compression::Zstd: return true;
+#endif
+        default: return false;
+    }
+}
+
+QString CompressedFileWriter::suffix(Compression compression) {
+    switch (compression) {
+        case Compression::Gzip: return QStringLiteral(".gz");
+        case Compression::Zstd: return QStringLiteral(".zst");
+        case Compression::None: break;
+    }
+    return QString();
+}
+
+qint64 CompressedFileWriter::readData(char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+qint64 CompressedFileWriter::writeData(const char* data, qint64 size) {
+    if (m_failed) {
+        return -1;
+    }
+    m_totalIn += size;
+    if (!m_pipeline) {
+        // Uncompressed: the file writer does its own buffering
+        if (m_file->write(data, size) != size) {
+            fail(m_file->errorString());
+            return -1;
+        }
+        return size;
+    }
+    m_block.append(data, static_cast<qsizetype>(size));
+    if (m_block.size() >= m_blockSize && !dispatchBlock(false)) {
+        fail(tr("Compression failed: ") + m_file->errorString());
+        return -1;
+    }
+    return size;
+}
+
+bool CompressedFileWriter::dispatchBlock(bool last) {
+    auto block = std::make_unique<Block>();
+    block->last = last;
+    block->inputSize = m_block.size();
+    block->dictionary = m_dictionary;
+    if (m_compression == Compression::Gzip) {
+        m_dictionary = m_block.right(kDictionarySize);
+    }
+    block->input.swap(m_block);
+    m_block.reserve(m_blockSize);
+    return m_pipeline->push(std::move(block));
+}
+
+bool CompressedFileWriter::fail(const QString& message) {
+    if (!m_failed) {
+        m_failed = true;
+        setErrorString(message);
+    }
+    return false;
+}
+
+} // namespace LithoMaker
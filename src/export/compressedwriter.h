@@ -0,0 +1,122 @@
+/**
+ * @file compressedwriter.h
+ * @brief Output file device with parallel gzip/zstd block compression
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "asyncfilewriter.h"
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <memory>
+
+namespace LithoMaker {
+
+/**
+ * @brief Output compression
+ */
+enum class Compression {
+    None,
+    Gzip, ///< .gz, a single gzip member
+    Zstd  ///< .zst, one zstd frame per block
+};
+
+/**
+ * @brief Write-only device that compresses into a file as data arrives
+ *
+ * Input is cut into blocks that worker threads compress concurrently
+ * while the caller keeps serializing; finished blocks are written in
+ * order through an AsyncFileWriter. Gzip blocks are raw deflate streams
+ * primed with the previous 32 KB (as pigz does) and joined into one
+ * member, so any gzip reader can decompress the result. Zstd blocks are
+ * independent frames, which zstd decoders concatenate. With
+ * Compression::None data goes straight to the file writer.
+ */
+class CompressedFileWriter : public QIODevice {
+    Q_OBJECT
+
+public:
+    /**
+     * @param filePath Output file path
+     * @param compression Compression method (None writes plain data)
+     * @param backend Backend of the underlying file writer
+     * @param parent Parent object
+     */
+    CompressedFileWriter(const QString& filePath, Compression compression,
+                         WriterBackend backend = WriterBackend::Auto,
+                         QObject* parent = nullptr);
+    ~CompressedFileWriter() override;
+
+    /**
+     * @brief Open the file; only WriteOnly (optionally with Text) is supported
+     */
+    bool open(OpenMode mode) override;
+
+    /**
+     * @brief Compress the remaining data, write the trailer and close
+     * @return false if compression or writing failed (see errorString())
+     */
+    bool finish();
+
+    void close() override;
+    bool isSequential() const override { return true; }
+
+    /**
+     * @brief Uncompressed bytes accepted so far
+     */
+    qint64 size() const override { return m_totalIn; }
+
+    /**
+     * @brief Number of compression threads, set before open()
+     * @param threads Thread count, or 0 for one per CPU (the default)
+     */
+    void setThreadCount(int threads) { m_threadCount = threads; }
+
+    /**
+     * @brief Compressed bytes written to the file
+     */
+    qint64 compressedSize() const;
+
+    /**
+     * @brief Time the caller waited for compression or the disk
+     */
+    qint64 stallMs() const;
+
+    /**
+     * @brief Whether this build supports a compression method
+     */
+    static bool isSupported(Compression compression);
+
+    /**
+     * @brief File name suffix including the dot (".gz", ".zst" or empty)
+     */
+    static QString suffix(Compression compression);
+
+protected:
+    qint64 readData(char* data, qint64 maxSize) override;
+    qint64 writeData(const char* data, qint64 size) override;
+
+private:
+    class Pipeline;
+
+    bool dispatchBlock(bool last);
+    bool fail(const QString& message);
+
+    Compression m_compression;
+    std::unique_ptr<AsyncFileWriter> m_file;
+    std::unique_ptr<Pipeline> m_pipeline;
+    QByteArray m_block;
+    QByteArray m_dictionary;
+    qsizetype m_blockSize{1 << 20};
+    int m_threadCount{0};
+    qint64 m_totalIn{0};
+    qint64 m_pipelineStallNs{0};
+    bool m_failed{false};
+};
+
+} // namespace LithoMaker
@@ -8,6 +8,9 @@
 
 #pragma once
 
+#include "asyncfilewriter.h"
+#include "core/progress.h"
+
 #include <QList>
 #include <QVector3D>
 #include <QString>
@@ -21,6 +24,7 @@ struct ExportResult {
     bool success{false};
     QString errorMessage;
     qint64 bytesWritten{0};
+    qint64 writeStallMs{0}; ///< Time serialization waited for the disk
 };
 
 /**
@@ -53,6 +57,23 @@ public:
      * @brief Get file filter for file dialogs
      */
     virtual QString fileFilter() const = 0;
+
+    /**
+     * @brief Select how output is written to disk
+     */
+    void setWriterBackend(WriterBackend backend) { m_writerBackend = backend; }
+    WriterBackend writerBackend() const { return m_writerBackend; }
+
+    /**
+     * @brief Receive progress during exportMesh(), counted in triangles
+     *
+     * Formats that pass over the mesh several times count each pass.
+     */
+    void setProgressCallback(ProgressCallback callback) { m_progressCallback = std::move(callback); }
+
+protected:
+    WriterBackend m_writerBackend{WriterBackend::Auto};
+    ProgressCallback m_progressCallback;
 };
 
 } // namespace LithoMaker
@@ -0,0 +1,323 @@
+/**
+ * @file gltfexporter.cpp
+ * @brief Binary glTF (GLB) mesh exporter implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "gltfexporter.h"
+#include "mesh/indexedmesh.h"
+#include "mesh/meshgenerator.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr quint32 kGlbMagic = 0x46546C67;     // "glTF"
+constexpr quint32 kChunkJson = 0x4E4F534A;    // "JSON"
+constexpr quint32 kChunkBin = 0x004E4942;     // "BIN\0"
+constexpr int kComponentFloat = 5126;
+constexpr int kComponentUShort = 5123;
+constexpr int kComponentUInt = 5125;
+constexpr int kTargetArrayBuffer = 34962;
+constexpr int kTargetElementArrayBuffer = 34963;
+constexpr int kMaxPrimitiveVertices = 65535;  // 0xFFFF is reserved for restart
+constexpr float kMillimetersToMeters = 0.001f;
+
+template <typename T>
+void appendValue(QByteArray& buffer, T value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void padTo4(QByteArray& buffer, char fill) {
+    while (buffer.size() % 4 != 0) {
+        buffer.append(fill);
+    }
+}
+
+/**
+ * @brief A run of consecutive triangles addressable with 16-bit indices
+ */
+struct Primitive {
+    qsizetype positionOffset{0};
+    qsizetype indexOffset{0};
+    int vertexCount{0};
+    int indexCount{0};
+    quint16 min[3]{0xFFFF, 0xFFFF, 0xFFFF};
+    quint16 max[3]{0, 0, 0};
+};
+
+} // namespace
+
+GltfExporter::GltfExporter(bool quantize)
+    : m_quantize(quantize)
+{
+}
+
+ExportResult GltfExporter::exportMesh(const QList<QVector3D>& mesh,
+                                       const QString& filePath) {
+    if (mesh.isEmpty()) {
+        return {false, QObject::tr("Empty mesh"), 0};
+    }
+
+    if (mesh.size() % 3 != 0) {
+        return {false, QObject::tr("Invalid mesh: vertex count not divisible by 3"), 0};
+    }
+
+    // Three passes over the triangles: welding, reordering and encoding
+    const qint64 triangles = mesh.size() / 3;
+    ProgressMeter progress(triangles * 3, m_progressCallback);
+    IndexedMesh indexed = IndexedMesh::fromTriangles(mesh);
+    progress.add(triangles);
+    indexed.optimizeVertexCache();
+    progress.add(triangles);
+
+    const MeshBounds bounds = computeBounds(indexed.vertices);
+    const QVector3D minCorner = bounds.min;
+    const QVector3D maxCorner = bounds.max;
+
+    QByteArray positions;
+    QByteArray indices;
+    QJsonArray accessors;
+    QJsonArray primitives;
+    QJsonObject node;
+
+    if (m_quantize) {
+        // Quantize to the full 16-bit range of the bounding box
+        float step[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            const float extent = maxCorner[axis] - minCorner[axis];
+            step[axis] = extent > 0.0f ? extent / 65535.0f : 1.0f;
+        }
+        auto quantizeVertex = [&](const QVector3D& v, quint16 out[3]) {
+            for (int axis = 0; axis < 3; ++axis) {
+                const float q = std::round((v[axis] - minCorner[axis]) / step[axis]);
+                out[axis] = static_cast<quint16>(std::clamp(q, 0.0f, 65535.0f));
+            }
+        };
+
+        // Split into primitives of at most 64K vertices. Vertices are
+        // numbered by first use, so each run stays mostly sequential.
+        std::vector<int> localIndex(indexed.vertices.size(), -1);
+        std::vector<int> owner(indexed.vertices.size(), -1);
+        QList<Primitive> runs;
+        Primitive current;
+
+        positions.reserve(indexed.vertices.size() * 8);
+        indices.reserve(indexed.indices.size() * 2);
+
+        auto flush = [&]() {
+            padTo4(indices, '\0');
+            runs.append(current);
+            current = Primitive();
+            current.positionOffset = positions.size();
+            current.indexOffset = indices.size();
+        };
+
+        for (int t = 0; t < indexed.triangleCount(); ++t) {
+            int fresh = 0;
+            for (int k = 0; k < 3; ++k) {
+                if (owner[indexed.indices[t * 3 + k]] != runs.size()) ++fresh;
+            }
+            if (current.vertexCount + fresh > kMaxPrimitiveVertices) {
+                flush();
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                const quint32 v = indexed.indices[t * 3 + k];
+                if (owner[v] != runs.size()) {
+                    owner[v] = static_cast<int>(runs.size());
+                    localIndex[v] = current.vertexCount++;
+
+                    quint16 q[3];
+                    quantizeVertex(indexed.vertices[v], q);
+                    for (int axis = 0; axis < 3; ++axis) {
+                        appendValue<quint16>(positions, q[axis]);
+                        current.min[axis] = std::min(current.min[axis], q[axis]);
+                        current.max[axis] = std::max(current.max[axis], q[axis]);
+                    }
+                    appendValue<quint16>(positions, 0); // Pad to 4-byte stride
+                }
+                appendValue<quint16>(indices, static_cast<quint16>(localIndex[v]));
+                ++current.indexCount;
+            }
+            if ((t + 1) % kProgressBatch == 0) {
+                progress.add(kProgressBatch);
+            }
+        }
+        if (current.indexCount > 0) {
+            flush();
+        }
+
+        for (const Primitive& run : runs) {
+            const int positionAccessor = static_cast<int>(accessors.size());
+            accessors.append(QJsonObject{
+                {"bufferView", 0},
+                {"byteOffset", static_cast<double>(run.positionOffset)},
+                {"componentType", kComponentUShort},
+                {"count", run.vertexCount},
+                {"type", "VEC3"},
+                {"min", QJsonArray{run.min[0], run.min[1], run.min[2]}},
+                {"max", QJsonArray{run.max[0], run.max[1], run.max[2]}},
+            });
+            accessors.append(QJsonObject{
+                {"bufferView", 1},
+                {"byteOffset", static_cast<double>(run.indexOffset)},
+                {"componentType", kComponentUShort},
+                {"count", run.indexCount},
+                {"type", "SCALAR"},
+            });
+            primitives.append(QJsonObject{
+                {"attributes", QJsonObject{{"POSITION", positionAccessor}}},
+                {"indices", positionAccessor + 1},
+                {"material", 0},
+            });
+        }
+
+        // Dequantization and millimeter to meter conversion in one transform
+        node["translation"] = QJsonArray{minCorner.x() * kMillimetersToMeters,
+                                         minCorner.y() * kMillimetersToMeters,
+                                         minCorner.z() * kMillimetersToMeters};
+        node["scale"] = QJsonArray{step[0] * kMillimetersToMeters,
+                                   step[1] * kMillimetersToMeters,
+                                   step[2] * kMillimetersToMeters};
+    } else {
+        positions.reserve(indexed.vertices.size() * 12);
+        for (const QVector3D& v : indexed.vertices) {
+            appendValue<float>(positions, v.x());
+            appendValue<float>(positions, v.y());
+            appendValue<float>(positions, v.z());
+        }
+        indices.reserve(indexed.indices.size() * 4);
+        for (quint32 index : indexed.indices) {
+            appendValue<quint32>(indices, index);
+        }
+
+        accessors.append(QJsonObject{
+            {"bufferView", 0},
+            {"componentType", kComponentFloat},
+            {"count", static_cast<int>(indexed.vertices.size())},
+            {"type", "VEC3"},
+            {"min", QJsonArray{minCorner.x(), minCorner.y(), minCorner.z()}},
+            {"max", QJsonArray{maxCorner.x(), maxCorner.y(), maxCorner.z()}},
+        });
+        accessors.append(QJsonObject{
+            {"bufferView", 1},
+            {"componentType", kComponentUInt},
+            {"count", static_cast<int>(indexed.indices.size())},
+            {"type", "SCALAR"},
+        });
+        primitives.append(QJsonObject{
+            {"attributes", QJsonObject{{"POSITION", 0}}},
+            {"indices", 1},
+            {"material", 0},
+        });
+
+        const float scale = kMillimetersToMeters;
+        node["scale"] = QJsonArray{scale, scale, scale};
+    }
+
+    node["mesh"] = 0;
+    node["name"] = "Lithophane";
+
+    // The binary chunk is the positions followed by the indices; they are
+    // written one after the other rather than joined into a copy
+    const qsizetype indexOffset = positions.size();
+    const qint64 binaryPadding = (4 - (positions.size() + indices.size()) % 4) % 4;
+    const qint64 binaryLength = positions.size() + indices.size() + binaryPadding;
+
+    QJsonObject root;
+    root["asset"] = QJsonObject{{"version", "2.0"}, {"generator", "LithoMaker"}};
+    if (m_quantize) {
+        root["extensionsUsed"] = QJsonArray{"KHR_mesh_quantization"};
+        root["extensionsRequired"] = QJsonArray{"KHR_mesh_quantization"};
+    }
+    root["scene"] = 0;
+    root["scenes"] = QJsonArray{QJsonObject{{"nodes", QJsonArray{0}}}};
+    root["nodes"] = QJsonArray{node};
+    root["meshes"] = QJsonArray{QJsonObject{{"primitives", primitives}}};
+    root["materials"] = QJsonArray{QJsonObject{
+        {"name", "Lithophane"},
+        {"pbrMetallicRoughness", QJsonObject{
+            {"baseColorFactor", QJsonArray{0.95, 0.93, 0.88, 1.0}},
+            {"metallicFactor", 0.0},
+            {"roughnessFactor", 0.8},
+        }},
+        {"doubleSided", true},
+    }};
+    root["accessors"] = accessors;
+    root["bufferViews"] = QJsonArray{
+        QJsonObject{
+            {"buffer", 0},
+            {"byteOffset", 0},
+            {"byteLength", static_cast<double>(positions.size())},
+            {"byteStride", m_quantize ? 8 : 12},
+            {"target", kTargetArrayBuffer},
+        },
+        QJsonObject{
+            {"buffer", 0},
+            {"byteOffset", static_cast<double>(indexOffset)},
+            {"byteLength", static_cast<double>(indices.size())},
+            {"target", kTargetElementArrayBuffer},
+        },
+    };
+    root["buffers"] = QJsonArray{QJsonObject{{"byteLength", static_cast<double>(binaryLength)}}};
+
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    padTo4(json, ' ');
+
+    // GLB lengths are 32-bit
+    const qint64 totalLength = 12 + 8 + qint64(json.size()) + 8 + binaryLength;
+    if (totalLength > qint64(std::numeric_limits<quint32>::max())) {
+        return {false, QObject::tr("Mesh too large for GLB (over 4 GB); use another format"), 0};
+    }
+
+    AsyncFileWriter file(filePath, m_writerBackend);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return {false, QObject::tr("Cannot open file for writing: ") + file.errorString(), 0};
+    }
+
+    QByteArray header;
+    appendValue<quint32>(header, kGlbMagic);
+    appendValue<quint32>(header, 2);
+    appendValue<quint32>(header, static_cast<quint32>(totalLength));
+    appendValue<quint32>(header, static_cast<quint32>(json.size()));
+    appendValue<quint32>(header, kChunkJson);
+
+    QByteArray binaryHeader;
+    appendValue<quint32>(binaryHeader, static_cast<quint32>(binaryLength));
+    appendValue<quint32>(binaryHeader, kChunkBin);
+    const QByteArray padding(binaryPadding, '\0');
+
+    if (file.write(header) != header.size() || file.write(json) != json.size() ||
+        file.write(binaryHeader) != binaryHeader.size() ||
+        file.write(positions) != positions.size() ||
+        file.write(indices) != indices.size() ||
+        file.write(padding) != padding.size()) {
+        return {false, QObject::tr("Write error: ") + file.errorString(), 0};
+    }
+
+    const qint64 written = file.size();
+    if (!file.finish()) {
+        return {false, QObject::tr("Write error: ") + file.errorString(), 0};
+    }
+    progress.finish();
+
+    qInfo() << "Exported GLB:" << filePath << "(" << written << "bytes,"
+            << indexed.vertices.size() << "vertices," << primitives.size() << "primitives)";
+
+    return {true, QString(), written, file.stallMs()};
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,51 @@
+/**
+ * @file gltfexporter.h
+ * @brief Binary glTF (GLB) mesh exporter for web previews
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "exporter.h"
+
+namespace LithoMaker {
+
+/**
+ * @brief Binary glTF 2.0 exporter
+ *
+ * Produces a single self-contained .glb file meant for web viewers.
+ * The mesh is welded, reordered for vertex cache locality and, when
+ * quantization is enabled, stored with 16-bit positions
+ * (KHR_mesh_quantization) and 16-bit indices. Ordered, quantized data
+ * also compresses well with HTTP gzip/brotli transport compression.
+ *
+ * Quantized output takes about 10 bytes per triangle (three 16-bit
+ * indices plus about half an 8 byte vertex), a fifth of binary STL.
+ * EXT_meshopt_compression would shrink it further but is not written:
+ * it needs the meshoptimizer encoder, which is not a dependency.
+ */
+class GltfExporter : public Exporter {
+public:
+    /**
+     * @param quantize Store 16-bit positions and split the mesh into
+     *                 primitives addressable with 16-bit indices
+     */
+    explicit GltfExporter(bool quantize = true);
+
+    ExportResult exportMesh(const QList<QVector3D>& mesh,
+                           const QString& filePath) override;
+
+    QString name() const override { return QStringLiteral("glTF"); }
+    QString extension() const override { return QStringLiteral("glb"); }
+    QString fileFilter() const override { return QStringLiteral("glTF Binary Files (*.glb)"); }
+
+    void setQuantize(bool quantize) { m_quantize = quantize; }
+    bool quantize() const { return m_quantize; }
+
+private:
+    bool m_quantize;
+};
+
+} // namespace LithoMaker
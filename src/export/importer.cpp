@@ -0,0 +1,37 @@
+/**
+ * @file importer.cpp
+ * @brief Mesh importer selection
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "importer.h"
+#include "stlimporter.h"
+#include "objimporter.h"
+#include "threemfimporter.h"
+
+#include <QFileInfo>
+#include <QObject>
+
+namespace LithoMaker {
+
+std::unique_ptr<Importer> Importer::forFile(const QString& filePath) {
+    const QString suffix = QFileInfo(filePath).suffix().toLower();
+    if (suffix == "stl") {
+        return std::make_unique<StlImporter>();
+    }
+    if (suffix == "obj") {
+        return std::make_unique<ObjImporter>();
+    }
+    if (suffix == "3mf") {
+        return std::make_unique<ThreeMfImporter>();
+    }
+    return nullptr;
+}
+
+QString Importer::fileFilter() {
+    return QObject::tr("Mesh Files (*.stl *.obj *.3mf);;STL Files (*.stl);;OBJ Files (*.obj);;3MF Files (*.3mf)");
+}
+
+} // namespace LithoMaker
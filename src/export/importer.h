@@ -0,0 +1,61 @@
+/**
+ * @file importer.h
+ * @brief Abstract mesh importer interface
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QList>
+#include <QVector3D>
+#include <QString>
+#include <memory>
+
+namespace LithoMaker {
+
+/**
+ * @brief Import result
+ */
+struct ImportResult {
+    bool success{false};
+    QString errorMessage;
+    QList<QVector3D> mesh; ///< Triangles, 3 vertices per triangle
+};
+
+/**
+ * @brief Abstract base class for mesh importers
+ *
+ * Importers produce the same triangle soup MeshGenerator produces, so
+ * an imported mesh can be previewed and exported like a generated one.
+ */
+class Importer {
+public:
+    virtual ~Importer() = default;
+
+    /**
+     * @brief Read a mesh from file
+     * @param filePath Input file path
+     * @return Import result
+     */
+    virtual ImportResult importMesh(const QString& filePath) = 0;
+
+    /**
+     * @brief Get the importer name
+     */
+    virtual QString name() const = 0;
+
+    /**
+     * @brief Create the importer matching a file's extension
+     * @return Importer, or nullptr if the format is not supported
+     */
+    static std::unique_ptr<Importer> forFile(const QString& filePath);
+
+    /**
+     * @brief File filter for open dialogs covering all importable formats
+     */
+    static QString fileFilter();
+};
+
+} // namespace LithoMaker
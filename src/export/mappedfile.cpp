@@ -0,0 +1,49 @@
+/**
+ * @file mappedfile.cpp
+ * @brief Read-only memory-mapped file implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "mappedfile.h"
+
+#include <QObject>
+
+namespace LithoMaker {
+
+MappedFile::~MappedFile() {
+    if (m_mapped) {
+        m_file.unmap(m_mapped);
+    }
+}
+
+bool MappedFile::open(const QString& filePath) {
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = QObject::tr("Cannot open file: ") + m_file.errorString();
+        return false;
+    }
+
+    m_size = m_file.size();
+    if (m_size == 0) {
+        m_data = "";
+        return true;
+    }
+
+    m_mapped = m_file.map(0, m_size);
+    if (m_mapped) {
+        m_data = reinterpret_cast<const char*>(m_mapped);
+        return true;
+    }
+
+    m_buffer = m_file.readAll();
+    if (m_buffer.size() != m_size) {
+        m_error = QObject::tr("Cannot read file: ") + m_file.errorString();
+        return false;
+    }
+    m_data = m_buffer.constData();
+    return true;
+}
+
+} // namespace LithoMaker
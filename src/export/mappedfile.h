@@ -0,0 +1,48 @@
+/**
+ * @file mappedfile.h
+ * @brief Read-only memory-mapped file
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+namespace LithoMaker {
+
+/**
+ * @brief Maps a whole file into memory for parsing
+ *
+ * Falls back to reading the file when mapping is not possible (for
+ * example in the browser build), so callers always get one contiguous
+ * buffer.
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const QString& filePath);
+
+    const char* data() const { return m_data; }
+    qint64 size() const { return m_size; }
+
+    QString errorString() const { return m_error; }
+
+private:
+    QFile m_file;
+    uchar* m_mapped{nullptr};
+    QByteArray m_buffer;
+    const char* m_data{nullptr};
+    qint64 m_size{0};
+    QString m_error;
+};
+
+} // namespace LithoMaker
@@ -7,14 +7,26 @@
  */
 
 #include "objexporter.h"
+#include "core/memorystats.h"
 
-#include <QFile>
 #include <QTextStream>
 #include <QDebug>
 #include <QMap>
 
 namespace LithoMaker {
 
+namespace {
+
+// Tree node and string header of a vertex map entry, roughly
+constexpr qint64 kMapEntryOverhead = 80;
+
+qint64 dedupBytes(qint64 mapBytes, const QList<QVector3D>& vertices, const QList<int>& indices) {
+    return mapBytes + vertices.capacity() * qint64(sizeof(QVector3D)) +
+           indices.capacity() * qint64(sizeof(int));
+}
+
+} // namespace
+
 ExportResult ObjExporter::exportMesh(const QList<QVector3D>& mesh, 
                                       const QString& filePath) {
     if (mesh.isEmpty()) {
@@ -25,7 +37,7 @@ ExportResult ObjExporter::exportMesh(const QList<QVector3D>& mesh,
         return {false, QObject::tr("Invalid mesh: vertex count not divisible by 3"), 0};
     }
 
-    QFile file(filePath);
+    AsyncFileWriter file(filePath, m_writerBackend);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         return {false, QObject::tr("Cannot open file for writing: ") + file.errorString(), 0};
     }
@@ -43,6 +55,8 @@ ExportResult ObjExporter::exportMesh(const QList<QVector3D>& mesh,
     QMap<QString, int> vertexMap;
     QList<QVector3D> uniqueVertices;
     QList<int> faceIndices;
+    qint64 mapBytes = 0;
+    MemoryLease memory(MemorySubsystem::Export);
 
     auto getVertexKey = [](const QVector3D& v) {
         return QString("%1_%2_%3")
@@ -51,14 +65,22 @@ ExportResult ObjExporter::exportMesh(const QList<QVector3D>& mesh,
             .arg(static_cast<double>(v.z()), 0, 'f', 6);
     };
 
+    // Two passes over the triangles: deduplication and faces
+    ProgressMeter progress(mesh.size() / 3 * 2, m_progressCallback);
     for (const QVector3D& v : mesh) {
         QString key = getVertexKey(v);
         if (!vertexMap.contains(key)) {
+            mapBytes += kMapEntryOverhead + key.size() * qint64(sizeof(QChar));
             vertexMap[key] = uniqueVertices.size() + 1; // OBJ is 1-indexed
             uniqueVertices.append(v);
         }
         faceIndices.append(vertexMap[key]);
+        if (faceIndices.size() % (kProgressBatch * 3) == 0) {
+            memory.resize(dedupBytes(mapBytes, uniqueVertices, faceIndices));
+            progress.add(kProgressBatch);
+        }
     }
+    memory.resize(dedupBytes(mapBytes, uniqueVertices, faceIndices));
 
     // Write vertices
     for (const QVector3D& v : uniqueVertices) {
@@ -72,15 +94,22 @@ ExportResult ObjExporter::exportMesh(const QList<QVector3D>& mesh,
         out << "f " << faceIndices[i] 
             << " " << faceIndices[i + 1] 
             << " " << faceIndices[i + 2] << "\n";
+        if ((i / 3 + 1) % kProgressBatch == 0) {
+            progress.add(kProgressBatch);
+        }
     }
 
-    qint64 written = file.size();
-    file.close();
+    out.flush();
+    const qint64 written = file.size();
+    if (!file.finish()) {
+        return {false, QObject::tr("Write error: ") + file.errorString(), 0};
+    }
+    progress.finish();
 
     qInfo() << "Exported OBJ:" << filePath << "(" << written << "bytes," 
             << uniqueVertices.size() << "unique vertices)";
 
-    return {true, QString(), written};
+    return {true, QString(), written, file.stallMs()};
 }
 
 } // namespace LithoMaker
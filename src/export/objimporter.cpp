@@ -0,0 +1,171 @@
+/**
+ * @file objimporter.cpp
+ * @brief Wavefront OBJ mesh importer implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "objimporter.h"
+#include "mappedfile.h"
+#include "textparse.h"
+
+#include <QDebug>
+#include <QObject>
+
+#include <vector>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+struct ObjChunk {
+    QList<QVector3D> vertices;
+    std::vector<qint64> indices; ///< Triangle corners, 1-based or negative
+    std::vector<qint64> relativeBase; ///< Vertices seen in this chunk before each negative index
+    bool failed{false};
+};
+
+int chunkCount() {
+#ifdef USE_OPENMP
+    return omp_get_max_threads() * 4;
+#else
+    return 1;
+#endif
+}
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t';
+}
+
+void parseChunk(const char* p, const char* end, ObjChunk& chunk) {
+    std::vector<qint64> polygon;
+    for (; p < end; p = TextParse::nextLine(p, end)) {
+        const char* q = TextParse::skipSpaces(p, end);
+        if (q + 1 >= end || !isBlank(q[1])) {
+            continue; // vt, vn, comments and other statements
+        }
+        if (q[0] == 'v') {
+            ++q;
+            float x, y, z;
+            if (!TextParse::parseFloat(q, end, x) || !TextParse::parseFloat(q, end, y) ||
+                !TextParse::parseFloat(q, end, z)) {
+                chunk.failed = true;
+                return;
+            }
+            chunk.vertices.append(QVector3D(x, y, z));
+        } else if (q[0] == 'f') {
+            ++q;
+            polygon.clear();
+            qint64 index;
+            while (TextParse::parseInt(q, end, index)) {
+                if (index == 0) {
+                    chunk.failed = true;
+                    return;
+                }
+                polygon.push_back(index);
+                // Skip the /vt/vn part of v/vt/vn, v//vn and v/vt forms
+                while (q < end && !isBlank(*q) && *q != '\r' && *q != '\n') {
+                    ++q;
+                }
+            }
+            if (polygon.size() < 3) {
+                chunk.failed = true;
+                return;
+            }
+            for (size_t i = 1; i + 1 < polygon.size(); ++i) {
+                for (qint64 corner : {polygon[0], polygon[i], polygon[i + 1]}) {
+                    chunk.indices.push_back(corner);
+                    if (corner < 0) {
+                        chunk.relativeBase.push_back(chunk.vertices.size());
+                    }
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+ImportResult ObjImporter::importMesh(const QString& filePath) {
+    MappedFile file;
+    if (!file.open(filePath)) {
+        return {false, file.errorString(), {}};
+    }
+
+    const char* data = file.data();
+    const auto ranges = TextParse::splitLines(data, data + file.size(), chunkCount());
+    const int chunks = static_cast<int>(ranges.size());
+    std::vector<ObjChunk> parsed(chunks);
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+    #endif
+    for (int c = 0; c < chunks; ++c) {
+        parseChunk(ranges[c].first, ranges[c].second, parsed[c]);
+    }
+
+    // Vertices are numbered across the whole file, so each chunk needs
+    // the number of vertices defined before it
+    std::vector<qint64> vertexOffset(chunks + 1, 0);
+    std::vector<qint64> cornerOffset(chunks + 1, 0);
+    for (int c = 0; c < chunks; ++c) {
+        if (parsed[c].failed) {
+            return {false, QObject::tr("Invalid vertex or face definition"), {}};
+        }
+        vertexOffset[c + 1] = vertexOffset[c] + parsed[c].vertices.size();
+        cornerOffset[c + 1] = cornerOffset[c] + static_cast<qint64>(parsed[c].indices.size());
+    }
+
+    const qint64 vertexCount = vertexOffset[chunks];
+    const qint64 cornerCount = cornerOffset[chunks];
+    if (cornerCount == 0) {
+        return {false, QObject::tr("Empty mesh"), {}};
+    }
+
+    std::vector<const QVector3D*> vertices;
+    vertices.reserve(vertexCount);
+    for (const auto& chunk : parsed) {
+        for (const QVector3D& v : chunk.vertices) {
+            vertices.push_back(&v);
+        }
+    }
+
+    QList<QVector3D> mesh(cornerCount);
+    QVector3D* out = mesh.data();
+    bool outOfRange = false;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) reduction(||:outOfRange)
+    #endif
+    for (int c = 0; c < chunks; ++c) {
+        const ObjChunk& chunk = parsed[c];
+        size_t relative = 0;
+        for (size_t i = 0; i < chunk.indices.size(); ++i) {
+            qint64 index = chunk.indices[i];
+            if (index < 0) {
+                index = vertexOffset[c] + chunk.relativeBase[relative++] + index;
+            } else {
+                index -= 1;
+            }
+            if (index < 0 || index >= vertexCount) {
+                outOfRange = true;
+                break;
+            }
+            out[cornerOffset[c] + static_cast<qint64>(i)] = *vertices[index];
+        }
+    }
+
+    if (outOfRange) {
+        return {false, QObject::tr("Face references a missing vertex"), {}};
+    }
+
+    qInfo() << "Imported OBJ:" << vertexCount << "vertices," << cornerCount / 3 << "triangles";
+    return {true, QString(), std::move(mesh)};
+}
+
+} // namespace LithoMaker
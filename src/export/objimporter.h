@@ -0,0 +1,31 @@
+/**
+ * @file objimporter.h
+ * @brief Wavefront OBJ mesh importer
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "importer.h"
+
+namespace LithoMaker {
+
+/**
+ * @brief Wavefront OBJ mesh importer
+ *
+ * Reads vertex positions and faces; texture coordinates, normals,
+ * groups and materials are ignored. Polygons are fan-triangulated and
+ * relative (negative) indices are supported.
+ */
+class ObjImporter : public Importer {
+public:
+    ObjImporter() = default;
+
+    ImportResult importMesh(const QString& filePath) override;
+
+    QString name() const override { return QStringLiteral("OBJ"); }
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,138 @@
+/**
+ * @file platebatch.cpp
+ * @brief Batch plate export implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "platebatch.h"
+#include "platepacker.h"
+#include "threemfwriter.h"
+
+#include <QDir>
+#include <QMatrix4x4>
+#include <QDebug>
+#include <algorithm>
+#include <limits>
+
+namespace LithoMaker {
+
+namespace {
+
+// Stand the lithophane up (mesh Y becomes build Z), optionally turned
+// by 90 degrees on the bed
+QMatrix4x4 orientation(bool rotated) {
+    QMatrix4x4 matrix;
+    if (rotated) {
+        matrix.rotate(90.0f, 0.0f, 0.0f, 1.0f);
+    }
+    matrix.rotate(90.0f, 1.0f, 0.0f, 0.0f);
+    return matrix;
+}
+
+// Bounds of the oriented mesh, from the eight corners of its box
+MeshBounds orientedBounds(const MeshBounds& bounds, const QMatrix4x4& matrix) {
+    const float inf = std::numeric_limits<float>::max();
+    MeshBounds result{QVector3D(inf, inf, inf), QVector3D(-inf, -inf, -inf)};
+    for (int corner = 0; corner < 8; ++corner) {
+        const QVector3D p = matrix.map(QVector3D(
+            (corner & 1) ? bounds.max.x() : bounds.min.x(),
+            (corner & 2) ? bounds.max.y() : bounds.min.y(),
+            (corner & 4) ? bounds.max.z() : bounds.min.z()));
+        result.min = QVector3D(std::min(result.min.x(), p.x()),
+                               std::min(result.min.y(), p.y()),
+                               std::min(result.min.z(), p.z()));
+        result.max = QVector3D(std::max(result.max.x(), p.x()),
+                               std::max(result.max.y(), p.y()),
+                               std::max(result.max.z(), p.z()));
+    }
+    return result;
+}
+
+} // namespace
+
+PlateBatchExporter::PlateBatchExporter(const QSizeF& bedSize, float spacing)
+    : m_bedSize(bedSize)
+    , m_spacing(spacing)
+{
+}
+
+PlateBatchResult PlateBatchExporter::exportPlates(const QList<PlateJob>& jobs,
+                                                  const QString& outputDir,
+                                                  const QString& baseName,
+                                                  ProgressCallback progressCallback) const {
+    PlateBatchResult result;
+    if (jobs.isEmpty()) {
+        result.errorMessage = QObject::tr("No lithophanes to export");
+        return result;
+    }
+
+    // Footprints of the upright, unrotated lithophanes
+    const QMatrix4x4 upright = orientation(false);
+    QList<QSizeF> footprints;
+    footprints.reserve(jobs.size());
+    for (const PlateJob& job : jobs) {
+        const MeshBounds oriented = orientedBounds(job.bounds, upright);
+        footprints.append(QSizeF(oriented.max.x() - oriented.min.x(),
+                                 oriented.max.y() - oriented.min.y()));
+    }
+
+    QList<int> unplaced;
+    const auto plates = PlatePacker(m_bedSize, m_spacing).pack(footprints, &unplaced);
+    for (int index : unplaced) {
+        result.skipped.append(jobs[index].name);
+        qWarning() << "Footprint larger than the bed, skipped:" << jobs[index].name;
+    }
+
+    ProgressMeter progress(jobs.size(), progressCallback);
+    for (int plate = 0; plate < plates.size(); ++plate) {
+        const QString filePath = QDir(outputDir).filePath(
+            QString("%1_plate%2.3mf").arg(baseName).arg(plate + 1));
+
+        ThreeMfWriter writer;
+        if (!writer.open(filePath, m_writerBackend)) {
+            result.errorMessage = writer.errorString();
+            return result;
+        }
+
+        for (const PlatePlacement& placement : plates[plate]) {
+            const PlateJob& job = jobs[placement.index];
+            const QMatrix4x4 oriented = orientation(placement.rotated);
+            const MeshBounds bounds = orientedBounds(job.bounds, oriented);
+
+            QMatrix4x4 transform;
+            transform.translate(static_cast<float>(placement.position.x()) - bounds.min.x(),
+                                static_cast<float>(placement.position.y()) - bounds.min.y(),
+                                -bounds.min.z());
+            transform *= oriented;
+
+            const QList<QVector3D> mesh = job.generate();
+            if (mesh.isEmpty() || !writer.addObject(mesh, job.name, transform)) {
+                result.errorMessage = mesh.isEmpty()
+                    ? QObject::tr("Failed to generate %1").arg(job.name)
+                    : writer.errorString();
+                return result;
+            }
+
+            progress.add(1);
+        }
+
+        if (!writer.close()) {
+            result.errorMessage = writer.errorString();
+            return result;
+        }
+        result.files.append(filePath);
+        result.bytesWritten += writer.bytesWritten();
+        result.writeStallMs += writer.stallMs();
+    }
+
+    qInfo() << "Plate batch exported:" << jobs.size() - unplaced.size() << "lithophanes on"
+            << plates.size() << "plates";
+
+    progress.finish();
+    result.success = true;
+    return result;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,79 @@
+/**
+ * @file platebatch.h
+ * @brief Batch export of many lithophanes packed onto 3MF build plates
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "asyncfilewriter.h"
+#include "mesh/meshgenerator.h"
+
+#include <QList>
+#include <QSizeF>
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+namespace LithoMaker {
+
+/**
+ * @brief One lithophane in a plate batch
+ */
+struct PlateJob {
+    QString name;        ///< Object name in the 3MF
+    MeshBounds bounds;   ///< Predicted mesh bounds (see MeshGenerator::predictBounds)
+    std::function<QList<QVector3D>()> generate; ///< Produces the mesh on demand
+};
+
+/**
+ * @brief Result of a plate batch export
+ */
+struct PlateBatchResult {
+    bool success{false};
+    QString errorMessage;
+    QStringList files;     ///< Written plate files
+    QStringList skipped;   ///< Jobs whose footprint does not fit on the bed
+    qint64 bytesWritten{0};
+    qint64 writeStallMs{0};  ///< Time serialization waited for the disk
+};
+
+/**
+ * @brief Packs lithophanes upright onto build plates, one 3MF per plate
+ *
+ * Footprints (including stabilizer feet) are taken from the predicted
+ * bounds, so packing happens before any mesh is generated. Each mesh is
+ * then generated, streamed into its plate archive and released before
+ * the next one is generated.
+ */
+class PlateBatchExporter {
+public:
+    /**
+     * @param bedSize Usable bed size (mm)
+     * @param spacing Minimum gap between objects (mm)
+     */
+    PlateBatchExporter(const QSizeF& bedSize, float spacing);
+
+    /**
+     * @brief Pack and export all jobs
+     * @param jobs Lithophanes to place
+     * @param outputDir Directory receiving the plate files
+     * @param baseName Base file name, plates are named <baseName>_plate<N>.3mf
+     * @param progressCallback Optional callback, one step per written object
+     */
+    PlateBatchResult exportPlates(const QList<PlateJob>& jobs,
+                                  const QString& outputDir,
+                                  const QString& baseName,
+                                  ProgressCallback progressCallback = nullptr) const;
+
+    void setWriterBackend(WriterBackend backend) { m_writerBackend = backend; }
+
+private:
+    QSizeF m_bedSize;
+    float m_spacing;
+    WriterBackend m_writerBackend{WriterBackend::Auto};
+};
+
+} // namespace LithoMaker
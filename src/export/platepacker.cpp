@@ -0,0 +1,188 @@
+/**
+ * @file platepacker.cpp
+ * @brief Skyline bottom-left rectangle packing implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "platepacker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr double kEpsilon = 1e-6;
+constexpr double kNoFit = std::numeric_limits<double>::max();
+
+/**
+ * @brief Skyline of one plate: the top edge of everything placed so far
+ */
+class Skyline {
+public:
+    Skyline(double width, double height)
+        : m_width(width), m_height(height)
+    {
+        m_segments.push_back({0.0, 0.0, width});
+    }
+
+    /**
+     * @brief Find the bottom-left position for a rectangle
+     * @return Segment index, or -1 if the rectangle does not fit
+     */
+    int find(double width, double height, double& bestY) const {
+        int bestIndex = -1;
+        bestY = kNoFit;
+        for (int i = 0; i < static_cast<int>(m_segments.size()); ++i) {
+            if (m_segments[i].x + width > m_width + kEpsilon) {
+                break;
+            }
+            const double y = restingHeight(i, width);
+            if (y + height <= m_height + kEpsilon && y < bestY - kEpsilon) {
+                bestY = y;
+                bestIndex = i;
+            }
+        }
+        return bestIndex;
+    }
+
+    double x(int index) const { return m_segments[index].x; }
+
+    void place(int index, double width, double top) {
+        const Segment placed{m_segments[index].x, top, width};
+        m_segments.insert(m_segments.begin() + index, placed);
+
+        // Trim the segments now covered by the new one
+        const double right = placed.x + placed.width;
+        size_t next = static_cast<size_t>(index) + 1;
+        while (next < m_segments.size() && m_segments[next].x < right - kEpsilon) {
+            Segment& segment = m_segments[next];
+            const double overlap = right - segment.x;
+            segment.x += overlap;
+            segment.width -= overlap;
+            if (segment.width <= kEpsilon) {
+                m_segments.erase(m_segments.begin() + next);
+            } else {
+                break;
+            }
+        }
+
+        // Merge neighbours at the same height
+        for (size_t i = 1; i < m_segments.size();) {
+            if (std::abs(m_segments[i - 1].y - m_segments[i].y) <= kEpsilon) {
+                m_segments[i - 1].width += m_segments[i].width;
+                m_segments.erase(m_segments.begin() + i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+private:
+    struct Segment {
+        double x;
+        double y;
+        double width;
+    };
+
+    // Height at which a rectangle starting at segment index comes to rest
+    double restingHeight(int index, double width) const {
+        double y = 0.0;
+        double remaining = width;
+        for (size_t i = index; remaining > kEpsilon; ++i) {
+            if (i >= m_segments.size()) {
+                return kNoFit;
+            }
+            y = std::max(y, m_segments[i].y);
+            remaining -= m_segments[i].width;
+        }
+        return y;
+    }
+
+    double m_width;
+    double m_height;
+    std::vector<Segment> m_segments;
+};
+
+} // namespace
+
+PlatePacker::PlatePacker(const QSizeF& bedSize, float spacing)
+    : m_bedSize(bedSize)
+    , m_spacing(std::max(spacing, 0.0f))
+{
+}
+
+QList<QList<PlatePlacement>> PlatePacker::pack(const QList<QSizeF>& footprints,
+                                               QList<int>* unplaced) const {
+    // Spacing is added to every footprint, and to the bed so that the
+    // last footprint in a row or column may touch the edge
+    const double binWidth = m_bedSize.width() + m_spacing;
+    const double binHeight = m_bedSize.height() + m_spacing;
+
+    std::vector<int> order(footprints.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&footprints](int a, int b) {
+        const QSizeF& fa = footprints[a];
+        const QSizeF& fb = footprints[b];
+        return std::max(fa.width(), fa.height()) > std::max(fb.width(), fb.height());
+    });
+
+    std::vector<Skyline> skylines;
+    QList<QList<PlatePlacement>> plates;
+
+    auto tryPlace = [&](size_t plate, int index) {
+        const double w = footprints[index].width() + m_spacing;
+        const double h = footprints[index].height() + m_spacing;
+
+        double y = 0.0;
+        double rotatedY = 0.0;
+        const int segment = skylines[plate].find(w, h, y);
+        const int rotatedSegment = skylines[plate].find(h, w, rotatedY);
+        if (segment < 0 && rotatedSegment < 0) {
+            return false;
+        }
+
+        // Prefer the orientation that leaves the lower skyline
+        const bool rotated = segment < 0 ||
+            (rotatedSegment >= 0 && rotatedY + w < y + h - kEpsilon);
+        const int chosen = rotated ? rotatedSegment : segment;
+        const double baseY = rotated ? rotatedY : y;
+
+        PlatePlacement placement;
+        placement.index = index;
+        placement.position = QPointF(skylines[plate].x(chosen), baseY);
+        placement.rotated = rotated;
+        skylines[plate].place(chosen, rotated ? h : w, baseY + (rotated ? w : h));
+        plates[static_cast<qsizetype>(plate)].append(placement);
+        return true;
+    };
+
+    for (int index : order) {
+        bool placed = false;
+        for (size_t plate = 0; plate < skylines.size() && !placed; ++plate) {
+            placed = tryPlace(plate, index);
+        }
+        if (!placed) {
+            skylines.emplace_back(binWidth, binHeight);
+            plates.append(QList<PlatePlacement>());
+            placed = tryPlace(skylines.size() - 1, index);
+            if (!placed) {
+                skylines.pop_back();
+                plates.removeLast();
+                if (unplaced) {
+                    unplaced->append(index);
+                }
+            }
+        }
+    }
+
+    return plates;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,55 @@
+/**
+ * @file platepacker.h
+ * @brief Rectangle bin packing of footprints onto build plates
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QList>
+#include <QPointF>
+#include <QSizeF>
+
+namespace LithoMaker {
+
+/**
+ * @brief Placement of one footprint on a plate
+ */
+struct PlatePlacement {
+    int index{0};      ///< Index of the footprint in the input list
+    QPointF position;  ///< Lower-left corner on the bed (mm)
+    bool rotated{false}; ///< Footprint turned by 90 degrees
+};
+
+/**
+ * @brief Packs rectangular footprints onto as few plates as possible
+ *
+ * Uses the skyline bottom-left heuristic: footprints are sorted by their
+ * longer side, and each is placed at the lowest position along the
+ * skyline of the first plate where it fits (optionally rotated).
+ */
+class PlatePacker {
+public:
+    /**
+     * @param bedSize Usable bed size (mm)
+     * @param spacing Minimum gap between footprints (mm)
+     */
+    PlatePacker(const QSizeF& bedSize, float spacing);
+
+    /**
+     * @brief Pack footprints onto plates
+     * @param footprints Footprint sizes (mm)
+     * @param unplaced Optional output for footprints larger than the bed
+     * @return One list of placements per plate
+     */
+    QList<QList<PlatePlacement>> pack(const QList<QSizeF>& footprints,
+                                      QList<int>* unplaced = nullptr) const;
+
+private:
+    QSizeF m_bedSize;
+    float m_spacing;
+};
+
+} // namespace LithoMaker
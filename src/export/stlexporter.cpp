@@ -8,8 +8,6 @@
 
 #include "stlexporter.h"
 
-#include <QFile>
-#include <QDataStream>
 #include <QDebug>
 #include <cstring>
 
@@ -39,7 +37,7 @@ ExportResult StlExporter::exportMesh(const QList<QVector3D>& mesh,
 
 ExportResult StlExporter::exportBinary(const QList<QVector3D>& mesh, 
                                         const QString& filePath) {
-    QFile file(filePath);
+    CompressedFileWriter file(filePath, m_compression, m_writerBackend);
     if (!file.open(QIODevice::WriteOnly)) {
         return {false, QObject::tr("Cannot open file for writing: ") + file.errorString(), 0};
     }
@@ -54,42 +52,45 @@ ExportResult StlExporter::exportBinary(const QList<QVector3D>& mesh,
     quint32 triangleCount = static_cast<quint32>(mesh.size() / 3);
     file.write(reinterpret_cast<const char*>(&triangleCount), sizeof(quint32));
 
-    // Write triangles
+    // Write triangles: normal (not calculated, set to 0), three vertices
+    // and a zero attribute byte count, 50 bytes per record
+    char record[50];
+    std::memset(record, 0, sizeof(record));
+    ProgressMeter progress(triangleCount, m_progressCallback);
     for (int i = 0; i < mesh.size(); i += 3) {
-        // Normal vector (not calculated, set to 0)
-        float normal[3] = {0.0f, 0.0f, 0.0f};
-        file.write(reinterpret_cast<const char*>(normal), sizeof(float) * 3);
-
-        // Three vertices
         for (int j = 0; j < 3; ++j) {
             const QVector3D& v = mesh.at(i + j);
-            float vertex[3] = {v.x(), v.y(), v.z()};
-            file.write(reinterpret_cast<const char*>(vertex), sizeof(float) * 3);
+            const float vertex[3] = {v.x(), v.y(), v.z()};
+            std::memcpy(record + 12 + j * 12, vertex, sizeof(vertex));
+        }
+        file.write(record, sizeof(record));
+        if ((i / 3 + 1) % kProgressBatch == 0) {
+            progress.add(kProgressBatch);
         }
-
-        // Attribute byte count
-        quint16 attrByteCount = 0;
-        file.write(reinterpret_cast<const char*>(&attrByteCount), sizeof(quint16));
     }
 
-    qint64 written = file.size();
-    file.close();
+    if (!file.finish()) {
+        return {false, QObject::tr("Write error: ") + file.errorString(), 0};
+    }
+    progress.finish();
+    const qint64 written = file.compressedSize();
 
     qInfo() << "Exported binary STL:" << filePath << "(" << written << "bytes," 
             << triangleCount << "triangles)";
 
-    return {true, QString(), written};
+    return {true, QString(), written, file.stallMs()};
 }
 
 ExportResult StlExporter::exportAscii(const QList<QVector3D>& mesh, 
                                        const QString& filePath) {
-    QFile file(filePath);
+    CompressedFileWriter file(filePath, m_compression, m_writerBackend);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         return {false, QObject::tr("Cannot open file for writing: ") + file.errorString(), 0};
     }
 
     file.write("solid lithophane\n");
 
+    ProgressMeter progress(mesh.size() / 3, m_progressCallback);
     for (int i = 0; i < mesh.size(); i += 3) {
         file.write("facet normal 0.0 0.0 0.0\n");
         file.write("\touter loop\n");
@@ -105,16 +106,22 @@ ExportResult StlExporter::exportAscii(const QList<QVector3D>& mesh,
         
         file.write("\tendloop\n");
         file.write("endfacet\n");
+        if ((i / 3 + 1) % kProgressBatch == 0) {
+            progress.add(kProgressBatch);
+        }
     }
 
     file.write("endsolid\n");
 
-    qint64 written = file.size();
-    file.close();
+    if (!file.finish()) {
+        return {false, QObject::tr("Write error: ") + file.errorString(), 0};
+    }
+    progress.finish();
+    const qint64 written = file.compressedSize();
 
     qInfo() << "Exported ASCII STL:" << filePath << "(" << written << "bytes)";
 
-    return {true, QString(), written};
+    return {true, QString(), written, file.stallMs()};
 }
 
 } // namespace LithoMaker
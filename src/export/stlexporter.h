@@ -9,6 +9,7 @@
 #pragma once
 
 #include "exporter.h"
+#include "compressedwriter.h"
 
 namespace LithoMaker {
 
@@ -31,17 +32,28 @@ public:
                            const QString& filePath) override;
 
     QString name() const override { return QStringLiteral("STL"); }
-    QString extension() const override { return QStringLiteral("stl"); }
-    QString fileFilter() const override { return QStringLiteral("STL Files (*.stl)"); }
+    QString extension() const override {
+        return QStringLiteral("stl") + CompressedFileWriter::suffix(m_compression);
+    }
+    QString fileFilter() const override {
+        return QStringLiteral("STL Files (*.%1)").arg(extension());
+    }
 
     void setFormat(StlFormat format) { m_format = format; }
     StlFormat format() const { return m_format; }
 
+    /**
+     * @brief Compress the output while it is written (.stl.gz / .stl.zst)
+     */
+    void setCompression(Compression compression) { m_compression = compression; }
+    Compression compression() const { return m_compression; }
+
 private:
     ExportResult exportBinary(const QList<QVector3D>& mesh, const QString& filePath);
     ExportResult exportAscii(const QList<QVector3D>& mesh, const QString& filePath);
 
     StlFormat m_format;
+    Compression m_compression{Compression::None};
 };
 
 } // namespace LithoMaker
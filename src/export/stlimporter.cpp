@@ -0,0 +1,161 @@
+/**
+ * @file stlimporter.cpp
+ * @brief STL mesh importer implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "stlimporter.h"
+#include "mappedfile.h"
+#include "textparse.h"
+
+#include <QDebug>
+#include <QObject>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr qint64 kHeaderSize = 84;
+constexpr qint64 kRecordSize = 50;
+
+int chunkCount() {
+#ifdef USE_OPENMP
+    return omp_get_max_threads() * 4;
+#else
+    return 1;
+#endif
+}
+
+bool startsWith(const char* p, const char* end, const char* token) {
+    const size_t length = std::strlen(token);
+    return static_cast<size_t>(end - p) >= length && std::memcmp(p, token, length) == 0;
+}
+
+} // namespace
+
+ImportResult StlImporter::importMesh(const QString& filePath) {
+    MappedFile file;
+    if (!file.open(filePath)) {
+        return {false, file.errorString(), {}};
+    }
+
+    const char* data = file.data();
+    const qint64 size = file.size();
+
+    // A binary file's size always matches its triangle count
+    if (size >= kHeaderSize) {
+        quint32 triangleCount = 0;
+        std::memcpy(&triangleCount, data + 80, sizeof(triangleCount));
+        if (kHeaderSize + static_cast<qint64>(triangleCount) * kRecordSize == size) {
+            return importBinary(data, size);
+        }
+    }
+
+    const char* p = TextParse::skipSpaces(data, data + size);
+    while (p < data + size && *p == '\n') {
+        p = TextParse::skipSpaces(p + 1, data + size);
+    }
+    if (startsWith(p, data + size, "solid")) {
+        return importAscii(data, size);
+    }
+
+    return {false, QObject::tr("Not a valid STL file"), {}};
+}
+
+ImportResult StlImporter::importBinary(const char* data, qint64 size) {
+    const qint64 triangleCount = (size - kHeaderSize) / kRecordSize;
+    if (triangleCount == 0) {
+        return {false, QObject::tr("Empty mesh"), {}};
+    }
+
+    QList<QVector3D> mesh(triangleCount * 3);
+    QVector3D* out = mesh.data();
+    const char* records = data + kHeaderSize;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (qint64 t = 0; t < triangleCount; ++t) {
+        // Skip the 12 byte normal; vertices follow
+        const char* record = records + t * kRecordSize + 12;
+        for (int j = 0; j < 3; ++j) {
+            float v[3];
+            std::memcpy(v, record + j * 12, sizeof(v));
+            out[t * 3 + j] = QVector3D(v[0], v[1], v[2]);
+        }
+    }
+
+    qInfo() << "Imported binary STL:" << triangleCount << "triangles";
+    return {true, QString(), std::move(mesh)};
+}
+
+ImportResult StlImporter::importAscii(const char* data, qint64 size) {
+    const auto ranges = TextParse::splitLines(data, data + size, chunkCount());
+    const int chunks = static_cast<int>(ranges.size());
+    std::vector<QList<QVector3D>> chunkVertices(chunks);
+    std::vector<qint64> errorLine(chunks, -1);
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1)
+    #endif
+    for (int c = 0; c < chunks; ++c) {
+        const char* end = ranges[c].second;
+        auto& vertices = chunkVertices[c];
+        vertices.reserve((end - ranges[c].first) / 100);
+        qint64 line = 0;
+        for (const char* p = ranges[c].first; p < end; p = TextParse::nextLine(p, end), ++line) {
+            const char* q = TextParse::skipSpaces(p, end);
+            if (!startsWith(q, end, "vertex")) {
+                continue; // facet, loop and solid lines carry no geometry
+            }
+            q += 6;
+            float x, y, z;
+            if (!TextParse::parseFloat(q, end, x) || !TextParse::parseFloat(q, end, y) ||
+                !TextParse::parseFloat(q, end, z)) {
+                errorLine[c] = line;
+                break;
+            }
+            vertices.append(QVector3D(x, y, z));
+        }
+    }
+
+    qint64 linesBefore = 0;
+    qint64 total = 0;
+    for (int c = 0; c < chunks; ++c) {
+        if (errorLine[c] >= 0) {
+            // Only count lines when reporting, it is not needed otherwise
+            for (int k = 0; k < c; ++k) {
+                linesBefore += std::count(ranges[k].first, ranges[k].second, '\n');
+            }
+            return {false, QObject::tr("Invalid vertex on line %1").arg(linesBefore + errorLine[c] + 1), {}};
+        }
+        total += chunkVertices[c].size();
+    }
+    if (total == 0) {
+        return {false, QObject::tr("Empty mesh"), {}};
+    }
+    if (total % 3 != 0) {
+        return {false, QObject::tr("Invalid mesh: vertex count not divisible by 3"), {}};
+    }
+
+    QList<QVector3D> mesh;
+    mesh.reserve(total);
+    for (auto& vertices : chunkVertices) {
+        mesh.append(vertices);
+        vertices = QList<QVector3D>();
+    }
+
+    qInfo() << "Imported ASCII STL:" << total / 3 << "triangles";
+    return {true, QString(), std::move(mesh)};
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,35 @@
+/**
+ * @file stlimporter.h
+ * @brief STL mesh importer (binary and ASCII)
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "importer.h"
+
+namespace LithoMaker {
+
+/**
+ * @brief STL mesh importer
+ *
+ * Detects binary and ASCII files by content, not by the "solid" header
+ * alone (binary files often start with it too). Both variants are
+ * parsed in parallel from a memory-mapped file.
+ */
+class StlImporter : public Importer {
+public:
+    StlImporter() = default;
+
+    ImportResult importMesh(const QString& filePath) override;
+
+    QString name() const override { return QStringLiteral("STL"); }
+
+private:
+    ImportResult importBinary(const char* data, qint64 size);
+    ImportResult importAscii(const char* data, qint64 size);
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,150 @@
+/**
+ * @file textparse.h
+ * @brief Locale-independent number parsing helpers for mesh importers
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+namespace LithoMaker {
+namespace TextParse {
+
+inline const char* skipSpaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        ++p;
+    }
+    return p;
+}
+
+inline const char* nextLine(const char* p, const char* end) {
+    while (p < end && *p != '\n') {
+        ++p;
+    }
+    return p < end ? p + 1 : end;
+}
+
+/**
+ * @brief Parse a float, skipping leading blanks
+ *
+ * Uses std::from_chars where the standard library implements it for
+ * floating point, otherwise a plain decimal parser. Neither depends on
+ * the C locale, unlike strtof.
+ */
+inline bool parseFloat(const char*& p, const char* end, float& value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        ++p; // from_chars rejects an explicit plus sign
+    }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    const auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+#else
+    const char* start = p;
+    bool negative = false;
+    if (p < end && *p == '-') {
+        negative = true;
+        ++p;
+    }
+    quint64 mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+        if (mantissa < 100000000000000000ull) {
+            mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+        } else {
+            ++exponent;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits) {
+            if (mantissa < 100000000000000000ull) {
+                mantissa = mantissa * 10 + static_cast<quint64>(*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if (digits == 0) {
+        p = start;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* expStart = p++;
+        bool expNegative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            expNegative = *p == '-';
+            ++p;
+        }
+        int exp = 0;
+        const char* expDigits = p;
+        for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+            exp = std::min(exp * 10 + (*p - '0'), 9999);
+        }
+        if (p == expDigits) {
+            p = expStart; // Not an exponent after all
+        } else {
+            exponent += expNegative ? -exp : exp;
+        }
+    }
+    const double result = static_cast<double>(mantissa) * std::pow(10.0, exponent);
+    value = static_cast<float>(negative ? -result : result);
+    return true;
+#endif
+}
+
+/**
+ * @brief Parse a (possibly negative) integer, skipping leading blanks
+ */
+inline bool parseInt(const char*& p, const char* end, qint64& value) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+        ++p;
+    }
+    const auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+/**
+ * @brief Split a text buffer into up to @p parts ranges at line starts
+ */
+inline std::vector<std::pair<const char*, const char*>> splitLines(const char* begin,
+                                                                   const char* end,
+                                                                   int parts) {
+    std::vector<std::pair<const char*, const char*>> ranges;
+    const qint64 size = end - begin;
+    const char* start = begin;
+    for (int i = 1; i <= parts && start < end; ++i) {
+        const char* stop = i == parts ? end : begin + size * i / parts;
+        if (stop < start) {
+            stop = start;
+        }
+        if (stop > begin && stop < end && stop[-1] != '\n') {
+            stop = nextLine(stop, end);
+        }
+        if (stop > start) {
+            ranges.emplace_back(start, stop);
+        }
+        start = stop;
+    }
+    return ranges;
+}
+
+} // namespace TextParse
+} // namespace LithoMaker
@@ -7,176 +7,124 @@
  */
 
 #include "threemfexporter.h"
+#include "threemfwriter.h"
+#include "thumbnailrenderer.h"
+#include "mesh/meshgenerator.h"
 
-#include <QFile>
-#include <QDebug>
 #include <QMap>
-#include <QDir>
-#ifndef BUILD_WASM
-#include <QProcess>
-#endif
+
+#include <algorithm>
 
 namespace LithoMaker {
 
-ExportResult ThreeMfExporter::exportMesh(const QList<QVector3D>& mesh, 
-                                          const QString& filePath) {
-#ifdef BUILD_WASM
-    // 3MF export requires QProcess which is not available in browser
-    Q_UNUSED(mesh);
-    Q_UNUSED(filePath);
-    return {false, QObject::tr("3MF export is not available in browser version. Please use STL or OBJ format."), 0};
-#else
-    if (mesh.isEmpty()) {
-        return {false, QObject::tr("Empty mesh"), 0};
-    }
+namespace {
+
+// Printer the bundled lithophane profile is compatible with
+const char* kPrinterSettings[][2] = {
+    {"printer_technology", "FFF"},
+    {"printer_settings_id", "Original Prusa i3 MK3"},
+    {"printer_model", "MK3"},
+    {"printer_variant", "0.4"},
+    {"printer_vendor", "PrusaResearch"},
+    {"printer_notes", "PRINTER_VENDOR_PRUSA3D\\nPRINTER_MODEL_MK3\\n"},
+    {"nozzle_diameter", "0.4"},
+    {"max_print_height", "210"},
+};
+
+QString formatMm(double value) {
+    return QString::number(value, 'f', 0);
+}
 
-    if (mesh.size() % 3 != 0) {
-        return {false, QObject::tr("Invalid mesh: vertex count not divisible by 3"), 0};
-    }
+/**
+ * Rotate +90 degrees about X, so the image's vertical axis becomes the
+ * print's Z, then move the bottom onto the bed and the center to the
+ * middle of it.
+ */
+QMatrix4x4 uprightTransform(const QList<QVector3D>& mesh, const QSizeF& bedSize) {
+    const MeshBounds bounds = computeBounds(mesh);
+    const QVector3D& min = bounds.min;
+    const QVector3D& max = bounds.max;
+
+    QMatrix4x4 rotation;
+    rotation.rotate(90.0f, 1.0f, 0.0f, 0.0f);
+    const QVector3D center = rotation.map((min + max) * 0.5f);
+
+    QMatrix4x4 transform;
+    transform.translate(static_cast<float>(bedSize.width()) * 0.5f - center.x(),
+                        static_cast<float>(bedSize.height()) * 0.5f - center.y(),
+                        -min.y());
+    return transform * rotation;
+}
 
-    // Create temporary directory for 3MF contents
-    QString tempDir = QDir::temp().filePath("lithomaker_3mf_" + QString::number(QDateTime::currentMSecsSinceEpoch()));
-    QDir().mkpath(tempDir);
-    QDir().mkpath(tempDir + "/3D");
-    QDir().mkpath(tempDir + "/_rels");
-
-    // Write content files
-    QFile contentTypes(tempDir + "/[Content_Types].xml");
-    if (contentTypes.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        contentTypes.write(generateContentTypesXml().toUtf8());
-        contentTypes.close();
-    }
+} // namespace
 
-    QFile rels(tempDir + "/_rels/.rels");
-    if (rels.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        rels.write(generateRelsXml().toUtf8());
-        rels.close();
-    }
+void ThreeMfExporter::setSlicerProfile(const QByteArray& printProfile, const QString& profileName) {
+    m_printProfile = printProfile;
+    m_profileName = profileName;
+}
 
-    QFile model(tempDir + "/3D/3dmodel.model");
-    if (model.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        model.write(generateModelXml(mesh).toUtf8());
-        model.close();
+QByteArray ThreeMfExporter::slicerConfig() const {
+    // PrusaSlicer stores a project's configuration as "; key = value"
+    // lines, sorted by key
+    QMap<QByteArray, QByteArray> settings;
+    for (const QByteArray& rawLine : m_printProfile.split('\n')) {
+        const QByteArray line = rawLine.trimmed();
+        const int separator = line.indexOf('=');
+        if (line.isEmpty() || line.startsWith('#') || line.startsWith(';') || separator < 0) {
+            continue;
+        }
+        settings.insert(line.left(separator).trimmed(), line.mid(separator + 1).trimmed());
     }
 
-    // Create ZIP using PowerShell (Windows) or zip command (Linux/Mac)
-    bool success = false;
-    
-#ifdef Q_OS_WIN
-    // Use PowerShell Compress-Archive
-    QProcess process;
-    QString tempDirWin = tempDir;
-    QString filePathWin = filePath;
-    tempDirWin.replace("/", "\\");
-    filePathWin.replace("/", "\\");
-    QString script = QString("Compress-Archive -Path '%1\\*' -DestinationPath '%2' -Force")
-        .arg(tempDirWin)
-        .arg(filePathWin);
-    process.start("powershell", QStringList() << "-Command" << script);
-    process.waitForFinished(30000);
-    success = (process.exitCode() == 0);
-#else
-    // Use zip command on Linux/Mac
-    QProcess process;
-    process.setWorkingDirectory(tempDir);
-    process.start("zip", QStringList() << "-r" << filePath << ".");
-    process.waitForFinished(30000);
-    success = (process.exitCode() == 0);
-#endif
-
-    // Cleanup temp directory
-    QDir(tempDir).removeRecursively();
-
-    if (!success) {
-        return {false, QObject::tr("Failed to create 3MF archive"), 0};
+    if (settings.value("print_settings_id").isEmpty()) {
+        settings.insert("print_settings_id", m_profileName.toUtf8());
+    }
+    for (const auto& setting : kPrinterSettings) {
+        if (!settings.contains(setting[0])) {
+            settings.insert(setting[0], setting[1]);
+        }
+    }
+    if (!settings.contains("bed_shape")) {
+        const QString width = formatMm(m_bedSize.width());
+        const QString depth = formatMm(m_bedSize.height());
+        settings.insert("bed_shape", QString("0x0,%1x0,%1x%2,0x%2").arg(width, depth).toUtf8());
     }
 
-    QFile file(filePath);
-    qint64 size = file.exists() ? file.size() : 0;
-
-    qInfo() << "Exported 3MF:" << filePath << "(" << size << "bytes)";
-
-    return {true, QString(), size};
-#endif // BUILD_WASM
-}
-
-QString ThreeMfExporter::generateContentTypesXml() {
-    return R"(<?xml version="1.0" encoding="UTF-8"?>
-<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">
-  <Default Extension="rels" ContentType="application/vnd.openxmlformats-package.relationships+xml"/>
-  <Default Extension="model" ContentType="application/vnd.ms-package.3dmanufacturing-3dmodel+xml"/>
-</Types>
-)";
-}
-
-QString ThreeMfExporter::generateRelsXml() {
-    return R"(<?xml version="1.0" encoding="UTF-8"?>
-<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships">
-  <Relationship Target="/3D/3dmodel.model" Id="rel0" Type="http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel"/>
-</Relationships>
-)";
+    QByteArray config = "; generated by LithoMaker\n\n";
+    for (auto it = settings.cbegin(); it != settings.cend(); ++it) {
+        config += "; " + it.key() + " = " + it.value() + "\n";
+    }
+    return config;
 }
 
-QString ThreeMfExporter::generateModelXml(const QList<QVector3D>& mesh) {
-    // Deduplicate vertices
-    QMap<QString, int> vertexMap;
-    QList<QVector3D> uniqueVertices;
-    QList<int> triangleIndices;
-
-    auto getVertexKey = [](const QVector3D& v) {
-        return QString("%1_%2_%3")
-            .arg(static_cast<double>(v.x()), 0, 'f', 6)
-            .arg(static_cast<double>(v.y()), 0, 'f', 6)
-            .arg(static_cast<double>(v.z()), 0, 'f', 6);
-    };
-
-    for (const QVector3D& v : mesh) {
-        QString key = getVertexKey(v);
-        if (!vertexMap.contains(key)) {
-            vertexMap[key] = uniqueVertices.size(); // 3MF is 0-indexed
-            uniqueVertices.append(v);
-        }
-        triangleIndices.append(vertexMap[key]);
+ExportResult ThreeMfExporter::exportMesh(const QList<QVector3D>& mesh, 
+                                          const QString& filePath) {
+    if (mesh.isEmpty()) {
+        return {false, QObject::tr("Empty mesh"), 0};
     }
 
-    QString xml;
-    xml += R"(<?xml version="1.0" encoding="UTF-8"?>
-<model unit="millimeter" xmlns="http://schemas.microsoft.com/3dmanufacturing/core/2015/02">
-  <resources>
-    <object id="1" type="model">
-      <mesh>
-        <vertices>
-)";
-
-    // Vertices
-    for (const QVector3D& v : uniqueVertices) {
-        xml += QString("          <vertex x=\"%1\" y=\"%2\" z=\"%3\"/>\n")
-            .arg(static_cast<double>(v.x()), 0, 'f', 6)
-            .arg(static_cast<double>(v.y()), 0, 'f', 6)
-            .arg(static_cast<double>(v.z()), 0, 'f', 6);
+    if (mesh.size() % 3 != 0) {
+        return {false, QObject::tr("Invalid mesh: vertex count not divisible by 3"), 0};
     }
 
-    xml += "        </vertices>\n        <triangles>\n";
+    ThreeMfWriter writer;
+    if (m_thumbnail) {
+        writer.setThumbnail(ThumbnailRenderer::renderPng(mesh));
+    }
+    if (!m_printProfile.isEmpty()) {
+        writer.setSlicerConfig(slicerConfig());
+    }
 
-    // Triangles
-    for (int i = 0; i < triangleIndices.size(); i += 3) {
-        xml += QString("          <triangle v1=\"%1\" v2=\"%2\" v3=\"%3\"/>\n")
-            .arg(triangleIndices[i])
-            .arg(triangleIndices[i + 1])
-            .arg(triangleIndices[i + 2]);
+    const QMatrix4x4 transform = m_upright ? uprightTransform(mesh, m_bedSize) : QMatrix4x4();
+    ProgressMeter progress(mesh.size() / 3 * 2, m_progressCallback);
+    if (!writer.open(filePath, m_writerBackend) ||
+        !writer.addObject(mesh, QStringLiteral("lithophane"), transform, &progress) ||
+        !writer.close()) {
+        return {false, QObject::tr("Failed to create 3MF archive: ") + writer.errorString(), 0};
     }
+    progress.finish();
 
-    xml += R"(        </triangles>
-      </mesh>
-    </object>
-  </resources>
-  <build>
-    <item objectid="1"/>
-  </build>
-</model>
-)";
-
-    return xml;
+    return {true, QString(), writer.bytesWritten(), writer.stallMs()};
 }
 
 } // namespace LithoMaker
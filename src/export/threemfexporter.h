@@ -10,13 +10,21 @@
 
 #include "exporter.h"
 
+#include <QByteArray>
+#include <QSizeF>
+
 namespace LithoMaker {
 
 /**
  * @brief 3MF mesh exporter
  * 
  * Creates a valid 3MF package (ZIP with XML content)
- * compatible with modern 3D printing slicers.
+ * compatible with modern 3D printing slicers. The archive is written
+ * in-process by ThreeMfWriter, so this also works in the browser build.
+ *
+ * Optionally the package is made a print-ready project: the slicer
+ * profile is embedded, the lithophane is stood upright in the middle of
+ * the bed and a thumbnail is included.
  */
 class ThreeMfExporter : public Exporter {
 public:
@@ -29,10 +37,40 @@ public:
     QString extension() const override { return QStringLiteral("3mf"); }
     QString fileFilter() const override { return QStringLiteral("3MF Files (*.3mf)"); }
 
+    /**
+     * @brief Embed a PrusaSlicer print profile (.ini contents)
+     * @param printProfile Profile as saved by PrusaSlicer; empty disables
+     * @param profileName Name shown in the slicer's print settings
+     *
+     * Printer settings for the Original Prusa i3 MK3, which the bundled
+     * lithophane profile is made for, are added unless the profile sets
+     * them itself.
+     */
+    void setSlicerProfile(const QByteArray& printProfile, const QString& profileName);
+
+    /**
+     * @brief Stand the lithophane on its bottom edge for printing
+     */
+    void setUpright(bool upright) { m_upright = upright; }
+
+    /**
+     * @brief Bed size used to center the object and in the printer settings
+     */
+    void setBedSize(const QSizeF& bedSize) { m_bedSize = bedSize; }
+
+    /**
+     * @brief Include a rendered thumbnail
+     */
+    void setThumbnail(bool thumbnail) { m_thumbnail = thumbnail; }
+
 private:
-    QString generateModelXml(const QList<QVector3D>& mesh);
-    QString generateContentTypesXml();
-    QString generateRelsXml();
+    QByteArray slicerConfig() const;
+
+    QByteArray m_printProfile;
+    QString m_profileName;
+    bool m_upright{false};
+    bool m_thumbnail{false};
+    QSizeF m_bedSize{250.0, 210.0};
 };
 
 } // namespace LithoMaker
@@ -0,0 +1,402 @@
+/**
+ * @file threemfimporter.cpp
+ * @brief 3MF mesh importer implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "threemfimporter.h"
+#include "mappedfile.h"
+#include "textparse.h"
+#include "zipreader.h"
+
+#include <QDebug>
+#include <QMap>
+#include <QObject>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+const QString kDefaultModelPath = QStringLiteral("3D/3dmodel.model");
+
+using Transform = std::array<float, 12>;
+constexpr Transform kIdentity{1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0};
+
+struct MeshObject {
+    QList<QVector3D> vertices;
+    std::vector<qint64> indices;
+};
+
+struct BuildItem {
+    qint64 objectId;
+    Transform transform;
+};
+
+int chunkCount() {
+#ifdef USE_OPENMP
+    return omp_get_max_threads() * 4;
+#else
+    return 1;
+#endif
+}
+
+bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+/**
+ * Find the next start tag named @p tag (without namespace prefix) in
+ * [p, end) and return its '<', or end. Closing tags are skipped.
+ */
+const char* findTag(const char* p, const char* end, std::string_view tag) {
+    while (p < end) {
+        p = static_cast<const char*>(std::memchr(p, '<', end - p));
+        if (!p) {
+            return end;
+        }
+        const char* name = p + 1;
+        // Skip an optional namespace prefix such as "m:"
+        const char* q = name;
+        while (q < end && !isBlank(*q) && *q != '>' && *q != '/' && *q != ':') {
+            ++q;
+        }
+        if (q < end && *q == ':') {
+            name = q + 1;
+        }
+        if (static_cast<size_t>(end - name) > tag.size() &&
+            std::memcmp(name, tag.data(), tag.size()) == 0) {
+            const char next = name[tag.size()];
+            if (isBlank(next) || next == '>' || next == '/') {
+                return p;
+            }
+        }
+        ++p;
+    }
+    return end;
+}
+
+/**
+ * Call @p visit(name, valueBegin, valueEnd) for each attribute of the
+ * tag starting at @p p, and return the position past the tag's '>'.
+ */
+template <typename Visitor>
+const char* visitAttributes(const char* p, const char* end, Visitor visit) {
+    while (p < end && !isBlank(*p) && *p != '>' && *p != '/') {
+        ++p; // Tag name
+    }
+    while (p < end) {
+        while (p < end && isBlank(*p)) {
+            ++p;
+        }
+        if (p >= end || *p == '>' || *p == '/') {
+            break;
+        }
+        const char* name = p;
+        while (p < end && *p != '=' && !isBlank(*p)) {
+            ++p;
+        }
+        const std::string_view attribute(name, p - name);
+        while (p < end && (isBlank(*p) || *p == '=')) {
+            ++p;
+        }
+        if (p >= end || (*p != '"' && *p != '\'')) {
+            return end;
+        }
+        const char quote = *p++;
+        const char* value = p;
+        p = static_cast<const char*>(std::memchr(p, quote, end - p));
+        if (!p) {
+            return end;
+        }
+        visit(attribute, value, p);
+        ++p;
+    }
+    p = static_cast<const char*>(std::memchr(p, '>', end - p));
+    return p ? p + 1 : end;
+}
+
+// Attribute names may carry a namespace prefix too
+std::string_view localName(std::string_view name) {
+    const size_t colon = name.find(':');
+    return colon == std::string_view::npos ? name : name.substr(colon + 1);
+}
+
+/**
+ * Split [begin, end) into ranges that start at a '<', so no tag is cut
+ */
+std::vector<std::pair<const char*, const char*>> splitTags(const char* begin, const char* end) {
+    std::vector<std::pair<const char*, const char*>> ranges;
+    const int parts = chunkCount();
+    const qint64 size = end - begin;
+    const char* start = begin;
+    for (int i = 1; i <= parts && start < end; ++i) {
+        const char* stop = i == parts ? end : std::max(start, begin + size * i / parts);
+        const char* tag = static_cast<const char*>(std::memchr(stop, '<', end - stop));
+        stop = tag ? tag : end;
+        if (stop > start) {
+            ranges.emplace_back(start, stop);
+        }
+        start = stop;
+    }
+    return ranges;
+}
+
+bool parseVertices(const char* begin, const char* end, QList<QVector3D>& vertices) {
+    const auto ranges = splitTags(begin, end);
+    const int chunks = static_cast<int>(ranges.size());
+    std::vector<QList<QVector3D>> parsed(chunks);
+    bool failed = false;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) reduction(||:failed)
+    #endif
+    for (int c = 0; c < chunks; ++c) {
+        const char* chunkEnd = ranges[c].second;
+        parsed[c].reserve((chunkEnd - ranges[c].first) / 48);
+        for (const char* p = findTag(ranges[c].first, chunkEnd, "vertex"); p < chunkEnd;
+             p = findTag(p, chunkEnd, "vertex")) {
+            float xyz[3];
+            int found = 0;
+            p = visitAttributes(p + 1, chunkEnd, [&](std::string_view name, const char* v, const char* e) {
+                name = localName(name);
+                if (name.size() == 1 && name[0] >= 'x' && name[0] <= 'z' &&
+                    TextParse::parseFloat(v, e, xyz[name[0] - 'x'])) {
+                    found |= 1 << (name[0] - 'x');
+                }
+            });
+            if (found != 7) {
+                failed = true;
+                break;
+            }
+            parsed[c].append(QVector3D(xyz[0], xyz[1], xyz[2]));
+        }
+    }
+
+    if (failed) {
+        return false;
+    }
+    for (auto& chunk : parsed) {
+        vertices.append(chunk);
+    }
+    return true;
+}
+
+bool parseTriangles(const char* begin, const char* end, std::vector<qint64>& indices) {
+    const auto ranges = splitTags(begin, end);
+    const int chunks = static_cast<int>(ranges.size());
+    std::vector<std::vector<qint64>> parsed(chunks);
+    bool failed = false;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) reduction(||:failed)
+    #endif
+    for (int c = 0; c < chunks; ++c) {
+        const char* chunkEnd = ranges[c].second;
+        parsed[c].reserve((chunkEnd - ranges[c].first) / 12);
+        for (const char* p = findTag(ranges[c].first, chunkEnd, "triangle"); p < chunkEnd;
+             p = findTag(p, chunkEnd, "triangle")) {
+            qint64 corners[3];
+            int found = 0;
+            p = visitAttributes(p + 1, chunkEnd, [&](std::string_view name, const char* v, const char* e) {
+                name = localName(name);
+                if (name.size() == 2 && name[0] == 'v' && name[1] >= '1' && name[1] <= '3' &&
+                    TextParse::parseInt(v, e, corners[name[1] - '1'])) {
+                    found |= 1 << (name[1] - '1');
+                }
+            });
+            if (found != 7) {
+                failed = true;
+                break;
+            }
+            parsed[c].insert(parsed[c].end(), corners, corners + 3);
+        }
+    }
+
+    if (failed) {
+        return false;
+    }
+    for (const auto& chunk : parsed) {
+        indices.insert(indices.end(), chunk.begin(), chunk.end());
+    }
+    return true;
+}
+
+bool parseTransform(const char* p, const char* end, Transform& transform) {
+    for (float& value : transform) {
+        if (!TextParse::parseFloat(p, end, value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+float unitScale(std::string_view unit) {
+    if (unit == "micron") return 0.001f;
+    if (unit == "centimeter") return 10.0f;
+    if (unit == "inch") return 25.4f;
+    if (unit == "foot") return 304.8f;
+    if (unit == "meter") return 1000.0f;
+    return 1.0f; // millimeter
+}
+
+QString modelPath(ZipReader& zip) {
+    QByteArray rels;
+    if (!zip.read(QStringLiteral("_rels/.rels"), rels)) {
+        return kDefaultModelPath;
+    }
+    // The root model is the relationship whose type ends in "3dmodel"
+    const char* end = rels.constData() + rels.size();
+    for (const char* p = findTag(rels.constData(), end, "Relationship"); p < end;
+         p = findTag(p, end, "Relationship")) {
+        QString target;
+        bool isModel = false;
+        p = visitAttributes(p + 1, end, [&](std::string_view name, const char* v, const char* e) {
+            if (name == "Target") {
+                target = QString::fromUtf8(v, e - v);
+            } else if (name == "Type") {
+                isModel = std::string_view(v, e - v).find("3dmodel") != std::string_view::npos;
+            }
+        });
+        if (isModel && !target.isEmpty()) {
+            return target;
+        }
+    }
+    return kDefaultModelPath;
+}
+
+} // namespace
+
+ImportResult ThreeMfImporter::importMesh(const QString& filePath) {
+    MappedFile file;
+    if (!file.open(filePath)) {
+        return {false, file.errorString(), {}};
+    }
+
+    ZipReader zip(file.data(), file.size());
+    QByteArray model;
+    if (!zip.open() || !zip.read(modelPath(zip), model)) {
+        return {false, zip.errorString(), {}};
+    }
+
+    const char* begin = model.constData();
+    const char* end = begin + model.size();
+
+    float scale = 1.0f;
+    const char* modelTag = findTag(begin, end, "model");
+    if (modelTag < end) {
+        visitAttributes(modelTag + 1, end, [&](std::string_view name, const char* v, const char* e) {
+            if (name == "unit") {
+                scale = unitScale(std::string_view(v, e - v));
+            }
+        });
+    }
+
+    // Objects are few; only their vertex and triangle lists are large
+    // enough to be worth parsing in parallel
+    QMap<qint64, MeshObject> objects;
+    const char* resourcesEnd = findTag(begin, end, "build");
+    for (const char* p = findTag(begin, resourcesEnd, "object"); p < resourcesEnd;) {
+        qint64 id = -1;
+        p = visitAttributes(p + 1, resourcesEnd, [&](std::string_view name, const char* v, const char* e) {
+            if (name == "id") {
+                TextParse::parseInt(v, e, id);
+            }
+        });
+        const char* next = findTag(p, resourcesEnd, "object");
+
+        const char* vertices = findTag(p, next, "vertices");
+        const char* triangles = findTag(p, next, "triangles");
+        if (vertices < next && triangles < next) {
+            MeshObject object;
+            if (!parseVertices(vertices + 1, triangles, object.vertices) ||
+                !parseTriangles(triangles + 1, next, object.indices)) {
+                return {false, QObject::tr("Invalid mesh in 3MF object %1").arg(id), {}};
+            }
+            objects.insert(id, std::move(object));
+        }
+        p = next;
+    }
+
+    std::vector<BuildItem> items;
+    for (const char* p = findTag(resourcesEnd, end, "item"); p < end; p = findTag(p, end, "item")) {
+        BuildItem item{-1, kIdentity};
+        bool validTransform = true;
+        p = visitAttributes(p + 1, end, [&](std::string_view name, const char* v, const char* e) {
+            if (name == "objectid") {
+                TextParse::parseInt(v, e, item.objectId);
+            } else if (name == "transform") {
+                validTransform = parseTransform(v, e, item.transform);
+            }
+        });
+        if (!validTransform) {
+            return {false, QObject::tr("Invalid transform in 3MF build item"), {}};
+        }
+        if (!objects.contains(item.objectId)) {
+            return {false, QObject::tr("3MF build item references an unsupported object"), {}};
+        }
+        items.push_back(item);
+    }
+    if (items.empty()) {
+        // No build section: take the objects where they are
+        for (auto it = objects.cbegin(); it != objects.cend(); ++it) {
+            items.push_back({it.key(), kIdentity});
+        }
+    }
+
+    qint64 total = 0;
+    for (const BuildItem& item : items) {
+        total += static_cast<qint64>(objects.constFind(item.objectId)->indices.size());
+    }
+    if (total == 0) {
+        return {false, QObject::tr("Empty mesh"), {}};
+    }
+
+    QList<QVector3D> mesh(total);
+    QVector3D* out = mesh.data();
+    bool outOfRange = false;
+    for (const BuildItem& item : items) {
+        const MeshObject& object = *objects.constFind(item.objectId);
+        const QVector3D* vertices = object.vertices.constData();
+        const qint64 vertexCount = object.vertices.size();
+        const qint64 count = static_cast<qint64>(object.indices.size());
+        const Transform& m = item.transform;
+
+        // 3MF uses row vectors: p' = p * M, M given as 4 rows of 3 values
+        #ifdef USE_OPENMP
+        #pragma omp parallel for schedule(static) reduction(||:outOfRange)
+        #endif
+        for (qint64 i = 0; i < count; ++i) {
+            const qint64 index = object.indices[i];
+            if (index < 0 || index >= vertexCount) {
+                outOfRange = true;
+                continue;
+            }
+            const QVector3D& v = vertices[index];
+            out[i] = QVector3D(v.x() * m[0] + v.y() * m[3] + v.z() * m[6] + m[9],
+                               v.x() * m[1] + v.y() * m[4] + v.z() * m[7] + m[10],
+                               v.x() * m[2] + v.y() * m[5] + v.z() * m[8] + m[11]) * scale;
+        }
+        out += count;
+    }
+
+    if (outOfRange) {
+        return {false, QObject::tr("Triangle references a missing vertex"), {}};
+    }
+
+    qInfo() << "Imported 3MF:" << items.size() << "items," << total / 3 << "triangles";
+    return {true, QString(), std::move(mesh)};
+}
+
+} // namespace LithoMaker
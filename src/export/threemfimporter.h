@@ -0,0 +1,32 @@
+/**
+ * @file threemfimporter.h
+ * @brief 3MF mesh importer
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "importer.h"
+
+namespace LithoMaker {
+
+/**
+ * @brief 3MF mesh importer
+ *
+ * Reads the mesh objects of the package's root model and places them
+ * as listed in its build section, with units converted to millimeters.
+ * Objects made of components and the materials extension are not
+ * supported.
+ */
+class ThreeMfImporter : public Importer {
+public:
+    ThreeMfImporter() = default;
+
+    ImportResult importMesh(const QString& filePath) override;
+
+    QString name() const override { return QStringLiteral("3MF"); }
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,258 @@
+/**
+ * @file threemfwriter.cpp
+ * @brief Streaming 3MF package writer implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "threemfwriter.h"
+#include "zipwriter.h"
+#include "core/memorystats.h"
+
+#include <QMap>
+#include <QStringList>
+#include <QDebug>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr qsizetype kChunkSize = 1 << 20;
+
+// Tree node and string header of a vertex map entry, roughly
+constexpr qint64 kMapEntryOverhead = 80;
+
+qint64 dedupBytes(qint64 mapBytes, const QList<QVector3D>& vertices, const QList<int>& indices) {
+    return mapBytes + vertices.capacity() * qint64(sizeof(QVector3D)) +
+           indices.capacity() * qint64(sizeof(int));
+}
+
+const char* kContentTypesXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">
+  <Default Extension="rels" ContentType="application/vnd.openxmlformats-package.relationships+xml"/>
+  <Default Extension="model" ContentType="application/vnd.ms-package.3dmanufacturing-3dmodel+xml"/>
+)";
+
+const char* kPngContentType =
+    R"(  <Default Extension="png" ContentType="image/png"/>
+)";
+
+const char* kRelsXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships">
+  <Relationship Target="/3D/3dmodel.model" Id="rel0" Type="http://schemas.microsoft.com/3dmanufacturing/2013/01/3dmodel"/>
+)";
+
+const char* kThumbnailRelationship =
+    R"(  <Relationship Target="/Metadata/thumbnail.png" Id="rel1" Type="http://schemas.openxmlformats.org/package/2006/relationships/metadata/thumbnail"/>
+)";
+
+const char* kModelHeader = R"(<?xml version="1.0" encoding="UTF-8"?>
+<model unit="millimeter" xmlns="http://schemas.microsoft.com/3dmanufacturing/core/2015/02" xmlns:slic3rpe="http://schemas.slic3r.org/3mf/2017/06">
+)";
+
+// Tells PrusaSlicer that Metadata/Slic3r_PE.config belongs to this model
+const char* kSlicerMetadata =
+    R"(  <metadata name="slic3rpe:Version3mf">1</metadata>
+)";
+
+const QString kThumbnailPath = QStringLiteral("Metadata/thumbnail.png");
+const QString kSlicerConfigPath = QStringLiteral("Metadata/Slic3r_PE.config");
+
+// 3MF uses row vectors: p' = p * M, with M given as 4 rows of 3 values
+QString transformString(const QMatrix4x4& matrix) {
+    QStringList values;
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 3; ++row) {
+            values << QString::number(static_cast<double>(matrix(row, column)), 'f', 6);
+        }
+    }
+    return values.join(' ');
+}
+
+} // namespace
+
+ThreeMfWriter::ThreeMfWriter() = default;
+
+ThreeMfWriter::~ThreeMfWriter() = default;
+
+bool ThreeMfWriter::open(const QString& filePath, WriterBackend backend) {
+    m_file = std::make_unique<AsyncFileWriter>(filePath, backend);
+    if (!m_file->open(QIODevice::WriteOnly)) {
+        return fail(QObject::tr("Cannot open file for writing: ") + m_file->errorString());
+    }
+
+    m_zip = std::make_unique<ZipWriter>(m_file.get());
+    m_items.clear();
+    m_nextObjectId = 1;
+
+    QByteArray contentTypes = kContentTypesXml;
+    QByteArray rels = kRelsXml;
+    if (!m_thumbnail.isEmpty()) {
+        contentTypes += kPngContentType;
+        rels += kThumbnailRelationship;
+    }
+    contentTypes += "</Types>\n";
+    rels += "</Relationships>\n";
+
+    if (!writeEntry(QStringLiteral("[Content_Types].xml"), contentTypes) ||
+        !writeEntry(QStringLiteral("_rels/.rels"), rels)) {
+        return false;
+    }
+
+    QByteArray header = kModelHeader;
+    if (!m_slicerConfig.isEmpty()) {
+        header += kSlicerMetadata;
+    }
+    header += "  <resources>\n";
+
+    if (!m_zip->beginEntry(QStringLiteral("3D/3dmodel.model")) ||
+        !m_zip->write(header)) {
+        return fail(m_zip->errorString());
+    }
+    return true;
+}
+
+bool ThreeMfWriter::addObject(const QList<QVector3D>& mesh, const QString& name,
+                              const QMatrix4x4& transform, ProgressMeter* progress) {
+    if (!m_zip) {
+        return fail(QObject::tr("3MF package is not open"));
+    }
+
+    // Deduplicate vertices
+    QMap<QString, int> vertexMap;
+    QList<QVector3D> uniqueVertices;
+    QList<int> triangleIndices;
+    triangleIndices.reserve(mesh.size());
+    qint64 mapBytes = 0;
+    MemoryLease memory(MemorySubsystem::Export, dedupBytes(0, uniqueVertices, triangleIndices));
+
+    auto getVertexKey = [](const QVector3D& v) {
+        return QString("%1_%2_%3")
+            .arg(static_cast<double>(v.x()), 0, 'f', 6)
+            .arg(static_cast<double>(v.y()), 0, 'f', 6)
+            .arg(static_cast<double>(v.z()), 0, 'f', 6);
+    };
+
+    for (const QVector3D& v : mesh) {
+        QString key = getVertexKey(v);
+        if (!vertexMap.contains(key)) {
+            mapBytes += kMapEntryOverhead + key.size() * qint64(sizeof(QChar));
+            vertexMap[key] = uniqueVertices.size(); // 3MF is 0-indexed
+            uniqueVertices.append(v);
+        }
+        triangleIndices.append(vertexMap[key]);
+        if (triangleIndices.size() % (kProgressBatch * 3) == 0) {
+            memory.resize(dedupBytes(mapBytes, uniqueVertices, triangleIndices));
+            if (progress) {
+                progress->add(kProgressBatch);
+            }
+        }
+    }
+    memory.resize(dedupBytes(mapBytes, uniqueVertices, triangleIndices));
+
+    const int objectId = m_nextObjectId++;
+    QByteArray chunk;
+    chunk.reserve(kChunkSize + 256);
+    chunk += QString("    <object id=\"%1\" name=\"%2\" type=\"model\">\n"
+                     "      <mesh>\n"
+                     "        <vertices>\n")
+                 .arg(objectId).arg(name.toHtmlEscaped()).toUtf8();
+
+    for (const QVector3D& v : uniqueVertices) {
+        chunk += QString("          <vertex x=\"%1\" y=\"%2\" z=\"%3\"/>\n")
+            .arg(static_cast<double>(v.x()), 0, 'f', 6)
+            .arg(static_cast<double>(v.y()), 0, 'f', 6)
+            .arg(static_cast<double>(v.z()), 0, 'f', 6)
+            .toLatin1();
+        if (!writeChunk(chunk, false)) return false;
+    }
+
+    chunk += "        </vertices>\n        <triangles>\n";
+
+    for (int i = 0; i < triangleIndices.size(); i += 3) {
+        chunk += QString("          <triangle v1=\"%1\" v2=\"%2\" v3=\"%3\"/>\n")
+            .arg(triangleIndices[i])
+            .arg(triangleIndices[i + 1])
+            .arg(triangleIndices[i + 2])
+            .toLatin1();
+        if (!writeChunk(chunk, false)) return false;
+        if (progress && (i / 3 + 1) % kProgressBatch == 0) {
+            progress->add(kProgressBatch);
+        }
+    }
+
+    chunk += "        </triangles>\n      </mesh>\n    </object>\n";
+    if (!writeChunk(chunk, true)) return false;
+
+    m_items.append({objectId, transform});
+    return true;
+}
+
+bool ThreeMfWriter::close() {
+    if (!m_zip) {
+        return fail(QObject::tr("3MF package is not open"));
+    }
+
+    QByteArray build = "  </resources>\n  <build>\n";
+    for (const BuildItem& item : m_items) {
+        if (item.transform.isIdentity()) {
+            build += QString("    <item objectid=\"%1\"/>\n").arg(item.objectId).toLatin1();
+        } else {
+            build += QString("    <item objectid=\"%1\" transform=\"%2\"/>\n")
+                .arg(item.objectId).arg(transformString(item.transform)).toLatin1();
+        }
+    }
+    build += "  </build>\n</model>\n";
+
+    if (!m_zip->write(build) || !m_zip->endEntry()) {
+        return fail(m_zip->errorString());
+    }
+
+    if ((!m_thumbnail.isEmpty() && !writeEntry(kThumbnailPath, m_thumbnail)) ||
+        (!m_slicerConfig.isEmpty() && !writeEntry(kSlicerConfigPath, m_slicerConfig))) {
+        return false;
+    }
+
+    if (!m_zip->finish()) {
+        return fail(m_zip->errorString());
+    }
+
+    if (!m_file->finish()) {
+        return fail(QObject::tr("Write error: ") + m_file->errorString());
+    }
+    qInfo() << "Exported 3MF:" << m_file->fileName() << "(" << m_zip->bytesWritten()
+            << "bytes," << m_items.size() << "objects)";
+    return true;
+}
+
+qint64 ThreeMfWriter::bytesWritten() const {
+    return m_zip ? m_zip->bytesWritten() : 0;
+}
+
+bool ThreeMfWriter::writeEntry(const QString& name, const QByteArray& data) {
+    if (!m_zip->beginEntry(name) || !m_zip->write(data) || !m_zip->endEntry()) {
+        return fail(m_zip->errorString());
+    }
+    return true;
+}
+
+bool ThreeMfWriter::writeChunk(QByteArray& buffer, bool force) {
+    if (buffer.size() < kChunkSize && !force) {
+        return true;
+    }
+    if (!m_zip->write(buffer)) {
+        return fail(m_zip->errorString());
+    }
+    buffer.resize(0); // Keep capacity for the next chunk
+    return true;
+}
+
+bool ThreeMfWriter::fail(const QString& message) {
+    if (m_error.isEmpty()) {
+        m_error = message;
+    }
+    return false;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,107 @@
+/**
+ * @file threemfwriter.h
+ * @brief Streaming 3MF package writer
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "asyncfilewriter.h"
+#include "core/progress.h"
+
+#include <QList>
+#include <QMatrix4x4>
+#include <QString>
+#include <QVector3D>
+#include <memory>
+
+namespace LithoMaker {
+
+class ZipWriter;
+
+/**
+ * @brief Writes a 3MF package object by object
+ *
+ * The model part is streamed into the archive as each object is added,
+ * so only the mesh currently being written has to be in memory. Build
+ * items (one per object, with its placement transform) are written
+ * when the package is closed.
+ */
+class ThreeMfWriter {
+public:
+    ThreeMfWriter();
+    ~ThreeMfWriter();
+
+    /**
+     * @brief Embed a PNG thumbnail shown by file browsers and slicers
+     *
+     * Must be called before open().
+     */
+    void setThumbnail(const QByteArray& png) { m_thumbnail = png; }
+
+    /**
+     * @brief Embed a PrusaSlicer configuration ("; key = value" lines)
+     *
+     * PrusaSlicer loads it with the project, so the package can be
+     * sliced without choosing profiles. Must be called before open().
+     */
+    void setSlicerConfig(const QByteArray& config) { m_slicerConfig = config; }
+
+    /**
+     * @brief Create the package and start the model part
+     * @param filePath Output file path
+     * @param backend How the package is written to disk
+     */
+    bool open(const QString& filePath, WriterBackend backend = WriterBackend::Auto);
+
+    /**
+     * @brief Append a mesh object and its build item
+     * @param mesh List of vertices (triangles, 3 per triangle)
+     * @param name Object name shown in slicers
+     * @param transform Placement of the object on the build plate
+     * @param progress Optional meter, advanced by twice the triangle
+     *        count (deduplication and triangle passes)
+     */
+    bool addObject(const QList<QVector3D>& mesh, const QString& name,
+                   const QMatrix4x4& transform = QMatrix4x4(),
+                   ProgressMeter* progress = nullptr);
+
+    /**
+     * @brief Write the build section and finish the archive
+     */
+    bool close();
+
+    /**
+     * @brief Bytes written to the package so far
+     */
+    qint64 bytesWritten() const;
+
+    /**
+     * @brief Time spent waiting for the disk so far
+     */
+    qint64 stallMs() const { return m_file ? m_file->stallMs() : 0; }
+
+    QString errorString() const { return m_error; }
+
+private:
+    struct BuildItem {
+        int objectId;
+        QMatrix4x4 transform;
+    };
+
+    bool writeEntry(const QString& name, const QByteArray& data);
+    bool writeChunk(QByteArray& buffer, bool force);
+    bool fail(const QString& message);
+
+    std::unique_ptr<AsyncFileWriter> m_file;
+    std::unique_ptr<ZipWriter> m_zip;
+    QByteArray m_thumbnail;
+    QByteArray m_slicerConfig;
+    QList<BuildItem> m_items;
+    int m_nextObjectId{1};
+    QString m_error;
+};
+
+} // namespace LithoMaker
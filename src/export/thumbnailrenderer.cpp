@@ -0,0 +1,120 @@
+/**
+ * @file thumbnailrenderer.cpp
+ * @brief Software rendering of mesh thumbnails implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "thumbnailrenderer.h"
+#include "mesh/meshgenerator.h"
+
+#include <QBuffer>
+#include <QColor>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+// Light from the upper left, towards the viewer
+const QVector3D kLightDirection = QVector3D(-0.4f, 0.5f, 0.75f).normalized();
+constexpr float kAmbient = 0.25f;
+constexpr int kMargin = 4;
+const QColor kBaseColor(230, 226, 216);
+
+} // namespace
+
+QImage ThumbnailRenderer::render(const QList<QVector3D>& mesh, int size) {
+    QImage image(size, size, QImage::Format_ARGB32);
+    image.fill(Qt::transparent);
+    if (mesh.size() < 3 || size <= 2 * kMargin) {
+        return image;
+    }
+
+    const MeshBounds bounds = computeBounds(mesh);
+    const QVector3D& min = bounds.min;
+    const QVector3D& max = bounds.max;
+
+    // Fit the larger side into the image, keeping the aspect ratio
+    const float extent = std::max(max.x() - min.x(), max.y() - min.y());
+    if (extent <= 0.0f) {
+        return image;
+    }
+    const float scale = (size - 2 * kMargin) / extent;
+    const float offsetX = (size - (max.x() - min.x()) * scale) * 0.5f;
+    const float offsetY = (size - (max.y() - min.y()) * scale) * 0.5f;
+
+    std::vector<float> depth(static_cast<size_t>(size) * size, -std::numeric_limits<float>::max());
+
+    for (qsizetype i = 0; i + 2 < mesh.size(); i += 3) {
+        QVector3D normal = QVector3D::crossProduct(mesh[i + 1] - mesh[i], mesh[i + 2] - mesh[i]);
+        if (normal.isNull()) {
+            continue;
+        }
+        normal.normalize();
+        if (normal.z() < 0.0f) {
+            normal = -normal; // Light both sides, the depth test picks the visible one
+        }
+        const float shade = kAmbient + (1.0f - kAmbient) *
+            std::max(0.0f, QVector3D::dotProduct(normal, kLightDirection));
+        const QRgb color = qRgb(static_cast<int>(kBaseColor.red() * shade),
+                                static_cast<int>(kBaseColor.green() * shade),
+                                static_cast<int>(kBaseColor.blue() * shade));
+
+        // Screen space, with Y pointing down
+        float sx[3], sy[3], sz[3];
+        for (int k = 0; k < 3; ++k) {
+            const QVector3D& v = mesh[i + k];
+            sx[k] = offsetX + (v.x() - min.x()) * scale;
+            sy[k] = size - (offsetY + (v.y() - min.y()) * scale);
+            sz[k] = v.z();
+        }
+
+        const float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+        if (std::abs(area) < 1e-12f) {
+            continue; // Edge-on, invisible from the front
+        }
+
+        const int x0 = std::max(0, static_cast<int>(std::floor(std::min({sx[0], sx[1], sx[2]}))));
+        const int x1 = std::min(size - 1, static_cast<int>(std::ceil(std::max({sx[0], sx[1], sx[2]}))));
+        const int y0 = std::max(0, static_cast<int>(std::floor(std::min({sy[0], sy[1], sy[2]}))));
+        const int y1 = std::min(size - 1, static_cast<int>(std::ceil(std::max({sy[0], sy[1], sy[2]}))));
+
+        for (int y = y0; y <= y1; ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            const float py = y + 0.5f;
+            for (int x = x0; x <= x1; ++x) {
+                const float px = x + 0.5f;
+                const float w0 = ((sx[1] - px) * (sy[2] - py) - (sx[2] - px) * (sy[1] - py)) / area;
+                const float w1 = ((sx[2] - px) * (sy[0] - py) - (sx[0] - px) * (sy[2] - py)) / area;
+                const float w2 = 1.0f - w0 - w1;
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                    continue;
+                }
+                const float z = w0 * sz[0] + w1 * sz[1] + w2 * sz[2];
+                float& stored = depth[static_cast<size_t>(y) * size + x];
+                if (z > stored) {
+                    stored = z;
+                    line[x] = color;
+                }
+            }
+        }
+    }
+
+    return image;
+}
+
+QByteArray ThumbnailRenderer::renderPng(const QList<QVector3D>& mesh, int size) {
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    render(mesh, size).save(&buffer, "PNG");
+    return png;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,41 @@
+/**
+ * @file thumbnailrenderer.h
+ * @brief Software rendering of mesh thumbnails
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QImage>
+#include <QList>
+#include <QVector3D>
+
+namespace LithoMaker {
+
+/**
+ * @brief Renders a shaded thumbnail of a mesh without OpenGL
+ *
+ * The mesh is viewed face-on from +Z with an orthographic projection,
+ * which for a lithophane shows the relief. Rendering happens on the
+ * CPU, so thumbnails can be made during export on any platform,
+ * including the browser build.
+ */
+class ThumbnailRenderer {
+public:
+    /**
+     * @brief Render a square thumbnail with a transparent background
+     * @param mesh List of vertices (triangles, 3 per triangle)
+     * @param size Width and height in pixels
+     */
+    static QImage render(const QList<QVector3D>& mesh, int size = 256);
+
+    /**
+     * @brief Render a thumbnail and encode it as PNG
+     */
+    static QByteArray renderPng(const QList<QVector3D>& mesh, int size = 256);
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,191 @@
+/**
+ * @file zipreader.cpp
+ * @brief Minimal ZIP archive reader implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "zipreader.h"
+
+#include <QObject>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr quint32 kLocalHeaderSignature = 0x04034b50;
+constexpr quint32 kCentralHeaderSignature = 0x02014b50;
+constexpr quint32 kEndOfCentralDirSignature = 0x06054b50;
+constexpr qint64 kLocalHeaderSize = 30;
+constexpr qint64 kCentralHeaderSize = 46;
+constexpr qint64 kEndOfCentralDirSize = 22;
+constexpr quint16 kMethodStored = 0;
+constexpr quint16 kMethodDeflated = 8;
+
+// Deflate expands data at most about 1032 times; a larger declared size
+// comes from a corrupt or crafted header
+constexpr qint64 kMaxDeflateRatio = 1032;
+constexpr qint64 kInitialInflateBytes = 64 * 1024;
+
+quint16 get16(const char* p) {
+    const auto* u = reinterpret_cast<const quint8*>(p);
+    return static_cast<quint16>(u[0] | (u[1] << 8));
+}
+
+quint32 get32(const char* p) {
+    return get16(p) | (static_cast<quint32>(get16(p + 2)) << 16);
+}
+
+} // namespace
+
+ZipReader::ZipReader(const char* data, qint64 size)
+    : m_data(data), m_size(size) {
+}
+
+bool ZipReader::open() {
+    m_entries.clear();
+
+    // The end record sits before an optional comment of up to 64 KB
+    const qint64 searchStart = std::max<qint64>(0, m_size - kEndOfCentralDirSize - 0xFFFF);
+    qint64 eocd = -1;
+    for (qint64 pos = m_size - kEndOfCentralDirSize; pos >= searchStart; --pos) {
+        if (get32(m_data + pos) == kEndOfCentralDirSignature) {
+            eocd = pos;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        return fail(QObject::tr("Not a ZIP archive"));
+    }
+
+    const quint16 count = get16(m_data + eocd + 10);
+    const qint64 directoryOffset = get32(m_data + eocd + 16);
+    if (count == 0xFFFF || directoryOffset == 0xFFFFFFFF) {
+        return fail(QObject::tr("ZIP64 archives are not supported"));
+    }
+
+    qint64 pos = directoryOffset;
+    for (quint16 i = 0; i < count; ++i) {
+        if (pos + kCentralHeaderSize > m_size || get32(m_data + pos) != kCentralHeaderSignature) {
+            return fail(QObject::tr("Corrupt ZIP central directory"));
+        }
+        const quint16 nameLength = get16(m_data + pos + 28);
+        const quint16 extraLength = get16(m_data + pos + 30);
+        const quint16 commentLength = get16(m_data + pos + 32);
+        if (pos + kCentralHeaderSize + nameLength > m_size) {
+            return fail(QObject::tr("Corrupt ZIP central directory"));
+        }
+
+        Entry entry;
+        entry.method = get16(m_data + pos + 10);
+        entry.compressedSize = get32(m_data + pos + 20);
+        entry.size = get32(m_data + pos + 24);
+        entry.offset = get32(m_data + pos + 42);
+        entry.name = QString::fromUtf8(m_data + pos + kCentralHeaderSize, nameLength);
+        m_entries.append(entry);
+
+        pos += kCentralHeaderSize + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+const ZipReader::Entry* ZipReader::find(const QString& name) const {
+    // Package paths may or may not carry a leading slash
+    const QString path = name.startsWith('/') ? name.mid(1) : name;
+    for (const Entry& entry : m_entries) {
+        if (entry.name.compare(path, Qt::CaseInsensitive) == 0) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool ZipReader::contains(const QString& name) const {
+    return find(name) != nullptr;
+}
+
+bool ZipReader::read(const QString& name, QByteArray& out) {
+    const Entry* entry = find(name);
+    if (!entry) {
+        return fail(QObject::tr("Missing archive entry: ") + name);
+    }
+
+    const qint64 header = entry->offset;
+    if (header + kLocalHeaderSize > m_size || get32(m_data + header) != kLocalHeaderSignature) {
+        return fail(QObject::tr("Corrupt ZIP entry: ") + name);
+    }
+    const qint64 start = header + kLocalHeaderSize + get16(m_data + header + 26) +
+                         get16(m_data + header + 28);
+    if (start + entry->compressedSize > m_size) {
+        return fail(QObject::tr("Truncated ZIP entry: ") + name);
+    }
+    const char* compressed = m_data + start;
+
+    if (entry->method == kMethodStored) {
+        if (entry->size != entry->compressedSize || start + entry->size > m_size) {
+            return fail(QObject::tr("Corrupt ZIP entry: ") + name);
+        }
+        out = QByteArray::fromRawData(compressed, entry->size);
+        return true;
+    }
+
+    if (entry->method != kMethodDeflated) {
+        return fail(QObject::tr("Unsupported ZIP compression method in entry: ") + name);
+    }
+
+#ifdef HAVE_ZLIB
+    const qint64 declared = entry->size;
+    if (declared > qint64(entry->compressedSize) * kMaxDeflateRatio + kInitialInflateBytes) {
+        return fail(QObject::tr("Corrupt ZIP entry: ") + name);
+    }
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return fail(QObject::tr("Cannot initialize decompression"));
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed));
+    stream.avail_in = entry->compressedSize;
+
+    // The buffer grows with the inflated data, so a declared size alone
+    // cannot force a large allocation
+    out.resize(std::min(declared, qint64(entry->compressedSize) * 4 + kInitialInflateBytes));
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (qint64(stream.total_out) == out.size()) {
+            if (out.size() >= declared) {
+                break; // More data than declared
+            }
+            out.resize(std::min(declared, qint64(out.size()) * 2));
+        }
+        stream.next_out = reinterpret_cast<Bytef*>(out.data() + stream.total_out);
+        stream.avail_out = uInt(out.size() - qint64(stream.total_out));
+        status = inflate(&stream, Z_NO_FLUSH);
+        if (status == Z_OK && stream.avail_in == 0 && stream.avail_out > 0) {
+            break; // Truncated stream
+        }
+    }
+    const qint64 produced = qint64(stream.total_out);
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END || produced != declared) {
+        out.clear();
+        return fail(QObject::tr("Cannot decompress ZIP entry: ") + name);
+    }
+    return true;
+#else
+    return fail(QObject::tr("Compressed ZIP entries need zlib support"));
+#endif
+}
+
+bool ZipReader::fail(const QString& message) {
+    m_error = message;
+    return false;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,65 @@
+/**
+ * @file zipreader.h
+ * @brief Minimal ZIP archive reader over an in-memory buffer
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+namespace LithoMaker {
+
+/**
+ * @brief Random access ZIP reader (stored and deflated entries)
+ *
+ * Works on a buffer that stays valid for the reader's lifetime, such as
+ * a MappedFile. Stored entries are returned without copying. Deflated
+ * entries need zlib. Archives are limited to 4 GB (no ZIP64).
+ */
+class ZipReader {
+public:
+    ZipReader(const char* data, qint64 size);
+
+    /**
+     * @brief Read the central directory
+     */
+    bool open();
+
+    /**
+     * @brief Check whether an entry exists
+     */
+    bool contains(const QString& name) const;
+
+    /**
+     * @brief Get an entry's uncompressed contents
+     * @param name Path of the entry inside the archive
+     * @param out Entry data; a non-owning view for stored entries
+     */
+    bool read(const QString& name, QByteArray& out);
+
+    QString errorString() const { return m_error; }
+
+private:
+    struct Entry {
+        QString name;
+        quint16 method{0};
+        quint32 compressedSize{0};
+        quint32 size{0};
+        quint32 offset{0};
+    };
+
+    const Entry* find(const QString& name) const;
+    bool fail(const QString& message);
+
+    const char* m_data;
+    qint64 m_size;
+    QList<Entry> m_entries;
+    QString m_error;
+};
+
+} // namespace LithoMaker
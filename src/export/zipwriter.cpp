@@ -0,0 +1,352 @@
+/**
+ * @file zipwriter.cpp
+ * @brief Minimal streaming ZIP archive writer implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "zipwriter.h"
+
+#include <QIODevice>
+#include <QDateTime>
+#include <QObject>
+
+#include <algorithm>
+#include <array>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr quint32 kLocalHeaderSignature = 0x04034b50;
+constexpr quint32 kDataDescriptorSignature = 0x08074b50;
+constexpr quint32 kCentralHeaderSignature = 0x02014b50;
+constexpr quint32 kEndOfCentralDirSignature = 0x06054b50;
+constexpr quint32 kZip64EndOfCentralDirSignature = 0x06064b50;
+constexpr quint32 kZip64LocatorSignature = 0x07064b50;
+constexpr quint16 kZip64ExtraId = 0x0001;
+constexpr quint16 kVersionNeeded = 20;
+constexpr quint16 kVersionZip64 = 45;
+constexpr quint16 kFlagDataDescriptor = 0x0008;
+constexpr quint16 kFlagUtf8 = 0x0800;
+constexpr quint32 kZip64Marker = 0xFFFFFFFFu; // Real value is in the ZIP64 record
+constexpr quint16 kZip64CountMarker = 0xFFFF;
+#ifdef HAVE_ZLIB
+constexpr quint16 kMethod = 8; // Deflate
+constexpr int kDeflateLevel = 6;
+constexpr qsizetype kDeflateChunk = 64 * 1024;
+constexpr qint64 kMaxDeflateInput = 1 << 30; // avail_in is 32-bit
+#else
+constexpr quint16 kMethod = 0; // Stored
+#endif
+
+const std::array<quint32, 256>& crcTable() {
+    static const std::array<quint32, 256> table = [] {
+        std::array<quint32, 256> t{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+    return table;
+}
+
+quint32 updateCrc(quint32 crc, const char* data, qint64 size) {
+    const auto& table = crcTable();
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+void put16(QByteArray& out, quint16 value) {
+    out.append(static_cast<char>(value & 0xFF));
+    out.append(static_cast<char>((value >> 8) & 0xFF));
+}
+
+void put32(QByteArray& out, quint32 value) {
+    put16(out, static_cast<quint16>(value & 0xFFFF));
+    put16(out, static_cast<quint16>(value >> 16));
+}
+
+void put64(QByteArray& out, quint64 value) {
+    put32(out, static_cast<quint32>(value & 0xFFFFFFFF));
+    put32(out, static_cast<quint32>(value >> 32));
+}
+
+bool needsZip64(quint64 value) {
+    return value >= kZip64Marker;
+}
+
+// 32-bit field, or the marker when the value goes in a ZIP64 record
+quint32 field32(quint64 value) {
+    return needsZip64(value) ? kZip64Marker : static_cast<quint32>(value);
+}
+
+} // namespace
+
+/**
+ * @brief Deflate stream, reused for every entry
+ */
+struct ZipWriter::Deflater {
+#ifdef HAVE_ZLIB
+    z_stream stream{};
+    bool initialized{false};
+    QByteArray buffer;
+#endif
+};
+
+ZipWriter::ZipWriter(QIODevice* device)
+    : m_device(device)
+    , m_deflater(std::make_unique<Deflater>())
+{
+    const QDateTime now = QDateTime::currentDateTime();
+    const QDate date = now.date();
+    const QTime time = now.time();
+    m_dosTime = static_cast<quint16>((time.hour() << 11) | (time.minute() << 5) | (time.second() / 2));
+    m_dosDate = static_cast<quint16>(((qMax(date.year(), 1980) - 1980) << 9) |
+                                     (date.month() << 5) | date.day());
+}
+
+ZipWriter::~ZipWriter() {
+#ifdef HAVE_ZLIB
+    if (m_deflater->initialized) {
+        deflateEnd(&m_deflater->stream);
+    }
+#endif
+}
+
+bool ZipWriter::beginEntry(const QString& name) {
+    if (m_finished) {
+        return fail(QObject::tr("Archive already finished"));
+    }
+    if (m_entryOpen && !endEntry()) {
+        return false;
+    }
+
+#ifdef HAVE_ZLIB
+    Deflater& deflater = *m_deflater;
+    if (!deflater.initialized) {
+        // Raw deflate, ZIP has its own headers
+        if (deflateInit2(&deflater.stream, kDeflateLevel, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return fail(QObject::tr("Cannot initialize compression"));
+        }
+        deflater.initialized = true;
+        deflater.buffer.resize(kDeflateChunk);
+    } else if (deflateReset(&deflater.stream) != Z_OK) {
+        return fail(QObject::tr("Cannot initialize compression"));
+    }
+#endif
+
+    Entry entry;
+    entry.name = name.toUtf8();
+    entry.offset = m_offset;
+
+    QByteArray header;
+    header.reserve(30 + entry.name.size());
+    put32(header, kLocalHeaderSignature);
+    put16(header, kVersionNeeded);
+    put16(header, kFlagDataDescriptor | kFlagUtf8);
+    put16(header, kMethod);
+    put16(header, m_dosTime);
+    put16(header, m_dosDate);
+    put32(header, 0); // CRC, sizes: in data descriptor
+    put32(header, 0);
+    put32(header, 0);
+    put16(header, static_cast<quint16>(entry.name.size()));
+    put16(header, 0); // Extra field length
+    header.append(entry.name);
+
+    m_entries.append(entry);
+    m_entryOpen = true;
+    return writeRaw(header.constData(), header.size());
+}
+
+bool ZipWriter::write(const char* data, qint64 size) {
+    if (!m_entryOpen) {
+        return fail(QObject::tr("No open archive entry"));
+    }
+    Entry& entry = m_entries.last();
+    entry.crc = updateCrc(entry.crc, data, size);
+    entry.size += static_cast<quint64>(size);
+    return writeData(data, size, false);
+}
+
+bool ZipWriter::endEntry() {
+    if (!m_entryOpen) {
+        return true;
+    }
+    m_entryOpen = false;
+    if (!writeData(nullptr, 0, true)) {
+        return false;
+    }
+
+    // Sizes are 64-bit in the descriptor of entries that need ZIP64
+    const Entry& entry = m_entries.last();
+    QByteArray descriptor;
+    put32(descriptor, kDataDescriptorSignature);
+    put32(descriptor, entry.crc);
+    if (needsZip64(entry.size) || needsZip64(entry.compressedSize)) {
+        put64(descriptor, entry.compressedSize);
+        put64(descriptor, entry.size);
+    } else {
+        put32(descriptor, static_cast<quint32>(entry.compressedSize));
+        put32(descriptor, static_cast<quint32>(entry.size));
+    }
+    return writeRaw(descriptor.constData(), descriptor.size());
+}
+
+bool ZipWriter::finish() {
+    if (m_finished) {
+        return true;
+    }
+    if (!endEntry()) {
+        return false;
+    }
+
+    const quint64 directoryOffset = m_offset;
+    QByteArray directory;
+    for (const Entry& entry : m_entries) {
+        // Values that do not fit go in a ZIP64 extra field, in this order
+        QByteArray extra;
+        if (needsZip64(entry.size)) {
+            put64(extra, entry.size);
+        }
+        if (needsZip64(entry.compressedSize)) {
+            put64(extra, entry.compressedSize);
+        }
+        if (needsZip64(entry.offset)) {
+            put64(extra, entry.offset);
+        }
+        if (!extra.isEmpty()) {
+            QByteArray field;
+            put16(field, kZip64ExtraId);
+            put16(field, static_cast<quint16>(extra.size()));
+            extra.prepend(field);
+        }
+        const quint16 version = extra.isEmpty() ? kVersionNeeded : kVersionZip64;
+
+        put32(directory, kCentralHeaderSignature);
+        put16(directory, version); // Version made by
+        put16(directory, version);
+        put16(directory, kFlagDataDescriptor | kFlagUtf8);
+        put16(directory, kMethod);
+        put16(directory, m_dosTime);
+        put16(directory, m_dosDate);
+        put32(directory, entry.crc);
+        put32(directory, field32(entry.compressedSize));
+        put32(directory, field32(entry.size));
+        put16(directory, static_cast<quint16>(entry.name.size()));
+        put16(directory, static_cast<quint16>(extra.size()));
+        put16(directory, 0); // Comment length
+        put16(directory, 0); // Disk number
+        put16(directory, 0); // Internal attributes
+        put32(directory, 0); // External attributes
+        put32(directory, field32(entry.offset));
+        directory.append(entry.name);
+        directory.append(extra);
+    }
+
+    const quint64 directorySize = static_cast<quint64>(directory.size());
+    const quint64 entryCount = static_cast<quint64>(m_entries.size());
+    if (entryCount >= kZip64CountMarker || needsZip64(directorySize) || needsZip64(directoryOffset)) {
+        const quint64 recordOffset = directoryOffset + directorySize;
+        put32(directory, kZip64EndOfCentralDirSignature);
+        put64(directory, 44); // Size of the rest of the record
+        put16(directory, kVersionZip64); // Version made by
+        put16(directory, kVersionZip64);
+        put32(directory, 0); // This disk
+        put32(directory, 0); // Disk with central directory
+        put64(directory, entryCount);
+        put64(directory, entryCount);
+        put64(directory, directorySize);
+        put64(directory, directoryOffset);
+
+        put32(directory, kZip64LocatorSignature);
+        put32(directory, 0); // Disk with the ZIP64 record
+        put64(directory, recordOffset);
+        put32(directory, 1); // Total disks
+    }
+
+    const quint16 count = static_cast<quint16>(std::min<quint64>(entryCount, kZip64CountMarker));
+    put32(directory, kEndOfCentralDirSignature);
+    put16(directory, 0); // This disk
+    put16(directory, 0); // Disk with central directory
+    put16(directory, count);
+    put16(directory, count);
+    put32(directory, field32(directorySize));
+    put32(directory, field32(directoryOffset));
+    put16(directory, 0); // Comment length
+
+    m_finished = true;
+    return writeRaw(directory.constData(), directory.size());
+}
+
+bool ZipWriter::writeData(const char* data, qint64 size, bool finish) {
+    Entry& entry = m_entries.last();
+#ifdef HAVE_ZLIB
+    z_stream& stream = m_deflater->stream;
+    QByteArray& buffer = m_deflater->buffer;
+    qint64 remaining = size;
+    while (true) {
+        const qint64 piece = std::min(remaining, kMaxDeflateInput);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        stream.avail_in = static_cast<uInt>(piece);
+        data += piece;
+        remaining -= piece;
+
+        // Drain the output until deflate has room to spare
+        const int flush = finish && remaining == 0 ? Z_FINISH : Z_NO_FLUSH;
+        do {
+            stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+            stream.avail_out = static_cast<uInt>(buffer.size());
+            if (deflate(&stream, flush) == Z_STREAM_ERROR) {
+                return fail(QObject::tr("Compression failed"));
+            }
+            const qint64 produced = buffer.size() - static_cast<qint64>(stream.avail_out);
+            entry.compressedSize += static_cast<quint64>(produced);
+            if (!writeRaw(buffer.constData(), produced)) {
+                return false;
+            }
+        } while (stream.avail_out == 0);
+
+        if (remaining == 0) {
+            return true;
+        }
+    }
+#else
+    Q_UNUSED(finish);
+    entry.compressedSize += static_cast<quint64>(size);
+    return writeRaw(data, size);
+#endif
+}
+
+bool ZipWriter::writeRaw(const char* data, qint64 size) {
+    if (!m_error.isEmpty()) {
+        return false;
+    }
+    if (m_device->write(data, size) != size) {
+        return fail(QObject::tr("Write failed: ") + m_device->errorString());
+    }
+    m_offset += static_cast<quint64>(size);
+    return true;
+}
+
+bool ZipWriter::fail(const QString& message) {
+    if (m_error.isEmpty()) {
+        m_error = message;
+    }
+    return false;
+}
+
+} // namespace LithoMaker
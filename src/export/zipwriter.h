@@ -0,0 +1,94 @@
+/**
+ * @file zipwriter.h
+ * @brief Minimal streaming ZIP archive writer
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+class QIODevice;
+
+namespace LithoMaker {
+
+/**
+ * @brief Sequential ZIP writer (deflated entries with data descriptors)
+ *
+ * Entry data is compressed and streamed straight to the device as it is
+ * produced, so neither the entry nor the archive has to be held in
+ * memory and the device never needs to seek. Entries are stored when
+ * built without zlib. ZIP64 records are added only where sizes, offsets
+ * or the entry count need them.
+ */
+class ZipWriter {
+public:
+    /**
+     * @brief Create a writer on an already opened device
+     * @param device Output device, must stay valid until finish()
+     */
+    explicit ZipWriter(QIODevice* device);
+    ~ZipWriter();
+
+    /**
+     * @brief Start a new entry, closing the previous one if needed
+     * @param name Path of the entry inside the archive
+     */
+    bool beginEntry(const QString& name);
+
+    /**
+     * @brief Append data to the current entry
+     */
+    bool write(const char* data, qint64 size);
+    bool write(const QByteArray& data) { return write(data.constData(), data.size()); }
+
+    /**
+     * @brief Finish the current entry (writes its data descriptor)
+     */
+    bool endEntry();
+
+    /**
+     * @brief Write the central directory; no entries can follow
+     */
+    bool finish();
+
+    /**
+     * @brief Total bytes written to the device so far
+     */
+    qint64 bytesWritten() const { return m_offset; }
+
+    QString errorString() const { return m_error; }
+
+private:
+    struct Entry {
+        QByteArray name;
+        quint32 crc{0};
+        quint64 size{0};
+        quint64 compressedSize{0};
+        quint64 offset{0};
+    };
+
+    struct Deflater;
+
+    bool writeData(const char* data, qint64 size, bool finish);
+    bool writeRaw(const char* data, qint64 size);
+    bool fail(const QString& message);
+
+    QIODevice* m_device;
+    std::unique_ptr<Deflater> m_deflater;
+    QList<Entry> m_entries;
+    bool m_entryOpen{false};
+    bool m_finished{false};
+    quint64 m_offset{0};
+    quint16 m_dosTime{0};
+    quint16 m_dosDate{0};
+    QString m_error;
+};
+
+} // namespace LithoMaker
@@ -17,6 +17,10 @@
 #include "ui/mainwindow.h"
 #include "version.h"
 
+#ifndef BUILD_WASM
+#include "batch/batchcommand.h"
+#endif
+
 /**
  * @brief Apply dark theme palette to the application
  */
@@ -41,6 +45,17 @@ void applyDarkTheme(QApplication& app) {
 }
 
 int main(int argc, char* argv[]) {
+#ifndef BUILD_WASM
+    // Batch conversion needs no display, so no QApplication
+    if (LithoMaker::isBatchCommand(argc, argv)) {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("LithoMaker");
+        app.setOrganizationName("LithoMaker");
+        app.setApplicationVersion(LITHOMAKER_VERSION);
+        return LithoMaker::runBatchCommand(app.arguments());
+    }
+#endif
+
     QApplication app(argc, argv);
     
     // Set application metadata
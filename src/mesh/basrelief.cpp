@@ -0,0 +1,344 @@
+/**
+ * @file basrelief.cpp
+ * @brief Bas-relief depth mapping with a parallel multigrid V-cycle solver
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "basrelief.h"
+#include "core/memorystats.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+namespace LithoMaker {
+
+namespace {
+
+// Solver grids are accounted with the depth buffers
+using Grid = TrackedVector<float, MemorySubsystem::DepthBuffer>;
+
+/**
+ * @brief One level of the multigrid hierarchy
+ *
+ * Solves L u = f where L is the 5-point Laplacian with Neumann
+ * boundaries (only in-bounds neighbours contribute).
+ */
+struct Level {
+    int width{0};
+    int height{0};
+    Grid u; ///< Solution / correction
+    Grid f; ///< Right-hand side
+    Grid r; ///< Residual
+
+    Level(int w, int h)
+        : width(w), height(h)
+        , u(static_cast<size_t>(w) * h, 0.0f)
+        , f(static_cast<size_t>(w) * h, 0.0f)
+        , r(static_cast<size_t>(w) * h, 0.0f)
+    {
+    }
+};
+
+// Red-black Gauss-Seidel sweeps, each colour updated in parallel
+void smooth(Level& level, int sweeps) {
+    const int w = level.width;
+    const int h = level.height;
+    float* u = level.u.data();
+    const float* f = level.f.data();
+
+    for (int sweep = 0; sweep < sweeps; ++sweep) {
+        for (int colour = 0; colour < 2; ++colour) {
+            #ifdef USE_OPENMP
+            #pragma omp parallel for schedule(static) if (w * h > 16384)
+            #endif
+            for (int y = 0; y < h; ++y) {
+                float* row = u + static_cast<size_t>(y) * w;
+                const float* up = y > 0 ? row - w : nullptr;
+                const float* down = y < h - 1 ? row + w : nullptr;
+                const float* rhs = f + static_cast<size_t>(y) * w;
+                for (int x = (y + colour) & 1; x < w; x += 2) {
+                    float sum = 0.0f;
+                    int count = 0;
+                    if (x > 0) { sum += row[x - 1]; ++count; }
+                    if (x < w - 1) { sum += row[x + 1]; ++count; }
+                    if (up) { sum += up[x]; ++count; }
+                    if (down) { sum += down[x]; ++count; }
+                    if (count > 0) {
+                        row[x] = (sum - rhs[x]) / static_cast<float>(count);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// r = f - L u, returns the squared residual norm
+double computeResidual(Level& level) {
+    const int w = level.width;
+    const int h = level.height;
+    const float* u = level.u.data();
+    const float* f = level.f.data();
+    float* r = level.r.data();
+    double norm = 0.0;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) reduction(+:norm) if (w * h > 16384)
+    #endif
+    for (int y = 0; y < h; ++y) {
+        const float* row = u + static_cast<size_t>(y) * w;
+        const float* rhs = f + static_cast<size_t>(y) * w;
+        float* res = r + static_cast<size_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            const float centre = row[x];
+            float lu = 0.0f;
+            if (x > 0) lu += row[x - 1] - centre;
+            if (x < w - 1) lu += row[x + 1] - centre;
+            if (y > 0) lu += row[x - w] - centre;
+            if (y < h - 1) lu += row[x + w] - centre;
+            res[x] = rhs[x] - lu;
+            norm += static_cast<double>(res[x]) * res[x];
+        }
+    }
+    return norm;
+}
+
+// Sum 2x2 blocks of the fine residual into the coarse right-hand side.
+// The coarse grid spacing is twice the fine one, hence sum (4 * average).
+void restrictResidual(const Level& fine, Level& coarse) {
+    const int fw = fine.width;
+    const int fh = fine.height;
+    const int cw = coarse.width;
+    const int ch = coarse.height;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) if (cw * ch > 16384)
+    #endif
+    for (int cy = 0; cy < ch; ++cy) {
+        const int fy0 = cy * 2;
+        const int fy1 = std::min(fy0 + 1, fh - 1);
+        for (int cx = 0; cx < cw; ++cx) {
+            const int fx0 = cx * 2;
+            const int fx1 = std::min(fx0 + 1, fw - 1);
+            float sum = fine.r[static_cast<size_t>(fy0) * fw + fx0];
+            if (fx1 != fx0) sum += fine.r[static_cast<size_t>(fy0) * fw + fx1];
+            if (fy1 != fy0) {
+                sum += fine.r[static_cast<size_t>(fy1) * fw + fx0];
+                if (fx1 != fx0) sum += fine.r[static_cast<size_t>(fy1) * fw + fx1];
+            }
+            const size_t index = static_cast<size_t>(cy) * cw + cx;
+            coarse.f[index] = sum;
+            coarse.u[index] = 0.0f;
+        }
+    }
+}
+
+// Bilinear (9/16, 3/16, 3/16, 1/16) cell-centred prolongation, added to
+// the fine solution. Clamping at the edges matches the Neumann boundary.
+void prolongAndCorrect(const Level& coarse, Level& fine) {
+    const int fw = fine.width;
+    const int fh = fine.height;
+    const int cw = coarse.width;
+    const int ch = coarse.height;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) if (fw * fh > 16384)
+    #endif
+    for (int fy = 0; fy < fh; ++fy) {
+        const int cy = std::min(fy / 2, ch - 1);
+        const int ny = std::clamp(cy + ((fy & 1) ? 1 : -1), 0, ch - 1);
+        const float* row = coarse.u.data() + static_cast<size_t>(cy) * cw;
+        const float* nrow = coarse.u.data() + static_cast<size_t>(ny) * cw;
+        float* target = fine.u.data() + static_cast<size_t>(fy) * fw;
+        for (int fx = 0; fx < fw; ++fx) {
+            const int cx = std::min(fx / 2, cw - 1);
+            const int nx = std::clamp(cx + ((fx & 1) ? 1 : -1), 0, cw - 1);
+            target[fx] += 0.5625f * row[cx] + 0.1875f * row[nx]
+                        + 0.1875f * nrow[cx] + 0.0625f * nrow[nx];
+        }
+    }
+}
+
+void vCycle(std::vector<Level>& levels, size_t index) {
+    Level& level = levels[index];
+
+    if (index + 1 == levels.size()) {
+        // Coarsest grid: plain relaxation until it has converged
+        smooth(level, std::max(50, 2 * (level.width + level.height)));
+        return;
+    }
+
+    smooth(level, 2);
+    computeResidual(level);
+    restrictResidual(level, levels[index + 1]);
+    vCycle(levels, index + 1);
+    prolongAndCorrect(levels[index + 1], level);
+    smooth(level, 2);
+}
+
+} // namespace
+
+BasReliefSolver::BasReliefSolver(const BasReliefConfig& config)
+    : m_config(config)
+{
+}
+
+QVector<float> BasReliefSolver::solve(const QVector<float>& depth, int width, int height,
+                                      float maxDepth) const {
+    if (width < 2 || height < 2 || maxDepth <= 0.0f ||
+        depth.size() != static_cast<qsizetype>(width) * height) {
+        return depth;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const size_t count = static_cast<size_t>(width) * height;
+    const float* input = depth.constData();
+    const float scale = 1.0f / maxDepth;
+
+    // Forward-difference gradients of the normalized intensity
+    Grid gx(count, 0.0f);
+    Grid gy(count, 0.0f);
+    double magnitudeSum = 0.0;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) reduction(+:magnitudeSum)
+    #endif
+    for (int y = 0; y < height; ++y) {
+        const size_t offset = static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const size_t i = offset + x;
+            const float dx = x < width - 1 ? (input[i + 1] - input[i]) * scale : 0.0f;
+            const float dy = y < height - 1 ? (input[i + width] - input[i]) * scale : 0.0f;
+            gx[i] = dx;
+            gy[i] = dy;
+            magnitudeSum += std::sqrt(dx * dx + dy * dy);
+        }
+    }
+
+    const float alpha = m_config.threshold * static_cast<float>(magnitudeSum / count);
+    if (alpha <= 0.0f) {
+        return depth; // Flat image, nothing to compress
+    }
+
+    // Attenuate: G = g * (|g| / alpha)^(beta - 1)
+    const float exponent = std::clamp(m_config.compression, 0.1f, 1.0f) - 1.0f;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (int y = 0; y < height; ++y) {
+        const size_t offset = static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const size_t i = offset + x;
+            const float magnitude = std::sqrt(gx[i] * gx[i] + gy[i] * gy[i]);
+            if (magnitude > 0.0f) {
+                const float factor = std::pow(magnitude / alpha, exponent);
+                gx[i] *= factor;
+                gy[i] *= factor;
+            }
+        }
+    }
+
+    // Multigrid hierarchy down to a few cells on the short side
+    std::vector<Level> levels;
+    levels.emplace_back(width, height);
+    while (levels.back().width > 4 && levels.back().height > 4) {
+        const Level& last = levels.back();
+        levels.emplace_back((last.width + 1) / 2, (last.height + 1) / 2);
+    }
+
+    // Right-hand side: divergence of the attenuated gradient field
+    // (backward differences, zero flux across the border)
+    Level& finest = levels.front();
+    double rhsNorm = 0.0;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static) reduction(+:rhsNorm)
+    #endif
+    for (int y = 0; y < height; ++y) {
+        const size_t offset = static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const size_t i = offset + x;
+            float div = gx[i] + gy[i];
+            if (x > 0) div -= gx[i - 1];
+            if (y > 0) div -= gy[i - width];
+            finest.f[i] = div;
+            rhsNorm += static_cast<double>(div) * div;
+        }
+    }
+
+    // Start from the normalized input, which is already close in shape
+    for (size_t i = 0; i < count; ++i) {
+        finest.u[i] = input[i] * scale;
+    }
+
+    const double target = static_cast<double>(m_config.tolerance) * m_config.tolerance * rhsNorm;
+    int cycles = 0;
+    double residual = computeResidual(finest);
+    while (cycles < m_config.maxCycles && residual > target) {
+        vCycle(levels, 0);
+        residual = computeResidual(finest);
+        ++cycles;
+    }
+
+    // Normalize to the depth range, clipping 0.1% outliers on either side
+    const float* solution = finest.u.data();
+    const auto [minIt, maxIt] = std::minmax_element(finest.u.begin(), finest.u.end());
+    float low = *minIt;
+    float high = *maxIt;
+    if (high > low) {
+        constexpr int bins = 4096;
+        std::vector<size_t> histogram(bins, 0);
+        const float binScale = (bins - 1) / (high - low);
+        for (size_t i = 0; i < count; ++i) {
+            ++histogram[static_cast<int>((solution[i] - low) * binScale)];
+        }
+        const size_t clip = count / 1000;
+        size_t seen = 0;
+        int lowBin = 0;
+        while (lowBin < bins - 1 && seen + histogram[lowBin] <= clip) {
+            seen += histogram[lowBin++];
+        }
+        seen = 0;
+        int highBin = bins - 1;
+        while (highBin > lowBin && seen + histogram[highBin] <= clip) {
+            seen += histogram[highBin--];
+        }
+        const float clippedLow = low + lowBin / binScale;
+        high = low + (highBin + 1) / binScale;
+        low = clippedLow;
+    }
+
+    QVector<float> result(static_cast<qsizetype>(count));
+    float* output = result.data();
+    const float range = high > low ? high - low : 1.0f;
+
+    #ifdef USE_OPENMP
+    #pragma omp parallel for schedule(static)
+    #endif
+    for (int y = 0; y < height; ++y) {
+        const size_t offset = static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x) {
+            const float t = (solution[offset + x] - low) / range;
+            output[offset + x] = std::clamp(t, 0.0f, 1.0f) * maxDepth;
+        }
+    }
+
+    qInfo() << "Bas-relief solved:" << width << "x" << height << "in" << cycles
+            << "V-cycles," << levels.size() << "levels," << timer.elapsed() << "ms"
+            << "(relative residual" << std::sqrt(residual / std::max(rhsNorm, 1e-30)) << ")";
+
+    return result;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,54 @@
+/**
+ * @file basrelief.h
+ * @brief Gradient-domain bas-relief depth mapping
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QVector>
+
+namespace LithoMaker {
+
+/**
+ * @brief Configuration for the bas-relief solver
+ */
+struct BasReliefConfig {
+    float compression{0.8f};  ///< Gradient attenuation exponent, clamped to 0.1-1.0
+    float threshold{0.1f};    ///< Gradients above threshold * mean gradient are attenuated
+    int maxCycles{10};        ///< Maximum number of multigrid V-cycles
+    float tolerance{1e-3f};   ///< Relative residual at which the solver stops
+};
+
+/**
+ * @brief Bas-relief depth mapping using a multigrid Poisson solver
+ *
+ * Attenuates large image gradients (large-scale shading) relative to
+ * small ones (detail), then reintegrates the modified gradient field by
+ * solving the Poisson equation with Neumann boundaries. The result uses
+ * the same layout and depth range as the linear depth buffer, so it can
+ * be meshed without any other changes.
+ */
+class BasReliefSolver {
+public:
+    BasReliefSolver() = default;
+    explicit BasReliefSolver(const BasReliefConfig& config);
+
+    /**
+     * @brief Compute a relief depth buffer
+     * @param depth Linear depth buffer (width * height, row-major)
+     * @param width Buffer width
+     * @param height Buffer height
+     * @param maxDepth Depth range of the input and output buffers
+     * @return Relief depth buffer with values in [0, maxDepth]
+     */
+    QVector<float> solve(const QVector<float>& depth, int width, int height,
+                         float maxDepth) const;
+
+private:
+    BasReliefConfig m_config;
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,236 @@
+/**
+ * @file heightfield.cpp
+ * @brief Lithophane heightfield with max-mip ray marching implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "heightfield.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+// Moller-Trumbore; returns the ray parameter or infinity
+float intersectTriangle(const QVector3D& origin, const QVector3D& direction,
+                        const QVector3D& a, const QVector3D& b, const QVector3D& c) {
+    const QVector3D edge1 = b - a;
+    const QVector3D edge2 = c - a;
+    const QVector3D p = QVector3D::crossProduct(direction, edge2);
+    const float det = QVector3D::dotProduct(edge1, p);
+    if (std::abs(det) < 1e-12f) {
+        return kInfinity;
+    }
+    const float invDet = 1.0f / det;
+    const QVector3D s = origin - a;
+    const float u = QVector3D::dotProduct(s, p) * invDet;
+    if (u < 0.0f || u > 1.0f) {
+        return kInfinity;
+    }
+    const QVector3D q = QVector3D::crossProduct(s, edge1);
+    const float v = QVector3D::dotProduct(direction, q) * invDet;
+    if (v < 0.0f || u + v > 1.0f) {
+        return kInfinity;
+    }
+    return QVector3D::dotProduct(edge2, q) * invDet;
+}
+
+} // namespace
+
+HeightField::HeightField(QVector<float> heights, int width, int height,
+                         const QVector3D& origin, float spacing)
+    : m_heights(std::move(heights))
+    , m_width(width)
+    , m_height(height)
+    , m_origin(origin)
+    , m_spacing(spacing)
+{
+    if (!isEmpty()) {
+        buildMaxMips();
+    }
+}
+
+void HeightField::buildMaxMips() {
+    int levelWidth = m_width - 1;
+    int levelHeight = m_height - 1;
+
+    QVector<float> cells(levelWidth * levelHeight);
+    for (int y = 0; y < levelHeight; ++y) {
+        const float* row = m_heights.constData() + y * m_width;
+        const float* nextRow = row + m_width;
+        for (int x = 0; x < levelWidth; ++x) {
+            cells[y * levelWidth + x] = std::max({row[x], row[x + 1], nextRow[x], nextRow[x + 1]});
+        }
+    }
+    m_minHeight = *std::min_element(m_heights.cbegin(), m_heights.cend());
+
+    m_maxMips = {cells};
+    m_mipWidths = {levelWidth};
+    m_mipHeights = {levelHeight};
+    while (levelWidth > 1 || levelHeight > 1) {
+        const QVector<float>& below = m_maxMips.last();
+        const int belowWidth = levelWidth;
+        const int belowHeight = levelHeight;
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+
+        QVector<float> level(levelWidth * levelHeight);
+        for (int y = 0; y < levelHeight; ++y) {
+            for (int x = 0; x < levelWidth; ++x) {
+                const int x0 = x * 2;
+                const int y0 = y * 2;
+                const int x1 = std::min(x0 + 1, belowWidth - 1);
+                const int y1 = std::min(y0 + 1, belowHeight - 1);
+                level[y * levelWidth + x] = std::max({below[y0 * belowWidth + x0], below[y0 * belowWidth + x1],
+                                                      below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]});
+            }
+        }
+        m_maxMips.append(level);
+        m_mipWidths.append(levelWidth);
+        m_mipHeights.append(levelHeight);
+    }
+}
+
+float HeightField::nodeMax(int level, int x, int y) const {
+    return m_maxMips[level][y * m_mipWidths[level] + x];
+}
+
+bool HeightField::intersectCell(int x, int y, const QVector3D& origin, const QVector3D& direction,
+                                float tMin, float tMax, SurfaceHit& hit) const {
+    auto corner = [this](int cx, int cy) {
+        return QVector3D(static_cast<float>(cx), static_cast<float>(cy), m_heights[cy * m_width + cx]);
+    };
+    const QVector3D topLeft = corner(x, y);
+    const QVector3D topRight = corner(x + 1, y);
+    const QVector3D bottomLeft = corner(x, y + 1);
+    const QVector3D bottomRight = corner(x + 1, y + 1);
+
+    // Same split as MeshGenerator::generateLithophaneRows
+    const float t1 = intersectTriangle(origin, direction, topLeft, bottomRight, bottomLeft);
+    const float t2 = intersectTriangle(origin, direction, topLeft, topRight, bottomRight);
+    const bool first = t1 <= t2;
+    const float t = first ? t1 : t2;
+    if (!(t >= tMin && t <= tMax)) {
+        return false;
+    }
+
+    // Plane z = a + gx * x + gy * y of the triangle hit, in grid units
+    float gx, gy;
+    if (first) {
+        gx = bottomRight.z() - bottomLeft.z();
+        gy = bottomLeft.z() - topLeft.z();
+    } else {
+        gx = topRight.z() - topLeft.z();
+        gy = bottomRight.z() - topRight.z();
+    }
+
+    const QVector3D grid = origin + direction * t;
+    hit.distance = t;
+    hit.position = QVector3D(m_origin.x() + grid.x() * m_spacing,
+                             m_origin.y() + grid.y() * m_spacing,
+                             grid.z());
+    hit.gradient = QVector2D(gx, gy) / m_spacing;
+    hit.normal = QVector3D(-hit.gradient.x(), -hit.gradient.y(), 1.0f).normalized();
+    hit.thickness = grid.z() - m_origin.z();
+    hit.onLithophane = true;
+    return true;
+}
+
+bool HeightField::intersect(const QVector3D& worldOrigin, const QVector3D& worldDirection,
+                            SurfaceHit& hit) const {
+    if (isEmpty()) {
+        return false;
+    }
+
+    // March in grid units; z stays in mm, and the ray parameter is the
+    // same in both spaces
+    const QVector3D origin((worldOrigin.x() - m_origin.x()) / m_spacing,
+                           (worldOrigin.y() - m_origin.y()) / m_spacing,
+                           worldOrigin.z());
+    const QVector3D direction(worldDirection.x() / m_spacing,
+                              worldDirection.y() / m_spacing,
+                              worldDirection.z());
+
+    // Clip to the bounding box of the surface
+    const float boxMin[3] = {0.0f, 0.0f, m_minHeight};
+    const float boxMax[3] = {static_cast<float>(m_width - 1), static_cast<float>(m_height - 1),
+                             m_maxMips.last().first()};
+    float tEnter = 0.0f;
+    float tExit = kInfinity;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float o = origin[axis];
+        const float d = direction[axis];
+        if (std::abs(d) < 1e-12f) {
+            if (o < boxMin[axis] || o > boxMax[axis]) {
+                return false;
+            }
+            continue;
+        }
+        float t0 = (boxMin[axis] - o) / d;
+        float t1 = (boxMax[axis] - o) / d;
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        tEnter = std::max(tEnter, t0);
+        tExit = std::min(tExit, t1);
+    }
+    if (tEnter > tExit) {
+        return false;
+    }
+
+    const int topLevel = static_cast<int>(m_maxMips.size()) - 1;
+    const float epsilon = 1e-5f * std::max(1.0f, tExit - tEnter);
+    const bool rising = direction.z() >= 0.0f;
+    int level = topLevel;
+    float t = tEnter;
+
+    while (t <= tExit) {
+        const QVector3D p = origin + direction * t;
+        const int nodeSize = 1 << level;
+        const int nx = std::clamp(static_cast<int>(std::floor(p.x() / nodeSize)), 0, m_mipWidths[level] - 1);
+        const int ny = std::clamp(static_cast<int>(std::floor(p.y() / nodeSize)), 0, m_mipHeights[level] - 1);
+
+        // Where the ray leaves this node's footprint
+        float tNode = tExit;
+        if (direction.x() > 0.0f) {
+            tNode = std::min(tNode, ((nx + 1) * nodeSize - origin.x()) / direction.x());
+        } else if (direction.x() < 0.0f) {
+            tNode = std::min(tNode, (nx * nodeSize - origin.x()) / direction.x());
+        }
+        if (direction.y() > 0.0f) {
+            tNode = std::min(tNode, ((ny + 1) * nodeSize - origin.y()) / direction.y());
+        } else if (direction.y() < 0.0f) {
+            tNode = std::min(tNode, (ny * nodeSize - origin.y()) / direction.y());
+        }
+
+        // Lowest point of the ray over the node
+        const float rayMin = rising ? p.z() : origin.z() + direction.z() * tNode;
+        if (rayMin > nodeMax(level, nx, ny)) {
+            // Entirely above: skip the node, and try bigger steps again
+            t = std::max(t, tNode) + epsilon;
+            level = std::min(level + 1, topLevel);
+            continue;
+        }
+
+        if (level > 0) {
+            --level;
+            continue;
+        }
+
+        if (intersectCell(nx, ny, origin, direction, t - epsilon, tNode + epsilon, hit)) {
+            return true;
+        }
+        t = std::max(t, tNode) + epsilon;
+    }
+    return false;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,97 @@
+/**
+ * @file heightfield.h
+ * @brief Lithophane heightfield with max-mip ray marching
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QVector>
+#include <QVector2D>
+#include <QVector3D>
+
+namespace LithoMaker {
+
+/**
+ * @brief Ray hit on a surface (mm)
+ */
+struct SurfaceHit {
+    float distance{0.0f};  ///< Ray parameter of the hit
+    QVector3D position;
+    QVector3D normal;
+    QVector2D gradient;    ///< dz/dx and dz/dy; zero off the lithophane
+    float thickness{0.0f}; ///< Material below the hit; zero off the lithophane
+    bool onLithophane{false};
+};
+
+/**
+ * @brief Regular grid of heights, triangulated like the generated mesh
+ *
+ * Sample (x, y) lies at origin + (x, y) * spacing with height z, and
+ * every cell is split into the same two triangles MeshGenerator emits,
+ * so hits are exact. A pyramid of per-node maximum heights lets ray
+ * queries skip whole regions the ray passes above, which makes them
+ * logarithmic in the grid size instead of linear.
+ */
+class HeightField {
+public:
+    HeightField() = default;
+
+    /**
+     * @param heights Row-major heights, width * height values
+     * @param origin Position of sample (0, 0); its z is the base plane
+     *        thickness is measured from
+     * @param spacing Distance between samples (mm)
+     */
+    HeightField(QVector<float> heights, int width, int height,
+                const QVector3D& origin, float spacing);
+
+    bool isEmpty() const { return m_width < 2 || m_height < 2; }
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+    const QVector3D& origin() const { return m_origin; }
+    float spacing() const { return m_spacing; }
+
+    /**
+     * @brief Height (z) of sample (x, y)
+     */
+    float sample(int x, int y) const { return m_heights[y * m_width + x]; }
+
+    /**
+     * @brief All heights, row-major
+     */
+    const QVector<float>& heights() const { return m_heights; }
+
+    /**
+     * @brief Find the first intersection of a ray with the surface
+     * @param origin Ray origin
+     * @param direction Ray direction, need not be normalized
+     * @param hit Receives the hit
+     * @return Whether the ray hits the surface
+     */
+    bool intersect(const QVector3D& origin, const QVector3D& direction, SurfaceHit& hit) const;
+
+private:
+    void buildMaxMips();
+    float nodeMax(int level, int x, int y) const;
+    bool intersectCell(int x, int y, const QVector3D& origin, const QVector3D& direction,
+                       float tMin, float tMax, SurfaceHit& hit) const;
+
+    QVector<float> m_heights;
+    int m_width{0};
+    int m_height{0};
+    QVector3D m_origin;
+    float m_spacing{1.0f};
+
+    // Level 0 holds the maximum of each cell's corners, every further
+    // level the maximum of 2x2 nodes of the level below
+    QVector<QVector<float>> m_maxMips;
+    QVector<int> m_mipWidths;
+    QVector<int> m_mipHeights;
+    float m_minHeight{0.0f};
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,204 @@
+/**
+ * @file indexedmesh.cpp
+ * @brief Indexed triangle mesh implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "indexedmesh.h"
+
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+struct VertexKey {
+    quint32 x;
+    quint32 y;
+    quint32 z;
+
+    bool operator==(const VertexKey& other) const {
+        return x == other.x && y == other.y && z == other.z;
+    }
+};
+
+struct VertexKeyHash {
+    size_t operator()(const VertexKey& key) const {
+        // Mix the three coordinates (constants from splitmix/murmur)
+        quint64 h = key.x * 0x9E3779B97F4A7C15ull;
+        h ^= (key.y + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2));
+        h ^= (key.z * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2));
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
+};
+
+// Welding and reordering buffers are accounted with the exporters
+template <typename T>
+using ExportVector = TrackedVector<T, MemorySubsystem::Export>;
+
+qint64 listBytes(const QList<QVector3D>& vertices, const QList<quint32>& indices) {
+    return vertices.capacity() * qint64(sizeof(QVector3D)) +
+           indices.capacity() * qint64(sizeof(quint32));
+}
+
+quint32 floatBits(float value) {
+    if (value == 0.0f) {
+        value = 0.0f; // Merge -0 and +0
+    }
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+} // namespace
+
+IndexedMesh IndexedMesh::fromTriangles(const QList<QVector3D>& mesh) {
+    IndexedMesh result;
+    result.indices.reserve(mesh.size());
+    result.vertices.reserve(mesh.size() / 4);
+    result.memory.resize(listBytes(result.vertices, result.indices));
+
+    std::unordered_map<VertexKey, quint32, VertexKeyHash, std::equal_to<VertexKey>,
+                       TrackedAllocator<std::pair<const VertexKey, quint32>, MemorySubsystem::Export>>
+        vertexMap;
+    vertexMap.reserve(static_cast<size_t>(mesh.size() / 4));
+
+    for (const QVector3D& v : mesh) {
+        const VertexKey key{floatBits(v.x()), floatBits(v.y()), floatBits(v.z())};
+        const auto [it, inserted] = vertexMap.try_emplace(
+            key, static_cast<quint32>(result.vertices.size()));
+        if (inserted) {
+            result.vertices.append(v);
+        }
+        result.indices.append(it->second);
+    }
+    result.memory.resize(listBytes(result.vertices, result.indices));
+
+    return result;
+}
+
+void IndexedMesh::optimizeVertexCache(int cacheSize) {
+    const int vertexCount = static_cast<int>(vertices.size());
+    const int triCount = triangleCount();
+    if (triCount == 0) {
+        return;
+    }
+
+    // Vertex -> triangle adjacency (CSR layout)
+    ExportVector<int> liveCount(vertexCount, 0);
+    for (quint32 index : indices) {
+        ++liveCount[index];
+    }
+    ExportVector<int> offsets(vertexCount + 1, 0);
+    for (int v = 0; v < vertexCount; ++v) {
+        offsets[v + 1] = offsets[v] + liveCount[v];
+    }
+    ExportVector<int> adjacency(indices.size());
+    {
+        ExportVector<int> fill(offsets.begin(), offsets.end() - 1);
+        for (int t = 0; t < triCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                adjacency[fill[indices[t * 3 + k]]++] = t;
+            }
+        }
+    }
+
+    ExportVector<int> cacheTime(vertexCount, 0);
+    ExportVector<bool> emitted(triCount, false);
+    ExportVector<int> deadEnd;
+    ExportVector<int> candidates;
+    ExportVector<int> order;
+    order.reserve(triCount);
+
+    int time = cacheSize + 1;
+    int cursor = 0;
+    int fanning = 0;
+
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // Emit all remaining triangles around the fanning vertex
+        for (int a = offsets[fanning]; a < offsets[fanning + 1]; ++a) {
+            const int t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+            order.push_back(t);
+            for (int k = 0; k < 3; ++k) {
+                const int v = static_cast<int>(indices[t * 3 + k]);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --liveCount[v];
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // Next fanning vertex: a candidate still in cache with live triangles
+        int best = -1;
+        int bestPriority = -1;
+        for (int v : candidates) {
+            if (liveCount[v] <= 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * liveCount[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        if (best < 0) {
+            // Dead end: recently used vertices first, then input order
+            while (!deadEnd.empty() && best < 0) {
+                const int v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveCount[v] > 0) {
+                    best = v;
+                }
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (liveCount[cursor] > 0) {
+                    best = cursor;
+                }
+                ++cursor;
+            }
+        }
+        fanning = best;
+    }
+
+    // Rewrite indices in the new triangle order, renumbering vertices by first use
+    ExportVector<qint64> remap(vertexCount, -1);
+    QList<QVector3D> newVertices;
+    newVertices.reserve(vertexCount);
+    QList<quint32> newIndices;
+    newIndices.reserve(indices.size());
+    const MemoryLease copies(MemorySubsystem::Export, listBytes(newVertices, newIndices));
+
+    for (int t : order) {
+        for (int k = 0; k < 3; ++k) {
+            const quint32 v = indices[t * 3 + k];
+            if (remap[v] < 0) {
+                remap[v] = newVertices.size();
+                newVertices.append(vertices[v]);
+            }
+            newIndices.append(static_cast<quint32>(remap[v]));
+        }
+    }
+
+    vertices = std::move(newVertices);
+    indices = std::move(newIndices);
+    memory.resize(listBytes(vertices, indices));
+}
+
+} // namespace LithoMaker
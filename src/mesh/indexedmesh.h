@@ -0,0 +1,49 @@
+/**
+ * @file indexedmesh.h
+ * @brief Indexed triangle mesh with welding and vertex cache optimization
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "core/memorystats.h"
+
+#include <QList>
+#include <QVector3D>
+
+namespace LithoMaker {
+
+/**
+ * @brief Triangle mesh with shared vertices
+ */
+struct IndexedMesh {
+    QList<QVector3D> vertices;
+    QList<quint32> indices; ///< 3 per triangle
+    MemoryLease memory{MemorySubsystem::Export}; ///< Reports the bytes of both lists
+
+    /**
+     * @brief Weld a triangle soup into an indexed mesh
+     *
+     * Vertices are merged when their coordinates are bit-identical,
+     * which is the case for all vertices the generator shares between
+     * triangles. Vertices are numbered in order of first use.
+     * @param mesh List of vertices (triangles, 3 per triangle)
+     */
+    static IndexedMesh fromTriangles(const QList<QVector3D>& mesh);
+
+    /**
+     * @brief Reorder triangles for post-transform vertex cache locality
+     *
+     * Uses the Tipsify algorithm (Sander et al. 2007), which is linear
+     * in the number of triangles. Vertices are then renumbered in order
+     * of first use so vertex fetches are sequential as well.
+     * @param cacheSize Target vertex cache size
+     */
+    void optimizeVertexCache(int cacheSize = 16);
+
+    int triangleCount() const { return static_cast<int>(indices.size() / 3); }
+};
+
+} // namespace LithoMaker
@@ -0,0 +1,227 @@
+/**
+ * @file layerslicer.cpp
+ * @brief Print layer cross-section implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "layerslicer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace LithoMaker {
+
+namespace {
+
+QPolygonF rectangle(float x0, float z0, float x1, float z1) {
+    return QPolygonF({QPointF(x0, z0), QPointF(x1, z0), QPointF(x1, z1), QPointF(x0, z1)});
+}
+
+} // namespace
+
+LayerSlicer::LayerSlicer(const MeshConfig& config, const QSizeF& dimensions, HeightField surface)
+    : m_config(config)
+    , m_dimensions(dimensions)
+    , m_surface(std::move(surface))
+    , m_hasStabilizers(config.enableStabilizers &&
+                       dimensions.height() > config.stabilizerThreshold)
+{
+}
+
+float LayerSlicer::printHeight() const {
+    return float(m_dimensions.height()) +
+           (m_config.enableHangers ? HangerGeometry::kHeight : 0.0f);
+}
+
+int LayerSlicer::layerCount(float layerHeight) const {
+    if (isEmpty() || layerHeight <= 0.0f) {
+        return 0;
+    }
+    return int(std::ceil(printHeight() / layerHeight));
+}
+
+QRectF LayerSlicer::extent() const {
+    const float depth = m_config.totalThickness - m_config.minThickness;
+    const float footDepth = m_hasStabilizers
+        ? float(m_dimensions.height()) * m_config.stabilizerHeightFactor * 0.5f : 0.0f;
+    const float zMin = -m_config.minThickness - footDepth;
+    float zMax = depth + footDepth;
+    if (m_config.enableHangers) {
+        zMax = std::max(zMax, HangerGeometry::kThickness);
+    }
+    return QRectF(0.0, zMin, m_dimensions.width(), zMax - zMin);
+}
+
+LayerSection LayerSlicer::section(float height) const {
+    LayerSection section;
+    section.height = height;
+    if (isEmpty() || height < 0.0f) {
+        return section;
+    }
+
+    if (height <= m_dimensions.height()) {
+        section.outlines.append(bodyOutline(height));
+    }
+    if (m_hasStabilizers) {
+        addStabilizers(height, section.outlines);
+    }
+    if (m_config.enableHangers) {
+        addHangers(height, section.outlines);
+    }
+    return section;
+}
+
+QPolygonF LayerSlicer::bodyOutline(float y) const {
+    const float width = float(m_dimensions.width());
+    const float height = float(m_dimensions.height());
+    const float border = m_config.frameBorder;
+    const float bottom = -m_config.minThickness;
+    const float depth = m_config.totalThickness - m_config.minThickness;
+
+    // The frame's top and bottom bars are solid
+    if (m_surface.isEmpty() || y <= border || y >= height - border) {
+        return rectangle(0.0f, bottom, width, depth);
+    }
+
+    // Where the top of the section changes slope: frame edges, the ends
+    // of the frame's inner slope, and along the surface every sample
+    // column plus every cell diagonal the layer crosses
+    const float slope = depth * m_config.frameSlopeFactor;
+    std::vector<float> xs = {0.0f, border, border + slope,
+                             width - border - slope, width - border, width};
+
+    const float spacing = m_surface.spacing();
+    const QVector3D& origin = m_surface.origin();
+    const float v = (y - origin.y()) / spacing;
+    if (v >= 0.0f && v <= float(m_surface.height() - 1)) {
+        const float fv = v - std::min(std::floor(v), float(m_surface.height() - 2));
+        xs.reserve(xs.size() + 2 * size_t(m_surface.width()));
+        for (int column = 0; column < m_surface.width(); ++column) {
+            xs.push_back(origin.x() + column * spacing);
+            if (column < m_surface.width() - 1 && fv > 0.0f && fv < 1.0f) {
+                xs.push_back(origin.x() + (column + fv) * spacing);
+            }
+        }
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end(), [](float a, float b) {
+        return b - a < 1e-5f;
+    }), xs.end());
+
+    QPolygonF outline;
+    outline.reserve(qsizetype(xs.size()) + 2);
+    outline.append(QPointF(0.0, bottom));
+    outline.append(QPointF(width, bottom));
+    for (auto it = xs.rbegin(); it != xs.rend(); ++it) {
+        const float x = std::clamp(*it, 0.0f, width);
+        float top = depth;
+        if (x > border && x < width - border) {
+            // Inside the frame: the lithophane, the frame's inner slope
+            // or the flat floor between them, whichever is highest
+            const float edgeDistance = std::min({x - border, width - border - x,
+                                                 y - border, height - border - y});
+            const float frame = slope > 0.0f ? depth * std::max(0.0f, 1.0f - edgeDistance / slope)
+                                             : 0.0f;
+            top = std::max({0.0f, frame, surfaceHeight(x, y)});
+        }
+        outline.append(QPointF(x, top));
+    }
+    return outline;
+}
+
+float LayerSlicer::surfaceHeight(float x, float y) const {
+    const float spacing = m_surface.spacing();
+    const float u = (x - m_surface.origin().x()) / spacing;
+    const float v = (y - m_surface.origin().y()) / spacing;
+    if (u < 0.0f || v < 0.0f || u > float(m_surface.width() - 1) ||
+        v > float(m_surface.height() - 1)) {
+        return -std::numeric_limits<float>::infinity();
+    }
+
+    const int cx = std::min(int(u), m_surface.width() - 2);
+    const int cy = std::min(int(v), m_surface.height() - 2);
+    const float fu = u - float(cx);
+    const float fv = v - float(cy);
+    const float z00 = m_surface.sample(cx, cy);
+    const float z10 = m_surface.sample(cx + 1, cy);
+    const float z01 = m_surface.sample(cx, cy + 1);
+    const float z11 = m_surface.sample(cx + 1, cy + 1);
+
+    // Same split as the mesh: (0,0)-(1,1)-(0,1) and (0,0)-(1,0)-(1,1)
+    if (fv >= fu) {
+        return z00 + fu * (z11 - z01) + fv * (z01 - z00);
+    }
+    return z00 + fu * (z10 - z00) + fv * (z11 - z10);
+}
+
+void LayerSlicer::addStabilizers(float y, QList<QPolygonF>& outlines) const {
+    const float footHeight = float(m_dimensions.height()) * m_config.stabilizerHeightFactor;
+    if (y >= footHeight) {
+        return;
+    }
+
+    // How far a foot sticks out from the frame at this height, following
+    // MeshGenerator::addSingleStabilizer()
+    const float footDepth = footHeight * 0.5f;
+    float reach = 0.0f;
+    if (m_config.permanentStabilizers) {
+        reach = footDepth * (1.0f - y / footHeight);
+    } else {
+        const float bodyTop = footHeight - StabilizerGeometry::kNeckHeight;
+        if (y < bodyTop) {
+            reach = footDepth + (StabilizerGeometry::kNeckWidth - footDepth) * (y / bodyTop);
+        } else {
+            reach = StabilizerGeometry::kNeckWidth * (footHeight - y) /
+                    StabilizerGeometry::kNeckHeight;
+        }
+    }
+    if (reach <= 0.0f) {
+        return;
+    }
+
+    const float width = float(m_dimensions.width());
+    const float footWidth = std::min(m_config.frameBorder, StabilizerGeometry::kMaxWidth);
+    const float front = m_config.totalThickness - m_config.minThickness;
+    const float back = -m_config.minThickness;
+    for (const float x : {0.0f, width - footWidth}) {
+        outlines.append(rectangle(x, front, x + footWidth, front + reach));
+        outlines.append(rectangle(x, back - reach, x + footWidth, back));
+    }
+}
+
+void LayerSlicer::addHangers(float y, QList<QPolygonF>& outlines) const {
+    using namespace HangerGeometry;
+    const float above = y - float(m_dimensions.height());
+    if (above < 0.0f || above >= kHeight) {
+        return;
+    }
+
+    const float width = float(m_dimensions.width());
+    const int count = m_config.hangerCount;
+    if (count <= 0) {
+        return;
+    }
+    const float step = width / count;
+    for (int i = 0; i < count; ++i) {
+        // The outer edges rise from the corners to the top third over
+        // kHeight; the hole edges close in at 45 degrees up to kHoleHeight
+        const float third = kWidth / 3.0f;
+        const float x = step * (i + 0.5f) - kWidth * 0.5f;
+        const float inset = above * third / kHeight;
+        const float left = x + inset;
+        const float right = x + kWidth - inset;
+        if (above < kHoleHeight) {
+            outlines.append(rectangle(left, 0.0f, x + third + above, kThickness));
+            outlines.append(rectangle(x + 2.0f * third - above, 0.0f, right, kThickness));
+        } else {
+            outlines.append(rectangle(left, 0.0f, right, kThickness));
+        }
+    }
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,84 @@
+/**
+ * @file layerslicer.h
+ * @brief Print layer cross-sections of a generated lithophane
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "heightfield.h"
+#include "meshgenerator.h"
+
+#include <QList>
+#include <QPolygonF>
+#include <QRectF>
+#include <QSizeF>
+
+namespace LithoMaker {
+
+/**
+ * @brief Outline of one print layer
+ */
+struct LayerSection {
+    float height{0.0f};        ///< Height above the bed (mm)
+    QList<QPolygonF> outlines; ///< Closed outlines, x = mesh X, y = mesh Z (mm)
+};
+
+/**
+ * @brief Computes the layers of an upright printed lithophane directly
+ *
+ * Printed upright, the bed is the mesh's y = 0 plane and layers follow
+ * the image rows. A layer therefore cuts the lithophane surface along a
+ * single line between two depth buffer rows, and the frame, stabilizers
+ * and hangers along known profiles. Sections are built from these in
+ * time linear in the image width, without slicing any triangles, so
+ * they can be recomputed for every step while scrubbing.
+ */
+class LayerSlicer {
+public:
+    LayerSlicer() = default;
+
+    /**
+     * @param config Configuration the mesh was generated with
+     * @param dimensions Size of the lithophane including frame (mm)
+     * @param surface Lithophane surface from MeshGenerator::heightField()
+     */
+    LayerSlicer(const MeshConfig& config, const QSizeF& dimensions, HeightField surface);
+
+    bool isEmpty() const { return m_dimensions.isEmpty(); }
+
+    /**
+     * @brief Height of the printed object, hangers included (mm)
+     */
+    float printHeight() const;
+
+    /**
+     * @brief Number of layers at a given layer height
+     */
+    int layerCount(float layerHeight) const;
+
+    /**
+     * @brief Region all sections lie in (x = mesh X, y = mesh Z)
+     */
+    QRectF extent() const;
+
+    /**
+     * @brief Cross-section at a height above the bed
+     */
+    LayerSection section(float height) const;
+
+private:
+    QPolygonF bodyOutline(float y) const;
+    float surfaceHeight(float x, float y) const;
+    void addStabilizers(float y, QList<QPolygonF>& outlines) const;
+    void addHangers(float y, QList<QPolygonF>& outlines) const;
+
+    MeshConfig m_config;
+    QSizeF m_dimensions;
+    HeightField m_surface;
+    bool m_hasStabilizers{false};
+};
+
+} // namespace LithoMaker
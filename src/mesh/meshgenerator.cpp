@@ -7,8 +7,11 @@
  */
 
 #include "meshgenerator.h"
+#include "basrelief.h"
+#include "core/jobscheduler.h"
 
 #include <QDebug>
+#include <algorithm>
 
 #ifdef USE_OPENMP
 #include <omp.h>
@@ -16,6 +19,47 @@
 
 namespace LithoMaker {
 
+namespace {
+
+// Lithophane bands published while generating; fewer for small images
+constexpr int kPreviewBands = 16;
+constexpr int kMinBandRows = 64;
+
+// Rows between checkpoints when running as a batch job
+constexpr int kYieldBandRows = 64;
+
+void extendBounds(MeshBounds& bounds, const QVector3D& v) {
+    bounds.min = QVector3D(std::min(bounds.min.x(), v.x()), std::min(bounds.min.y(), v.y()),
+                           std::min(bounds.min.z(), v.z()));
+    bounds.max = QVector3D(std::max(bounds.max.x(), v.x()), std::max(bounds.max.y(), v.y()),
+                           std::max(bounds.max.z(), v.z()));
+}
+
+} // namespace
+
+MeshBounds computeBounds(const QVector3D* vertices, qsizetype count) {
+    MeshBounds bounds;
+    if (count <= 0) {
+        return bounds;
+    }
+    bounds.min = bounds.max = vertices[0];
+
+    #pragma omp parallel if (count > 262144)
+    {
+        MeshBounds local{vertices[0], vertices[0]};
+        #pragma omp for schedule(static) nowait
+        for (qsizetype i = 0; i < count; ++i) {
+            extendBounds(local, vertices[i]);
+        }
+        #pragma omp critical
+        {
+            extendBounds(bounds, local.min);
+            extendBounds(bounds, local.max);
+        }
+    }
+    return bounds;
+}
+
 MeshGenerator::MeshGenerator(const MeshConfig& config)
     : m_config(config)
 {
@@ -26,7 +70,8 @@ void MeshGenerator::setConfig(const MeshConfig& config) {
 }
 
 QList<QVector3D> MeshGenerator::generate(const QImage& image,
-                                          ProgressCallback progressCallback) {
+                                          ProgressCallback progressCallback,
+                                          MeshPartCallback partCallback) {
     m_mesh.clear();
 
     QImage grayscaleImage = image.convertToFormat(QImage::Format_Grayscale8);
@@ -39,23 +84,20 @@ QList<QVector3D> MeshGenerator::generate(const QImage& image,
     const float totalHeight = (m_border * 2) + (grayscaleImage.height() * m_widthFactor);
     m_meshDimensions = QSizeF(m_config.width, totalHeight);
     
-    // Estimate polygon count for memory reservation
-    const int estimatedVertices = 
-        (image.width() - 1) * (image.height() - 1) * 6 * 3 + // Lithophane
-        12 +  // Backside
-        500 + // Frame estimate
-        (m_config.enableStabilizers ? 1000 : 0) +
-        (m_config.enableHangers ? m_config.hangerCount * 300 : 0);
-    
-    m_mesh.reserve(estimatedVertices);
+    m_mesh.reserve(estimateVertexCount(image.size()));
+    m_meshMemory.resize(m_mesh.capacity() * qsizetype(sizeof(QVector3D)));
     
     qInfo() << "Generating mesh for image" << grayscaleImage.size()
             << "-> final size" << m_meshDimensions << "mm";
 
-    // Generate lithophane heightmap (parallelized)
-    generateLithophane(grayscaleImage);
+    // Counted in triangles; the surface is nearly all of them
+    ProgressMeter progress(estimateVertexCount(image.size()) / 3, progressCallback);
 
-    if (progressCallback) progressCallback(50, 100);
+    // Generate lithophane heightmap (parallelized)
+    generateLithophane(grayscaleImage, progress, partCallback);
+    const qsizetype lithophaneEnd = m_mesh.size();
+    m_lithophaneVertexCount = lithophaneEnd;
+    checkpoint();
     
     // Generate backside
     if (m_config.enableSegmentation && m_config.backsideSegments > 1) {
@@ -64,13 +106,9 @@ QList<QVector3D> MeshGenerator::generate(const QImage& image,
         generateBackside(grayscaleImage);
     }
     
-    if (progressCallback) progressCallback(60, 100);
-    
     // Generate frame
     generateFrame(m_config.width, totalHeight);
     
-    if (progressCallback) progressCallback(80, 100);
-    
     // Generate stabilizers if needed
     if (m_config.enableStabilizers && 
         totalHeight > m_config.stabilizerThreshold) {
@@ -82,19 +120,59 @@ QList<QVector3D> MeshGenerator::generate(const QImage& image,
         generateHangers(m_config.width, totalHeight);
     }
     
-    if (progressCallback) progressCallback(100, 100);
+    if (partCallback) {
+        partCallback(m_mesh.constData() + lithophaneEnd, m_mesh.size() - lithophaneEnd);
+    }
+
+    progress.finish();
+    m_meshMemory.resize(m_mesh.capacity() * qsizetype(sizeof(QVector3D)));
     
     qInfo() << "Mesh generated:" << (m_mesh.size() / 3) << "triangles";
     
     return m_mesh;
 }
 
-void MeshGenerator::generateLithophane(const QImage& image) {
-    const float minThickness = -m_config.minThickness;
+MeshBounds MeshGenerator::predictBounds(const QSize& imageSize) const {
+    const float border = m_config.frameBorder;
+    const float widthFactor = (m_config.width - (border * 2)) / std::max(imageSize.width(), 1);
+    const float totalHeight = (border * 2) + (imageSize.height() * widthFactor);
+    const float depth = m_config.totalThickness - m_config.minThickness;
+
+    MeshBounds bounds;
+    bounds.min = QVector3D(0.0f, 0.0f, -m_config.minThickness);
+    bounds.max = QVector3D(m_config.width, totalHeight, depth);
+
+    if (m_config.enableStabilizers && totalHeight > m_config.stabilizerThreshold) {
+        // Feet stick out by half their height on both sides
+        const float footDepth = totalHeight * m_config.stabilizerHeightFactor * 0.5f;
+        bounds.min.setZ(bounds.min.z() - footDepth);
+        bounds.max.setZ(bounds.max.z() + footDepth);
+    }
+
+    if (m_config.enableHangers) {
+        bounds.max.setY(totalHeight + HangerGeometry::kHeight);
+        bounds.max.setZ(std::max(bounds.max.z(), HangerGeometry::kThickness));
+    }
+
+    return bounds;
+}
+
+qsizetype MeshGenerator::estimateVertexCount(const QSize& imageSize) const {
+    return
+        qsizetype(imageSize.width() - 1) * (imageSize.height() - 1) * 6 * 3 + // Lithophane
+        12 +  // Backside
+        500 + // Frame estimate
+        (m_config.enableStabilizers ? 1000 : 0) +
+        (m_config.enableHangers ? m_config.hangerCount * 300 : 0);
+}
+
+QVector<float> MeshGenerator::buildDepthBuffer(const QImage& image) const {
     const int height = image.height();
     const int width = image.width();
 
     QVector<float> depthBuffer(width * height);
+    const MemoryLease memory(MemorySubsystem::DepthBuffer,
+                             depthBuffer.size() * qsizetype(sizeof(float)));
     for (int y = 0; y < height; ++y) {
         const uchar* sourceRow = image.constScanLine(height - 1 - y);
         float* targetRow = depthBuffer.data() + y * width;
@@ -103,7 +181,61 @@ void MeshGenerator::generateLithophane(const QImage& image) {
         }
     }
 
-    const float* const buffer = depthBuffer.constData();
+    if (m_config.reliefMode == ReliefMode::BasRelief) {
+        BasReliefConfig reliefConfig;
+        reliefConfig.compression = m_config.reliefCompression;
+        depthBuffer = BasReliefSolver(reliefConfig)
+            .solve(depthBuffer, width, height, m_depthFactor * 255.0f);
+    }
+
+    return depthBuffer;
+}
+
+void MeshGenerator::generateLithophane(const QImage& image,
+                                       ProgressMeter& progress,
+                                       const MeshPartCallback& partCallback) {
+    const int height = image.height();
+    const int width = image.width();
+    const int rows = height - 1;
+
+    checkpoint();
+    const QVector<float> depthBuffer = buildDepthBuffer(image);
+    m_heightField = HeightField(depthBuffer, width, height,
+                                scaleVertex(0, 0, -m_config.minThickness), m_widthFactor);
+    m_heightFieldMemory.resize(depthBuffer.size() * qsizetype(sizeof(float)));
+
+    if (!partCallback && !m_jobContext) {
+        generateLithophaneRows(depthBuffer.constData(), width, height, 0, rows, &progress);
+        return;
+    }
+
+    // Publish the rows in bands as they are done, so a preview can fill
+    // in while the rest is generated, and let interactive work go first
+    // between bands
+    const int bandRows = partCallback
+        ? std::max(kMinBandRows, (rows + kPreviewBands - 1) / kPreviewBands)
+        : kYieldBandRows;
+    for (int firstRow = 0; firstRow < rows; firstRow += bandRows) {
+        checkpoint();
+        const int endRow = std::min(rows, firstRow + bandRows);
+        const qsizetype published = m_mesh.size();
+        generateLithophaneRows(depthBuffer.constData(), width, height, firstRow, endRow, &progress);
+        if (partCallback) {
+            partCallback(m_mesh.constData() + published, m_mesh.size() - published);
+        }
+    }
+}
+
+void MeshGenerator::checkpoint() {
+    if (m_jobContext) {
+        m_jobContext->checkpoint();
+    }
+}
+
+void MeshGenerator::generateLithophaneRows(const float* buffer, int width, int height,
+                                           int firstRow, int endRow, ProgressMeter* progress) {
+    const float minThickness = -m_config.minThickness;
+    const qint64 rowTriangles = qint64(width - 1) * 2 + 4; // Surface and side walls
     const float* const topRow = buffer;
     const float* const bottomRow = buffer + (height - 1) * width;
 
@@ -116,13 +248,13 @@ void MeshGenerator::generateLithophane(const QImage& image) {
     {
         const int threadId = omp_get_thread_num();
         auto& localMesh = threadMeshes[threadId];
-        localMesh.reserve((height / numThreads) * width * 18); // Rough estimate
+        localMesh.reserve(((endRow - firstRow) / numThreads + 1) * width * 18); // Rough estimate
 
-        #pragma omp for schedule(dynamic, 32)
-        for (int y = 0; y < height - 1; ++y) {
+        #pragma omp for schedule(dynamic, 8)
+        for (int y = firstRow; y < endRow; ++y) {
     #else
         auto& localMesh = m_mesh;
-        for (int y = 0; y < height - 1; ++y) {
+        for (int y = firstRow; y < endRow; ++y) {
     #endif
             const float* row = buffer + y * width;
             const float* nextRow = row + width;
@@ -184,11 +316,21 @@ void MeshGenerator::generateLithophane(const QImage& image) {
             localMesh.append(scaleVertex(width - 1, y, minThickness));
             localMesh.append(scaleVertex(width - 1, y + 1, minThickness));
             localMesh.append(scaleVertex(width - 1, y + 1, rightNextDepth));
+
+            // One atomic add per row; only the calling thread reports
+            if (progress) {
+                progress->add(y == 0 ? rowTriangles + qint64(width - 1) * 4 : rowTriangles);
+            }
         }
     #ifdef USE_OPENMP
     }
     
-    // Merge thread-local meshes
+    // Merge thread-local meshes, which are a second copy until then
+    qsizetype localBytes = 0;
+    for (const auto& localMesh : threadMeshes) {
+        localBytes += localMesh.capacity() * qsizetype(sizeof(QVector3D));
+    }
+    const MemoryLease localMemory(MemorySubsystem::Mesh, localBytes);
     for (auto& localMesh : threadMeshes) {
         m_mesh.append(localMesh);
     }
@@ -354,7 +496,7 @@ void MeshGenerator::generateFrame(float width, float height) {
 
 void MeshGenerator::generateStabilizers(float width, float height) {
     const float stabHeight = height * m_config.stabilizerHeightFactor;
-    const float stabWidth = std::min(m_border, 4.0f);
+    const float stabWidth = std::min(m_border, StabilizerGeometry::kMaxWidth);
     const float depth = stabHeight * 0.5f;
     const float minThickness = m_config.minThickness;
     const float totalThickness = m_config.totalThickness;
@@ -371,14 +513,14 @@ void MeshGenerator::generateStabilizers(float width, float height) {
 
 void MeshGenerator::addSingleStabilizer(float x, float stabHeight, float depth, 
                                         float minThickness, float totalThickness, float zDelta) {
-    const float stabWidth = std::min(m_border, 4.0f);
+    const float stabWidth = std::min(m_border, StabilizerGeometry::kMaxWidth);
     const float h = stabHeight;  // height of the stabilizer foot
     
     // When detachable (zDelta == 0, permanentStabilizers == false):
     // Create a thin necking connection at the top for easy break-off
     const bool detachable = (zDelta < 0.5f);  // permanentStabilizers=true sets zDelta=1
-    const float neckWidth = detachable ? 0.6f : 0.0f;  // ~1-2 extrusion lines
-    const float neckHeight = detachable ? 1.5f : 0.0f; // Height of the weak zone
+    const float neckWidth = detachable ? StabilizerGeometry::kNeckWidth : 0.0f;
+    const float neckHeight = detachable ? StabilizerGeometry::kNeckHeight : 0.0f;
     
     // ==== FRONT STABILIZER (positive Z direction) ====
     float z1 = totalThickness - minThickness;  // Base Z (attachment to frame)
@@ -616,78 +758,84 @@ void MeshGenerator::addSingleStabilizer(float x, float stabHeight, float depth,
 void MeshGenerator::generateHangers(float width, float height) {
     const int noOfHangers = m_config.hangerCount;
     const float xDelta = (width / noOfHangers) / 2.0f;
-    float x = xDelta - 4.5f; // 4.5 is half the width of a hanger
+    float x = xDelta - HangerGeometry::kWidth / 2.0f;
+
+    const float third = HangerGeometry::kWidth / 3.0f;
+    const float hole = HangerGeometry::kHoleHeight;
+    const float top = height + HangerGeometry::kHeight;
+    const float holeTop = height + hole;
+    const float back = HangerGeometry::kThickness;
     
     for (int i = 0; i < noOfHangers; ++i) {
         // Front face of hanger
-        m_mesh.append(QVector3D(x + 3, height, 0));
+        m_mesh.append(QVector3D(x + third, height, 0));
         m_mesh.append(QVector3D(x, height, 0));
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
         
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
-        m_mesh.append(QVector3D(x + 6, height + 3, 0));
-        m_mesh.append(QVector3D(x + 9, height, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
+        m_mesh.append(QVector3D(x + 2 * third, top, 0));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, 0));
         
         // Loop hole
-        m_mesh.append(QVector3D(x + 9, height, 0));
-        m_mesh.append(QVector3D(x + 6, height, 0));
-        m_mesh.append(QVector3D(x + 5, height + 1, 0));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, 0));
+        m_mesh.append(QVector3D(x + 2 * third, height, 0));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, 0));
         
-        m_mesh.append(QVector3D(x + 4, height + 1, 0));
-        m_mesh.append(QVector3D(x + 3, height, 0));
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
+        m_mesh.append(QVector3D(x + third + hole, holeTop, 0));
+        m_mesh.append(QVector3D(x + third, height, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
         
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
-        m_mesh.append(QVector3D(x + 9, height, 0));
-        m_mesh.append(QVector3D(x + 5, height + 1, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, 0));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, 0));
         
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
-        m_mesh.append(QVector3D(x + 5, height + 1, 0));
-        m_mesh.append(QVector3D(x + 4, height + 1, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, 0));
+        m_mesh.append(QVector3D(x + third + hole, holeTop, 0));
         
-        // Back face of hanger (z = 2)
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
-        m_mesh.append(QVector3D(x, height, 2));
-        m_mesh.append(QVector3D(x + 3, height, 2));
+        // Back face of hanger
+        m_mesh.append(QVector3D(x + third, top, back));
+        m_mesh.append(QVector3D(x, height, back));
+        m_mesh.append(QVector3D(x + third, height, back));
         
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
-        m_mesh.append(QVector3D(x + 3, height, 2));
-        m_mesh.append(QVector3D(x + 4, height + 1, 2));
+        m_mesh.append(QVector3D(x + third, top, back));
+        m_mesh.append(QVector3D(x + third, height, back));
+        m_mesh.append(QVector3D(x + third + hole, holeTop, back));
         
-        m_mesh.append(QVector3D(x + 9, height, 2));
-        m_mesh.append(QVector3D(x + 6, height + 3, 2));
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, back));
+        m_mesh.append(QVector3D(x + 2 * third, top, back));
+        m_mesh.append(QVector3D(x + third, top, back));
         
-        m_mesh.append(QVector3D(x + 5, height + 1, 2));
-        m_mesh.append(QVector3D(x + 6, height, 2));
-        m_mesh.append(QVector3D(x + 9, height, 2));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, back));
+        m_mesh.append(QVector3D(x + 2 * third, height, back));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, back));
         
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
-        m_mesh.append(QVector3D(x + 4, height + 1, 2));
-        m_mesh.append(QVector3D(x + 5, height + 1, 2));
+        m_mesh.append(QVector3D(x + third, top, back));
+        m_mesh.append(QVector3D(x + third + hole, holeTop, back));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, back));
         
-        m_mesh.append(QVector3D(x + 5, height + 1, 2));
-        m_mesh.append(QVector3D(x + 9, height, 2));
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, back));
+        m_mesh.append(QVector3D(x + HangerGeometry::kWidth, height, back));
+        m_mesh.append(QVector3D(x + third, top, back));
         
         // Side faces connecting front and back
         // Inner loop sides
-        m_mesh.append(QVector3D(x + 5, height + 1, 0));
-        m_mesh.append(QVector3D(x + 6, height, 0));
-        m_mesh.append(QVector3D(x + 6, height, 2));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, 0));
+        m_mesh.append(QVector3D(x + 2 * third, height, 0));
+        m_mesh.append(QVector3D(x + 2 * third, height, back));
         
-        m_mesh.append(QVector3D(x + 5, height + 1, 0));
-        m_mesh.append(QVector3D(x + 6, height, 2));
-        m_mesh.append(QVector3D(x + 5, height + 1, 2));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, 0));
+        m_mesh.append(QVector3D(x + 2 * third, height, back));
+        m_mesh.append(QVector3D(x + 2 * third - hole, holeTop, back));
         
         // Top arch
-        m_mesh.append(QVector3D(x + 6, height + 3, 0));
-        m_mesh.append(QVector3D(x + 3, height + 3, 0));
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
+        m_mesh.append(QVector3D(x + 2 * third, top, 0));
+        m_mesh.append(QVector3D(x + third, top, 0));
+        m_mesh.append(QVector3D(x + third, top, back));
         
-        m_mesh.append(QVector3D(x + 6, height + 3, 0));
-        m_mesh.append(QVector3D(x + 3, height + 3, 2));
-        m_mesh.append(QVector3D(x + 6, height + 3, 2));
+        m_mesh.append(QVector3D(x + 2 * third, top, 0));
+        m_mesh.append(QVector3D(x + third, top, back));
+        m_mesh.append(QVector3D(x + 2 * third, top, back));
         
         x += xDelta * 2;
     }
@@ -8,6 +8,10 @@
 
 #pragma once
 
+#include "heightfield.h"
+#include "core/memorystats.h"
+#include "core/progress.h"
+
 #include <QVector3D>
 #include <QImage>
 #include <QList>
@@ -15,6 +19,16 @@
 
 namespace LithoMaker {
 
+class JobContext;
+
+/**
+ * @brief Brightness-to-depth mapping
+ */
+enum class ReliefMode {
+    Linear,    ///< Depth proportional to brightness
+    BasRelief  ///< Gradient-compressed relief (more detail per mm of depth)
+};
+
 /**
  * @brief Configuration for mesh generation
  */
@@ -25,6 +39,10 @@ struct MeshConfig {
     float width{200.0f};         ///< Total width including frame (mm)
     float frameSlopeFactor{0.75f};
     
+    // Depth mapping
+    ReliefMode reliefMode{ReliefMode::Linear};
+    float reliefCompression{0.8f}; ///< Gradient attenuation exponent for bas-relief
+    
     // Stabilizers
     bool enableStabilizers{true};
     bool permanentStabilizers{false};
@@ -42,11 +60,60 @@ struct MeshConfig {
 };
 
 /**
- * @brief Progress callback type
- * @param current Current progress value
- * @param total Total progress value
+ * @brief Axis-aligned bounding box of a mesh (mm)
  */
-using ProgressCallback = std::function<void(int current, int total)>;
+struct MeshBounds {
+    QVector3D min;
+    QVector3D max;
+};
+
+/**
+ * @brief Bounding box of vertices
+ * @param vertices First vertex
+ * @param count Number of vertices
+ * @return Bounds, all zero for no vertices
+ *
+ * Large meshes are scanned in parallel.
+ */
+MeshBounds computeBounds(const QVector3D* vertices, qsizetype count);
+
+inline MeshBounds computeBounds(const QList<QVector3D>& mesh) {
+    return computeBounds(mesh.constData(), mesh.size());
+}
+
+/**
+ * @brief Stabilizer foot dimensions, shared with LayerSlicer (mm)
+ */
+namespace StabilizerGeometry {
+constexpr float kMaxWidth = 4.0f;
+constexpr float kNeckWidth = 0.6f;  ///< Detachable feet: ~1-2 extrusion lines
+constexpr float kNeckHeight = 1.5f; ///< Detachable feet: height of the weak zone
+} // namespace StabilizerGeometry
+
+/**
+ * @brief Hanger loop dimensions, shared with LayerSlicer (mm)
+ *
+ * Each loop narrows from kWidth at the frame to a third of that at the
+ * top, with a hole in its lower part.
+ */
+namespace HangerGeometry {
+constexpr float kWidth = 9.0f;
+constexpr float kHeight = 3.0f;     ///< Above the frame
+constexpr float kThickness = 2.0f;
+constexpr float kHoleHeight = 1.0f;
+} // namespace HangerGeometry
+
+/**
+ * @brief Callback receiving finished parts of the mesh during generation
+ * @param vertices First new vertex (triangles, 3 per triangle)
+ * @param count Number of new vertices
+ *
+ * Parts arrive in order and together make up the complete mesh. The
+ * pointer is only valid during the call.
+ */
+using MeshPartCallback = std::function<void(const QVector3D* vertices, qsizetype count)>;
+
+class MeshStages;
 
 /**
  * @brief Complete lithophane mesh generator
@@ -69,14 +136,27 @@ public:
      */
     const MeshConfig& config() const { return m_config; }
 
+    /**
+     * @brief Give way to interactive work while generating
+     * @param context Job the generator runs in, or nullptr
+     *
+     * The lithophane is then generated in row bands, with a checkpoint
+     * before each one.
+     */
+    void setJobContext(JobContext* context) { m_jobContext = context; }
+
     /**
      * @brief Generate the complete mesh from an image
      * @param image Grayscale image (should already be processed)
-     * @param progressCallback Optional callback for progress reporting
+     * @param progressCallback Optional callback for progress reporting,
+     *        counting generated triangles
+     * @param partCallback Optional callback receiving the lithophane in
+     *        row bands as they are finished, then the rest of the mesh
      * @return List of vertices (triangles, 3 vertices per triangle)
      */
     QList<QVector3D> generate(const QImage& image, 
-                              ProgressCallback progressCallback = nullptr);
+                              ProgressCallback progressCallback = nullptr,
+                              MeshPartCallback partCallback = nullptr);
 
     /**
      * @brief Get the last generated mesh
@@ -84,14 +164,48 @@ public:
      */
     const QList<QVector3D>& mesh() const { return m_mesh; }
 
+    /**
+     * @brief Get the lithophane surface of the last generated mesh
+     */
+    const HeightField& heightField() const { return m_heightField; }
+
+    /**
+     * @brief Number of leading vertices of mesh() that make up the
+     *        lithophane surface and its side walls
+     *
+     * The remaining vertices are the backside, frame, stabilizers and
+     * hangers.
+     */
+    qsizetype lithophaneVertexCount() const { return m_lithophaneVertexCount; }
+
     /**
      * @brief Get the total dimensions of last generated mesh
      */
     QSizeF meshDimensions() const { return m_meshDimensions; }
 
+    /**
+     * @brief Predict the bounds of the mesh for an image, without generating it
+     * @param imageSize Size of the source image in pixels
+     * @return Bounds including frame, stabilizers and hangers
+     */
+    MeshBounds predictBounds(const QSize& imageSize) const;
+
+    /**
+     * @brief Estimate the number of vertices generated for an image
+     * @param imageSize Size of the source image in pixels
+     */
+    qsizetype estimateVertexCount(const QSize& imageSize) const;
+
 private:
+    // Runs the generation stages on their own
+    friend class MeshStages;
+
     // Mesh generation helpers
-    void generateLithophane(const QImage& image);
+    QVector<float> buildDepthBuffer(const QImage& image) const;
+    void generateLithophane(const QImage& image, ProgressMeter& progress,
+                            const MeshPartCallback& partCallback);
+    void generateLithophaneRows(const float* buffer, int width, int height,
+                                int firstRow, int endRow, ProgressMeter* progress = nullptr);
     void generateBackside(const QImage& image);
     void generateFrame(float width, float height);
     void generateStabilizers(float width, float height);
@@ -99,6 +213,7 @@ private:
                               float minThickness, float totalThickness, float zDelta);
     void generateHangers(float width, float height);
     void generateSegmentedBackside(const QImage& image);
+    void checkpoint();
 
     // Vertex helpers
     QVector3D scaleVertex(float x, float y, float z) const;
@@ -106,6 +221,11 @@ private:
     MeshConfig m_config;
     QList<QVector3D> m_mesh;
     QSizeF m_meshDimensions;
+    HeightField m_heightField;
+    MemoryLease m_meshMemory{MemorySubsystem::Mesh};
+    MemoryLease m_heightFieldMemory{MemorySubsystem::DepthBuffer};
+    qsizetype m_lithophaneVertexCount{0};
+    JobContext* m_jobContext{nullptr};
     
     // Computed values during generation
     float m_widthFactor{1.0f};
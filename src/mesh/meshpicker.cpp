@@ -0,0 +1,190 @@
+/**
+ * @file meshpicker.cpp
+ * @brief Fast ray picking on generated and imported meshes implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "meshpicker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+namespace LithoMaker {
+
+namespace {
+
+constexpr int kLeafSize = 4;
+constexpr int kMaxDepth = 48;
+constexpr float kInfinity = std::numeric_limits<float>::infinity();
+
+QVector3D minVector(const QVector3D& a, const QVector3D& b) {
+    return QVector3D(std::min(a.x(), b.x()), std::min(a.y(), b.y()), std::min(a.z(), b.z()));
+}
+
+QVector3D maxVector(const QVector3D& a, const QVector3D& b) {
+    return QVector3D(std::max(a.x(), b.x()), std::max(a.y(), b.y()), std::max(a.z(), b.z()));
+}
+
+// Slab test; returns the entry distance or infinity
+float intersectBox(const QVector3D& origin, const QVector3D& inverseDirection,
+                   const QVector3D& min, const QVector3D& max, float tMax) {
+    float tEnter = 0.0f;
+    float tExit = tMax;
+    for (int axis = 0; axis < 3; ++axis) {
+        float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+        float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+        if (t0 > t1) {
+            std::swap(t0, t1);
+        }
+        // NaN (0 * inf on a slab boundary) must not shrink the interval
+        tEnter = t0 > tEnter ? t0 : tEnter;
+        tExit = t1 < tExit ? t1 : tExit;
+    }
+    return tEnter <= tExit ? tEnter : kInfinity;
+}
+
+} // namespace
+
+MeshPicker::MeshPicker(HeightField heightField, const QVector3D* triangles, qsizetype vertexCount)
+    : m_heightField(std::move(heightField))
+{
+    const int triangleCount = static_cast<int>(vertexCount / 3);
+    m_triangles.reserve(triangleCount * 3);
+    for (qsizetype i = 0; i < triangleCount * 3; ++i) {
+        m_triangles.append(triangles[i]);
+    }
+
+    m_order.resize(triangleCount);
+    for (int i = 0; i < triangleCount; ++i) {
+        m_order[i] = i;
+    }
+    if (triangleCount > 0) {
+        m_nodes.reserve(2 * triangleCount / kLeafSize + 1);
+        build(0, triangleCount, 0);
+    }
+}
+
+int MeshPicker::build(int first, int count, int depth) {
+    const int index = static_cast<int>(m_nodes.size());
+    m_nodes.push_back(Node());
+
+    QVector3D min(kInfinity, kInfinity, kInfinity);
+    QVector3D max(-kInfinity, -kInfinity, -kInfinity);
+    QVector3D centroidMin = min;
+    QVector3D centroidMax = max;
+    for (int i = first; i < first + count; ++i) {
+        const QVector3D* v = m_triangles.constData() + m_order[i] * 3;
+        min = minVector(min, minVector(v[0], minVector(v[1], v[2])));
+        max = maxVector(max, maxVector(v[0], maxVector(v[1], v[2])));
+        const QVector3D centroid = (v[0] + v[1] + v[2]) / 3.0f;
+        centroidMin = minVector(centroidMin, centroid);
+        centroidMax = maxVector(centroidMax, centroid);
+    }
+    m_nodes[index].min = min;
+    m_nodes[index].max = max;
+
+    if (count <= kLeafSize || depth >= kMaxDepth) {
+        m_nodes[index].first = first;
+        m_nodes[index].count = count;
+        return index;
+    }
+
+    // Median split along the widest spread of triangle centroids
+    const QVector3D extent = centroidMax - centroidMin;
+    const int axis = extent.x() >= extent.y() && extent.x() >= extent.z() ? 0
+                   : extent.y() >= extent.z() ? 1 : 2;
+    const int middle = first + count / 2;
+    std::nth_element(m_order.begin() + first, m_order.begin() + middle, m_order.begin() + first + count,
+                     [this, axis](int a, int b) {
+        const QVector3D* va = m_triangles.constData() + a * 3;
+        const QVector3D* vb = m_triangles.constData() + b * 3;
+        return va[0][axis] + va[1][axis] + va[2][axis] < vb[0][axis] + vb[1][axis] + vb[2][axis];
+    });
+
+    build(first, middle - first, depth + 1); // Left child follows its parent
+    const int right = build(middle, first + count - middle, depth + 1);
+    m_nodes[index].first = right;
+    return index;
+}
+
+bool MeshPicker::intersectBvh(const QVector3D& origin, const QVector3D& direction,
+                              SurfaceHit& hit) const {
+    if (m_nodes.empty()) {
+        return false;
+    }
+
+    const QVector3D inverseDirection(1.0f / direction.x(), 1.0f / direction.y(), 1.0f / direction.z());
+    float nearest = hit.distance;
+    int nearestTriangle = -1;
+
+    int stack[2 * kMaxDepth + 2];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const Node& node = m_nodes[stack[--stackSize]];
+        if (intersectBox(origin, inverseDirection, node.min, node.max, nearest) == kInfinity) {
+            continue;
+        }
+        if (node.count == 0) {
+            const int left = static_cast<int>(&node - m_nodes.data()) + 1;
+            stack[stackSize++] = node.first;
+            stack[stackSize++] = left;
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; ++i) {
+            const QVector3D* v = m_triangles.constData() + m_order[i] * 3;
+            // Moller-Trumbore
+            const QVector3D edge1 = v[1] - v[0];
+            const QVector3D edge2 = v[2] - v[0];
+            const QVector3D p = QVector3D::crossProduct(direction, edge2);
+            const float det = QVector3D::dotProduct(edge1, p);
+            if (std::abs(det) < 1e-12f) {
+                continue;
+            }
+            const float invDet = 1.0f / det;
+            const QVector3D s = origin - v[0];
+            const float u = QVector3D::dotProduct(s, p) * invDet;
+            if (u < 0.0f || u > 1.0f) {
+                continue;
+            }
+            const QVector3D q = QVector3D::crossProduct(s, edge1);
+            const float w = QVector3D::dotProduct(direction, q) * invDet;
+            if (w < 0.0f || u + w > 1.0f) {
+                continue;
+            }
+            const float t = QVector3D::dotProduct(edge2, q) * invDet;
+            if (t >= 0.0f && t < nearest) {
+                nearest = t;
+                nearestTriangle = m_order[i];
+            }
+        }
+    }
+
+    if (nearestTriangle < 0) {
+        return false;
+    }
+
+    const QVector3D* v = m_triangles.constData() + nearestTriangle * 3;
+    hit = SurfaceHit();
+    hit.distance = nearest;
+    hit.position = origin + direction * nearest;
+    hit.normal = QVector3D::crossProduct(v[1] - v[0], v[2] - v[0]).normalized();
+    return true;
+}
+
+bool MeshPicker::pick(const QVector3D& origin, const QVector3D& direction, SurfaceHit& hit) const {
+    SurfaceHit nearest;
+    nearest.distance = kInfinity;
+    bool found = m_heightField.intersect(origin, direction, nearest);
+    found = intersectBvh(origin, direction, nearest) || found;
+    if (found) {
+        hit = nearest;
+    }
+    return found;
+}
+
+} // namespace LithoMaker
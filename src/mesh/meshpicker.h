@@ -0,0 +1,61 @@
+/**
+ * @file meshpicker.h
+ * @brief Fast ray picking on generated and imported meshes
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "heightfield.h"
+
+#include <QList>
+#include <QVector3D>
+
+#include <vector>
+
+namespace LithoMaker {
+
+/**
+ * @brief Answers "what is under this ray" for the preview
+ *
+ * The lithophane surface is queried through its HeightField, and all
+ * other triangles (frame, backside, stabilizers, hangers, or a whole
+ * imported mesh) through a bounding volume hierarchy. Both are
+ * sublinear, so picking stays interactive for any mesh size.
+ */
+class MeshPicker {
+public:
+    /**
+     * @param heightField Lithophane surface, may be empty
+     * @param triangles Other triangles (3 vertices per triangle)
+     */
+    MeshPicker(HeightField heightField, const QVector3D* triangles, qsizetype vertexCount);
+
+    /**
+     * @brief Find the nearest surface along a ray
+     * @param origin Ray origin
+     * @param direction Ray direction, need not be normalized
+     * @param hit Receives the nearest hit
+     */
+    bool pick(const QVector3D& origin, const QVector3D& direction, SurfaceHit& hit) const;
+
+private:
+    struct Node {
+        QVector3D min;
+        QVector3D max;
+        int first{0};  ///< First triangle (leaf) or right child (inner node)
+        int count{0};  ///< Triangle count; 0 for inner nodes
+    };
+
+    int build(int first, int count, int depth);
+    bool intersectBvh(const QVector3D& origin, const QVector3D& direction, SurfaceHit& hit) const;
+
+    HeightField m_heightField;
+    QList<QVector3D> m_triangles;
+    std::vector<int> m_order; ///< Triangle indices, grouped by leaf
+    std::vector<Node> m_nodes;
+};
+
+} // namespace LithoMaker
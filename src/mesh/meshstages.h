@@ -0,0 +1,45 @@
+/**
+ * @file meshstages.h
+ * @brief Access to MeshGenerator's generation stages one at a time
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "meshgenerator.h"
+
+namespace LithoMaker {
+
+/**
+ * @brief Runs single stages of a MeshGenerator
+ *
+ * Internal; not used by the application, only by tools that time the
+ * stages on their own, such as the kernel benchmarks. The generator's
+ * scale factors are those of its last generate() call, so that is run on
+ * the image first.
+ */
+class MeshStages {
+public:
+    explicit MeshStages(MeshGenerator& generator) : m_generator(generator) {}
+
+    QVector<float> depthBuffer(const QImage& image) const {
+        return m_generator.buildDepthBuffer(image);
+    }
+
+    /**
+     * @brief Emit the lithophane surface of a depth buffer
+     * @return Number of vertices emitted
+     */
+    qsizetype surfaceRows(const QVector<float>& buffer, int width, int height) {
+        m_generator.m_mesh.clear(); // Keeps the capacity, so only emission is timed
+        m_generator.generateLithophaneRows(buffer.constData(), width, height, 0, height - 1);
+        return m_generator.m_mesh.size();
+    }
+
+private:
+    MeshGenerator& m_generator;
+};
+
+} // namespace LithoMaker
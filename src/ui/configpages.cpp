@@ -40,6 +40,17 @@ RenderPage::RenderPage(QWidget* parent)
     auto* stabFactor = new LineEdit("render", "stabilizerHeightFactor", "0.15");
     connect(resetButton, &QPushButton::clicked, stabFactor, &LineEdit::resetToDefault);
 
+    auto* reliefLabel = new QLabel(tr("Relief mode:"));
+    auto* reliefMode = new ComboBox("render", "reliefMode", "linear");
+    reliefMode->addConfigItem(tr("Linear"), "linear");
+    reliefMode->addConfigItem(tr("Bas-relief (compressed gradients)"), "basrelief");
+    reliefMode->setFromConfig();
+    connect(resetButton, &QPushButton::clicked, reliefMode, &ComboBox::resetToDefault);
+
+    auto* compressionLabel = new QLabel(tr("Bas-relief compression (0.1-1.0):"));
+    auto* compression = new LineEdit("render", "reliefCompression", "0.8");
+    connect(resetButton, &QPushButton::clicked, compression, &LineEdit::resetToDefault);
+
     auto* slopeLabel = new QLabel(tr("Frame slope factor:"));
     auto* slopeFactor = new LineEdit("render", "frameSlopeFactor", "0.75");
     connect(resetButton, &QPushButton::clicked, slopeFactor, &LineEdit::resetToDefault);
@@ -52,6 +63,10 @@ RenderPage::RenderPage(QWidget* parent)
     auto* hangersSlider = new Slider("render", "hangers", 1, 4, 2, 1);
     connect(resetButton, &QPushButton::clicked, hangersSlider, &Slider::resetToDefault);
 
+    auto* layerHeightLabel = new QLabel(tr("Layer height for layer preview (mm):"));
+    auto* layerHeight = new LineEdit("render", "layerHeight", "0.2");
+    connect(resetButton, &QPushButton::clicked, layerHeight, &LineEdit::resetToDefault);
+
     auto* layout = new QVBoxLayout(this);
     layout->addWidget(resetButton);
     layout->addWidget(enableStabilizers);
@@ -60,11 +75,17 @@ RenderPage::RenderPage(QWidget* parent)
     layout->addWidget(stabThreshold);
     layout->addWidget(stabFactorLabel);
     layout->addWidget(stabFactor);
+    layout->addWidget(reliefLabel);
+    layout->addWidget(reliefMode);
+    layout->addWidget(compressionLabel);
+    layout->addWidget(compression);
     layout->addWidget(slopeLabel);
     layout->addWidget(slopeFactor);
     layout->addWidget(enableHangers);
     layout->addWidget(hangersLabel);
     layout->addWidget(hangersSlider);
+    layout->addWidget(layerHeightLabel);
+    layout->addWidget(layerHeight);
     layout->addStretch();
 }
 
@@ -84,11 +105,57 @@ ExportPage::ExportPage(QWidget* parent)
                                         tr("Always overwrite existing file"), false);
     connect(resetButton, &QPushButton::clicked, overwriteCheck, &CheckBox::resetToDefault);
 
+    auto* writerLabel = new QLabel(tr("File writing:"));
+    auto* writerCombo = new ComboBox("export", "writerBackend", "auto");
+    writerCombo->addConfigItem(tr("Automatic"), "auto");
+    writerCombo->addConfigItem(tr("Background thread"), "threaded");
+#ifdef HAVE_IO_URING
+    writerCombo->addConfigItem(tr("io_uring (Linux)"), "io_uring");
+#endif
+    writerCombo->addConfigItem(tr("Direct (no overlap)"), "direct");
+    writerCombo->setFromConfig();
+    connect(resetButton, &QPushButton::clicked, writerCombo, &ComboBox::resetToDefault);
+
+    auto* profileCheck = new CheckBox("export", "3mfProfile",
+                                      tr("3MF: embed lithophane slicer profile (PrusaSlicer)"), true);
+    connect(resetButton, &QPushButton::clicked, profileCheck, &CheckBox::resetToDefault);
+
+    auto* uprightCheck = new CheckBox("export", "3mfUpright",
+                                      tr("3MF: place upright on the bed for printing"), true);
+    connect(resetButton, &QPushButton::clicked, uprightCheck, &CheckBox::resetToDefault);
+
+    auto* thumbnailCheck = new CheckBox("export", "3mfThumbnail",
+                                        tr("3MF: include thumbnail"), true);
+    connect(resetButton, &QPushButton::clicked, thumbnailCheck, &CheckBox::resetToDefault);
+
+    auto* bedWidthLabel = new QLabel(tr("Bed width (mm):"));
+    auto* bedWidth = new LineEdit("export", "bedWidth", "250.0");
+    connect(resetButton, &QPushButton::clicked, bedWidth, &LineEdit::resetToDefault);
+
+    auto* bedDepthLabel = new QLabel(tr("Bed depth (mm):"));
+    auto* bedDepth = new LineEdit("export", "bedDepth", "210.0");
+    connect(resetButton, &QPushButton::clicked, bedDepth, &LineEdit::resetToDefault);
+
+    auto* spacingLabel = new QLabel(tr("Plate batch: spacing between objects (mm):"));
+    auto* spacing = new LineEdit("export", "plateSpacing", "5.0");
+    connect(resetButton, &QPushButton::clicked, spacing, &LineEdit::resetToDefault);
+
     auto* layout = new QVBoxLayout(this);
     layout->addWidget(resetButton);
     layout->addWidget(formatLabel);
     layout->addWidget(formatCombo);
     layout->addWidget(overwriteCheck);
+    layout->addWidget(writerLabel);
+    layout->addWidget(writerCombo);
+    layout->addWidget(profileCheck);
+    layout->addWidget(uprightCheck);
+    layout->addWidget(thumbnailCheck);
+    layout->addWidget(bedWidthLabel);
+    layout->addWidget(bedWidth);
+    layout->addWidget(bedDepthLabel);
+    layout->addWidget(bedDepth);
+    layout->addWidget(spacingLabel);
+    layout->addWidget(spacing);
     layout->addStretch();
 }
 
@@ -0,0 +1,359 @@
+/**
+ * @file jobqueuepanel.cpp
+ * @brief Queue of dropped images meshed in the background implementation
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "jobqueuepanel.h"
+#include "pipelinesettings.h"
+#include "core/imageloader.h"
+#include "core/jobscheduler.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPointer>
+#include <QPushButton>
+#include <QSignalBlocker>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <algorithm>
+#include <utility>
+
+namespace LithoMaker {
+
+namespace {
+
+// Images are scaled down like an accepted preview resize
+constexpr int kMaxImageSize = 2000;
+
+// Meshes kept for previewing; a 2000 px image makes about 290 MB. The
+// most recently used one is always kept.
+constexpr qint64 kMeshCacheBytes = qint64(512) * 1024 * 1024;
+
+enum Column {
+    ImageColumn,
+    StateColumn,
+    TimeColumn,
+    TrianglesColumn
+};
+
+// Runs on the UI thread, unless the panel is gone by then. Posted to
+// the application, which outlives the jobs, rather than to the panel.
+template <typename Function>
+void post(const QPointer<JobQueuePanel>& panel, Function function) {
+    QMetaObject::invokeMethod(QCoreApplication::instance(), [panel, function]() {
+        if (panel) {
+            function(panel.data());
+        }
+    }, Qt::QueuedConnection);
+}
+
+std::shared_ptr<QueuedMesh> generateMesh(const QString& input, const QImage& image,
+                                         const MeshConfig& config, JobContext& context) {
+    MeshGenerator generator(config);
+    generator.setJobContext(&context);
+    QList<QVector3D> mesh = generator.generate(image);
+    if (mesh.isEmpty()) {
+        return nullptr;
+    }
+    auto result = std::make_shared<QueuedMesh>();
+    result->input = input;
+    result->mesh = std::move(mesh);
+    result->heightField = generator.heightField();
+    result->config = config;
+    result->dimensions = generator.meshDimensions();
+    result->lithophaneVertexCount = generator.lithophaneVertexCount();
+    result->meshMemory.resize(result->mesh.capacity() * qint64(sizeof(QVector3D)));
+    result->heightFieldMemory.resize(qint64(result->heightField.width()) *
+                                     result->heightField.height() * qint64(sizeof(float)));
+    return result;
+}
+
+qint64 meshBytes(const QueuedMesh& mesh) {
+    return mesh.meshMemory.bytes() + mesh.heightFieldMemory.bytes();
+}
+
+} // namespace
+
+JobQueuePanel::JobQueuePanel(QWidget* parent)
+    : QWidget(parent)
+{
+    auto* layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_summaryLabel = new QLabel();
+    layout->addWidget(m_summaryLabel);
+
+    m_list = new QTreeWidget();
+    m_list->setRootIsDecorated(false);
+    m_list->setUniformRowHeights(true);
+    m_list->setHeaderLabels({tr("Image"), tr("Status"), tr("Time"), tr("Triangles")});
+    m_list->header()->setSectionResizeMode(ImageColumn, QHeaderView::Stretch);
+    m_list->header()->setStretchLastSection(false);
+    for (int column : {StateColumn, TimeColumn, TrianglesColumn}) {
+        m_list->header()->setSectionResizeMode(column, QHeaderView::ResizeToContents);
+    }
+    m_list->setToolTip(tr("Select a finished image to preview it"));
+    connect(m_list, &QTreeWidget::currentItemChanged, this, &JobQueuePanel::onCurrentItemChanged);
+    layout->addWidget(m_list);
+
+    auto* buttonLayout = new QHBoxLayout();
+    m_cancelButton = new QPushButton(tr("Cancel Queued"));
+    connect(m_cancelButton, &QPushButton::clicked, this, &JobQueuePanel::cancelQueued);
+    buttonLayout->addWidget(m_cancelButton);
+    m_clearButton = new QPushButton(tr("Clear Finished"));
+    connect(m_clearButton, &QPushButton::clicked, this, &JobQueuePanel::clearFinished);
+    buttonLayout->addWidget(m_clearButton);
+    buttonLayout->addStretch();
+    layout->addLayout(buttonLayout);
+
+    updateSummary();
+}
+
+JobQueuePanel::~JobQueuePanel() {
+    JobScheduler& scheduler = JobScheduler::instance();
+    scheduler.cancelPending(JobPriority::Batch);
+    scheduler.waitForIdle();
+}
+
+void JobQueuePanel::addImages(const QStringList& paths, const MeshConfig& config,
+                              bool flipVertically) {
+    const QPointer<JobQueuePanel> panel(this);
+    for (const QString& path : paths) {
+        Job job;
+        job.id = m_nextId++;
+        job.path = path;
+        job.config = config;
+        job.item = new QTreeWidgetItem(m_list, {QFileInfo(path).fileName()});
+        job.item->setToolTip(ImageColumn, path);
+        job.item->setData(ImageColumn, Qt::UserRole, job.id);
+        for (int column : {TimeColumn, TrianglesColumn}) {
+            job.item->setTextAlignment(column, Qt::AlignRight | Qt::AlignVCenter);
+        }
+        m_jobs.append(job);
+        updateItem(job);
+
+        const int id = job.id;
+        JobScheduler::instance().submit(JobPriority::Batch,
+            [panel, id, path, config, flipVertically](JobContext& context) {
+                post(panel, [id](JobQueuePanel* p) { p->jobStarted(id); });
+
+                QElapsedTimer timer;
+                timer.start();
+                QImage image;
+                std::shared_ptr<QueuedMesh> mesh;
+                QString error;
+                const auto loaded = ImageLoader::load(path, kMaxImageSize, true);
+                if (!loaded) {
+                    error = tr("Cannot read the image");
+                } else {
+                    // Kept in the format the generator converts to
+                    image = prepareLithophaneImage(loaded->image, flipVertically)
+                                .convertToFormat(QImage::Format_Grayscale8);
+                    mesh = generateMesh(path, image, config, context);
+                    if (!mesh) {
+                        error = tr("Mesh generation failed");
+                    }
+                }
+                const qint64 ms = timer.elapsed();
+                post(panel, [id, ms, image, mesh, error](JobQueuePanel* p) {
+                    p->jobFinished(id, ms, image, mesh, error);
+                });
+            });
+    }
+    updateSummary();
+}
+
+JobQueuePanel::Job* JobQueuePanel::findJob(int id) {
+    for (Job& job : m_jobs) {
+        if (job.id == id) {
+            return &job;
+        }
+    }
+    return nullptr;
+}
+
+void JobQueuePanel::jobStarted(int id) {
+    Job* job = findJob(id);
+    if (job && job->state == State::Queued) {
+        job->state = State::Running;
+        updateItem(*job);
+        updateSummary();
+    }
+}
+
+void JobQueuePanel::jobFinished(int id, qint64 ms, const QImage& image,
+                                std::shared_ptr<const QueuedMesh> mesh,
+                                const QString& errorMessage) {
+    Job* job = findJob(id);
+    if (!job) {
+        return; // Cleared meanwhile
+    }
+    job->state = mesh ? State::Done : State::Failed;
+    job->ms = ms;
+    job->errorMessage = errorMessage;
+    if (mesh) {
+        job->image = image;
+        job->imageMemory.resize(image.sizeInBytes());
+        job->triangles = mesh->mesh.size() / 3;
+        cacheMesh(*job, mesh);
+    }
+    updateItem(*job);
+    updateSummary();
+
+    // Selected while it was running
+    if (mesh && m_list->currentItem() == job->item) {
+        emit meshSelected(std::move(mesh));
+    }
+}
+
+void JobQueuePanel::meshRegenerated(int id, std::shared_ptr<const QueuedMesh> mesh) {
+    Job* job = findJob(id);
+    if (!job) {
+        return;
+    }
+    job->regenerating = false;
+    if (mesh) {
+        cacheMesh(*job, mesh);
+    }
+    updateItem(*job);
+    if (mesh && m_list->currentItem() == job->item) {
+        emit meshSelected(std::move(mesh));
+    }
+}
+
+void JobQueuePanel::onCurrentItemChanged(QTreeWidgetItem* current) {
+    if (!current) {
+        return;
+    }
+    Job* job = findJob(current->data(ImageColumn, Qt::UserRole).toInt());
+    if (job) {
+        showJob(*job);
+    }
+}
+
+void JobQueuePanel::showJob(Job& job) {
+    if (job.mesh) {
+        const std::shared_ptr<const QueuedMesh> mesh = job.mesh;
+        cacheMesh(job, mesh); // Most recently used now
+        emit meshSelected(mesh);
+        return;
+    }
+    if (job.state != State::Done || job.regenerating) {
+        return;
+    }
+
+    // Dropped from the cache; someone is waiting for it this time
+    job.regenerating = true;
+    updateItem(job);
+    const QPointer<JobQueuePanel> panel(this);
+    JobScheduler::instance().submit(JobPriority::Interactive,
+        [panel, id = job.id, path = job.path, image = job.image,
+         config = job.config](JobContext& context) {
+            const std::shared_ptr<QueuedMesh> mesh = generateMesh(path, image, config, context);
+            post(panel, [id, mesh](JobQueuePanel* p) { p->meshRegenerated(id, mesh); });
+        });
+}
+
+void JobQueuePanel::cacheMesh(Job& job, std::shared_ptr<const QueuedMesh> mesh) {
+    job.mesh = std::move(mesh);
+    m_cachedMeshes.removeAll(job.id);
+    m_cachedMeshes.append(job.id);
+
+    qint64 bytes = 0;
+    for (int id : m_cachedMeshes) {
+        bytes += meshBytes(*findJob(id)->mesh);
+    }
+    while (bytes > kMeshCacheBytes && m_cachedMeshes.size() > 1) {
+        Job* oldest = findJob(m_cachedMeshes.takeFirst());
+        bytes -= meshBytes(*oldest->mesh);
+        oldest->mesh.reset(); // Unless it is being previewed
+    }
+}
+
+void JobQueuePanel::cancelQueued() {
+    JobScheduler::instance().cancelPending(JobPriority::Batch);
+    for (Job& job : m_jobs) {
+        if (job.state == State::Queued) {
+            job.state = State::Cancelled;
+            updateItem(job);
+        }
+    }
+    updateSummary();
+}
+
+void JobQueuePanel::clearFinished() {
+    // Removing the current item must not preview another one
+    const QSignalBlocker blocker(m_list);
+    for (auto it = m_jobs.begin(); it != m_jobs.end();) {
+        if (it->state == State::Queued || it->state == State::Running) {
+            ++it;
+            continue;
+        }
+        // Frees the cached mesh, unless it is being previewed
+        m_cachedMeshes.removeAll(it->id);
+        delete it->item;
+        it = m_jobs.erase(it);
+    }
+    updateSummary();
+}
+
+void JobQueuePanel::updateItem(const Job& job) {
+    QString state;
+    switch (job.state) {
+    case State::Queued:
+        state = tr("Queued");
+        break;
+    case State::Running:
+        state = tr("Running");
+        break;
+    case State::Done:
+        state = job.regenerating ? tr("Generating") : tr("Done");
+        break;
+    case State::Failed:
+        state = tr("Failed");
+        break;
+    case State::Cancelled:
+        state = tr("Cancelled");
+        break;
+    }
+    job.item->setText(StateColumn, state);
+    job.item->setToolTip(StateColumn, job.errorMessage);
+    const bool finished = job.state == State::Done || job.state == State::Failed;
+    job.item->setText(TimeColumn, finished ? tr("%1 s").arg(job.ms / 1000.0, 0, 'f', 1)
+                                           : QString());
+    job.item->setText(TrianglesColumn, job.triangles > 0 ? QString::number(job.triangles)
+                                                         : QString());
+}
+
+void JobQueuePanel::updateSummary() {
+    int done = 0;
+    int failed = 0;
+    int pending = 0;
+    qint64 busyMs = 0;
+    for (const Job& job : m_jobs) {
+        done += job.state == State::Done ? 1 : 0;
+        failed += job.state == State::Failed ? 1 : 0;
+        pending += job.state == State::Queued || job.state == State::Running ? 1 : 0;
+        busyMs += job.ms;
+    }
+    QString text = tr("%1 of %2 images done").arg(done).arg(m_jobs.size());
+    if (failed > 0) {
+        text += tr(", %1 failed").arg(failed);
+    }
+    if (done + failed > 0) {
+        text += tr(", %1 s per image").arg(busyMs / 1000.0 / (done + failed), 0, 'f', 1);
+    }
+    m_summaryLabel->setText(text);
+    m_cancelButton->setEnabled(pending > 0);
+    m_clearButton->setEnabled(pending < m_jobs.size());
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,122 @@
+/**
+ * @file jobqueuepanel.h
+ * @brief Queue of dropped images meshed in the background
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include <QWidget>
+#include <QImage>
+#include <QList>
+#include <QSizeF>
+#include <QVector3D>
+#include <memory>
+
+#include "core/memorystats.h"
+#include "mesh/heightfield.h"
+#include "mesh/meshgenerator.h"
+
+class QLabel;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+namespace LithoMaker {
+
+/**
+ * @brief Mesh generated by a queued job, kept for previewing
+ */
+struct QueuedMesh {
+    QString input;
+    QList<QVector3D> mesh;
+    HeightField heightField;
+    MeshConfig config;
+    QSizeF dimensions;
+    qsizetype lithophaneVertexCount{0};
+    MemoryLease meshMemory{MemorySubsystem::Mesh};
+    MemoryLease heightFieldMemory{MemorySubsystem::DepthBuffer};
+};
+
+/**
+ * @brief List of images being meshed by the job scheduler
+ *
+ * Every image becomes a batch job, so several are generated in parallel
+ * and they pause while a preview is generated. The list shows the
+ * state and time of each job, and selecting a finished one offers its
+ * mesh for previewing. Only the most recently used meshes are kept;
+ * the others are generated again from their prepared image, which is
+ * far smaller, when selected.
+ */
+class JobQueuePanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit JobQueuePanel(QWidget* parent = nullptr);
+
+    /**
+     * @brief Waits for the running jobs; queued ones are dropped
+     */
+    ~JobQueuePanel() override;
+
+    /**
+     * @brief Queue images for meshing
+     * @param config Mesh settings for all of them
+     * @param flipVertically Mirror the images, as for a preview
+     */
+    void addImages(const QStringList& paths, const MeshConfig& config, bool flipVertically);
+
+signals:
+    void meshSelected(std::shared_ptr<const QueuedMesh> mesh);
+
+private slots:
+    void onCurrentItemChanged(QTreeWidgetItem* current);
+    void cancelQueued();
+    void clearFinished();
+
+private:
+    enum class State {
+        Queued,
+        Running,
+        Done,
+        Failed,
+        Cancelled
+    };
+
+    struct Job {
+        int id{0};
+        QString path;
+        State state{State::Queued};
+        qint64 ms{0};
+        qint64 triangles{0};
+        QString errorMessage;
+        QImage image; // Prepared source, to generate the mesh again
+        MemoryLease imageMemory{MemorySubsystem::Image};
+        MeshConfig config;
+        std::shared_ptr<const QueuedMesh> mesh; // Unless dropped from the cache
+        bool regenerating{false};
+        QTreeWidgetItem* item{nullptr};
+    };
+
+    Job* findJob(int id);
+    void jobStarted(int id);
+    void jobFinished(int id, qint64 ms, const QImage& image,
+                     std::shared_ptr<const QueuedMesh> mesh, const QString& errorMessage);
+    void meshRegenerated(int id, std::shared_ptr<const QueuedMesh> mesh);
+    void showJob(Job& job);
+    void cacheMesh(Job& job, std::shared_ptr<const QueuedMesh> mesh);
+    void updateItem(const Job& job);
+    void updateSummary();
+
+    QTreeWidget* m_list{nullptr};
+    QLabel* m_summaryLabel{nullptr};
+    QPushButton* m_cancelButton{nullptr};
+    QPushButton* m_clearButton{nullptr};
+    QList<Job> m_jobs;
+    QList<int> m_cachedMeshes; // Jobs with a mesh, least recently used first
+    int m_nextId{0};
+};
+
+} // namespace LithoMaker
@@ -7,18 +7,21 @@
  */
 
 #include "mainwindow.h"
-#ifndef BUILD_WASM
 #include "previewwidget.h"
-#endif
+#include "jobqueuepanel.h"
+#include "mesh/layerslicer.h"
+#include "mesh/meshpicker.h"
 #include "widgets/slider.h"
 #include "aboutbox.h"
 #include "configdialog.h"
+#include "pipelinesettings.h"
 
 #include "core/settings.h"
 #include "core/imageloader.h"
-#include "export/stlexporter.h"
-#include "export/objexporter.h"
-#include "export/threemfexporter.h"
+#include "core/jobscheduler.h"
+#include "export/compressedwriter.h"
+#include "export/platebatch.h"
+#include "export/importer.h"
 #include "version.h"
 
 #include <QVBoxLayout>
@@ -30,10 +33,12 @@
 #include <QPushButton>
 #include <QComboBox>
 #include <QProgressBar>
+#include <QSlider>
 #include <QMenuBar>
 #include <QMenu>
 #include <QAction>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
 #include <QMimeData>
 #include <QDragEnterEvent>
@@ -41,6 +46,10 @@
 #include <QDebug>
 #include <QApplication>
 #include <QStatusBar>
+#include <QTimer>
+#include <QImageReader>
+#include <QtMath>
+#include <cmath>
 #include <utility>
 
 namespace LithoMaker {
@@ -133,8 +142,15 @@ void MainWindow::createWidgets() {
     m_exportFormatCombo = new QComboBox();
     m_exportFormatCombo->addItem("STL (Binary)", "stl_bin");
     m_exportFormatCombo->addItem("STL (ASCII)", "stl_ascii");
+    if (CompressedFileWriter::isSupported(Compression::Gzip)) {
+        m_exportFormatCombo->addItem("STL (Binary, gzip)", "stl_gz");
+    }
+    if (CompressedFileWriter::isSupported(Compression::Zstd)) {
+        m_exportFormatCombo->addItem("STL (Binary, zstd)", "stl_zst");
+    }
     m_exportFormatCombo->addItem("OBJ", "obj");
     m_exportFormatCombo->addItem("3MF", "3mf");
+    m_exportFormatCombo->addItem("glTF Binary (GLB)", "glb");
     connect(m_exportFormatCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), 
             this, &MainWindow::onExportFormatChanged);
     formatLayout->addWidget(m_exportFormatCombo);
@@ -170,37 +186,88 @@ void MainWindow::createWidgets() {
     m_progressBar->setVisible(false);
     controlsLayout->addWidget(m_progressBar);
 
+#ifndef BUILD_WASM
+    // Images dropped together; shown with the first of them
+    m_jobQueue = new JobQueuePanel();
+    m_jobQueue->setVisible(false);
+    connect(m_jobQueue, &JobQueuePanel::meshSelected, this, &MainWindow::showQueuedMesh);
+    controlsLayout->addWidget(m_jobQueue, 1);
+#endif
+
     controlsLayout->addStretch();
 
-#ifndef BUILD_WASM
     // Right panel - 3D preview
     m_previewWidget = new PreviewWidget();
 
+    // Print layer scrubber; the top position shows the whole mesh
+    m_layerSlider = new QSlider(Qt::Vertical);
+    m_layerSlider->setToolTip(tr("Print layer"));
+    m_layerSlider->setVisible(false);
+    connect(m_layerSlider, &QSlider::valueChanged, this, [this](int value) {
+        m_previewWidget->setLayer(value < m_layerSlider->maximum() ? value : -1);
+    });
+
+    auto* previewContainer = new QWidget();
+    auto* previewLayout = new QHBoxLayout(previewContainer);
+    previewLayout->setContentsMargins(0, 0, 0, 0);
+    previewLayout->addWidget(m_previewWidget, 1);
+    previewLayout->addWidget(m_layerSlider);
+
     splitter->addWidget(controlsWidget);
-    splitter->addWidget(m_previewWidget);
+    splitter->addWidget(previewContainer);
     splitter->setStretchFactor(0, 1);
     splitter->setStretchFactor(1, 2);
-#else
-    // WASM: No 3D preview, just use controls
-    splitter->addWidget(controlsWidget);
-    auto* placeholder = new QLabel(tr("3D Preview not available in browser version"));
-    placeholder->setAlignment(Qt::AlignCenter);
-    splitter->addWidget(placeholder);
-    splitter->setStretchFactor(0, 1);
-    splitter->setStretchFactor(1, 1);
-#endif
 
     mainLayout->addWidget(splitter);
 
     // Status bar
     m_statusLabel = new QLabel(tr("Ready"));
     statusBar()->addWidget(m_statusLabel);
+
+    // Surface readout under the cursor, and click-to-measure distances
+    m_surfaceLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_surfaceLabel);
+    connect(m_previewWidget, &PreviewWidget::surfaceHovered, this, [this](const SurfaceHit& hit) {
+        QString text = tr("X %1  Y %2  Z %3 mm")
+            .arg(double(hit.position.x()), 0, 'f', 2)
+            .arg(double(hit.position.y()), 0, 'f', 2)
+            .arg(double(hit.position.z()), 0, 'f', 2);
+        if (hit.onLithophane) {
+            const double slope = qRadiansToDegrees(std::atan(double(hit.gradient.length())));
+            text += tr("  |  thickness %1 mm, slope %2°")
+                .arg(double(hit.thickness), 0, 'f', 2)
+                .arg(slope, 0, 'f', 1);
+        }
+        m_surfaceLabel->setText(text);
+    });
+    connect(m_previewWidget, &PreviewWidget::surfaceLeft, m_surfaceLabel, &QLabel::clear);
+    connect(m_previewWidget, &PreviewWidget::distanceMeasured, this, [this](float distance) {
+        m_statusLabel->setText(tr("Measured distance: %1 mm").arg(double(distance), 0, 'f', 2));
+    });
+
+    // Memory held by the pipeline, per subsystem in the tooltip
+    m_memoryLabel = new QLabel();
+    statusBar()->addPermanentWidget(m_memoryLabel);
+    auto* memoryTimer = new QTimer(this);
+    connect(memoryTimer, &QTimer::timeout, this, &MainWindow::refreshMemoryUsage);
+    memoryTimer->start(1000);
+    refreshMemoryUsage();
 }
 
 void MainWindow::createMenus() {
     // File menu
     auto* fileMenu = menuBar()->addMenu(tr("&File"));
     
+    auto* openMeshAction = fileMenu->addAction(tr("&Open mesh..."));
+    connect(openMeshAction, &QAction::triggered, this, &MainWindow::onOpenMesh);
+    fileMenu->addSeparator();
+
+#ifndef BUILD_WASM
+    auto* batchAction = fileMenu->addAction(tr("&Batch export to plates..."));
+    connect(batchAction, &QAction::triggered, this, &MainWindow::onBatchPlateExport);
+    fileMenu->addSeparator();
+
+#endif
     auto* quitAction = fileMenu->addAction(tr("&Quit"));
     quitAction->setShortcut(QKeySequence::Quit);
     connect(quitAction, &QAction::triggered, this, &QMainWindow::close);
@@ -212,6 +279,15 @@ void MainWindow::createMenus() {
     prefsAction->setShortcut(QKeySequence::Preferences);
     connect(prefsAction, &QAction::triggered, this, &MainWindow::showPreferences);
 
+    auto* memoryAction = optionsMenu->addAction(tr("Show &memory usage in preview"));
+    memoryAction->setCheckable(true);
+    memoryAction->setChecked(Settings::instance().value("ui/showMemoryUsage", false).toBool());
+    m_previewWidget->setShowMemoryUsage(memoryAction->isChecked());
+    connect(memoryAction, &QAction::toggled, this, [this](bool checked) {
+        Settings::instance().setValue("ui/showMemoryUsage", checked);
+        m_previewWidget->setShowMemoryUsage(checked);
+    });
+
     // Help menu
     auto* helpMenu = menuBar()->addMenu(tr("&Help"));
     
@@ -252,14 +328,28 @@ void MainWindow::dragEnterEvent(QDragEnterEvent* event) {
 }
 
 void MainWindow::dropEvent(QDropEvent* event) {
+    QStringList paths;
     for (const QUrl& url : event->mimeData()->urls()) {
         QString path = url.toLocalFile();
         QString ext = QFileInfo(path).suffix().toLower();
         if (ImageLoader::isFormatSupported(ext)) {
-            setInputFile(path);
-            return;
+            paths.append(path);
         }
     }
+    if (paths.isEmpty()) {
+        return;
+    }
+#ifndef BUILD_WASM
+    // Several images are meshed in the background with the current
+    // settings, for previewing when they are done
+    if (paths.size() > 1) {
+        m_jobQueue->addImages(paths, meshConfigFromSettings(), m_flipVerticalCheckbox->isChecked());
+        m_jobQueue->setVisible(true);
+        m_statusLabel->setText(tr("Queued %1 images").arg(paths.size()));
+        return;
+    }
+#endif
+    setInputFile(paths.first());
 }
 
 void MainWindow::closeEvent(QCloseEvent* event) {
@@ -284,7 +374,7 @@ void MainWindow::onInputFileSelect() {
 }
 
 void MainWindow::onOutputFileSelect() {
-    QString formats = "STL Files (*.stl);;OBJ Files (*.obj);;3MF Files (*.3mf);;All Files (*)";
+    QString formats = "STL Files (*.stl);;Compressed STL Files (*.stl.gz *.stl.zst);;OBJ Files (*.obj);;3MF Files (*.3mf);;glTF Binary Files (*.glb);;All Files (*)";
     QString startDir = QFileInfo(m_outputLineEdit->text()).absolutePath();
     
     QString file = QFileDialog::getSaveFileName(this, tr("Save output file"), startDir, formats);
@@ -299,10 +389,16 @@ void MainWindow::onExportFormatChanged(int index) {
     QString currentFile = m_outputLineEdit->text();
     QString baseName = QFileInfo(currentFile).completeBaseName();
     QString dir = QFileInfo(currentFile).absolutePath();
+    if (baseName.endsWith(".stl", Qt::CaseInsensitive)) {
+        baseName.chop(4); // Coming from a compressed STL
+    }
     
     QString ext = "stl";
-    if (format == "obj") ext = "obj";
+    if (format == "stl_gz") ext = "stl.gz";
+    else if (format == "stl_zst") ext = "stl.zst";
+    else if (format == "obj") ext = "obj";
     else if (format == "3mf") ext = "3mf";
+    else if (format == "glb") ext = "glb";
     
     QString newPath = QDir(dir).filePath(baseName + "." + ext);
     m_outputLineEdit->setText(newPath);
@@ -318,6 +414,7 @@ void MainWindow::onPreviewClicked() {
     }
 
     m_previewButton->setEnabled(false);
+    setJobQueueEnabled(false);
     m_exportButton->setEnabled(false);
     m_meshReady = false;
     m_progressBar->setVisible(true);
@@ -331,6 +428,7 @@ void MainWindow::onPreviewClicked() {
         QMessageBox::warning(this, tr("Load failed"), 
             tr("Failed to load the image file."));
         m_previewButton->setEnabled(true);
+        setJobQueueEnabled(true);
         m_progressBar->setVisible(false);
         return;
     }
@@ -342,6 +440,7 @@ void MainWindow::onPreviewClicked() {
                "Continue anyway?"));
         if (reply != QMessageBox::Yes) {
             m_previewButton->setEnabled(true);
+            setJobQueueEnabled(true);
             m_progressBar->setVisible(false);
             return;
         }
@@ -361,46 +460,71 @@ void MainWindow::onPreviewClicked() {
     QApplication::processEvents();
 
     // Configure mesh generator
-    auto& settings = Settings::instance();
-    MeshConfig config;
-    config.minThickness = settings.value("render/minThickness", 0.8).toFloat();
-    config.totalThickness = settings.value("render/totalThickness", 4.0).toFloat();
-    config.frameBorder = settings.value("render/frameBorder", 3.0).toFloat();
-    config.width = settings.value("render/width", 200.0).toFloat();
-    config.enableStabilizers = settings.value("render/enableStabilizers", true).toBool();
-    config.permanentStabilizers = settings.value("render/permanentStabilizers", false).toBool();
-    config.stabilizerThreshold = settings.value("render/stabilizerThreshold", 60.0).toFloat();
-    config.stabilizerHeightFactor = settings.value("render/stabilizerHeightFactor", 0.15).toFloat();
-    config.frameSlopeFactor = settings.value("render/frameSlopeFactor", 0.75).toFloat();
-    config.enableHangers = settings.value("render/enableHangers", true).toBool();
-    config.hangerCount = settings.value("render/hangers", 2).toInt();
-
-    m_meshGenerator->setConfig(config);
-
-    // Apply flip based on user preference, then invert for lithophane
-    QImage image = result->image;
-    if (m_flipVerticalCheckbox->isChecked()) {
-        image = image.mirrored(false, true);  // Flip vertically
-    }
-    image.invertPixels();
-
-    // Generate mesh
-    auto generatedMesh = m_meshGenerator->generate(image, [this](int current, int total) {
-        m_progressBar->setValue(10 + (current * 80) / total);
-        QApplication::processEvents();
-    });
+    m_meshGenerator->setConfig(meshConfigFromSettings());
+    QImage image = prepareImage(result->image);
+    const MemoryLease imageMemory(MemorySubsystem::Image, image.sizeInBytes());
 
-    m_currentMesh = generatedMesh;
-    m_meshReady = true;
+#ifndef BUILD_WASM
+    // Show the lithophane filling in while the rest is being generated
+    const MeshBounds bounds = m_meshGenerator->predictBounds(image.size());
+    m_previewWidget->beginStream(bounds.min, bounds.max,
+                                 m_meshGenerator->estimateVertexCount(image.size()));
+    updateLayerSlider();
+    MeshPartCallback partCallback = [this](const QVector3D* vertices, qsizetype count) {
+        m_previewWidget->appendMesh(vertices, count);
+    };
+#else
+    // Free the previous preview before generating the next mesh
+    m_previewWidget->clear();
+    updateLayerSlider();
+    MeshPartCallback partCallback;
+#endif
 
-    m_progressBar->setValue(95);
-    m_statusLabel->setText(tr("Updating preview..."));
-    QApplication::processEvents();
+    // Drop the previous mesh, so the generator reuses its buffer instead
+    // of allocating a second one while the window holds the first.
+    // Peaks are reported per preview.
+    m_currentMesh = QList<QVector3D>();
+    m_importedMeshMemory.resize(0);
+#ifndef BUILD_WASM
+    m_queuedMesh.reset();
+#endif
+    MemoryStats::resetPeaks();
+
+    // Generate mesh; background batch jobs pause meanwhile
+    QList<QVector3D> generatedMesh;
+    {
+        const JobScheduler::InteractiveScope interactive;
+        generatedMesh = m_meshGenerator->generate(image, [this](const Progress& progress) {
+            m_progressBar->setValue(10 + int(progress.fraction() * 80.0));
+            m_statusLabel->setText(tr("Generating mesh... %1")
+                .arg(ProgressMeter::describe(progress, tr("triangles"))));
+            QApplication::processEvents();
+        }, partCallback);
+    }
 
+    m_currentMesh = std::move(generatedMesh);
+    m_meshReady = true;
+
+    const qsizetype lithophaneEnd = m_meshGenerator->lithophaneVertexCount();
 #ifndef BUILD_WASM
-    // Update preview
-    m_previewWidget->setMesh(std::move(generatedMesh));
+    // Shares the generated mesh, so the streamed copy is freed
+    m_previewWidget->finishStream(m_currentMesh);
+#else
+    // Browser memory is tight: show the lithophane as a heightfield
+    // displaced on the GPU instead of a second copy of its triangles
+    m_previewWidget->setSurfaceMesh(m_meshGenerator->heightField(),
+                                    m_currentMesh.mid(lithophaneEnd));
 #endif
+    // The lithophane surface is picked through its heightfield, the
+    // remaining geometry through a BVH
+    m_previewWidget->setPicker(std::make_shared<MeshPicker>(
+        m_meshGenerator->heightField(), m_currentMesh.constData() + lithophaneEnd,
+        m_currentMesh.size() - lithophaneEnd));
+    m_previewWidget->setLayerSlicer(
+        std::make_shared<LayerSlicer>(m_meshGenerator->config(), m_meshGenerator->meshDimensions(),
+                                      m_meshGenerator->heightField()),
+        Settings::instance().value("render/layerHeight", 0.2).toFloat());
+    updateLayerSlider();
 
     m_progressBar->setValue(100);
     m_progressBar->setVisible(false);
@@ -408,6 +532,7 @@ void MainWindow::onPreviewClicked() {
     m_exportButton->setEnabled(true);
     m_statusLabel->setText(tr("Preview ready: %1 triangles. Click Export when satisfied.")
         .arg(m_currentMesh.size() / 3));
+    setJobQueueEnabled(true); // Queue selections made meanwhile replace it
 }
 
 void MainWindow::onExportClicked() {
@@ -434,49 +559,279 @@ void MainWindow::onFlipChanged(bool /*checked*/) {
     }
 }
 
+void MainWindow::onOpenMesh() {
+    const QString file = QFileDialog::getOpenFileName(
+        this, tr("Open mesh"), QFileInfo(m_outputLineEdit->text()).absolutePath(),
+        Importer::fileFilter());
+    if (file.isEmpty()) {
+        return;
+    }
+
+    auto importer = Importer::forFile(file);
+    if (!importer) {
+        QMessageBox::warning(this, tr("Import failed"), tr("Unsupported mesh format."));
+        return;
+    }
+
+    m_statusLabel->setText(tr("Importing %1...").arg(importer->name()));
+    QApplication::processEvents();
+
+    auto result = importer->importMesh(file);
+    if (!result.success) {
+        m_statusLabel->setText(tr("Import failed"));
+        QMessageBox::warning(this, tr("Import failed"), result.errorMessage);
+        return;
+    }
+
+    // An imported mesh replaces the preview and can be exported to any
+    // format, which makes the window usable as a converter
+    m_currentMesh = result.mesh;
+    m_importedMeshMemory.resize(m_currentMesh.capacity() * qint64(sizeof(QVector3D)));
+#ifndef BUILD_WASM
+    m_queuedMesh.reset();
+#endif
+    m_meshReady = true;
+
+    m_previewWidget->setMesh(std::move(result.mesh));
+    m_previewWidget->setPicker(std::make_shared<MeshPicker>(
+        HeightField(), m_currentMesh.constData(), m_currentMesh.size()));
+    updateLayerSlider();
+
+    m_exportButton->setEnabled(true);
+    m_statusLabel->setText(tr("Imported %1: %2 triangles. Click Export to convert.")
+        .arg(QFileInfo(file).fileName())
+        .arg(m_currentMesh.size() / 3));
+}
+
+void MainWindow::updateLayerSlider() {
+    const int layers = m_previewWidget->layerCount();
+    const QSignalBlocker blocker(m_layerSlider);
+    m_layerSlider->setRange(0, layers);
+    m_layerSlider->setValue(layers);
+    m_layerSlider->setVisible(layers > 0);
+}
+
 void MainWindow::doExport() {
     QString outputFile = m_outputLineEdit->text();
     QString format = m_exportFormatCombo->currentData().toString();
 
-    std::unique_ptr<Exporter> exporter;
-    if (format == "stl_bin") {
-        exporter = std::make_unique<StlExporter>(StlFormat::Binary);
-    } else if (format == "stl_ascii") {
-        exporter = std::make_unique<StlExporter>(StlFormat::Ascii);
-    } else if (format == "obj") {
-        exporter = std::make_unique<ObjExporter>();
-    } else if (format == "3mf") {
-        exporter = std::make_unique<ThreeMfExporter>();
-    } else {
-        exporter = std::make_unique<StlExporter>(StlFormat::Binary);
-    }
+    std::unique_ptr<Exporter> exporter = exporterFromSettings(format);
 
-    auto& settings = Settings::instance();
-    if (QFileInfo::exists(outputFile) && !settings.value("export/alwaysOverwrite", false).toBool()) {
+#ifndef BUILD_WASM
+    if (QFileInfo::exists(outputFile) &&
+        !Settings::instance().value("export/alwaysOverwrite", false).toBool()) {
         auto reply = QMessageBox::question(this, tr("Overwrite?"),
             tr("Output file already exists. Overwrite?"));
         if (reply != QMessageBox::Yes) {
             return;
         }
     }
+#else
+    // The file is streamed to the browser as a download named after the
+    // output file, so only its name matters
+    outputFile = QFileInfo(outputFile).fileName();
+    if (outputFile.isEmpty()) {
+        outputFile = QStringLiteral("lithophane.") + exporter->extension();
+    }
+#endif
+
+    // Events are processed during the export to show progress. The mesh
+    // is held by a copy in case it is replaced meanwhile, and the
+    // buttons are disabled until the export is done.
+    const QList<QVector3D> mesh = m_currentMesh;
+    m_previewButton->setEnabled(false);
+    setJobQueueEnabled(false);
+    m_exportButton->setEnabled(false);
+    m_progressBar->setValue(0);
+    m_progressBar->setVisible(true);
+    exporter->setProgressCallback([this](const Progress& progress) {
+        m_progressBar->setValue(progress.percent());
+        m_statusLabel->setText(tr("Exporting... %1")
+            .arg(ProgressMeter::describe(progress, tr("triangles"))));
+        QApplication::processEvents();
+    });
 
-    auto result = exporter->exportMesh(m_currentMesh, outputFile);
+    auto result = exporter->exportMesh(mesh, outputFile);
+    m_progressBar->setVisible(false);
+    m_previewButton->setEnabled(true);
+    setJobQueueEnabled(true);
+    m_exportButton->setEnabled(m_meshReady);
     if (!result.success) {
         QMessageBox::warning(this, tr("Export failed"), result.errorMessage);
     } else {
         QMessageBox::information(this, tr("Export succeeded"),
-            tr("Successfully exported to %1\n\nFile size: %2 KB\nTriangles: %3")
+            tr("Successfully exported to %1\n\nFile size: %2 KB\nTriangles: %3\nWaited for disk: %4 ms")
                 .arg(outputFile)
                 .arg(result.bytesWritten / 1024)
-                .arg(m_currentMesh.size() / 3));
+                .arg(m_currentMesh.size() / 3)
+                .arg(result.writeStallMs));
+    }
+}
+
+void MainWindow::setJobQueueEnabled(bool enabled) {
+#ifndef BUILD_WASM
+    m_jobQueue->setEnabled(enabled);
+    if (enabled && m_pendingQueuedMesh) {
+        showQueuedMesh(std::exchange(m_pendingQueuedMesh, nullptr));
     }
+#else
+    Q_UNUSED(enabled);
+#endif
 }
 
+QImage MainWindow::prepareImage(const QImage& source) const {
+    return prepareLithophaneImage(source, m_flipVerticalCheckbox->isChecked());
+}
+
+#ifndef BUILD_WASM
+void MainWindow::onBatchPlateExport() {
+    const QStringList files = QFileDialog::getOpenFileNames(
+        this, tr("Select images for batch export"),
+        QFileInfo(m_inputLineEdit->text()).absolutePath(),
+        ImageLoader::supportedFormatsFilter());
+    if (files.isEmpty()) {
+        return;
+    }
+
+    const QString outputDir = QFileDialog::getExistingDirectory(
+        this, tr("Select output folder for plates"),
+        QFileInfo(m_outputLineEdit->text()).absolutePath());
+    if (outputDir.isEmpty()) {
+        return;
+    }
+
+    auto& settings = Settings::instance();
+    const QSizeF bedSize(settings.value("export/bedWidth", 250.0).toDouble(),
+                         settings.value("export/bedDepth", 210.0).toDouble());
+    const float spacing = settings.value("export/plateSpacing", 5.0).toFloat();
+
+    // Footprints come from the image headers; meshes are generated lazily
+    // while each plate is written
+    const MeshConfig config = meshConfigFromSettings();
+    MeshGenerator predictor(config);
+    QList<PlateJob> jobs;
+    for (const QString& file : files) {
+        const QSize size = QImageReader(file).size();
+        if (!size.isValid()) {
+            qWarning() << "Cannot read image size, skipped:" << file;
+            continue;
+        }
+
+        PlateJob job;
+        job.name = QFileInfo(file).completeBaseName();
+        job.bounds = predictor.predictBounds(size);
+        job.generate = [this, file, config]() {
+            auto loaded = ImageLoader::load(file);
+            if (!loaded) {
+                return QList<QVector3D>();
+            }
+            MeshGenerator generator(config);
+            return generator.generate(prepareImage(loaded->image));
+        };
+        jobs.append(job);
+    }
+
+    m_previewButton->setEnabled(false);
+    setJobQueueEnabled(false);
+    m_exportButton->setEnabled(false);
+    m_progressBar->setVisible(true);
+    m_progressBar->setValue(0);
+    m_statusLabel->setText(tr("Exporting plates..."));
+    QApplication::processEvents();
+
+    const QString baseName = QFileInfo(m_outputLineEdit->text()).completeBaseName();
+    PlateBatchExporter batchExporter(bedSize, spacing);
+    batchExporter.setWriterBackend(AsyncFileWriter::backendFromName(
+        settings.value("export/writerBackend", "auto").toString()));
+    const auto result = batchExporter.exportPlates(
+        jobs, outputDir, baseName, [this](const Progress& progress) {
+            m_progressBar->setValue(progress.percent());
+            m_statusLabel->setText(tr("Exporting plates... %1/%2 (%3)")
+                .arg(progress.done).arg(progress.total)
+                .arg(ProgressMeter::describe(progress, tr("lithophanes"))));
+            QApplication::processEvents();
+        });
+
+    m_progressBar->setVisible(false);
+    m_previewButton->setEnabled(true);
+    setJobQueueEnabled(true);
+    m_exportButton->setEnabled(m_meshReady);
+
+    if (!result.success) {
+        m_statusLabel->setText(tr("Batch export failed"));
+        QMessageBox::warning(this, tr("Batch export failed"), result.errorMessage);
+        return;
+    }
+
+    QString message = tr("Exported %1 lithophanes on %2 plates to %3\n\nTotal size: %4 KB\nWaited for disk: %5 ms")
+        .arg(jobs.size() - result.skipped.size())
+        .arg(result.files.size())
+        .arg(outputDir)
+        .arg(result.bytesWritten / 1024)
+        .arg(result.writeStallMs);
+    if (!result.skipped.isEmpty()) {
+        message += tr("\n\nToo large for the bed: %1").arg(result.skipped.join(", "));
+    }
+    m_statusLabel->setText(tr("Batch export completed: %1 plates").arg(result.files.size()));
+    QMessageBox::information(this, tr("Batch export succeeded"), message);
+}
+
+void MainWindow::showQueuedMesh(std::shared_ptr<const QueuedMesh> mesh) {
+    // Not in the middle of streaming a preview or exporting; shown when
+    // that is done
+    if (!m_jobQueue->isEnabled()) {
+        m_pendingQueuedMesh = std::move(mesh);
+        return;
+    }
+
+    // The queue's copy is shared, so it is shown and exported without
+    // generating it again or counting its memory twice
+    m_queuedMesh = std::move(mesh);
+    m_currentMesh = m_queuedMesh->mesh;
+    m_importedMeshMemory.resize(0);
+    m_meshReady = true;
+    {
+        const QSignalBlocker blocker(m_inputLineEdit);
+        m_inputLineEdit->setText(m_queuedMesh->input);
+    }
+
+    const qsizetype lithophaneEnd = m_queuedMesh->lithophaneVertexCount;
+    m_previewWidget->setMesh(m_currentMesh);
+    m_previewWidget->setPicker(std::make_shared<MeshPicker>(
+        m_queuedMesh->heightField, m_currentMesh.constData() + lithophaneEnd,
+        m_currentMesh.size() - lithophaneEnd));
+    m_previewWidget->setLayerSlicer(
+        std::make_shared<LayerSlicer>(m_queuedMesh->config, m_queuedMesh->dimensions,
+                                      m_queuedMesh->heightField),
+        Settings::instance().value("render/layerHeight", 0.2).toFloat());
+    updateLayerSlider();
+
+    m_exportButton->setEnabled(true);
+    m_statusLabel->setText(tr("Showing %1 from the queue: %2 triangles. Click Export to save it.")
+        .arg(QFileInfo(m_queuedMesh->input).fileName())
+        .arg(m_currentMesh.size() / 3));
+}
+#endif
+
 void MainWindow::updatePreview() {
     // Generate a quick preview if input file exists
     // This could be done in a background thread for responsiveness
 }
 
+void MainWindow::refreshMemoryUsage() {
+    const QString text = tr("Memory: %1 (peak %2)")
+        .arg(MemoryStats::formatBytes(MemoryStats::currentTotal()),
+             MemoryStats::formatBytes(MemoryStats::peakTotal()));
+    m_memoryLabel->setToolTip(MemoryStats::report().join('\n'));
+    if (text == m_memoryLabel->text()) {
+        return;
+    }
+    m_memoryLabel->setText(text);
+    if (m_previewWidget->showsMemoryUsage()) {
+        m_previewWidget->update();
+    }
+}
+
 void MainWindow::showPreferences() {
     ConfigDialog dialog(this);
     dialog.exec();
@@ -14,19 +14,23 @@
 #include <QCheckBox>
 #include <memory>
 
+#include "core/memorystats.h"
 #include "mesh/meshgenerator.h"
 
 // Forward declarations
 class QLineEdit;
 class QPushButton;
 class QComboBox;
+class QSlider;
 
 namespace LithoMaker {
 
-#ifndef BUILD_WASM
 class PreviewWidget;
-#endif
 class Slider;
+#ifndef BUILD_WASM
+class JobQueuePanel;
+struct QueuedMesh;
+#endif
 
 /**
  * @brief Main application window
@@ -53,9 +57,15 @@ private slots:
     void onOutputFileSelect();
     void onExportFormatChanged(int index);
     void onFlipChanged(bool checked);
+    void onOpenMesh();
+#ifndef BUILD_WASM
+    void onBatchPlateExport();
+    void showQueuedMesh(std::shared_ptr<const QueuedMesh> mesh);
+#endif
     void showPreferences();
     void showAbout();
     void updatePreview();
+    void refreshMemoryUsage();
 
 private:
     void createWidgets();
@@ -64,6 +74,9 @@ private:
     void saveSettings();
     void setInputFile(const QString& path);
     void doExport();
+    void updateLayerSlider();
+    void setJobQueueEnabled(bool enabled);
+    QImage prepareImage(const QImage& image) const;
 
     // UI widgets
     Slider* m_minThicknessSlider{nullptr};
@@ -81,14 +94,23 @@ private:
     QPushButton* m_exportButton{nullptr};
     QProgressBar* m_progressBar{nullptr};
     QLabel* m_statusLabel{nullptr};
-#ifndef BUILD_WASM
     PreviewWidget* m_previewWidget{nullptr};
+    QLabel* m_surfaceLabel{nullptr};
+    QLabel* m_memoryLabel{nullptr};
+    QSlider* m_layerSlider{nullptr};
+#ifndef BUILD_WASM
+    JobQueuePanel* m_jobQueue{nullptr};
 #endif
 
     // Mesh generation
     std::unique_ptr<MeshGenerator> m_meshGenerator;
     QList<QVector3D> m_currentMesh;
+    MemoryLease m_importedMeshMemory{MemorySubsystem::Mesh}; ///< Generated meshes are the generator's
     bool m_meshReady{false};
+#ifndef BUILD_WASM
+    std::shared_ptr<const QueuedMesh> m_queuedMesh; ///< Shown from the job queue
+    std::shared_ptr<const QueuedMesh> m_pendingQueuedMesh; ///< Selected while busy
+#endif
 };
 
 } // namespace LithoMaker
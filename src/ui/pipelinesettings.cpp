@@ -0,0 +1,108 @@
+/**
+ * @file pipelinesettings.cpp
+ * @brief Mesh and export configuration from the user's settings
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "pipelinesettings.h"
+
+#include "core/settings.h"
+#include "export/gltfexporter.h"
+#include "export/objexporter.h"
+#include "export/stlexporter.h"
+#include "export/threemfexporter.h"
+
+#include <QDebug>
+#include <QFile>
+
+namespace LithoMaker {
+
+namespace {
+
+std::unique_ptr<Exporter> make3mfExporter() {
+    auto& settings = Settings::instance();
+    auto exporter = std::make_unique<ThreeMfExporter>();
+    exporter->setBedSize(QSizeF(settings.value("export/bedWidth", 250.0).toDouble(),
+                                settings.value("export/bedDepth", 210.0).toDouble()));
+    exporter->setUpright(settings.value("export/3mfUpright", true).toBool());
+    exporter->setThumbnail(settings.value("export/3mfThumbnail", true).toBool());
+    if (settings.value("export/3mfProfile", true).toBool()) {
+        QFile profile(":/lithophane.ini");
+        if (profile.open(QIODevice::ReadOnly)) {
+            exporter->setSlicerProfile(profile.readAll(),
+                                       QStringLiteral("0.2mm QUALITY @MK3 - Lithophane optimized"));
+        } else {
+            qWarning() << "Cannot read bundled slicer profile:" << profile.errorString();
+        }
+    }
+    return exporter;
+}
+
+} // namespace
+
+MeshConfig meshConfigFromSettings() {
+    auto& settings = Settings::instance();
+    MeshConfig config;
+    config.minThickness = settings.value("render/minThickness", 0.8).toFloat();
+    config.totalThickness = settings.value("render/totalThickness", 4.0).toFloat();
+    config.frameBorder = settings.value("render/frameBorder", 3.0).toFloat();
+    config.width = settings.value("render/width", 200.0).toFloat();
+    config.enableStabilizers = settings.value("render/enableStabilizers", true).toBool();
+    config.permanentStabilizers = settings.value("render/permanentStabilizers", false).toBool();
+    config.stabilizerThreshold = settings.value("render/stabilizerThreshold", 60.0).toFloat();
+    config.stabilizerHeightFactor = settings.value("render/stabilizerHeightFactor", 0.15).toFloat();
+    config.frameSlopeFactor = settings.value("render/frameSlopeFactor", 0.75).toFloat();
+    config.enableHangers = settings.value("render/enableHangers", true).toBool();
+    config.hangerCount = settings.value("render/hangers", 2).toInt();
+    config.reliefMode = settings.value("render/reliefMode", "linear").toString() == "basrelief"
+        ? ReliefMode::BasRelief : ReliefMode::Linear;
+    config.reliefCompression = settings.value("render/reliefCompression", 0.8).toFloat();
+    return config;
+}
+
+QImage prepareLithophaneImage(const QImage& source, bool flipVertically) {
+    QImage image = flipVertically ? source.mirrored(false, true) : source;
+    image.invertPixels();
+    return image;
+}
+
+std::unique_ptr<Exporter> exporterFromSettings(const QString& format) {
+    std::unique_ptr<Exporter> exporter;
+    if (format == "stl_bin") {
+        exporter = std::make_unique<StlExporter>(StlFormat::Binary);
+    } else if (format == "stl_ascii") {
+        exporter = std::make_unique<StlExporter>(StlFormat::Ascii);
+    } else if (format == "stl_gz" || format == "stl_zst") {
+        auto stlExporter = std::make_unique<StlExporter>(StlFormat::Binary);
+        stlExporter->setCompression(format == "stl_gz" ? Compression::Gzip : Compression::Zstd);
+        exporter = std::move(stlExporter);
+    } else if (format == "obj") {
+        exporter = std::make_unique<ObjExporter>();
+    } else if (format == "3mf") {
+        exporter = make3mfExporter();
+    } else if (format == "glb") {
+        exporter = std::make_unique<GltfExporter>();
+    } else {
+        exporter = std::make_unique<StlExporter>(StlFormat::Binary);
+    }
+
+    exporter->setWriterBackend(AsyncFileWriter::backendFromName(
+        Settings::instance().value("export/writerBackend", "auto").toString()));
+    return exporter;
+}
+
+QStringList exportFormats() {
+    QStringList formats{QStringLiteral("stl_bin"), QStringLiteral("stl_ascii")};
+    if (CompressedFileWriter::isSupported(Compression::Gzip)) {
+        formats << QStringLiteral("stl_gz");
+    }
+    if (CompressedFileWriter::isSupported(Compression::Zstd)) {
+        formats << QStringLiteral("stl_zst");
+    }
+    formats << QStringLiteral("obj") << QStringLiteral("3mf") << QStringLiteral("glb");
+    return formats;
+}
+
+} // namespace LithoMaker
@@ -0,0 +1,43 @@
+/**
+ * @file pipelinesettings.h
+ * @brief Mesh and export configuration from the user's settings
+ *
+ * Copyright 2021-2024 Lars Muldjord / Contributors
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#pragma once
+
+#include "export/exporter.h"
+#include "mesh/meshgenerator.h"
+
+#include <QImage>
+#include <QStringList>
+#include <memory>
+
+namespace LithoMaker {
+
+/**
+ * @brief Mesh parameters as set in the preferences
+ */
+MeshConfig meshConfigFromSettings();
+
+/**
+ * @brief Image as the mesh generator expects it: inverted, so dark
+ *        areas become thick, and optionally flipped vertically
+ */
+QImage prepareLithophaneImage(const QImage& source, bool flipVertically);
+
+/**
+ * @brief Exporter for a format, set up as in the preferences
+ * @param format Format id: stl_bin, stl_ascii, stl_gz, stl_zst, obj, 3mf or glb.
+ *               Unknown ids give a binary STL exporter.
+ */
+std::unique_ptr<Exporter> exporterFromSettings(const QString& format);
+
+/**
+ * @brief Format ids supported in this build
+ */
+QStringList exportFormats();
+
+} // namespace LithoMaker
@@ -9,14 +9,22 @@
 #include "previewwidget.h"
 
 #include <QDebug>
+#include <QFontMetrics>
+#include <QOpenGLContext>
+#include <QPainter>
+#include <QScreen>
 #include <QtMath>
+#include <algorithm>
+#include <limits>
 #include <utility>
 
 namespace LithoMaker {
 
+// Shader sources leave out the #version line; shaderSource() adds the
+// one for the context, and the bodies are valid GLSL 3.30 and GLSL ES 3.00
+
 // Vertex shader
 static const char* vertexShaderSource = R"(
-    #version 330 core
     layout(location = 0) in vec3 position;
     layout(location = 1) in vec3 normal;
     
@@ -26,28 +34,83 @@ static const char* vertexShaderSource = R"(
     
     out vec3 fragNormal;
     out vec3 fragPos;
+    out float meshHeight;
+    
+    void main() {
+        gl_Position = mvp * vec4(position, 1.0);
+        fragPos = vec3(model * vec4(position, 1.0));
+        fragNormal = normalMatrix * normal;
+        meshHeight = position.y;
+    }
+)";
+
+// Lithophane surface from a heightfield texture. Vertices are made up
+// from gl_VertexID, two triangles per cell split like the generated
+// mesh, so no vertex buffer is needed
+static const char* surfaceVertexShaderSource = R"(
+    uniform mat4 mvp;
+    uniform mat4 model;
+    uniform mat3 normalMatrix;
+    uniform sampler2D heights;
+    uniform vec3 origin;
+    uniform float spacing;
+    
+    out vec3 fragNormal;
+    out vec3 fragPos;
+    out float meshHeight;
+    
+    const ivec2 corners[6] = ivec2[6](ivec2(0, 0), ivec2(1, 1), ivec2(0, 1),
+                                      ivec2(0, 0), ivec2(1, 0), ivec2(1, 1));
+    
+    float heightAt(ivec2 grid, ivec2 size) {
+        // Float textures cannot be filtered in WebGL2, so fetch texels
+        return texelFetch(heights, clamp(grid, ivec2(0), size - 1), 0).r;
+    }
     
     void main() {
+        ivec2 size = textureSize(heights, 0);
+        int cell = gl_VertexID / 6;
+        ivec2 grid = ivec2(cell % (size.x - 1), cell / (size.x - 1)) + corners[gl_VertexID % 6];
+        vec3 position = vec3(origin.xy + vec2(grid) * spacing, heightAt(grid, size));
+        
+        // Smooth normals from central differences
+        float dx = heightAt(grid + ivec2(1, 0), size) - heightAt(grid - ivec2(1, 0), size);
+        float dy = heightAt(grid + ivec2(0, 1), size) - heightAt(grid - ivec2(0, 1), size);
+        vec3 normal = normalize(vec3(-dx, -dy, 2.0 * spacing));
+        
         gl_Position = mvp * vec4(position, 1.0);
         fragPos = vec3(model * vec4(position, 1.0));
         fragNormal = normalMatrix * normal;
+        meshHeight = position.y;
     }
 )";
 
 // Fragment shader with Phong lighting
 static const char* fragmentShaderSource = R"(
-    #version 330 core
     in vec3 fragNormal;
     in vec3 fragPos;
+    in float meshHeight;
     
     uniform vec3 lightPos;
     uniform vec3 lightColor;
     uniform vec3 objectColor;
     uniform vec3 viewPos;
+    uniform float clipHeight;
+    uniform vec3 cutColor;
     
     out vec4 fragColor;
     
     void main() {
+        // Layer view: cut away everything above the layer, and show the
+        // inside seen through the cut as solid
+        if (meshHeight > clipHeight) {
+            discard;
+        }
+        if (!gl_FrontFacing) {
+            fragColor = vec4(cutColor, 1.0);
+            return;
+        }
+        
         // Ambient
         float ambientStrength = 0.3;
         vec3 ambient = ambientStrength * lightColor;
@@ -70,17 +133,67 @@ static const char* fragmentShaderSource = R"(
     }
 )";
 
+// Upscales the reduced resolution frame rendered during interaction
+static const char* blitVertexShaderSource = R"(
+    out vec2 texCoord;
+    
+    void main() {
+        // One triangle covering the viewport, no vertex buffer needed
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        texCoord = corner;
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+static const char* blitFragmentShaderSource = R"(
+    in vec2 texCoord;
+    
+    uniform sampler2D image;
+    
+    out vec4 fragColor;
+    
+    void main() {
+        fragColor = texture(image, texCoord);
+    }
+)";
+
+// Interaction ends this long after the last mouse event
+static constexpr int kInteractionIdleMs = 150;
+// Mouse travel below which a press and release count as a click
+static constexpr qreal kClickTolerance = 4.0;
+static constexpr float kMinInteractionScale = 0.25f;
+static constexpr float kMaxInteractionScale = 1.0f;
+
+static QByteArray shaderSource(const QOpenGLContext* context, const char* body) {
+    QByteArray source = context->isOpenGLES()
+        ? QByteArrayLiteral("#version 300 es\n"
+                            "precision highp float;\nprecision highp int;\nprecision highp sampler2D;\n")
+        : QByteArrayLiteral("#version 330 core\n");
+    return source + body;
+}
+
 PreviewWidget::PreviewWidget(QWidget* parent)
     : QOpenGLWidget(parent)
 {
     setMinimumSize(300, 300);
     setFocusPolicy(Qt::StrongFocus);
+    setMouseTracking(true); // Hover picking
     
     // Enable multisampling for smoother edges
     QSurfaceFormat format;
     format.setSamples(4);
     format.setDepthBufferSize(24);
+#ifdef BUILD_WASM
+    // WebGL2
+    format.setRenderableType(QSurfaceFormat::OpenGLES);
+    format.setVersion(3, 0);
+#endif
     setFormat(format);
+
+    m_interactionTimer.setSingleShot(true);
+    m_interactionTimer.setInterval(kInteractionIdleMs);
+    connect(&m_interactionTimer, &QTimer::timeout, this, &PreviewWidget::onInteractionFinished);
+    connect(this, &QOpenGLWidget::frameSwapped, this, &PreviewWidget::onFrameSwapped);
 }
 
 PreviewWidget::~PreviewWidget() {
@@ -88,7 +201,12 @@ PreviewWidget::~PreviewWidget() {
     m_vertexBuffer.destroy();
     m_normalBuffer.destroy();
     m_vao.destroy();
+    m_blitVao.destroy();
+    m_interactionFbo.reset();
+    m_surfaceTexture.reset();
     delete m_program;
+    delete m_blitProgram;
+    delete m_surfaceProgram;
     doneCurrent();
 }
 
@@ -99,34 +217,61 @@ void PreviewWidget::initializeGL() {
     glEnable(GL_CULL_FACE);
     glCullFace(GL_BACK);
     
-    // Background color
-    if (m_darkTheme) {
-        glClearColor(0.12f, 0.12f, 0.14f, 1.0f);
-    } else {
-        glClearColor(0.94f, 0.94f, 0.94f, 1.0f);
-    }
+    applyClearColor();
     
     setupShaders();
     
     m_vao.create();
+    m_blitVao.create();
     m_vertexBuffer.create();
     m_normalBuffer.create();
 }
 
 void PreviewWidget::setupShaders() {
+    const QOpenGLContext* glContext = context();
     m_program = new QOpenGLShaderProgram(this);
     
-    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexShaderSource)) {
+    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                            shaderSource(glContext, vertexShaderSource))) {
         qWarning() << "Vertex shader compilation failed:" << m_program->log();
     }
     
-    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentShaderSource)) {
+    if (!m_program->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                            shaderSource(glContext, fragmentShaderSource))) {
         qWarning() << "Fragment shader compilation failed:" << m_program->log();
     }
     
     if (!m_program->link()) {
         qWarning() << "Shader linking failed:" << m_program->log();
     }
+
+    m_surfaceProgram = new QOpenGLShaderProgram(this);
+    if (!m_surfaceProgram->addShaderFromSourceCode(
+            QOpenGLShader::Vertex, shaderSource(glContext, surfaceVertexShaderSource)) ||
+        !m_surfaceProgram->addShaderFromSourceCode(
+            QOpenGLShader::Fragment, shaderSource(glContext, fragmentShaderSource)) ||
+        !m_surfaceProgram->link()) {
+        qWarning() << "Surface shader setup failed:" << m_surfaceProgram->log();
+    }
+
+    m_blitProgram = new QOpenGLShaderProgram(this);
+    if (!m_blitProgram->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                                shaderSource(glContext, blitVertexShaderSource)) ||
+        !m_blitProgram->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                                shaderSource(glContext, blitFragmentShaderSource)) ||
+        !m_blitProgram->link()) {
+        qWarning() << "Blit shader setup failed, interaction stays at full quality:"
+                   << m_blitProgram->log();
+    }
+}
+
+void PreviewWidget::applyClearColor() {
+    // Background color
+    if (m_darkTheme) {
+        glClearColor(0.12f, 0.12f, 0.14f, 1.0f);
+    } else {
+        glClearColor(0.94f, 0.94f, 0.94f, 1.0f);
+    }
 }
 
 void PreviewWidget::resizeGL(int w, int h) {
@@ -134,91 +279,543 @@ void PreviewWidget::resizeGL(int w, int h) {
 }
 
 void PreviewWidget::paintGL() {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    
-    if (m_mesh.isEmpty() || !m_program->isLinked()) {
-        return;
-    }
-    
-    if (m_meshDirty) {
-        updateMeshBuffer();
-        m_meshDirty = false;
+    // The measurement overlay's QPainter may have changed these
+    applyClearColor();
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    if (m_interacting && hasGeometry() && m_program->isLinked() && m_blitProgram->isLinked()) {
+        paintInteractive();
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        if (!hasGeometry() || !m_program->isLinked()) {
+            return;
+        }
+
+        drawScene(width(), height());
     }
-    
-    m_program->bind();
-    
-    // Calculate matrices
+
+    drawOverlay();
+}
+
+QMatrix4x4 PreviewWidget::modelMatrix() const {
     QMatrix4x4 model;
     model.translate(-m_meshCenter);
     model.rotate(m_rotationX, 1.0f, 0.0f, 0.0f);
     model.rotate(m_rotationY, 0.0f, 1.0f, 0.0f);
-    
+    return model;
+}
+
+QMatrix4x4 PreviewWidget::viewMatrix() const {
     QMatrix4x4 view;
     float distance = m_meshRadius * 2.5f / m_zoom;
     view.lookAt(QVector3D(0, 0, distance), QVector3D(0, 0, 0), QVector3D(0, 1, 0));
-    
+    return view;
+}
+
+QMatrix4x4 PreviewWidget::projectionMatrix(float aspect) const {
     QMatrix4x4 projection;
-    float aspect = float(width()) / float(height());
     projection.perspective(45.0f, aspect, 0.1f, m_meshRadius * 10.0f);
+    return projection;
+}
+
+void PreviewWidget::drawScene(int viewportWidth, int viewportHeight) {
+    if (m_meshDirty || m_uploadedVertices < m_mesh.size()) {
+        updateMeshBuffer();
+        m_meshDirty = false;
+    }
+    if (m_surfaceDirty) {
+        updateSurfaceTexture();
+        m_surfaceDirty = false;
+    }
+    
+    // Calculate matrices
+    const QMatrix4x4 model = modelMatrix();
+    const QMatrix4x4 view = viewMatrix();
+    const float distance = m_meshRadius * 2.5f / m_zoom;
+    const QMatrix4x4 projection = projectionMatrix(float(viewportWidth) / float(viewportHeight));
     
     QMatrix4x4 mvp = projection * view * model;
     QMatrix3x3 normalMatrix = model.normalMatrix();
     
-    m_program->setUniformValue("mvp", mvp);
-    m_program->setUniformValue("model", model);
-    m_program->setUniformValue("normalMatrix", normalMatrix);
-    m_program->setUniformValue("lightPos", QVector3D(m_meshRadius * 2, m_meshRadius * 2, m_meshRadius * 3));
-    m_program->setUniformValue("lightColor", m_lightColor);
-    m_program->setUniformValue("objectColor", m_meshColor);
-    m_program->setUniformValue("viewPos", QVector3D(0, 0, distance));
+    // Both programs share the fragment shader
+    const auto setUniforms = [&](QOpenGLShaderProgram* program) {
+        program->setUniformValue("mvp", mvp);
+        program->setUniformValue("model", model);
+        program->setUniformValue("normalMatrix", normalMatrix);
+        program->setUniformValue("lightPos", QVector3D(m_meshRadius * 2, m_meshRadius * 2, m_meshRadius * 3));
+        program->setUniformValue("lightColor", m_lightColor);
+        program->setUniformValue("objectColor", m_meshColor);
+        program->setUniformValue("viewPos", QVector3D(0, 0, distance));
+        program->setUniformValue("clipHeight", layerViewActive()
+            ? float(m_layer + 1) * m_layerHeight : std::numeric_limits<float>::max());
+        program->setUniformValue("cutColor", QVector3D(1.0f, 0.55f, 0.0f));
+    };
     
-    m_vao.bind();
-    glDrawArrays(GL_TRIANGLES, 0, m_mesh.size());
-    m_vao.release();
-    
-    m_program->release();
+    // Back faces are only visible through the cut
+    if (layerViewActive()) {
+        glDisable(GL_CULL_FACE);
+    }
+
+    if (m_uploadedVertices > 0) {
+        m_program->bind();
+        setUniforms(m_program);
+        m_vao.bind();
+        glDrawArrays(GL_TRIANGLES, 0, m_uploadedVertices);
+        m_vao.release();
+        m_program->release();
+    }
+
+    if (m_surfaceTexture && m_surfaceProgram->isLinked()) {
+        m_surfaceProgram->bind();
+        setUniforms(m_surfaceProgram);
+        m_surfaceProgram->setUniformValue("heights", 0);
+        m_surfaceProgram->setUniformValue("origin", m_surface.origin());
+        m_surfaceProgram->setUniformValue("spacing", m_surfaceSpacing);
+        m_surfaceTexture->bind(0);
+        m_blitVao.bind(); // No vertex attributes, like the blit
+        glDrawArrays(GL_TRIANGLES, 0,
+                     (m_surfaceGrid.width() - 1) * (m_surfaceGrid.height() - 1) * 6);
+        m_blitVao.release();
+        m_surfaceTexture->release(0);
+        m_surfaceProgram->release();
+    }
+
+    glEnable(GL_CULL_FACE);
+}
+
+void PreviewWidget::updateSurfaceTexture() {
+    m_surfaceTexture.reset();
+    m_surfaceTextureBytes = 0;
+    if (m_surface.isEmpty()) {
+        updateMemoryUsage();
+        return;
+    }
+
+    // Images larger than the GPU's texture limit are previewed with
+    // every step-th sample
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+    maxSize = std::max(maxSize, 2);
+    const int largest = std::max(m_surface.width(), m_surface.height());
+    const int step = (largest + maxSize - 1) / maxSize;
+    const int gridWidth = (m_surface.width() - 1) / step + 1;
+    const int gridHeight = (m_surface.height() - 1) / step + 1;
+
+    const float* heights = m_surface.heights().constData();
+    QVector<float> decimated;
+    if (step > 1) {
+        decimated.resize(qsizetype(gridWidth) * gridHeight);
+        for (int y = 0; y < gridHeight; ++y) {
+            for (int x = 0; x < gridWidth; ++x) {
+                decimated[qsizetype(y) * gridWidth + x] = m_surface.sample(x * step, y * step);
+            }
+        }
+        heights = decimated.constData();
+        qInfo() << "Preview surface reduced to" << gridWidth << "x" << gridHeight
+                << "samples for the GPU texture limit";
+    }
+
+    m_surfaceTexture = std::make_unique<QOpenGLTexture>(QOpenGLTexture::Target2D);
+    m_surfaceTexture->setFormat(QOpenGLTexture::R32F);
+    m_surfaceTexture->setSize(gridWidth, gridHeight);
+    m_surfaceTexture->setMipLevels(1);
+    m_surfaceTexture->allocateStorage(QOpenGLTexture::Red, QOpenGLTexture::Float32);
+    m_surfaceTexture->setMinMagFilters(QOpenGLTexture::Nearest, QOpenGLTexture::Nearest);
+    m_surfaceTexture->setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_surfaceTexture->setData(QOpenGLTexture::Red, QOpenGLTexture::Float32, heights);
+    m_surfaceGrid = QSize(gridWidth, gridHeight);
+    m_surfaceSpacing = m_surface.spacing() * float(step);
+    m_surfaceTextureBytes = qint64(gridWidth) * gridHeight * qint64(sizeof(float));
+    updateMemoryUsage();
+}
+
+void PreviewWidget::paintInteractive() {
+    const qreal ratio = devicePixelRatioF();
+    const QSize fullSize(qRound(width() * ratio), qRound(height() * ratio));
+    const QSize size(std::max(1, qRound(fullSize.width() * m_interactionScale)),
+                     std::max(1, qRound(fullSize.height() * m_interactionScale)));
+
+    // Single-sampled, so this pass also skips the cost of multisampling
+    if (!m_interactionFbo || m_interactionFbo->size() != size) {
+        m_interactionFbo = std::make_unique<QOpenGLFramebufferObject>(
+            size, QOpenGLFramebufferObject::Depth);
+        glBindTexture(GL_TEXTURE_2D, m_interactionFbo->texture());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    m_interactionFbo->bind();
+    glViewport(0, 0, size.width(), size.height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawScene(size.width(), size.height());
+
+    // Scale the frame up into the widget
+    glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    glViewport(0, 0, fullSize.width(), fullSize.height());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDisable(GL_DEPTH_TEST);
+
+    m_blitProgram->bind();
+    m_blitProgram->setUniformValue("image", 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_interactionFbo->texture());
+    m_blitVao.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    m_blitVao.release();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    m_blitProgram->release();
+
+    glEnable(GL_DEPTH_TEST);
+}
+
+bool PreviewWidget::pickAt(const QPointF& position, SurfaceHit& hit) const {
+    if (!m_picker || width() <= 0 || height() <= 0) {
+        return false;
+    }
+
+    // Unproject through the inverse of the full transform, which gives
+    // the ray directly in mesh coordinates
+    const QMatrix4x4 mvp = projectionMatrix(float(width()) / float(height())) *
+                           viewMatrix() * modelMatrix();
+    bool invertible = false;
+    const QMatrix4x4 inverse = mvp.inverted(&invertible);
+    if (!invertible) {
+        return false;
+    }
+    const float x = float(2.0 * position.x() / width() - 1.0);
+    const float y = float(1.0 - 2.0 * position.y() / height());
+    const QVector3D nearPoint = inverse.map(QVector3D(x, y, -1.0f));
+    const QVector3D farPoint = inverse.map(QVector3D(x, y, 1.0f));
+    if (!m_picker->pick(nearPoint, farPoint - nearPoint, hit)) {
+        return false;
+    }
+    // The cut away part of the layer view cannot be picked
+    return !layerViewActive() || hit.position.y() <= float(m_layer + 1) * m_layerHeight;
+}
+
+void PreviewWidget::drawOverlay() {
+    if (m_measurePoints.isEmpty() && !layerViewActive() && !m_showMemoryUsage) {
+        return;
+    }
+
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    drawMeasurement(painter);
+    drawLayerSection(painter);
+    drawMemoryUsage(painter);
+}
+
+void PreviewWidget::drawMeasurement(QPainter& painter) {
+    if (m_measurePoints.isEmpty()) {
+        return;
+    }
+
+    const QMatrix4x4 mvp = projectionMatrix(float(width()) / float(height())) *
+                           viewMatrix() * modelMatrix();
+    QList<QPointF> points;
+    for (const QVector3D& point : m_measurePoints) {
+        const QVector3D ndc = mvp.map(point);
+        points.append(QPointF((ndc.x() + 1.0f) * 0.5f * width(), (1.0f - ndc.y()) * 0.5f * height()));
+    }
+
+    painter.setPen(QPen(QColor(255, 140, 0), 2));
+    painter.setBrush(QColor(255, 140, 0));
+    for (const QPointF& point : points) {
+        painter.drawEllipse(point, 3.0, 3.0);
+    }
+    if (points.size() == 2) {
+        painter.drawLine(points[0], points[1]);
+        const float distance = m_measurePoints[0].distanceToPoint(m_measurePoints[1]);
+        painter.setPen(m_darkTheme ? Qt::white : Qt::black);
+        painter.drawText((points[0] + points[1]) / 2.0 + QPointF(6, -6),
+                         tr("%1 mm").arg(double(distance), 0, 'f', 2));
+    }
+}
+
+void PreviewWidget::drawLayerSection(QPainter& painter) {
+    if (!layerViewActive()) {
+        return;
+    }
+
+    // Inset in the lower left corner. The section is a few millimeters
+    // thick and up to hundreds wide, so thickness is stretched to fit
+    const QRectF extent = m_layerSlicer->extent();
+    const qreal margin = 10.0;
+    const QRectF panel(margin, height() - margin - 120.0,
+                       std::min<qreal>(width() - 2 * margin, 360.0), 120.0);
+    const QRectF area = panel.adjusted(8.0, 24.0, -8.0, -8.0);
+    if (area.width() <= 0.0 || extent.isEmpty()) {
+        return;
+    }
+    const qreal scaleX = area.width() / extent.width();
+    const qreal scaleZ = area.height() / extent.height();
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(m_darkTheme ? QColor(0, 0, 0, 160) : QColor(255, 255, 255, 200));
+    painter.drawRoundedRect(panel, 4.0, 4.0);
+
+    painter.setPen(m_darkTheme ? Qt::white : Qt::black);
+    painter.drawText(panel.adjusted(8.0, 4.0, -8.0, 0.0), Qt::AlignLeft | Qt::AlignTop,
+                     tr("Layer %1 / %2 at %3 mm (thickness x%4)")
+                         .arg(m_layer + 1)
+                         .arg(layerCount())
+                         .arg(double(m_layerSection.height), 0, 'f', 2)
+                         .arg(scaleZ / scaleX, 0, 'f', 0));
+
+    // Mesh Z points towards the viewer of the image, drawn upwards here
+    painter.setPen(QPen(QColor(255, 140, 0), 1.0));
+    painter.setBrush(QColor(255, 140, 0, 110));
+    for (const QPolygonF& outline : m_layerSection.outlines) {
+        QPolygonF mapped;
+        mapped.reserve(outline.size());
+        for (const QPointF& point : outline) {
+            mapped.append(QPointF(area.left() + (point.x() - extent.left()) * scaleX,
+                                  area.bottom() - (point.y() - extent.top()) * scaleZ));
+        }
+        painter.drawPolygon(mapped);
+    }
+}
+
+void PreviewWidget::drawMemoryUsage(QPainter& painter) {
+    if (!m_showMemoryUsage) {
+        return;
+    }
+
+    QStringList lines = MemoryStats::report();
+    lines.append(tr("Total: %1 (peak %2)")
+        .arg(MemoryStats::formatBytes(MemoryStats::currentTotal()),
+             MemoryStats::formatBytes(MemoryStats::peakTotal())));
+
+    // Panel in the upper left corner, sized to the text
+    const QFontMetrics metrics = painter.fontMetrics();
+    int textWidth = 0;
+    for (const QString& line : lines) {
+        textWidth = std::max(textWidth, metrics.horizontalAdvance(line));
+    }
+    const qreal margin = 10.0;
+    const QRectF panel(margin, margin, textWidth + 16.0, lines.size() * metrics.height() + 8.0);
+
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(m_darkTheme ? QColor(0, 0, 0, 160) : QColor(255, 255, 255, 200));
+    painter.drawRoundedRect(panel, 4.0, 4.0);
+
+    painter.setPen(m_darkTheme ? Qt::white : Qt::black);
+    painter.drawText(panel.adjusted(8.0, 4.0, -8.0, -4.0), Qt::AlignLeft | Qt::AlignTop,
+                     lines.join('\n'));
+}
+
+void PreviewWidget::setShowMemoryUsage(bool show) {
+    m_showMemoryUsage = show;
+    update();
+}
+
+void PreviewWidget::setPicker(std::shared_ptr<const MeshPicker> picker) {
+    m_picker = std::move(picker);
+    m_measurePoints.clear();
+    update();
+}
+
+void PreviewWidget::setLayerSlicer(std::shared_ptr<const LayerSlicer> slicer, float layerHeight) {
+    m_layerSlicer = std::move(slicer);
+    m_layerHeight = layerHeight > 0.0f ? layerHeight : 0.2f;
+    m_layer = -1;
+    m_layerSection = LayerSection();
+    update();
+}
+
+int PreviewWidget::layerCount() const {
+    return m_layerSlicer ? m_layerSlicer->layerCount(m_layerHeight) : 0;
+}
+
+void PreviewWidget::setLayer(int layer) {
+    if (!m_layerSlicer || layer < 0 || layer >= layerCount()) {
+        layer = -1;
+    }
+    if (layer == m_layer) {
+        return;
+    }
+
+    // Sections are cheap enough to compute for every step of a scrub;
+    // slicers sample the middle of each layer
+    m_layer = layer;
+    m_layerSection = layer >= 0
+        ? m_layerSlicer->section((float(layer) + 0.5f) * m_layerHeight) : LayerSection();
+    update();
+}
+
+void PreviewWidget::requestInteractiveUpdate() {
+    m_interacting = true;
+    m_interactionTimer.start();
+
+    // At most one frame in flight; input arriving meanwhile is folded
+    // into the next frame, which is started when this one is shown
+    if (m_frameInFlight) {
+        m_redrawPending = true;
+        return;
+    }
+    m_frameInFlight = true;
+    m_frameClock.start();
+    update();
+}
+
+void PreviewWidget::onFrameSwapped() {
+    m_frameInFlight = false;
+    if (!m_redrawPending) {
+        return;
+    }
+    m_redrawPending = false;
+
+    // Input is waiting for frames, so frame time is what limits the
+    // interaction: trade resolution for it
+    if (m_interacting && m_frameClock.isValid()) {
+        const qreal refreshRate = screen() ? screen()->refreshRate() : 60.0;
+        const qreal refreshMs = 1000.0 / std::max<qreal>(refreshRate, 1.0);
+        const qreal frameMs = m_frameClock.nsecsElapsed() / 1e6;
+        if (frameMs > refreshMs * 1.5) {
+            m_interactionScale = std::max(kMinInteractionScale, m_interactionScale * 0.8f);
+        } else if (frameMs < refreshMs * 1.1) {
+            m_interactionScale = std::min(kMaxInteractionScale, m_interactionScale * 1.1f);
+        }
+    }
+
+    m_frameInFlight = true;
+    m_frameClock.start();
+    update();
+}
+
+void PreviewWidget::onInteractionFinished() {
+    m_interactionTimer.stop();
+    m_interacting = false;
+    m_frameInFlight = false;
+    m_redrawPending = false;
+    update(); // Full quality frame
 }
 
 void PreviewWidget::setMesh(QList<QVector3D> mesh) {
+    setSurfaceMesh(HeightField(), std::move(mesh));
+}
+
+void PreviewWidget::setSurfaceMesh(HeightField surface, QList<QVector3D> mesh) {
+    m_picker.reset();
+    m_layerSlicer.reset();
+    m_layer = -1;
+    m_measurePoints.clear();
     m_mesh = std::move(mesh);
+    m_surface = std::move(surface);
+    m_reservedVertices = 0;
     m_meshDirty = true;
+    m_surfaceDirty = true;
 
-    // Calculate bounding box and center
-    if (!m_mesh.isEmpty()) {
-        QVector3D minBound(std::numeric_limits<float>::max(),
-                          std::numeric_limits<float>::max(),
-                          std::numeric_limits<float>::max());
-        QVector3D maxBound(std::numeric_limits<float>::lowest(),
-                          std::numeric_limits<float>::lowest(),
-                          std::numeric_limits<float>::lowest());
-
-        for (const auto& v : m_mesh) {
-            minBound.setX(std::min(minBound.x(), v.x()));
-            minBound.setY(std::min(minBound.y(), v.y()));
-            minBound.setZ(std::min(minBound.z(), v.z()));
-            maxBound.setX(std::max(maxBound.x(), v.x()));
-            maxBound.setY(std::max(maxBound.y(), v.y()));
-            maxBound.setZ(std::max(maxBound.z(), v.z()));
-        }
+    m_normals.clear();
+    if (hasGeometry()) {
+        updateBounds();
+        appendNormals(0);
+    }
 
-        m_meshCenter = (minBound + maxBound) / 2.0f;
-        m_meshRadius = (maxBound - minBound).length() / 2.0f;
+    qsizetype triangles = m_mesh.size() / 3;
+    if (!m_surface.isEmpty()) {
+        triangles += qsizetype(m_surface.width() - 1) * (m_surface.height() - 1) * 2;
+    }
+    updateMemoryUsage();
+    emit meshUpdated(int(triangles));
+    update();  // Trigger repaint
+
+    qInfo() << "Preview updated:" << triangles << "triangles";
+}
 
-        calculateNormals();
+void PreviewWidget::beginStream(const QVector3D& min, const QVector3D& max,
+                                qsizetype expectedVertices) {
+    m_picker.reset();
+    m_layerSlicer.reset();
+    m_layer = -1;
+    m_measurePoints.clear();
+    m_surface = HeightField();
+    m_surfaceDirty = true;
+    m_mesh.clear();
+    m_normals.clear();
+    m_mesh.reserve(expectedVertices);
+    m_normals.reserve(expectedVertices);
+    m_reservedVertices = expectedVertices;
+    m_meshDirty = true;
+
+    // Place the camera for the final size right away, so it does not
+    // move while the mesh fills in
+    m_meshCenter = (min + max) / 2.0f;
+    m_meshRadius = (max - min).length() / 2.0f;
+    updateMemoryUsage();
+    update();
+}
+
+void PreviewWidget::appendMesh(const QVector3D* vertices, qsizetype count) {
+    const qsizetype first = m_mesh.size();
+    m_mesh.resize(first + count);
+    std::copy(vertices, vertices + count, m_mesh.begin() + first);
+    appendNormals(first);
+    updateMemoryUsage();
+    update();
+}
+
+void PreviewWidget::finishStream(QList<QVector3D> mesh) {
+    m_reservedVertices = 0;
+    // Same vertices, so the normals and uploaded buffers stay valid
+    if (!mesh.isEmpty() && mesh.size() == m_mesh.size()) {
+        m_mesh = std::move(mesh);
+    }
+    if (!m_mesh.isEmpty()) {
+        updateBounds();
     }
+    updateMemoryUsage();
 
     emit meshUpdated(m_mesh.size() / 3);
-    update();  // Trigger repaint
+    update();
 
     qInfo() << "Preview updated:" << (m_mesh.size() / 3) << "triangles";
 }
 
-void PreviewWidget::calculateNormals() {
-    m_normals.clear();
+void PreviewWidget::updateBounds() {
+    QVector3D minBound(std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::max());
+    QVector3D maxBound(std::numeric_limits<float>::lowest(),
+                      std::numeric_limits<float>::lowest(),
+                      std::numeric_limits<float>::lowest());
+
+    for (const auto& v : m_mesh) {
+        minBound.setX(std::min(minBound.x(), v.x()));
+        minBound.setY(std::min(minBound.y(), v.y()));
+        minBound.setZ(std::min(minBound.z(), v.z()));
+        maxBound.setX(std::max(maxBound.x(), v.x()));
+        maxBound.setY(std::max(maxBound.y(), v.y()));
+        maxBound.setZ(std::max(maxBound.z(), v.z()));
+    }
+
+    if (!m_surface.isEmpty()) {
+        const QVector3D& origin = m_surface.origin();
+        const QVector<float>& heights = m_surface.heights();
+        const float top = *std::max_element(heights.cbegin(), heights.cend());
+        const QVector3D corner = origin + QVector3D((m_surface.width() - 1) * m_surface.spacing(),
+                                                    (m_surface.height() - 1) * m_surface.spacing(),
+                                                    0.0f);
+        minBound.setX(std::min(minBound.x(), origin.x()));
+        minBound.setY(std::min(minBound.y(), origin.y()));
+        minBound.setZ(std::min(minBound.z(), origin.z()));
+        maxBound.setX(std::max(maxBound.x(), corner.x()));
+        maxBound.setY(std::max(maxBound.y(), corner.y()));
+        maxBound.setZ(std::max(maxBound.z(), top));
+    }
+
+    m_meshCenter = (minBound + maxBound) / 2.0f;
+    m_meshRadius = (maxBound - minBound).length() / 2.0f;
+}
+
+void PreviewWidget::appendNormals(qsizetype first) {
     m_normals.reserve(m_mesh.size());
     
     // Calculate per-face normals (flat shading)
-    for (int i = 0; i < m_mesh.size(); i += 3) {
+    for (qsizetype i = first; i < m_mesh.size(); i += 3) {
         QVector3D v0 = m_mesh[i];
         QVector3D v1 = m_mesh[i + 1];
         QVector3D v2 = m_mesh[i + 2];
@@ -234,30 +831,74 @@ void PreviewWidget::calculateNormals() {
     }
 }
 
+void PreviewWidget::updateMemoryUsage() {
+    // The mesh is usually shared with the window's copy and only costs
+    // memory here once this widget holds the last reference
+    qint64 bytes = m_normals.capacity() * qint64(sizeof(QVector3D));
+    if (m_mesh.isDetached()) {
+        bytes += m_mesh.capacity() * qint64(sizeof(QVector3D));
+    }
+    bytes += m_bufferCapacity * qint64(2 * sizeof(QVector3D)); // Vertex and normal buffers
+    bytes += m_surfaceTextureBytes;
+    m_memory.resize(bytes);
+}
+
 void PreviewWidget::updateMeshBuffer() {
-    if (m_mesh.isEmpty()) return;
+    if (m_mesh.isEmpty()) {
+        m_uploadedVertices = 0;
+        return;
+    }
     
     m_vao.bind();
     
+    // Reallocate only for a new mesh or when a streamed one outgrows the
+    // buffers; otherwise just the new vertices are written
+    if (m_meshDirty || m_mesh.size() > m_bufferCapacity) {
+        m_bufferCapacity = std::max({m_mesh.size(), m_reservedVertices,
+                                     m_meshDirty ? qsizetype(0) : m_bufferCapacity * 2});
+        const int bytes = static_cast<int>(m_bufferCapacity * sizeof(QVector3D));
+
+        m_vertexBuffer.bind();
+        m_vertexBuffer.allocate(bytes);
+        m_program->enableAttributeArray(0);
+        m_program->setAttributeBuffer(0, GL_FLOAT, 0, 3, sizeof(QVector3D));
+
+        m_normalBuffer.bind();
+        m_normalBuffer.allocate(bytes);
+        m_program->enableAttributeArray(1);
+        m_program->setAttributeBuffer(1, GL_FLOAT, 0, 3, sizeof(QVector3D));
+
+        m_uploadedVertices = 0;
+    }
+
+    const int offset = static_cast<int>(m_uploadedVertices * sizeof(QVector3D));
+    const int bytes = static_cast<int>((m_mesh.size() - m_uploadedVertices) * sizeof(QVector3D));
+
     // Upload vertex positions
     m_vertexBuffer.bind();
-    m_vertexBuffer.allocate(m_mesh.constData(), m_mesh.size() * sizeof(QVector3D));
-    m_program->enableAttributeArray(0);
-    m_program->setAttributeBuffer(0, GL_FLOAT, 0, 3, sizeof(QVector3D));
+    m_vertexBuffer.write(offset, m_mesh.constData() + m_uploadedVertices, bytes);
     
     // Upload normals
     m_normalBuffer.bind();
-    m_normalBuffer.allocate(m_normals.constData(), m_normals.size() * sizeof(QVector3D));
-    m_program->enableAttributeArray(1);
-    m_program->setAttributeBuffer(1, GL_FLOAT, 0, 3, sizeof(QVector3D));
+    m_normalBuffer.write(offset, m_normals.constData() + m_uploadedVertices, bytes);
     
     m_vao.release();
+    m_uploadedVertices = m_mesh.size();
+    updateMemoryUsage();
 }
 
 void PreviewWidget::clear() {
+    m_picker.reset();
+    m_layerSlicer.reset();
+    m_layer = -1;
+    m_measurePoints.clear();
+    m_surface = HeightField();
+    m_surfaceDirty = true;
     m_mesh.clear();
     m_normals.clear();
+    m_uploadedVertices = 0;
     m_meshDirty = true;
+    updateMemoryUsage();
     update();
 }
 
@@ -272,21 +913,33 @@ void PreviewWidget::setDarkTheme(bool dark) {
     m_darkTheme = dark;
     if (context()) {
         makeCurrent();
-        if (dark) {
-            glClearColor(0.12f, 0.12f, 0.14f, 1.0f);
-        } else {
-            glClearColor(0.94f, 0.94f, 0.94f, 1.0f);
-        }
+        applyClearColor();
         doneCurrent();
     }
     update();
 }
 
+void PreviewWidget::leaveEvent(QEvent* event) {
+    QOpenGLWidget::leaveEvent(event);
+    emit surfaceLeft();
+}
+
 void PreviewWidget::mousePressEvent(QMouseEvent* event) {
     m_lastMousePos = event->position();
+    m_pressPos = event->position();
 }
 
 void PreviewWidget::mouseMoveEvent(QMouseEvent* event) {
+    if (event->buttons() == Qt::NoButton) {
+        SurfaceHit hit;
+        if (pickAt(event->position(), hit)) {
+            emit surfaceHovered(hit);
+        } else {
+            emit surfaceLeft();
+        }
+        return;
+    }
+
     QPointF delta = event->position() - m_lastMousePos;
     m_lastMousePos = event->position();
     
@@ -298,15 +951,44 @@ void PreviewWidget::mouseMoveEvent(QMouseEvent* event) {
         // Clamp vertical rotation
         m_rotationX = qBound(-90.0f, m_rotationX, 90.0f);
         
+        requestInteractiveUpdate();
+    }
+}
+
+void PreviewWidget::mouseReleaseEvent(QMouseEvent* event) {
+    if (m_interacting) {
+        onInteractionFinished();
+    }
+
+    if ((event->position() - m_pressPos).manhattanLength() > kClickTolerance) {
+        return; // End of a drag
+    }
+
+    if (event->button() == Qt::RightButton) {
+        m_measurePoints.clear();
         update();
+        return;
+    }
+
+    SurfaceHit hit;
+    if (event->button() != Qt::LeftButton || !pickAt(event->position(), hit)) {
+        return;
     }
+    if (m_measurePoints.size() >= 2) {
+        m_measurePoints.clear();
+    }
+    m_measurePoints.append(hit.position);
+    if (m_measurePoints.size() == 2) {
+        emit distanceMeasured(m_measurePoints[0].distanceToPoint(m_measurePoints[1]));
+    }
+    update();
 }
 
 void PreviewWidget::wheelEvent(QWheelEvent* event) {
     float delta = event->angleDelta().y() / 120.0f;
     m_zoom *= (1.0f + delta * 0.1f);
     m_zoom = qBound(0.1f, m_zoom, 10.0f);
-    update();
+    requestInteractiveUpdate();
 }
 
 } // namespace LithoMaker
@@ -13,13 +13,23 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLVertexArrayObject>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLTexture>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <QVector3D>
 #include <QMatrix4x4>
 #include <QList>
 #include <QMouseEvent>
 #include <QWheelEvent>
+#include <memory>
+
+#include "core/memorystats.h"
+#include "mesh/layerslicer.h"
+#include "mesh/meshpicker.h"
 
 class QLabel;
+class QPainter;
 
 namespace LithoMaker {
 
@@ -27,6 +37,25 @@ namespace LithoMaker {
  * @brief OpenGL-based 3D preview widget
  *
  * Displays the lithophane mesh with mouse-controlled rotation and zoom.
+ *
+ * While the camera is being dragged or zoomed, frames are rendered
+ * without multisampling into a smaller offscreen buffer that is scaled
+ * up to the widget, and redraws are limited to one per displayed frame.
+ * The scale adapts to how long frames take, and full quality returns
+ * shortly after the interaction stops.
+ *
+ * With a MeshPicker set, hovering reports the surface under the cursor
+ * and two clicks measure the distance between surface points (right
+ * click clears the measurement).
+ *
+ * In layer view, everything above the current print layer is cut away
+ * and the layer's outline is shown in an inset, like a slicer preview.
+ *
+ * The memory held by the subsystems (see MemoryStats) can be shown in
+ * the upper left corner.
+ *
+ * Shaders are written for both OpenGL 3.3 core and OpenGL ES 3 /
+ * WebGL2, so the same widget serves the desktop and browser builds.
  */
 class PreviewWidget : public QOpenGLWidget, protected QOpenGLFunctions {
     Q_OBJECT
@@ -41,6 +70,42 @@ public:
      */
     void setMesh(QList<QVector3D> mesh);
 
+    /**
+     * @brief Show a lithophane given as its surface plus other triangles
+     * @param surface Lithophane surface
+     * @param mesh Remaining triangles (frame, stabilizers, hangers)
+     *
+     * The surface is uploaded as a float texture and its triangles are
+     * generated by the vertex shader, so it takes 4 bytes per pixel of
+     * GPU and widget memory instead of 18 vertices with normals. Used
+     * where memory is tight, as in the browser.
+     */
+    void setSurfaceMesh(HeightField surface, QList<QVector3D> mesh);
+
+    /**
+     * @brief Start showing a mesh that arrives in parts
+     * @param min Expected lower bounds, used to place the camera
+     * @param max Expected upper bounds
+     * @param expectedVertices Expected vertex count, to size GPU buffers
+     *
+     * Parts added with appendMesh() are uploaded with sub-buffer updates,
+     * so only new data is transferred while the mesh is being generated.
+     */
+    void beginStream(const QVector3D& min, const QVector3D& max, qsizetype expectedVertices);
+
+    /**
+     * @brief Add triangles to a mesh started with beginStream()
+     */
+    void appendMesh(const QVector3D* vertices, qsizetype count);
+
+    /**
+     * @brief Mark a streamed mesh complete and fit the camera to it
+     * @param mesh The complete mesh, which must hold the vertices that
+     *        were appended, in order; the widget then shares it instead
+     *        of keeping its own copy. Ignored if the sizes differ.
+     */
+    void finishStream(QList<QVector3D> mesh = {});
+
     /**
      * @brief Clear the mesh display
      */
@@ -56,22 +121,78 @@ public:
      */
     void setDarkTheme(bool dark);
 
+    /**
+     * @brief Set the picking structure for the displayed mesh
+     * @param picker Picker, or nullptr to disable picking
+     */
+    void setPicker(std::shared_ptr<const MeshPicker> picker);
+
+    /**
+     * @brief Set the layer source for the displayed mesh
+     * @param slicer Slicer, or nullptr if the mesh has no layer view
+     * @param layerHeight Print layer height (mm)
+     */
+    void setLayerSlicer(std::shared_ptr<const LayerSlicer> slicer, float layerHeight);
+
+    /**
+     * @brief Number of print layers, 0 without a layer slicer
+     */
+    int layerCount() const;
+
+    /**
+     * @brief Show the mesh up to a print layer
+     * @param layer Layer index, or -1 to show the whole mesh
+     */
+    void setLayer(int layer);
+
+    /**
+     * @brief Show memory use per subsystem over the preview
+     */
+    void setShowMemoryUsage(bool show);
+    bool showsMemoryUsage() const { return m_showMemoryUsage; }
+
 signals:
     void meshUpdated(int triangleCount);
+    void surfaceHovered(const LithoMaker::SurfaceHit& hit);
+    void surfaceLeft();
+    void distanceMeasured(float distance);
 
 protected:
     void initializeGL() override;
     void resizeGL(int w, int h) override;
     void paintGL() override;
 
+    void leaveEvent(QEvent* event) override;
     void mousePressEvent(QMouseEvent* event) override;
     void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
 
+private slots:
+    void onFrameSwapped();
+    void onInteractionFinished();
+
 private:
     void setupShaders();
+    void applyClearColor();
+    QMatrix4x4 modelMatrix() const;
+    QMatrix4x4 viewMatrix() const;
+    QMatrix4x4 projectionMatrix(float aspect) const;
+    bool pickAt(const QPointF& position, SurfaceHit& hit) const;
+    void drawOverlay();
+    void drawMeasurement(QPainter& painter);
+    void drawLayerSection(QPainter& painter);
+    void drawMemoryUsage(QPainter& painter);
+    bool layerViewActive() const { return m_layerSlicer && m_layer >= 0; }
+    bool hasGeometry() const { return !m_mesh.isEmpty() || !m_surface.isEmpty(); }
+    void drawScene(int viewportWidth, int viewportHeight);
+    void updateSurfaceTexture();
+    void paintInteractive();
+    void requestInteractiveUpdate();
     void updateMeshBuffer();
-    void calculateNormals();
+    void updateBounds();
+    void appendNormals(qsizetype first);
+    void updateMemoryUsage();
 
     // Mesh data
     QList<QVector3D> m_mesh;
@@ -85,6 +206,44 @@ private:
     QOpenGLBuffer m_normalBuffer{QOpenGLBuffer::VertexBuffer};
     QOpenGLVertexArrayObject m_vao;
     bool m_meshDirty{false};
+    qsizetype m_bufferCapacity{0};   // Vertices the GPU buffers can hold
+    qsizetype m_uploadedVertices{0}; // Vertices already on the GPU
+    qsizetype m_reservedVertices{0}; // Expected size of a streamed mesh
+
+    // Heightfield surface, displaced in the vertex shader
+    HeightField m_surface;
+    QOpenGLShaderProgram* m_surfaceProgram{nullptr};
+    std::unique_ptr<QOpenGLTexture> m_surfaceTexture;
+    QSize m_surfaceGrid;      // Samples in the texture
+    float m_surfaceSpacing{1.0f};
+    bool m_surfaceDirty{false};
+    qint64 m_surfaceTextureBytes{0};
+
+    // Interaction mode
+    QOpenGLShaderProgram* m_blitProgram{nullptr};
+    QOpenGLVertexArrayObject m_blitVao;
+    std::unique_ptr<QOpenGLFramebufferObject> m_interactionFbo;
+    QTimer m_interactionTimer;
+    QElapsedTimer m_frameClock;
+    float m_interactionScale{0.5f}; // Fraction of the widget's pixels per axis
+    bool m_interacting{false};
+    bool m_frameInFlight{false};
+    bool m_redrawPending{false};
+
+    // Picking and measurement
+    std::shared_ptr<const MeshPicker> m_picker;
+    QList<QVector3D> m_measurePoints;
+    QPointF m_pressPos;
+
+    // Layer view
+    std::shared_ptr<const LayerSlicer> m_layerSlicer;
+    float m_layerHeight{0.2f};
+    int m_layer{-1};
+    LayerSection m_layerSection;
+
+    // Memory accounting
+    MemoryLease m_memory{MemorySubsystem::Preview};
+    bool m_showMemoryUsage{false};
 
     // Camera/View
     float m_rotationX{-20.0f};   // Slight tilt forward
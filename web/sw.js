@@ -0,0 +1,51 @@
+/**
+ * LithoMaker service worker
+ *
+ * Keeps the application files of the deployed build in the Cache API, so
+ * repeat visits load the WebAssembly module without a download and the
+ * browser can reuse its compiled code. The deploy workflow replaces
+ * __BUILD_ID__ with the commit being deployed; a new deployment therefore
+ * installs a new worker, which fetches the new files as one set and
+ * removes the old cache.
+ */
+
+const CACHE_NAME = 'lithomaker-__BUILD_ID__';
+const APP_FILES = [
+    './',
+    'index.html',
+    'style.css',
+    'favicon.png',
+    'qtloader.js',
+    'LithoMaker.js',
+    'LithoMaker.wasm'
+];
+
+self.addEventListener('install', (event) => {
+    event.waitUntil(
+        caches.open(CACHE_NAME)
+            .then((cache) => cache.addAll(APP_FILES))
+            .then(() => self.skipWaiting())
+    );
+});
+
+self.addEventListener('activate', (event) => {
+    event.waitUntil(
+        caches.keys()
+            .then((names) => Promise.all(names
+                .filter((name) => name.startsWith('lithomaker-') && name !== CACHE_NAME)
+                .map((name) => caches.delete(name))))
+            .then(() => self.clients.claim())
+    );
+});
+
+self.addEventListener('fetch', (event) => {
+    if (event.request.method !== 'GET') {
+        return;
+    }
+    // Cache first: the files of one build never change
+    event.respondWith(
+        caches.open(CACHE_NAME).then((cache) =>
+            cache.match(event.request, { ignoreSearch: true }).then((cached) =>
+                cached || fetch(event.request)))
+    );
+});